@@ -3,7 +3,9 @@ LOCAL_PATH := $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := \
-        C2DColorConverter.cpp
+        C2DColorConverter.cpp \
+        ColorConverterLayout.cpp \
+        CPUColorConverter.cpp
 
 LOCAL_C_INCLUDES := \
     $(TARGET_OUT_HEADERS)/qcom/display
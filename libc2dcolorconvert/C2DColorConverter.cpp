@@ -28,53 +28,90 @@
  */
 
 #include <C2DColorConverter.h>
+#include "ColorConverterLayout.h"
+#include "CPUColorConverter.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <linux/msm_kgsl.h>
+#include <linux/msm_ion.h>
 #include <sys/ioctl.h>
 #include <utils/Log.h>
 #include <dlfcn.h>
 #include <errno.h>
+#include <pthread.h>
 
 #undef LOG_TAG
 #define LOG_TAG "C2DColorConvert"
-#define ALIGN( num, to ) (((num) + (to-1)) & (~(to-1)))
-#define ALIGN8K 8192
-#define ALIGN4K 4096
-#define ALIGN2K 2048
-#define ALIGN128 128
-#define ALIGN32 32
-#define ALIGN16 16
+/* Room for the mappings of every blit in flight, and some to reuse */
+#define GPU_MAP_CACHE_SIZE 16
 
 //-----------------------------------------------------
 namespace android {
 
-class C2DColorConverter : public C2DColorConverterBase {
+class C2DColorConverter : public ColorConverterLayout {
 
 public:
     C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags,size_t srcStride);
-    int32_t getBuffReq(int32_t port, C2DBuffReq *req);
     int32_t dumpOutput(char * filename, char mode);
+    void flushMappings();
+    int convertC2DAsync(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, c2d_ts_handle *ts);
+    int waitC2D(c2d_ts_handle ts);
+    int convertRows(void * srcData, void * dstData, size_t row, size_t rows);
+    int setOutputClip(uint8_t lumaMax, uint8_t chromaMax);
+    /* The GPU converts whole surfaces */
+    bool canConvertRows() { return false; }
+    int getError() { return mError; }
 protected:
     virtual ~C2DColorConverter();
     virtual int convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData);
 
 private:
-    bool isYUVSurface(ColorConvertFormat format);
-    void *getDummySurfaceDef(ColorConvertFormat format, size_t width, size_t height, bool isSource);
-    C2D_STATUS updateYUVSurfaceDef(uint8_t *addr, void *base, void * data, bool isSource);
-    C2D_STATUS updateRGBSurfaceDef(uint8_t *addr, void * data, bool isSource);
+    /*
+     * GPU mappings kept across conversions, the buffers rarely change.
+     * The entry holds the ION handle of its buffer, 0 if ION did not know
+     * the fd, and such an entry only lasts until its slot is reused.
+     * Entries read by a blit in flight are busy and never evicted.
+     */
+    struct GPUMapping {
+        struct ion_handle_data ion;
+        void *ptr;
+        size_t len;
+        void *gpuAddr;
+        uint32_t lastUse;
+        uint32_t busy;
+    };
+
+    /*
+     * Surfaces and blit of one conversion in flight. Submits take the
+     * slots in turn, so a pending blit never sees its surfaces updated.
+     */
+    struct BlitSlot {
+        uint32_t srcSurface, dstSurface;
+        void *srcSurfaceDef;
+        void *dstSurfaceDef;
+        C2D_OBJECT blit;
+        GPUMapping *srcMap;
+        GPUMapping *dstMap;
+        c2d_ts_handle ts;
+        uint32_t seq;
+        bool pending;
+    };
+
+    int drawC2D(BlitSlot *slot, int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData);
+    int waitSlot(BlitSlot *slot);
+    void completeSlot(BlitSlot *slot);
+    void createSlot(BlitSlot *slot);
+    void destroySlot(BlitSlot *slot);
+    void *getDummySurfaceDef(ColorConvertFormat format, size_t width, size_t height, bool isSource, uint32_t *surfaceId);
+    C2D_STATUS updateYUVSurfaceDef(BlitSlot *slot, uint8_t *addr, void *base, void * data, bool isSource);
+    C2D_STATUS updateRGBSurfaceDef(BlitSlot *slot, uint8_t *addr, void * data, bool isSource);
     uint32_t getC2DFormat(ColorConvertFormat format);
-    size_t calcStride(ColorConvertFormat format, size_t width);
-    size_t calcYSize(ColorConvertFormat format, size_t width, size_t height);
-    size_t calcSize(ColorConvertFormat format, size_t width, size_t height);
     void *getMappedGPUAddr(int bufFD, void *bufPtr, size_t bufLen);
     bool unmapGPUAddr(unsigned long gAddr);
-    size_t calcLumaAlign(ColorConvertFormat format);
-    size_t calcSizeAlign(ColorConvertFormat format);
-    C2DBytesPerPixel calcBytesPerPixel(ColorConvertFormat format);
+    GPUMapping *getCachedGPUAddr(int bufFD, void *bufPtr, size_t bufLen);
+    void releaseMapping(GPUMapping *map);
 
     void *mC2DLibHandle;
     LINK_c2dCreateSurface mC2DCreateSurface;
@@ -88,30 +125,34 @@ private:
     LINK_c2dMapAddr mC2DMapAddr;
     LINK_c2dUnMapAddr mC2DUnMapAddr;
 
-    uint32_t mSrcSurface, mDstSurface;
-    void * mSrcSurfaceDef;
-    void * mDstSurfaceDef;
-
-    C2D_OBJECT mBlit;
-    size_t mSrcWidth;
-    size_t mSrcHeight;
-    size_t mSrcStride;
-    size_t mDstWidth;
-    size_t mDstHeight;
-    size_t mSrcSize;
-    size_t mDstSize;
-    size_t mSrcYSize;
-    size_t mDstYSize;
-    enum ColorConvertFormat mSrcFormat;
-    enum ColorConvertFormat mDstFormat;
-    int32_t mFlags;
+    BlitSlot mSlots[C2D_MAX_ASYNC];
+    /* Slot the next submit takes, and the one drawn last */
+    uint32_t mNextSlot;
+    uint32_t mLastSlot;
+
+    GPUMapping mMappings[GPU_MAP_CACHE_SIZE];
+    uint32_t mMapClock;
+    /* Our own ION client, it names the buffer behind a client fd */
+    int mIonFd;
+    /* Guards the slots and the mappings, never held over a GPU wait */
+    pthread_mutex_t mLock;
 
     int mError;
 };
 
 C2DColorConverter::C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride)
+    : ColorConverterLayout(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride)
 {
      mError = 0;
+     mMapClock = 0;
+     memset(mMappings, 0, sizeof(mMappings));
+     memset(mSlots, 0, sizeof(mSlots));
+     mNextSlot = 0;
+     mLastSlot = 0;
+     pthread_mutex_init(&mLock, NULL);
+     mIonFd = open("/dev/ion", O_RDONLY);
+     if (mIonFd < 0)
+         ALOGE("ION open failed, GPU mappings are not reused\n");
      mC2DLibHandle = dlopen("libC2D2.so", RTLD_NOW);
      if (!mC2DLibHandle) {
          ALOGE("FATAL ERROR: could not dlopen libc2d2.so: %s", dlerror());
@@ -137,36 +178,8 @@ C2DColorConverter::C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t d
          return;
      }
 
-    mSrcWidth = srcWidth;
-    mSrcHeight = srcHeight;
-    mSrcStride = srcStride;;
-    mDstWidth = dstWidth;
-    mDstHeight = dstHeight;
-    mSrcFormat = srcFormat;
-    mDstFormat = dstFormat;
-    mSrcSize = calcSize(srcFormat, srcWidth, srcHeight);
-    mDstSize = calcSize(dstFormat, dstWidth, dstHeight);
-    mSrcYSize = calcYSize(srcFormat, srcWidth, srcHeight);
-    mDstYSize = calcYSize(dstFormat, dstWidth, dstHeight);
-    mSrcSurfaceDef = NULL;
-    mDstSurfaceDef = NULL;
-
-    mFlags = flags; // can be used for rotation
-
-    mSrcSurfaceDef = getDummySurfaceDef(srcFormat, srcWidth, srcHeight, true);
-    mDstSurfaceDef = getDummySurfaceDef(dstFormat, dstWidth, dstHeight, false);
-
-    memset((void*)&mBlit,0,sizeof(C2D_OBJECT));
-    mBlit.source_rect.x = 0 << 16;
-    mBlit.source_rect.y = 0 << 16;
-    mBlit.source_rect.width = srcWidth << 16;
-    mBlit.source_rect.height = srcHeight << 16;
-    mBlit.target_rect.x = 0 << 16;
-    mBlit.target_rect.y = 0 << 16;
-    mBlit.target_rect.width = dstWidth << 16;
-    mBlit.target_rect.height = dstHeight << 16;
-    mBlit.config_mask = C2D_ALPHA_BLEND_NONE | C2D_NO_BILINEAR_BIT | C2D_NO_ANTIALIASING_BIT | C2D_TARGET_RECT_BIT;
-    mBlit.surface_id = mSrcSurface;
+    /* The other slots get their surfaces once the pipeline reaches them */
+    createSlot(&mSlots[0]);
 }
 
 C2DColorConverter::~C2DColorConverter()
@@ -175,31 +188,102 @@ C2DColorConverter::~C2DColorConverter()
         if (mC2DLibHandle) {
             dlclose(mC2DLibHandle);
         }
+        if (mIonFd >= 0)
+            close(mIonFd);
+        pthread_mutex_destroy(&mLock);
         return;
     }
 
-    mC2DDestroySurface(mDstSurface);
-    mC2DDestroySurface(mSrcSurface);
+    flushMappings();
+    if (mIonFd >= 0)
+        close(mIonFd);
+    for (int i = 0; i < C2D_MAX_ASYNC; i++)
+        destroySlot(&mSlots[i]);
+
+    dlclose(mC2DLibHandle);
+    pthread_mutex_destroy(&mLock);
+}
+
+void C2DColorConverter::createSlot(BlitSlot *slot)
+{
+    slot->srcSurfaceDef = getDummySurfaceDef(mSrcFormat, mSrcWidth, mSrcHeight, true, &slot->srcSurface);
+    slot->dstSurfaceDef = getDummySurfaceDef(mDstFormat, mDstWidth, mDstHeight, false, &slot->dstSurface);
+
+    memset((void*)&slot->blit,0,sizeof(C2D_OBJECT));
+    slot->blit.source_rect.x = 0 << 16;
+    slot->blit.source_rect.y = 0 << 16;
+    slot->blit.source_rect.width = mSrcWidth << 16;
+    slot->blit.source_rect.height = mSrcHeight << 16;
+    slot->blit.target_rect.x = 0 << 16;
+    slot->blit.target_rect.y = 0 << 16;
+    slot->blit.target_rect.width = mDstWidth << 16;
+    slot->blit.target_rect.height = mDstHeight << 16;
+    slot->blit.config_mask = C2D_ALPHA_BLEND_NONE | C2D_NO_BILINEAR_BIT | C2D_NO_ANTIALIASING_BIT | C2D_TARGET_RECT_BIT;
+    slot->blit.surface_id = slot->srcSurface;
+}
+
+void C2DColorConverter::destroySlot(BlitSlot *slot)
+{
+    if (!slot->srcSurfaceDef)
+        return;
+
+    mC2DDestroySurface(slot->dstSurface);
+    mC2DDestroySurface(slot->srcSurface);
     if (isYUVSurface(mSrcFormat)) {
-        delete ((C2D_YUV_SURFACE_DEF *)mSrcSurfaceDef);
+        delete ((C2D_YUV_SURFACE_DEF *)slot->srcSurfaceDef);
     } else {
-        delete ((C2D_RGB_SURFACE_DEF *)mSrcSurfaceDef);
+        delete ((C2D_RGB_SURFACE_DEF *)slot->srcSurfaceDef);
     }
 
     if (isYUVSurface(mDstFormat)) {
-        delete ((C2D_YUV_SURFACE_DEF *)mDstSurfaceDef);
+        delete ((C2D_YUV_SURFACE_DEF *)slot->dstSurfaceDef);
     } else {
-        delete ((C2D_RGB_SURFACE_DEF *)mDstSurfaceDef);
+        delete ((C2D_RGB_SURFACE_DEF *)slot->dstSurfaceDef);
     }
-    mSrcSurfaceDef = NULL;
-    mDstSurfaceDef = NULL;
+    slot->srcSurfaceDef = NULL;
+    slot->dstSurfaceDef = NULL;
+}
 
-    dlclose(mC2DLibHandle);
+/* The blit of the slot is done, its buffers may be unmapped again */
+void C2DColorConverter::completeSlot(BlitSlot *slot)
+{
+    slot->pending = false;
+    slot->srcMap->busy--;
+    slot->dstMap->busy--;
+    slot->srcMap = NULL;
+    slot->dstMap = NULL;
 }
 
-int C2DColorConverter::convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData)
+/*
+ * Waits for the blit of a pending slot, called with mLock held. The lock
+ * is dropped over the wait so that the next blits can be submitted.
+ */
+int C2DColorConverter::waitSlot(BlitSlot *slot)
+{
+    C2D_STATUS status;
+    c2d_ts_handle ts = slot->ts;
+    uint32_t seq = slot->seq;
+
+    pthread_mutex_unlock(&mLock);
+    status = mC2DWaitTimestamp(ts);
+    pthread_mutex_lock(&mLock);
+    if (slot->pending && slot->seq == seq)
+        completeSlot(slot);
+    if (status != C2D_STATUS_OK) {
+        ALOGE("C2D WaitTimestamp failed: status %d\n", status);
+        return -status;
+    }
+    return 0;
+}
+
+/*
+ * Points the surfaces of the slot at the buffers and records the blit,
+ * called with mLock held on a slot that is not pending.
+ */
+int C2DColorConverter::drawC2D(BlitSlot *slot, int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData)
 {
     C2D_STATUS ret;
+    GPUMapping *srcMap, *dstMap;
     uint8_t *srcMappedGpuAddr = nullptr;
     uint8_t *dstMappedGpuAddr = nullptr;
 
@@ -213,81 +297,130 @@ int C2DColorConverter::convertC2D(int srcFd, void *srcBase, void * srcData, int
         return -1;
     }
 
-    srcMappedGpuAddr = (uint8_t *)getMappedGPUAddr(srcFd, srcData, mSrcSize);
-    if (!srcMappedGpuAddr)
+    if (!slot->srcSurfaceDef)
+        createSlot(slot);
+
+    srcMap = getCachedGPUAddr(srcFd, srcData, mSrcSize);
+    if (!srcMap)
         return -1;
+    srcMappedGpuAddr = (uint8_t *)srcMap->gpuAddr;
 
     if (isYUVSurface(mSrcFormat)) {
-        ret = updateYUVSurfaceDef(srcMappedGpuAddr, srcBase, srcData, true);
+        ret = updateYUVSurfaceDef(slot, srcMappedGpuAddr, srcBase, srcData, true);
     } else {
-        ret = updateRGBSurfaceDef(srcMappedGpuAddr, srcData, true);
+        ret = updateRGBSurfaceDef(slot, srcMappedGpuAddr, srcData, true);
     }
 
     if (ret != C2D_STATUS_OK) {
         ALOGE("Update src surface def failed\n");
-        unmapGPUAddr((unsigned long)srcMappedGpuAddr);
         return -ret;
     }
 
-    dstMappedGpuAddr = (uint8_t *)getMappedGPUAddr(dstFd, dstData, mDstSize);
-    if (!dstMappedGpuAddr) {
-        unmapGPUAddr((unsigned long)srcMappedGpuAddr);
+    dstMap = getCachedGPUAddr(dstFd, dstData, mDstSize);
+    if (!dstMap)
         return -1;
-    }
+    dstMappedGpuAddr = (uint8_t *)dstMap->gpuAddr;
 
     if (isYUVSurface(mDstFormat)) {
-        ret = updateYUVSurfaceDef(dstMappedGpuAddr, dstBase, dstData, false);
+        ret = updateYUVSurfaceDef(slot, dstMappedGpuAddr, dstBase, dstData, false);
     } else {
-        ret = updateRGBSurfaceDef(dstMappedGpuAddr, dstData, false);
+        ret = updateRGBSurfaceDef(slot, dstMappedGpuAddr, dstData, false);
     }
 
     if (ret != C2D_STATUS_OK) {
         ALOGE("Update dst surface def failed\n");
-        unmapGPUAddr((unsigned long)srcMappedGpuAddr);
-        unmapGPUAddr((unsigned long)dstMappedGpuAddr);
         return -ret;
     }
 
-    mBlit.surface_id = mSrcSurface;
-    ret = mC2DDraw(mDstSurface, C2D_TARGET_ROTATE_0, 0, 0, 0, &mBlit, 1);
-    mC2DFinish(mDstSurface);
-
-    bool unmappedSrcSuccess;
-    unmappedSrcSuccess = unmapGPUAddr((unsigned long)srcMappedGpuAddr);
-
-    bool unmappedDstSuccess;
-    unmappedDstSuccess = unmapGPUAddr((unsigned long)dstMappedGpuAddr);
-
+    mLastSlot = slot - mSlots;
+    slot->blit.surface_id = slot->srcSurface;
+    ret = mC2DDraw(slot->dstSurface, C2D_TARGET_ROTATE_0, 0, 0, 0, &slot->blit, 1);
     if (ret != C2D_STATUS_OK) {
         ALOGE("C2D Draw failed\n");
         return -ret; //c2d err values are positive
-    } else {
-        if (!unmappedSrcSuccess || !unmappedDstSuccess) {
-            ALOGE("unmapping GPU address failed\n");
-            return -1;
-        }
+    }
+    slot->srcMap = srcMap;
+    slot->dstMap = dstMap;
+    return ret;
+}
+
+/* Draws on the slot the next submit takes, nothing is in flight then */
+int C2DColorConverter::convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData)
+{
+    BlitSlot *slot;
+    int ret;
+
+    pthread_mutex_lock(&mLock);
+    slot = &mSlots[mNextSlot];
+    ret = slot->pending ? waitSlot(slot) : 0;
+    if (ret >= 0)
+        ret = drawC2D(slot, srcFd, srcBase, srcData, dstFd, dstBase, dstData);
+    if (ret >= 0)
+        mC2DFinish(slot->dstSurface);
+    pthread_mutex_unlock(&mLock);
+    return ret;
+}
+
+/*
+ * Returns once the blit is flushed. Each blit in flight has a slot of its
+ * own, only a submit that finds its slot still pending waits for the GPU.
+ */
+int C2DColorConverter::convertC2DAsync(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, c2d_ts_handle *ts)
+{
+    C2D_STATUS status;
+    BlitSlot *slot;
+    int ret;
+
+    if (!ts)
+        return -1;
+
+    pthread_mutex_lock(&mLock);
+    slot = &mSlots[mNextSlot];
+    ret = slot->pending ? waitSlot(slot) : 0;
+    if (ret >= 0)
+        ret = drawC2D(slot, srcFd, srcBase, srcData, dstFd, dstBase, dstData);
+    if (ret < 0) {
+        pthread_mutex_unlock(&mLock);
         return ret;
     }
+
+    status = mC2DFlush(slot->dstSurface, ts);
+    if (status != C2D_STATUS_OK) {
+        ALOGE("C2D Flush failed: status %d\n", status);
+        mC2DFinish(slot->dstSurface);
+        pthread_mutex_unlock(&mLock);
+        return -status;
+    }
+    slot->ts = *ts;
+    slot->seq++;
+    slot->pending = true;
+    slot->srcMap->busy++;
+    slot->dstMap->busy++;
+    mNextSlot = (mNextSlot + 1) % C2D_MAX_ASYNC;
+    pthread_mutex_unlock(&mLock);
+    return 0;
 }
 
-bool C2DColorConverter::isYUVSurface(ColorConvertFormat format)
+/* A blit no slot is pending on was waited for by a later submit already */
+int C2DColorConverter::waitC2D(c2d_ts_handle ts)
 {
-    switch (format) {
-        case YCbCr420Tile:
-        case YCbCr420SP:
-        case YCbCr420P:
-        case YCrCb420P:
-        case NV12_2K:
-        case NV12_128m:
-            return true;
-        case RGB565:
-        case RGBA8888:
-        default:
-            return false;
+    int ret = 0;
+
+    if (mError)
+        return mError;
+
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < C2D_MAX_ASYNC; i++) {
+        if (mSlots[i].pending && mSlots[i].ts == ts) {
+            ret = waitSlot(&mSlots[i]);
+            break;
+        }
     }
+    pthread_mutex_unlock(&mLock);
+    return ret;
 }
 
-void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t width, size_t height, bool isSource)
+void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t width, size_t height, bool isSource, uint32_t *surfaceId)
 {
     if (isYUVSurface(format)) {
         C2D_YUV_SURFACE_DEF * surfaceDef = new C2D_YUV_SURFACE_DEF;
@@ -308,7 +441,7 @@ void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t wi
           surfaceDef->phys2 = (void *)0xaaaaaaaa;
           surfaceDef->stride2 = calcStride(format, width) / 2;
         }
-        mC2DCreateSurface(isSource ? &mSrcSurface : &mDstSurface, isSource ? C2D_SOURCE : C2D_TARGET,
+        mC2DCreateSurface(surfaceId, isSource ? C2D_SOURCE : C2D_TARGET,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS | C2D_SURFACE_WITH_PHYS_DUMMY),
                         &(*surfaceDef));
         return ((void *)surfaceDef);
@@ -320,17 +453,17 @@ void* C2DColorConverter::getDummySurfaceDef(ColorConvertFormat format, size_t wi
         surfaceDef->buffer = (void *)0xaaaaaaaa;
         surfaceDef->phys = (void *)0xaaaaaaaa;
         surfaceDef->stride = calcStride(format, width);
-        mC2DCreateSurface(isSource ? &mSrcSurface : &mDstSurface, isSource ? C2D_SOURCE : C2D_TARGET,
+        mC2DCreateSurface(surfaceId, isSource ? C2D_SOURCE : C2D_TARGET,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST | C2D_SURFACE_WITH_PHYS | C2D_SURFACE_WITH_PHYS_DUMMY),
                         &(*surfaceDef));
         return ((void *)surfaceDef);
     }
 }
 
-C2D_STATUS C2DColorConverter::updateYUVSurfaceDef(uint8_t *gpuAddr, void *base, void *data, bool isSource)
+C2D_STATUS C2DColorConverter::updateYUVSurfaceDef(BlitSlot *slot, uint8_t *gpuAddr, void *base, void *data, bool isSource)
 {
     if (isSource) {
-        C2D_YUV_SURFACE_DEF * srcSurfaceDef = (C2D_YUV_SURFACE_DEF *)mSrcSurfaceDef;
+        C2D_YUV_SURFACE_DEF * srcSurfaceDef = (C2D_YUV_SURFACE_DEF *)slot->srcSurfaceDef;
         srcSurfaceDef->plane0 = data;
         srcSurfaceDef->phys0  = gpuAddr + ((uint8_t *)data - (uint8_t *)base);
         srcSurfaceDef->plane1 = (uint8_t *)data + mSrcYSize;
@@ -338,11 +471,11 @@ C2D_STATUS C2DColorConverter::updateYUVSurfaceDef(uint8_t *gpuAddr, void *base,
         srcSurfaceDef->plane2 = (uint8_t *)srcSurfaceDef->plane1 + mSrcYSize/4;
         srcSurfaceDef->phys2  = (uint8_t *)srcSurfaceDef->phys1 + mSrcYSize/4;
 
-        return mC2DUpdateSurface(mSrcSurface, C2D_SOURCE,
+        return mC2DUpdateSurface(slot->srcSurface, C2D_SOURCE,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS),
                         &(*srcSurfaceDef));
     } else {
-        C2D_YUV_SURFACE_DEF * dstSurfaceDef = (C2D_YUV_SURFACE_DEF *)mDstSurfaceDef;
+        C2D_YUV_SURFACE_DEF * dstSurfaceDef = (C2D_YUV_SURFACE_DEF *)slot->dstSurfaceDef;
         dstSurfaceDef->plane0 = data;
         dstSurfaceDef->phys0  = gpuAddr + ((uint8_t *)data - (uint8_t *)base);
         dstSurfaceDef->plane1 = (uint8_t *)data + mDstYSize;
@@ -350,27 +483,27 @@ C2D_STATUS C2DColorConverter::updateYUVSurfaceDef(uint8_t *gpuAddr, void *base,
         dstSurfaceDef->plane2 = (uint8_t *)dstSurfaceDef->plane1 + mDstYSize/4;
         dstSurfaceDef->phys2  = (uint8_t *)dstSurfaceDef->phys1 + mDstYSize/4;
 
-        return mC2DUpdateSurface(mDstSurface, C2D_TARGET,
+        return mC2DUpdateSurface(slot->dstSurface, C2D_TARGET,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS),
                         &(*dstSurfaceDef));
     }
 }
 
-C2D_STATUS C2DColorConverter::updateRGBSurfaceDef(uint8_t *gpuAddr, void * data, bool isSource)
+C2D_STATUS C2DColorConverter::updateRGBSurfaceDef(BlitSlot *slot, uint8_t *gpuAddr, void * data, bool isSource)
 {
     if (isSource) {
-        C2D_RGB_SURFACE_DEF * srcSurfaceDef = (C2D_RGB_SURFACE_DEF *)mSrcSurfaceDef;
+        C2D_RGB_SURFACE_DEF * srcSurfaceDef = (C2D_RGB_SURFACE_DEF *)slot->srcSurfaceDef;
         srcSurfaceDef->buffer = data;
         srcSurfaceDef->phys = gpuAddr;
-        return  mC2DUpdateSurface(mSrcSurface, C2D_SOURCE,
+        return  mC2DUpdateSurface(slot->srcSurface, C2D_SOURCE,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST | C2D_SURFACE_WITH_PHYS),
                         &(*srcSurfaceDef));
     } else {
-        C2D_RGB_SURFACE_DEF * dstSurfaceDef = (C2D_RGB_SURFACE_DEF *)mDstSurfaceDef;
+        C2D_RGB_SURFACE_DEF * dstSurfaceDef = (C2D_RGB_SURFACE_DEF *)slot->dstSurfaceDef;
         dstSurfaceDef->buffer = data;
         ALOGV("dstSurfaceDef->buffer = %p\n", data);
         dstSurfaceDef->phys = gpuAddr;
-        return mC2DUpdateSurface(mDstSurface, C2D_TARGET,
+        return mC2DUpdateSurface(slot->dstSurface, C2D_TARGET,
                         (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST | C2D_SURFACE_WITH_PHYS),
                         &(*dstSurfaceDef));
     }
@@ -399,108 +532,6 @@ uint32_t C2DColorConverter::getC2DFormat(ColorConvertFormat format)
     }
 }
 
-size_t C2DColorConverter::calcStride(ColorConvertFormat format, size_t width)
-{
-    switch (format) {
-        case RGB565:
-            return ALIGN(width, ALIGN32) * 2; // RGB565 has width as twice
-        case RGBA8888:
-	if (mSrcStride)
-		return mSrcStride * 4;
-	else
-		return ALIGN(width, ALIGN32) * 4;
-        case YCbCr420Tile:
-            return ALIGN(width, ALIGN128);
-        case YCbCr420SP:
-            return ALIGN(width, ALIGN16);
-        case NV12_2K:
-            return ALIGN(width, ALIGN16);
-        case NV12_128m:
-            return ALIGN(width, ALIGN128);
-        case YCbCr420P:
-            return width;
-        case YCrCb420P:
-            return ALIGN(width, ALIGN16);
-        default:
-            return 0;
-    }
-}
-
-size_t C2DColorConverter::calcYSize(ColorConvertFormat format, size_t width, size_t height)
-{
-    switch (format) {
-        case YCbCr420SP:
-            return (ALIGN(width, ALIGN16) * height);
-        case YCbCr420P:
-            return width * height;
-        case YCrCb420P:
-            return ALIGN(width, ALIGN16) * height;
-        case YCbCr420Tile:
-            return ALIGN(ALIGN(width, ALIGN128) * ALIGN(height, ALIGN32), ALIGN8K);
-        case NV12_2K: {
-            size_t alignedw = ALIGN(width, ALIGN16);
-            size_t lumaSize = ALIGN(alignedw * height, ALIGN2K);
-            return lumaSize;
-        }
-        case NV12_128m:
-            return ALIGN(width, ALIGN128) * ALIGN(height, ALIGN32);
-        default:
-            return 0;
-    }
-}
-
-size_t C2DColorConverter::calcSize(ColorConvertFormat format, size_t width, size_t height)
-{
-    int32_t alignedw = 0;
-    int32_t alignedh = 0;
-    int32_t size = 0;
-
-    switch (format) {
-        case RGB565:
-            size = ALIGN(width, ALIGN32) * ALIGN(height, ALIGN32) * 2;
-            size = ALIGN(size, ALIGN4K);
-            break;
-        case RGBA8888:
-            if (mSrcStride)
-              size = mSrcStride *  ALIGN(height, ALIGN32) * 4;
-            else
-              size = ALIGN(width, ALIGN32) * ALIGN(height, ALIGN32) * 4;
-            size = ALIGN(size, ALIGN4K);
-            break;
-        case YCbCr420SP:
-            alignedw = ALIGN(width, ALIGN16);
-            size = ALIGN((alignedw * height) + (ALIGN(width/2, ALIGN32) * (height/2) * 2), ALIGN4K);
-            break;
-        case YCbCr420P:
-            size = ALIGN((width * height * 3 / 2), ALIGN4K);
-            break;
-        case YCrCb420P:
-            alignedw = ALIGN(width, ALIGN16);
-            size = ALIGN((alignedw * height) + (ALIGN(width/2, ALIGN16) * (height/2) * 2), ALIGN4K);
-            break;
-        case YCbCr420Tile:
-            alignedw = ALIGN(width, ALIGN128);
-            alignedh = ALIGN(height, ALIGN32);
-            size = ALIGN(alignedw * alignedh, ALIGN8K) + ALIGN(alignedw * ALIGN(height/2, ALIGN32), ALIGN8K);
-            break;
-        case NV12_2K: {
-            alignedw = ALIGN(width, ALIGN16);
-            size_t lumaSize = ALIGN(alignedw * height, ALIGN2K);
-            size_t chromaSize = ALIGN((alignedw * height)/2, ALIGN2K);
-            size = ALIGN(lumaSize + chromaSize, ALIGN4K);
-            ALOGV("NV12_2k, width = %zu, height = %zu, size = %d", width, height, size);
-            }
-            break;
-        case NV12_128m:
-            alignedw = ALIGN(width, ALIGN128);
-            alignedh = ALIGN(height, ALIGN32);
-            size = ALIGN(alignedw * alignedh + (alignedw * ALIGN(height/2, ALIGN16)), ALIGN4K);
-            break;
-        default:
-            break;
-    }
-    return size;
-}
 /*
  * Tells GPU to map given buffer and returns a physical address of mapped buffer
  */
@@ -533,90 +564,88 @@ bool C2DColorConverter::unmapGPUAddr(unsigned long gAddr)
     return (status == C2D_STATUS_OK);
 }
 
-int32_t C2DColorConverter::getBuffReq(int32_t port, C2DBuffReq *req) {
-    if (!req) return -1;
-
-    if (port != C2D_INPUT && port != C2D_OUTPUT) return -1;
-
-    memset(req, 0, sizeof(C2DBuffReq));
-    if (port == C2D_INPUT) {
-        req->width = mSrcWidth;
-        req->height = mSrcHeight;
-        req->stride = calcStride(mSrcFormat, mSrcWidth);
-        req->sliceHeight = mSrcHeight;
-        req->lumaAlign = calcLumaAlign(mSrcFormat);
-        req->sizeAlign = calcSizeAlign(mSrcFormat);
-        req->size = calcSize(mSrcFormat, mSrcWidth, mSrcHeight);
-        req->bpp = calcBytesPerPixel(mSrcFormat);
-        ALOGV("input req->size = %d\n", req->size);
-    } else if (port == C2D_OUTPUT) {
-        req->width = mDstWidth;
-        req->height = mDstHeight;
-        req->stride = calcStride(mDstFormat, mDstWidth);
-        req->sliceHeight = mDstHeight;
-        req->lumaAlign = calcLumaAlign(mDstFormat);
-        req->sizeAlign = calcSizeAlign(mDstFormat);
-        req->size = calcSize(mDstFormat, mDstWidth, mDstHeight);
-        req->bpp = calcBytesPerPixel(mDstFormat);
-        ALOGV("output req->size = %d\n", req->size);
+/*
+ * Returns the GPU mapping of a buffer, mapping it on first use. The least
+ * recently used idle mapping is dropped when the cache is full. The fd
+ * number and its inode may belong to another buffer by now, so a mapping
+ * is only reused when ION gives the fd the handle the entry holds.
+ */
+C2DColorConverter::GPUMapping *C2DColorConverter::getCachedGPUAddr(int bufFD, void *bufPtr, size_t bufLen)
+{
+    struct ion_fd_data import;
+    GPUMapping *victim = NULL;
+    void *gpuaddr;
+
+    memset(&import, 0, sizeof(import));
+    import.fd = bufFD;
+    if (mIonFd < 0 || ioctl(mIonFd, ION_IOC_IMPORT, &import))
+        import.handle = 0;
+
+    for (int i = 0; i < GPU_MAP_CACHE_SIZE; i++) {
+        GPUMapping *map = &mMappings[i];
+
+        if (!map->gpuAddr) {
+            if (!victim || victim->gpuAddr)
+                victim = map;
+            continue;
+        }
+        if (import.handle && map->ion.handle == import.handle &&
+                map->ptr == bufPtr && map->len == bufLen) {
+            /* The entry keeps the handle, drop the reference the import took */
+            ioctl(mIonFd, ION_IOC_FREE, &import.handle);
+            map->lastUse = ++mMapClock;
+            return map;
+        }
+        if (map->busy)
+            continue;
+        if (!victim || (victim->gpuAddr && map->lastUse < victim->lastUse))
+            victim = map;
     }
-    return 0;
-}
 
-size_t C2DColorConverter::calcLumaAlign(ColorConvertFormat format) {
-    if (!isYUVSurface(format)) return 1; //no requirement
-
-    switch (format) {
-        case NV12_2K:
-          return ALIGN2K;
-        case NV12_128m:
-          return 1;
-        default:
-          ALOGE("unknown format passed for luma alignment number");
-          return 1;
+    if (!victim) {
+        ALOGE("Every GPU mapping is in use by a blit\n");
+        if (import.handle)
+            ioctl(mIonFd, ION_IOC_FREE, &import.handle);
+        return NULL;
     }
-}
-
-size_t C2DColorConverter::calcSizeAlign(ColorConvertFormat format) {
-    if (!isYUVSurface(format)) return 1; //no requirement
 
-    switch (format) {
-        case YCbCr420SP: //OR NV12
-        case YCbCr420P:
-        case NV12_2K:
-        case NV12_128m:
-          return ALIGN4K;
-        default:
-          ALOGE("unknown format passed for size alignment number");
-          return 1;
+    gpuaddr = getMappedGPUAddr(bufFD, bufPtr, bufLen);
+    if (!gpuaddr) {
+        if (import.handle)
+            ioctl(mIonFd, ION_IOC_FREE, &import.handle);
+        return NULL;
     }
+
+    if (victim->gpuAddr)
+        releaseMapping(victim);
+    victim->ion.handle = import.handle;
+    victim->ptr = bufPtr;
+    victim->len = bufLen;
+    victim->gpuAddr = gpuaddr;
+    victim->lastUse = ++mMapClock;
+    return victim;
 }
 
-C2DBytesPerPixel C2DColorConverter::calcBytesPerPixel(ColorConvertFormat format) {
-    C2DBytesPerPixel bpp;
-    bpp.numerator = 0;
-    bpp.denominator = 1;
+void C2DColorConverter::releaseMapping(GPUMapping *map)
+{
+    unmapGPUAddr((unsigned long)map->gpuAddr);
+    if (map->ion.handle && ioctl(mIonFd, ION_IOC_FREE, &map->ion))
+        ALOGE("ION free failed\n");
+    memset(map, 0, sizeof(*map));
+}
 
-    switch (format) {
-        case RGB565:
-            bpp.numerator = 2;
-            break;
-        case RGBA8888:
-            bpp.numerator = 4;
-            break;
-        case YCbCr420SP:
-        case YCbCr420P:
-        case YCrCb420P:
-        case YCbCr420Tile:
-        case NV12_2K:
-        case NV12_128m:
-            bpp.numerator = 3;
-            bpp.denominator = 2;
-            break;
-        default:
-            break;
+void C2DColorConverter::flushMappings()
+{
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < C2D_MAX_ASYNC && !mError; i++) {
+        if (mSlots[i].pending)
+            waitSlot(&mSlots[i]);
+    }
+    for (int i = 0; i < GPU_MAP_CACHE_SIZE; i++) {
+        if (mMappings[i].gpuAddr)
+            releaseMapping(&mMappings[i]);
     }
-    return bpp;
+    pthread_mutex_unlock(&mLock);
 }
 
 int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
@@ -636,7 +665,7 @@ int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
 
     int ret = 0;
     if (isYUVSurface(mDstFormat)) {
-      C2D_YUV_SURFACE_DEF * dstSurfaceDef = (C2D_YUV_SURFACE_DEF *)mDstSurfaceDef;
+      C2D_YUV_SURFACE_DEF * dstSurfaceDef = (C2D_YUV_SURFACE_DEF *)mSlots[mLastSlot].dstSurfaceDef;
       uint8_t * base = (uint8_t *)dstSurfaceDef->plane0;
       stride = dstSurfaceDef->stride0;
       sliceHeight = dstSurfaceDef->height;
@@ -680,7 +709,7 @@ int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
           }
       }
     } else {
-      C2D_RGB_SURFACE_DEF * dstSurfaceDef = (C2D_RGB_SURFACE_DEF *)mDstSurfaceDef;
+      C2D_RGB_SURFACE_DEF * dstSurfaceDef = (C2D_RGB_SURFACE_DEF *)mSlots[mLastSlot].dstSurfaceDef;
       uint8_t * base = (uint8_t *)dstSurfaceDef->buffer;
       stride = dstSurfaceDef->stride;
       sliceHeight = dstSurfaceDef->height;
@@ -715,9 +744,35 @@ int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
     return ret < 0 ? ret : 0;
 }
 
+/* The GPU converts whole surfaces */
+int C2DColorConverter::convertRows(void * srcData, void * dstData, size_t row, size_t rows)
+{
+    (void)srcData;
+    (void)dstData;
+    (void)row;
+    (void)rows;
+    return -1;
+}
+
+/* The blit has no per-channel clamp */
+int C2DColorConverter::setOutputClip(uint8_t lumaMax, uint8_t chromaMax)
+{
+    (void)lumaMax;
+    (void)chromaMax;
+    return -1;
+}
+
 extern "C" C2DColorConverterBase* createC2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride)
 {
-    return new C2DColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride);
+    if (!(flags & C2D_FLAG_CPU)) {
+        C2DColorConverter *c2d = new C2DColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride);
+
+        if (!c2d->getError())
+            return c2d;
+        ALOGW("C2D unavailable, converting on the CPU");
+        delete (C2DColorConverterBase *)c2d;
+    }
+    return new CPUColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride);
 }
 
 extern "C" void destroyC2DColorConverter(C2DColorConverterBase* C2DCC)
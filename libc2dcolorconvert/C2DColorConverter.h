@@ -100,6 +100,14 @@ typedef enum {
   C2D_OUTPUT,
 } C2D_PORT;
 
+/* createC2DColorConverter flags */
+typedef enum {
+  C2D_FLAG_CPU = 0x1, /* convert on the CPU even if the C2D library is present */
+} C2D_FLAGS;
+
+/* Conversions convertC2DAsync keeps in flight, a further one waits for the oldest */
+#define C2D_MAX_ASYNC 4
+
 class C2DColorConverterBase {
 
 public:
@@ -107,6 +115,21 @@ public:
     virtual int convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData) = 0;
     virtual int32_t getBuffReq(int32_t port, C2DBuffReq *req) = 0;
     virtual int32_t dumpOutput(char * filename, char mode) = 0;
+    /* Drops GPU mappings kept across conversions, call before freeing buffers */
+    virtual void flushMappings() = 0;
+    /* Submits the conversion without waiting, pass *ts to waitC2D. Up to
+     * C2D_MAX_ASYNC may be in flight, submits come from one thread. */
+    virtual int convertC2DAsync(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, c2d_ts_handle *ts) = 0;
+    /* Can be called from another thread while the next ones are submitted */
+    virtual int waitC2D(c2d_ts_handle ts) = 0;
+    /* Converts rows [row, row + rows) only so callers can split a frame
+     * across threads, row must be even. -1 if the converter cannot. */
+    virtual int convertRows(void * srcData, void * dstData, size_t row, size_t rows) = 0;
+    /* Clamps YUV output samples as they are written, so no separate pass
+     * is needed. -1 if the converter cannot. */
+    virtual int setOutputClip(uint8_t lumaMax, uint8_t chromaMax) = 0;
+    /* True if convertRows() works on this converter */
+    virtual bool canConvertRows() = 0;
 };
 
 typedef C2DColorConverterBase* createC2DColorConverter_t(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride);
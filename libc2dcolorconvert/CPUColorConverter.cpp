@@ -0,0 +1,647 @@
+/* Copyright (c) 2012 - 2013, 2017, The Linux Foundation. All rights reserved.
+ *
+ * redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * this software is provided "as is" and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement
+ * are disclaimed.  in no event shall the copyright owner or contributors
+ * be liable for any direct, indirect, incidental, special, exemplary, or
+ * consequential damages (including, but not limited to, procurement of
+ * substitute goods or services; loss of use, data, or profits; or
+ * business interruption) however caused and on any theory of liability,
+ * whether in contract, strict liability, or tort (including negligence
+ * or otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <utils/Log.h>
+#include "CPUColorConverter.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#undef LOG_TAG
+#define LOG_TAG "C2DColorConvert"
+
+namespace android {
+
+/*
+ * BT.601 limited range, 8 bit fixed point. Chroma is taken from the
+ * rounded average of each 2x2 block. The SIMD kernels compute exactly the
+ * same values as these.
+ */
+static inline uint8_t rgbToY(int r, int g, int b)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static inline uint8_t rgbToU(int r, int g, int b)
+{
+    return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+static inline uint8_t rgbToV(int r, int g, int b)
+{
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+static inline uint8_t clip(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline uint8_t clipMax(uint8_t v, uint8_t max)
+{
+    return v > max ? max : v;
+}
+
+static size_t rgbaToYUVRowsC(const uint8_t *top, const uint8_t *bottom,
+        uint8_t *yTop, uint8_t *yBottom, uint8_t *u, uint8_t *v,
+        size_t cStep, size_t width, uint8_t yMax, uint8_t cMax)
+{
+    for (size_t x = 0; x < width; x += 2) {
+        /* An odd last column pairs with itself */
+        size_t n = (x + 1 < width) ? 4 : 0;
+        const uint8_t *t = top + x * 4;
+        const uint8_t *b = bottom + x * 4;
+        int r, g, bl;
+
+        yTop[x] = clipMax(rgbToY(t[0], t[1], t[2]), yMax);
+        yBottom[x] = clipMax(rgbToY(b[0], b[1], b[2]), yMax);
+        if (n) {
+            yTop[x + 1] = clipMax(rgbToY(t[4], t[5], t[6]), yMax);
+            yBottom[x + 1] = clipMax(rgbToY(b[4], b[5], b[6]), yMax);
+        }
+        r = (t[0] + t[n] + b[0] + b[n] + 2) >> 2;
+        g = (t[1] + t[n + 1] + b[1] + b[n + 1] + 2) >> 2;
+        bl = (t[2] + t[n + 2] + b[2] + b[n + 2] + 2) >> 2;
+        u[(x / 2) * cStep] = clipMax(rgbToU(r, g, bl), cMax);
+        v[(x / 2) * cStep] = clipMax(rgbToV(r, g, bl), cMax);
+    }
+    return width;
+}
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+static inline uint8x8_t yNEON(uint8x8_t r, uint8x8_t g, uint8x8_t b, uint8x8_t max)
+{
+    uint16x8_t y = vmull_u8(r, vdup_n_u8(66));
+
+    y = vmlal_u8(y, g, vdup_n_u8(129));
+    y = vmlal_u8(y, b, vdup_n_u8(25));
+    return vmin_u8(vadd_u8(vrshrn_n_u16(y, 8), vdup_n_u8(16)), max);
+}
+
+static inline uint8x8_t chromaNEON(int16x8_t r, int16x8_t g, int16x8_t b,
+        int16_t cr, int16_t cg, int16_t cb, uint8x8_t max)
+{
+    int16x8_t c = vmulq_n_s16(r, cr);
+
+    c = vmlaq_n_s16(c, g, cg);
+    c = vmlaq_n_s16(c, b, cb);
+    return vmin_u8(vqmovun_s16(vaddq_s16(vrshrq_n_s16(c, 8), vdupq_n_s16(128))), max);
+}
+
+static size_t rgbaToYUVRowsNEON(const uint8_t *top, const uint8_t *bottom,
+        uint8_t *yTop, uint8_t *yBottom, uint8_t *u, uint8_t *v,
+        size_t cStep, size_t width, uint8_t yMax, uint8_t cMax)
+{
+    const uint8x8_t yMaxV = vdup_n_u8(yMax);
+    const uint8x8_t cMaxV = vdup_n_u8(cMax);
+    size_t x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        uint8x16x4_t t = vld4q_u8(top + x * 4);
+        uint8x16x4_t b = vld4q_u8(bottom + x * 4);
+        int16x8_t r, g, bl;
+        uint8x8x2_t uv;
+
+        vst1_u8(yTop + x, yNEON(vget_low_u8(t.val[0]), vget_low_u8(t.val[1]), vget_low_u8(t.val[2]), yMaxV));
+        vst1_u8(yTop + x + 8, yNEON(vget_high_u8(t.val[0]), vget_high_u8(t.val[1]), vget_high_u8(t.val[2]), yMaxV));
+        vst1_u8(yBottom + x, yNEON(vget_low_u8(b.val[0]), vget_low_u8(b.val[1]), vget_low_u8(b.val[2]), yMaxV));
+        vst1_u8(yBottom + x + 8, yNEON(vget_high_u8(b.val[0]), vget_high_u8(b.val[1]), vget_high_u8(b.val[2]), yMaxV));
+
+        /* Pairwise sums of both rows, then the rounded 2x2 average */
+        r = vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(t.val[0]), b.val[0]), 2));
+        g = vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(t.val[1]), b.val[1]), 2));
+        bl = vreinterpretq_s16_u16(vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(t.val[2]), b.val[2]), 2));
+        uv.val[0] = chromaNEON(r, g, bl, -38, -74, 112, cMaxV);
+        uv.val[1] = chromaNEON(r, g, bl, 112, -94, -18, cMaxV);
+        if (cStep == 2) {
+            vst2_u8(u + x, uv);
+        } else {
+            vst1_u8(u + x / 2, uv.val[0]);
+            vst1_u8(v + x / 2, uv.val[1]);
+        }
+    }
+    return x;
+}
+#elif defined(__i386__) || defined(__x86_64__)
+/* Eight RGBA pixels to R, G and B in 16 bit lanes */
+static inline void unpackSSE2(const uint8_t *p, __m128i *r, __m128i *g, __m128i *b)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    __m128i p0 = _mm_loadu_si128((const __m128i *)p);
+    __m128i p1 = _mm_loadu_si128((const __m128i *)(p + 16));
+
+    *r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+            _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    *b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+            _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+static inline __m128i ySSE2(__m128i r, __m128i g, __m128i b, __m128i max)
+{
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)),
+            _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+
+    y = _mm_add_epi16(y, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+    y = _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(128)), 8);
+    return _mm_min_epi16(_mm_add_epi16(y, _mm_set1_epi16(16)), max);
+}
+
+static inline __m128i chromaSSE2(__m128i r, __m128i g, __m128i b,
+        int16_t cr, int16_t cg, int16_t cb, __m128i max)
+{
+    __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)),
+            _mm_mullo_epi16(g, _mm_set1_epi16(cg)));
+
+    c = _mm_add_epi16(c, _mm_mullo_epi16(b, _mm_set1_epi16(cb)));
+    c = _mm_srai_epi16(_mm_add_epi16(c, _mm_set1_epi16(128)), 8);
+    return _mm_min_epi16(_mm_add_epi16(c, _mm_set1_epi16(128)), max);
+}
+
+/* Rounded 2x2 averages of eight pixels of two rows, four per register */
+static inline __m128i average2x2SSE2(__m128i t0, __m128i b0, __m128i t1, __m128i b1)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i s = _mm_packs_epi32(_mm_madd_epi16(_mm_add_epi16(t0, b0), ones),
+            _mm_madd_epi16(_mm_add_epi16(t1, b1), ones));
+
+    return _mm_srli_epi16(_mm_add_epi16(s, _mm_set1_epi16(2)), 2);
+}
+
+static size_t rgbaToYUVRowsSSE2(const uint8_t *top, const uint8_t *bottom,
+        uint8_t *yTop, uint8_t *yBottom, uint8_t *u, uint8_t *v,
+        size_t cStep, size_t width, uint8_t yMax, uint8_t cMax)
+{
+    const __m128i yMaxV = _mm_set1_epi16(yMax);
+    const __m128i cMaxV = _mm_set1_epi16(cMax);
+    size_t x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        __m128i tr0, tg0, tb0, tr1, tg1, tb1;
+        __m128i br0, bg0, bb0, br1, bg1, bb1;
+        __m128i r, g, b, cu, cv;
+
+        unpackSSE2(top + x * 4, &tr0, &tg0, &tb0);
+        unpackSSE2(top + x * 4 + 32, &tr1, &tg1, &tb1);
+        unpackSSE2(bottom + x * 4, &br0, &bg0, &bb0);
+        unpackSSE2(bottom + x * 4 + 32, &br1, &bg1, &bb1);
+
+        _mm_storeu_si128((__m128i *)(yTop + x), _mm_packus_epi16(
+                    ySSE2(tr0, tg0, tb0, yMaxV), ySSE2(tr1, tg1, tb1, yMaxV)));
+        _mm_storeu_si128((__m128i *)(yBottom + x), _mm_packus_epi16(
+                    ySSE2(br0, bg0, bb0, yMaxV), ySSE2(br1, bg1, bb1, yMaxV)));
+
+        r = average2x2SSE2(tr0, br0, tr1, br1);
+        g = average2x2SSE2(tg0, bg0, tg1, bg1);
+        b = average2x2SSE2(tb0, bb0, tb1, bb1);
+        cu = chromaSSE2(r, g, b, -38, -74, 112, cMaxV);
+        cv = chromaSSE2(r, g, b, 112, -94, -18, cMaxV);
+        if (cStep == 2) {
+            _mm_storeu_si128((__m128i *)(u + x),
+                    _mm_or_si128(cu, _mm_slli_epi16(cv, 8)));
+        } else {
+            _mm_storel_epi64((__m128i *)(u + x / 2), _mm_packus_epi16(cu, cu));
+            _mm_storel_epi64((__m128i *)(v + x / 2), _mm_packus_epi16(cv, cv));
+        }
+    }
+    return x;
+}
+
+/*
+ * The AVX2 packs work within 128 bit lanes, each is followed by a
+ * permute to bring the 64 bit quarters back in order.
+ */
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET
+static inline __m256i packs32AVX2(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+}
+
+AVX2_TARGET
+static inline void unpackAVX2(const uint8_t *p, __m256i *r, __m256i *g, __m256i *b)
+{
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    __m256i p0 = _mm256_loadu_si256((const __m256i *)p);
+    __m256i p1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+
+    *r = packs32AVX2(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask));
+    *g = packs32AVX2(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+            _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask));
+    *b = packs32AVX2(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask),
+            _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask));
+}
+
+AVX2_TARGET
+static inline __m256i yAVX2(__m256i r, __m256i g, __m256i b, __m256i max)
+{
+    __m256i y = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(66)),
+            _mm256_mullo_epi16(g, _mm256_set1_epi16(129)));
+
+    y = _mm256_add_epi16(y, _mm256_mullo_epi16(b, _mm256_set1_epi16(25)));
+    y = _mm256_srli_epi16(_mm256_add_epi16(y, _mm256_set1_epi16(128)), 8);
+    return _mm256_min_epi16(_mm256_add_epi16(y, _mm256_set1_epi16(16)), max);
+}
+
+AVX2_TARGET
+static inline __m256i chromaAVX2(__m256i r, __m256i g, __m256i b,
+        int16_t cr, int16_t cg, int16_t cb, __m256i max)
+{
+    __m256i c = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(cr)),
+            _mm256_mullo_epi16(g, _mm256_set1_epi16(cg)));
+
+    c = _mm256_add_epi16(c, _mm256_mullo_epi16(b, _mm256_set1_epi16(cb)));
+    c = _mm256_srai_epi16(_mm256_add_epi16(c, _mm256_set1_epi16(128)), 8);
+    return _mm256_min_epi16(_mm256_add_epi16(c, _mm256_set1_epi16(128)), max);
+}
+
+AVX2_TARGET
+static inline __m256i average2x2AVX2(__m256i t0, __m256i b0, __m256i t1, __m256i b1)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i s = packs32AVX2(_mm256_madd_epi16(_mm256_add_epi16(t0, b0), ones),
+            _mm256_madd_epi16(_mm256_add_epi16(t1, b1), ones));
+
+    return _mm256_srli_epi16(_mm256_add_epi16(s, _mm256_set1_epi16(2)), 2);
+}
+
+AVX2_TARGET
+static size_t rgbaToYUVRowsAVX2(const uint8_t *top, const uint8_t *bottom,
+        uint8_t *yTop, uint8_t *yBottom, uint8_t *u, uint8_t *v,
+        size_t cStep, size_t width, uint8_t yMax, uint8_t cMax)
+{
+    const __m256i yMaxV = _mm256_set1_epi16(yMax);
+    const __m256i cMaxV = _mm256_set1_epi16(cMax);
+    size_t x;
+
+    for (x = 0; x + 32 <= width; x += 32) {
+        __m256i tr0, tg0, tb0, tr1, tg1, tb1;
+        __m256i br0, bg0, bb0, br1, bg1, bb1;
+        __m256i r, g, b, cu, cv;
+
+        unpackAVX2(top + x * 4, &tr0, &tg0, &tb0);
+        unpackAVX2(top + x * 4 + 64, &tr1, &tg1, &tb1);
+        unpackAVX2(bottom + x * 4, &br0, &bg0, &bb0);
+        unpackAVX2(bottom + x * 4 + 64, &br1, &bg1, &bb1);
+
+        _mm256_storeu_si256((__m256i *)(yTop + x), _mm256_permute4x64_epi64(
+                    _mm256_packus_epi16(yAVX2(tr0, tg0, tb0, yMaxV), yAVX2(tr1, tg1, tb1, yMaxV)), 0xD8));
+        _mm256_storeu_si256((__m256i *)(yBottom + x), _mm256_permute4x64_epi64(
+                    _mm256_packus_epi16(yAVX2(br0, bg0, bb0, yMaxV), yAVX2(br1, bg1, bb1, yMaxV)), 0xD8));
+
+        r = average2x2AVX2(tr0, br0, tr1, br1);
+        g = average2x2AVX2(tg0, bg0, tg1, bg1);
+        b = average2x2AVX2(tb0, bb0, tb1, bb1);
+        cu = chromaAVX2(r, g, b, -38, -74, 112, cMaxV);
+        cv = chromaAVX2(r, g, b, 112, -94, -18, cMaxV);
+        if (cStep == 2) {
+            _mm256_storeu_si256((__m256i *)(u + x),
+                    _mm256_or_si256(cu, _mm256_slli_epi16(cv, 8)));
+        } else {
+            _mm_storeu_si128((__m128i *)(u + x / 2), _mm256_castsi256_si128(
+                        _mm256_permute4x64_epi64(_mm256_packus_epi16(cu, cu), 0xD8)));
+            _mm_storeu_si128((__m128i *)(v + x / 2), _mm256_castsi256_si128(
+                        _mm256_permute4x64_epi64(_mm256_packus_epi16(cv, cv), 0xD8)));
+        }
+    }
+    /* Up to 31 pixels left, SSE2 takes most of them */
+    return x + rgbaToYUVRowsSSE2(top + x * 4, bottom + x * 4, yTop + x, yBottom + x,
+            u + (x / 2) * cStep, v + (x / 2) * cStep, cStep, width - x, yMax, cMax);
+}
+#endif
+
+static CPUColorConverter::RGBAToYUVRows selectRGBAToYUV()
+{
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    return rgbaToYUVRowsNEON;
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return rgbaToYUVRowsAVX2;
+    return rgbaToYUVRowsSSE2;
+#else
+    return rgbaToYUVRowsC;
+#endif
+}
+
+CPUColorConverter::CPUColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride)
+    : ColorConverterLayout(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags, srcStride)
+{
+    mError = 0;
+    mLastOutput = NULL;
+    mLumaMax = 0xff;
+    mChromaMax = 0xff;
+    mRGBAToYUV = selectRGBAToYUV();
+
+    if (srcWidth != dstWidth || srcHeight != dstHeight) {
+        ALOGE("CPU converter does not scale %zux%zu to %zux%zu",
+                srcWidth, srcHeight, dstWidth, dstHeight);
+        mError = -1;
+    } else if (!isSupported(srcFormat) || !isSupported(dstFormat) ||
+            (!isYUVSurface(srcFormat) && !isYUVSurface(dstFormat))) {
+        ALOGE("CPU converter does not support %d to %d", srcFormat, dstFormat);
+        mError = -1;
+    }
+}
+
+bool CPUColorConverter::isSupported(ColorConvertFormat format)
+{
+    switch (format) {
+        case RGB565:
+        case RGBA8888:
+        case YCbCr420SP:
+        case YCbCr420P:
+        case YCrCb420P:
+        case NV12_2K:
+        case NV12_128m:
+            return true;
+        case YCbCr420Tile:
+        default:
+            return false;
+    }
+}
+
+/* Same plane placement as the C2D surface definitions, sizes match as nothing is scaled */
+void CPUColorConverter::getYUVPlanes(ColorConvertFormat format, size_t ySize, uint8_t *data, YUVPlanes *planes)
+{
+    uint8_t *plane1 = data + ySize;
+
+    planes->y = data;
+    planes->yStride = calcStride(format, mSrcWidth);
+    if (format == YCbCr420P || format == YCrCb420P) {
+        planes->cStride = planes->yStride / 2;
+        planes->cStep = 1;
+        planes->u = (format == YCbCr420P) ? plane1 : plane1 + ySize / 4;
+        planes->v = (format == YCbCr420P) ? plane1 + ySize / 4 : plane1;
+    } else {
+        planes->cStride = planes->yStride;
+        planes->cStep = 2;
+        planes->u = plane1;
+        planes->v = plane1 + 1;
+    }
+}
+
+void CPUColorConverter::rgbToYUV(uint8_t *src, const YUVPlanes &dst, size_t row, size_t rows)
+{
+    size_t stride = calcStride(mSrcFormat, mSrcWidth);
+    uint8_t *expanded = NULL;
+
+    if (mSrcFormat == RGB565) {
+        expanded = new uint8_t[mSrcWidth * 4 * 2];
+    }
+
+    for (size_t y = row; y < row + rows; y += 2) {
+        const uint8_t *top = src + y * stride;
+        const uint8_t *bottom = (y + 1 < mSrcHeight) ? top + stride : top;
+        uint8_t *yTop = dst.y + y * dst.yStride;
+        uint8_t *yBottom = (y + 1 < mSrcHeight) ? yTop + dst.yStride : yTop;
+        uint8_t *u = dst.u + (y / 2) * dst.cStride;
+        uint8_t *v = dst.v + (y / 2) * dst.cStride;
+        size_t done;
+
+        if (expanded) {
+            const uint8_t *in[2] = { top, bottom };
+
+            for (int i = 0; i < 2; i++) {
+                uint8_t *out = expanded + i * mSrcWidth * 4;
+
+                for (size_t x = 0; x < mSrcWidth; x++) {
+                    uint16_t p = in[i][2 * x] | (in[i][2 * x + 1] << 8);
+                    uint8_t r = (p >> 11) & 0x1f;
+                    uint8_t g = (p >> 5) & 0x3f;
+                    uint8_t b = p & 0x1f;
+
+                    out[4 * x] = (r << 3) | (r >> 2);
+                    out[4 * x + 1] = (g << 2) | (g >> 4);
+                    out[4 * x + 2] = (b << 3) | (b >> 2);
+                    out[4 * x + 3] = 0xff;
+                }
+            }
+            top = expanded;
+            bottom = expanded + mSrcWidth * 4;
+        }
+
+        done = mRGBAToYUV(top, bottom, yTop, yBottom, u, v, dst.cStep, mSrcWidth,
+                mLumaMax, mChromaMax);
+        if (done < mSrcWidth) {
+            rgbaToYUVRowsC(top + done * 4, bottom + done * 4, yTop + done, yBottom + done,
+                    u + (done / 2) * dst.cStep, v + (done / 2) * dst.cStep,
+                    dst.cStep, mSrcWidth - done, mLumaMax, mChromaMax);
+        }
+    }
+
+    delete[] expanded;
+}
+
+void CPUColorConverter::yuvToRGB(const YUVPlanes &src, uint8_t *dst, size_t row, size_t rows)
+{
+    size_t stride = calcStride(mDstFormat, mDstWidth);
+
+    for (size_t y = row; y < row + rows; y++) {
+        const uint8_t *luma = src.y + y * src.yStride;
+        const uint8_t *u = src.u + (y / 2) * src.cStride;
+        const uint8_t *v = src.v + (y / 2) * src.cStride;
+        uint8_t *out = dst + y * stride;
+
+        for (size_t x = 0; x < mDstWidth; x++) {
+            int c = 298 * (luma[x] - 16);
+            int d = u[(x / 2) * src.cStep] - 128;
+            int e = v[(x / 2) * src.cStep] - 128;
+            uint8_t r = clip((c + 409 * e + 128) >> 8);
+            uint8_t g = clip((c - 100 * d - 208 * e + 128) >> 8);
+            uint8_t b = clip((c + 516 * d + 128) >> 8);
+
+            if (mDstFormat == RGBA8888) {
+                out[4 * x] = r;
+                out[4 * x + 1] = g;
+                out[4 * x + 2] = b;
+                out[4 * x + 3] = 0xff;
+            } else {
+                uint16_t p = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+
+                out[2 * x] = p & 0xff;
+                out[2 * x + 1] = p >> 8;
+            }
+        }
+    }
+}
+
+static void copyRow(uint8_t *dst, const uint8_t *src, size_t len, uint8_t max)
+{
+    if (max == 0xff) {
+        memcpy(dst, src, len);
+        return;
+    }
+    for (size_t x = 0; x < len; x++)
+        dst[x] = clipMax(src[x], max);
+}
+
+void CPUColorConverter::yuvToYUV(const YUVPlanes &src, const YUVPlanes &dst, size_t row, size_t rows)
+{
+    size_t chromaWidth = (mSrcWidth + 1) / 2;
+
+    for (size_t y = row; y < row + rows; y++) {
+        copyRow(dst.y + y * dst.yStride, src.y + y * src.yStride, mSrcWidth, mLumaMax);
+        if (y & 1)
+            continue;
+
+        const uint8_t *su = src.u + (y / 2) * src.cStride;
+        const uint8_t *sv = src.v + (y / 2) * src.cStride;
+        uint8_t *du = dst.u + (y / 2) * dst.cStride;
+        uint8_t *dv = dst.v + (y / 2) * dst.cStride;
+
+        if (src.cStep == 2 && dst.cStep == 2) {
+            copyRow(du, su, chromaWidth * 2, mChromaMax);
+            continue;
+        }
+        for (size_t x = 0; x < chromaWidth; x++) {
+            du[x * dst.cStep] = clipMax(su[x * src.cStep], mChromaMax);
+            dv[x * dst.cStep] = clipMax(sv[x * src.cStep], mChromaMax);
+        }
+    }
+}
+
+/* Converts rows [row, row + rows), row must be even */
+int CPUColorConverter::convertBand(uint8_t *src, uint8_t *dst, size_t row, size_t rows)
+{
+    YUVPlanes srcPlanes, dstPlanes;
+
+    if (isYUVSurface(mSrcFormat))
+        getYUVPlanes(mSrcFormat, mSrcYSize, src, &srcPlanes);
+    if (isYUVSurface(mDstFormat))
+        getYUVPlanes(mDstFormat, mDstYSize, dst, &dstPlanes);
+
+    if (!isYUVSurface(mSrcFormat))
+        rgbToYUV(src, dstPlanes, row, rows);
+    else if (!isYUVSurface(mDstFormat))
+        yuvToRGB(srcPlanes, dst, row, rows);
+    else
+        yuvToYUV(srcPlanes, dstPlanes, row, rows);
+    return 0;
+}
+
+int CPUColorConverter::convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData)
+{
+    (void)srcFd;
+    (void)srcBase;
+    (void)dstFd;
+    (void)dstBase;
+
+    if (mError) {
+        ALOGE("CPU converter initialization failed\n");
+        return mError;
+    }
+    if ((srcData == NULL) || (dstData == NULL)) {
+        ALOGE("Incorrect input parameters\n");
+        return -1;
+    }
+
+    mLastOutput = (uint8_t *)dstData;
+    return convertBand((uint8_t *)srcData, (uint8_t *)dstData, 0, mSrcHeight);
+}
+
+int CPUColorConverter::convertRows(void * srcData, void * dstData, size_t row, size_t rows)
+{
+    if (mError)
+        return mError;
+    if (!rows)
+        return 0;
+    if ((srcData == NULL) || (dstData == NULL) || (row & 1) || row + rows > mSrcHeight) {
+        ALOGE("Incorrect input parameters\n");
+        return -1;
+    }
+
+    /* Every band of a frame has the same destination, one writer is enough */
+    if (!row)
+        mLastOutput = (uint8_t *)dstData;
+    return convertBand((uint8_t *)srcData, (uint8_t *)dstData, row, rows);
+}
+
+int CPUColorConverter::convertC2DAsync(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, c2d_ts_handle *ts)
+{
+    if (!ts)
+        return -1;
+    *ts = NULL;
+    return convertC2D(srcFd, srcBase, srcData, dstFd, dstBase, dstData);
+}
+
+int CPUColorConverter::waitC2D(c2d_ts_handle ts)
+{
+    (void)ts;
+    return mError;
+}
+
+void CPUColorConverter::flushMappings()
+{
+}
+
+int CPUColorConverter::setOutputClip(uint8_t lumaMax, uint8_t chromaMax)
+{
+    if (!isYUVSurface(mDstFormat))
+        return -1;
+    mLumaMax = lumaMax;
+    mChromaMax = chromaMax;
+    return 0;
+}
+
+int32_t CPUColorConverter::dumpOutput(char * filename, char mode)
+{
+    int fd;
+    int ret;
+
+    if (!filename || !mLastOutput) return -1;
+
+    int flags = O_RDWR | O_CREAT;
+    if (mode == 'a') {
+      flags |= O_APPEND;
+    }
+
+    if ((fd = open(filename, flags)) < 0) {
+        ALOGE("open dump file failed w/ errno %s", strerror(errno));
+        return -1;
+    }
+    ret = write(fd, mLastOutput, mDstSize);
+    if (ret < 0) {
+        ALOGE("file write failed w/ errno %s", strerror(errno));
+    }
+    close(fd);
+    return ret < 0 ? ret : 0;
+}
+
+}
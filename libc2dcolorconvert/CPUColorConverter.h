@@ -0,0 +1,91 @@
+/* Copyright (c) 2012 - 2013, 2017, The Linux Foundation. All rights reserved.
+ *
+ * redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * this software is provided "as is" and any express or implied
+ * warranties, including, but not limited to, the implied warranties of
+ * merchantability, fitness for a particular purpose and non-infringement
+ * are disclaimed.  in no event shall the copyright owner or contributors
+ * be liable for any direct, indirect, incidental, special, exemplary, or
+ * consequential damages (including, but not limited to, procurement of
+ * substitute goods or services; loss of use, data, or profits; or
+ * business interruption) however caused and on any theory of liability,
+ * whether in contract, strict liability, or tort (including negligence
+ * or otherwise) arising in any way out of the use of this software, even
+ * if advised of the possibility of such damage.
+ *
+ */
+
+#ifndef C2D_CPUColorConverter_H_
+#define C2D_CPUColorConverter_H_
+
+#include <stdint.h>
+#include "ColorConverterLayout.h"
+
+namespace android {
+
+/*
+ * Converts on the CPU, for targets without the C2D library and as a
+ * baseline for the GPU path. Scaling and macro-tiled buffers are not
+ * supported. RGB to YUV rows go through a NEON, SSE2 or AVX2 kernel
+ * picked when the converter is created, the rest is plain C.
+ */
+class CPUColorConverter : public ColorConverterLayout {
+
+public:
+    CPUColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags, size_t srcStride);
+    int32_t dumpOutput(char * filename, char mode);
+    void flushMappings();
+    int convertC2DAsync(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData, c2d_ts_handle *ts);
+    int waitC2D(c2d_ts_handle ts);
+    int convertRows(void * srcData, void * dstData, size_t row, size_t rows);
+    int setOutputClip(uint8_t lumaMax, uint8_t chromaMax);
+    bool canConvertRows() { return !mError; }
+
+    /* Two RGBA rows to two luma rows and one chroma row, samples clamped
+     * to yMax and cMax. Returns the pixels done. */
+    typedef size_t (*RGBAToYUVRows)(const uint8_t *top, const uint8_t *bottom,
+            uint8_t *yTop, uint8_t *yBottom, uint8_t *u, uint8_t *v,
+            size_t cStep, size_t width, uint8_t yMax, uint8_t cMax);
+protected:
+    virtual ~CPUColorConverter() {};
+    virtual int convertC2D(int srcFd, void *srcBase, void * srcData, int dstFd, void *dstBase, void * dstData);
+
+private:
+    struct YUVPlanes {
+        uint8_t *y;
+        uint8_t *u;
+        uint8_t *v;
+        size_t yStride;
+        size_t cStride;
+        size_t cStep; /* 2 when U and V are interleaved */
+    };
+
+    bool isSupported(ColorConvertFormat format);
+    void getYUVPlanes(ColorConvertFormat format, size_t ySize, uint8_t *data, YUVPlanes *planes);
+    int convertBand(uint8_t *src, uint8_t *dst, size_t row, size_t rows);
+    void rgbToYUV(uint8_t *src, const YUVPlanes &dst, size_t row, size_t rows);
+    void yuvToRGB(const YUVPlanes &src, uint8_t *dst, size_t row, size_t rows);
+    void yuvToYUV(const YUVPlanes &src, const YUVPlanes &dst, size_t row, size_t rows);
+
+    RGBAToYUVRows mRGBAToYUV;
+    uint8_t *mLastOutput;
+    uint8_t mLumaMax;
+    uint8_t mChromaMax;
+    int mError;
+};
+
+}
+
+#endif  // C2D_CPUColorConverter_H_
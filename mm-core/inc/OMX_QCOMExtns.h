@@ -587,6 +587,9 @@ enum OMX_QCOM_EXTN_INDEXTYPE
 
     OMX_QcomIndexParamAUDelimiter = 0x7F000072,
 
+    /* "OMX.QTI.index.config.threadscheduling" */
+    OMX_QTIIndexConfigThreadScheduling = 0x7F000073,
+
     /* Capabilities */
     OMX_QTIIndexParamCapabilitiesVTDriverVersion = 0x7F100000,
 
@@ -1647,6 +1650,7 @@ typedef struct QOMX_VIDEO_CUSTOM_BUFFERSIZE {
 #define OMX_QTI_INDEX_PARAM_VIDEO_PREFER_ADAPTIVE_PLAYBACK "OMX.QTI.index.param.video.PreferAdaptivePlayback"
 #define OMX_QTI_INDEX_CONFIG_COLOR_ASPECTS "OMX.google.android.index.describeColorAspects"
 #define OMX_QTI_INDEX_PARAM_VIDEO_CLIENT_EXTRADATA "OMX.QTI.index.param.client.extradata"
+#define OMX_QTI_INDEX_CONFIG_THREAD_SCHEDULING "OMX.QTI.index.config.threadscheduling"
 
 typedef enum {
     QOMX_VIDEO_FRAME_PACKING_CHECKERBOARD = 0,
@@ -2036,6 +2040,28 @@ typedef struct QOMX_VIDEO_DITHER_CONTROL {
     QOMX_VIDEO_DITHERTYPE eDitherType;
 } QOMX_VIDEO_DITHER_CONTROL;
 
+typedef enum QOMX_THREAD_ROLE {
+    QOMX_THREAD_ROLE_MESSAGE = 0,   /* command, EBD and FBD processing */
+    QOMX_THREAD_ROLE_CALLBACK = 1,  /* driver event polling */
+} QOMX_THREAD_ROLE;
+
+/**
+ * Scheduling of one component thread role, used with
+ * OMX_QTIIndexConfigThreadScheduling. eRole selects the role on get.
+ *
+ * nCpuMask      : Bit n allows CPU n, 0 leaves the affinity alone
+ * nNice         : Nice level, used when nFifoPriority is 0
+ * nFifoPriority : SCHED_FIFO priority, 0 selects SCHED_OTHER
+ */
+typedef struct QOMX_CONFIG_THREAD_SCHEDULING {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    QOMX_THREAD_ROLE eRole;
+    OMX_U32 nCpuMask;
+    OMX_S32 nNice;
+    OMX_U32 nFifoPriority;
+} QOMX_CONFIG_THREAD_SCHEDULING;
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -38,6 +38,15 @@ LOCAL_SHARED_LIBRARIES    := liblog libutils libcutils libdl libhardware
 
 LOCAL_SRC_FILES   := src/extra_data_handler.cpp
 LOCAL_SRC_FILES   += src/vidc_color_converter.cpp
+LOCAL_SRC_FILES   += src/msg_doorbell.cpp
+LOCAL_SRC_FILES   += src/worker_pool.cpp
+LOCAL_SRC_FILES   += src/thread_sched.cpp
+LOCAL_SRC_FILES   += src/mmap_cache.cpp
+LOCAL_SRC_FILES   += src/band_executor.cpp
+LOCAL_SRC_FILES   += src/pixel_kernels.cpp
+LOCAL_SRC_FILES   += src/v4l2_ctrl_batch.cpp
+LOCAL_SRC_FILES   += src/vidc_props.cpp
+LOCAL_SRC_FILES   += src/ion_pool.cpp
 
 include $(BUILD_STATIC_LIBRARY)
 
@@ -0,0 +1,79 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __BAND_EXECUTOR_H__
+#define __BAND_EXECUTOR_H__
+
+#include <pthread.h>
+
+#define BAND_EXECUTOR_MAX_THREADS 8
+
+/*
+ * Splits per-frame pixel work into bands of rows and runs them on a fixed
+ * set of threads owned by one session. Bands are two 16 row macroblock
+ * rows, so a band always covers whole 4:2:0 chroma rows. The calling
+ * thread takes bands too, with one thread the work runs inline.
+ */
+class band_executor
+{
+    public:
+        typedef void (*band_fn)(void *arg, unsigned int row, unsigned int rows);
+
+        static const unsigned int BAND_ROWS = 32;
+
+        band_executor();
+        ~band_executor();
+        /*Threads counts the caller, the rest are started here*/
+        bool open(unsigned int threads);
+        void close();
+        unsigned int threads() const {
+            return m_num_threads + 1;
+        }
+        /*Calls fn on every band of [0, height) and returns once all are done*/
+        void run(band_fn fn, void *arg, unsigned int height);
+
+    private:
+        static void *worker(void *arg);
+        void take_bands();
+
+        /* Serializes run() callers and open/close */
+        pthread_mutex_t m_run_lock;
+        pthread_mutex_t m_lock;
+        pthread_cond_t m_work_cond;
+        pthread_cond_t m_done_cond;
+        pthread_t m_threads[BAND_EXECUTOR_MAX_THREADS];
+        unsigned int m_num_threads;
+        band_fn m_fn;
+        void *m_arg;
+        unsigned int m_height;
+        unsigned int m_next_row;
+        unsigned int m_bands_left;
+        unsigned int m_generation;
+        bool m_stop;
+};
+
+#endif /* __BAND_EXECUTOR_H__ */
@@ -0,0 +1,260 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __BIT_READER_H__
+#define __BIT_READER_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * MSB first bitstream reader shared by the H264, MPEG4 and SEI parsers.
+ *
+ * Up to 64 bits are cached so that most reads are a shift and a mask, and
+ * Exp-Golomb codes are decoded with a count of leading zeros instead of a
+ * bit at a time loop. Reads never go past the end of the data: missing
+ * bits read as zero and overrun() reports that it happened. With skip_epb
+ * set the 0x03 of every 00 00 03 sequence is dropped while filling the
+ * cache, so NAL payloads can be read without converting them to RBSP
+ * first.
+ */
+class bit_reader
+{
+    public:
+        bit_reader() {
+            init(NULL, 0);
+        }
+
+        bit_reader(const uint8_t *data, uint32_t size, bool skip_epb = false) {
+            init(data, size, skip_epb);
+        }
+
+        void init(const uint8_t *data, uint32_t size, bool skip_epb = false) {
+            m_start = data;
+            m_ptr = data;
+            m_end = data ? data + size : data;
+            m_cache = 0;
+            m_bits = 0;
+            m_zeros = 0;
+            m_epb_count = 0;
+            m_skip_epb = skip_epb;
+            m_overrun = false;
+        }
+
+        /*Read n bits, n <= 32*/
+        uint32_t u(uint32_t n) {
+            uint32_t value;
+
+            if (!n)
+                return 0;
+            if (m_bits < n) {
+                refill();
+                if (m_bits < n) {
+                    /*Out of data, pad with zeros*/
+                    value = m_bits ? (uint32_t)(m_cache >> (64 - n)) : 0;
+                    m_cache = 0;
+                    m_bits = 0;
+                    m_overrun = true;
+                    return value;
+                }
+            }
+            value = (uint32_t)(m_cache >> (64 - n));
+            m_cache <<= n;
+            m_bits -= n;
+            return value;
+        }
+
+        /*Unsigned Exp-Golomb code*/
+        uint32_t ue() {
+            uint32_t lead_zeros;
+
+            if (m_bits < 33)
+                refill();
+            lead_zeros = m_cache ? __builtin_clzll(m_cache) : 64;
+            if (lead_zeros >= m_bits || lead_zeros > 31) {
+                /*No terminating one bit within reach*/
+                m_cache = 0;
+                m_bits = 0;
+                m_ptr = m_end;
+                m_overrun = true;
+                return 0;
+            }
+            skip(lead_zeros);
+            return u(lead_zeros + 1) - 1;
+        }
+
+        /*Signed Exp-Golomb code*/
+        int32_t se() {
+            uint32_t code = ue();
+            int32_t value = (int32_t)((code >> 1) + (code & 1));
+
+            return (code & 1) ? value : -value;
+        }
+
+        void skip(uint32_t n) {
+            while (n > 32) {
+                u(32);
+                n -= 32;
+            }
+            u(n);
+        }
+
+        /*
+         * Skip n whole bytes of data, emulation prevention bytes within
+         * them not counted. Runs without a zero byte are stepped over a
+         * word at a time.
+         */
+        void skip_bytes(uint32_t n) {
+            while (n && m_bits >= 8) {
+                u(8);
+                n--;
+            }
+            if (!n)
+                return;
+            m_cache = 0;
+            m_bits = 0;
+            while (n && m_ptr < m_end) {
+                if (m_ptr + 8 <= m_end && n >= 8) {
+                    uint64_t word;
+
+                    memcpy(&word, m_ptr, sizeof(word));
+                    if (!m_skip_epb ||
+                            (!((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) &&
+                             (m_zeros < 2 || m_ptr[0] != 0x03))) {
+                        m_ptr += 8;
+                        n -= 8;
+                        m_zeros = 0;
+                        continue;
+                    }
+                }
+                if (m_skip_epb && *m_ptr == 0x03 && m_zeros >= 2) {
+                    m_zeros = 0;
+                    m_epb_count++;
+                } else {
+                    m_zeros = *m_ptr ? 0 : m_zeros + 1;
+                    n--;
+                }
+                m_ptr++;
+            }
+            if (n)
+                m_overrun = true;
+        }
+
+        bool byte_aligned() const {
+            return !(m_bits & 7);
+        }
+
+        /*Bits left until the next byte boundary*/
+        uint32_t bits_to_align() const {
+            return m_bits & 7;
+        }
+
+        bool more_bits() const {
+            return m_bits || m_ptr < m_end;
+        }
+
+        /*Bytes not read yet, emulation prevention bytes included*/
+        uint32_t bytes_left() const {
+            return (uint32_t)(m_end - m_ptr) + (m_bits >> 3);
+        }
+
+        /*Source bytes consumed so far, emulation prevention bytes included*/
+        uint32_t bytes_consumed() const {
+            return (uint32_t)(m_ptr - m_start) - (m_bits >> 3);
+        }
+
+        uint32_t epb_count() const {
+            return m_epb_count;
+        }
+
+        bool overrun() const {
+            return m_overrun;
+        }
+
+    private:
+        void refill() {
+            if (m_ptr + 8 <= m_end && m_bits <= 56) {
+                uint64_t word;
+
+                memcpy(&word, m_ptr, sizeof(word));
+                /*Eight bytes without a zero cannot hold emulation prevention
+                  bytes, unless the first one completes a pair seen earlier*/
+                if (!m_skip_epb ||
+                        (!((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) &&
+                         (m_zeros < 2 || m_ptr[0] != 0x03))) {
+                    uint32_t take = (64 - m_bits) >> 3;
+
+                    word = __builtin_bswap64(word) >> m_bits;
+                    word &= ~0ULL << (64 - m_bits - (take << 3));
+                    m_cache |= word;
+                    m_bits += take << 3;
+                    m_ptr += take;
+                    m_zeros = 0;
+                    return;
+                }
+            }
+
+            while (m_bits <= 56 && m_ptr < m_end) {
+                uint8_t byte = *m_ptr++;
+
+                if (m_skip_epb && byte == 0x03 && m_zeros >= 2) {
+                    m_zeros = 0;
+                    m_epb_count++;
+                    continue;
+                }
+                m_zeros = byte ? 0 : m_zeros + 1;
+                m_cache |= (uint64_t)byte << (56 - m_bits);
+                m_bits += 8;
+            }
+        }
+
+        const uint8_t *m_start;
+        const uint8_t *m_ptr;
+        const uint8_t *m_end;
+        uint64_t m_cache;
+        uint32_t m_bits;
+        uint32_t m_zeros;
+        uint32_t m_epb_count;
+        bool     m_skip_epb;
+        bool     m_overrun;
+};
+
+/*
+ * Read n (<= 32) bits starting bit_pos bits into data[0..size) without
+ * keeping any reader state. Bits past size read as zero.
+ */
+static inline uint32_t bits_read_at(const uint8_t *data, uint32_t size,
+        uint32_t bit_pos, uint32_t n)
+{
+    bit_reader reader(data + (bit_pos >> 3),
+            size > (bit_pos >> 3) ? size - (bit_pos >> 3) : 0);
+
+    reader.u(bit_pos & 7);
+    return reader.u(n);
+}
+
+#endif /* __BIT_READER_H__ */
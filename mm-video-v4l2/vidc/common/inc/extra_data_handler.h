@@ -44,6 +44,7 @@ extern "C" {
 #endif // _ANDROID_
 
 #include "vidc_debug.h"
+#include "bit_reader.h"
 #define SEI_PAYLOAD_FRAME_PACKING_ARRANGEMENT 0x2D
 #define H264_START_CODE 0x01
 #define NAL_TYPE_SEI 0x06
@@ -62,6 +63,7 @@ class extra_data_handler
     private:
         OMX_QCOM_FRAME_PACK_ARRANGEMENT frame_packing_arrangement;
         OMX_U8 *rbsp_buf;
+        bit_reader rbsp_reader;
         OMX_U32 bit_ptr;
         OMX_U32 byte_ptr;
         OMX_U32 pack_sei;
@@ -0,0 +1,92 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __ION_POOL_H__
+#define __ION_POOL_H__
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <linux/msm_ion.h>
+
+#define ION_POOL_ENTRIES 64
+
+/*
+ * Idle ION allocations kept for the next request of about the same size,
+ * so a port reconfiguration or a new session skips the ION alloc and
+ * free. Buffers are held as the ion client fd and handle, the taker maps
+ * a new share fd from them. Sizes are rounded up to a class so nearby
+ * sizes can trade buffers. Secure buffers are never kept.
+ *
+ * The shared pool hands buffers between sessions of different clients,
+ * so a reused buffer is zeroed first as ION_IOC_ALLOC would do. Reuse
+ * saves the allocation and the IOMMU mapping, not the clearing.
+ */
+class ion_pool
+{
+    public:
+        ion_pool();
+        ~ion_pool();
+        /*One pool for every component of the process*/
+        static ion_pool *shared();
+        /*Length to allocate for len, so the buffer can serve its class*/
+        static size_t class_size(size_t len);
+        /*Bytes kept idle at most, 0 frees everything and keeps nothing*/
+        void set_limit(size_t bytes);
+        /*
+         * For the shared pool, where every component asks for its own
+         * limit: the largest asked for is kept, it never goes down.
+         */
+        void raise_limit(size_t bytes);
+        /*
+         * Fills handle and len of alloc_data with an idle buffer of the
+         * same heap and flags, len and align at least the asked ones,
+         * zeroed. Returns its ion client fd, -1 when nothing fits.
+         */
+        int get(struct ion_allocation_data *alloc_data);
+        /*Takes ownership of the client fd and handle, false if it is not kept*/
+        bool put(int ion_device_fd, const struct ion_allocation_data *alloc_data);
+
+    private:
+        struct entry {
+            int ion_device_fd;
+            struct ion_allocation_data alloc_data;
+            unsigned long last_use;
+        };
+
+        static void release(struct entry *e);
+        static bool clear(int ion_device_fd, const struct ion_allocation_data *alloc_data);
+        void trim(size_t bytes, struct entry *evicted, int *count);
+
+        pthread_mutex_t m_lock;
+        struct entry m_entries[ION_POOL_ENTRIES];
+        int m_count;
+        size_t m_bytes;
+        size_t m_limit;
+        unsigned long m_clock;
+};
+
+#endif /* __ION_POOL_H__ */
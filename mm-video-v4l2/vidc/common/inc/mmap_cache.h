@@ -0,0 +1,77 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __MMAP_CACHE_H__
+#define __MMAP_CACHE_H__
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <linux/msm_ion.h>
+
+#define MMAP_CACHE_ENTRIES 8
+
+/*
+ * Keeps mappings of client buffers across frames, keyed by ION buffer,
+ * offset and size, with least recently used eviction. Sources cycle
+ * through a small set of buffers, so most frames reuse a mapping instead
+ * of paying for mmap and munmap. Neither the fd number nor its inode tell
+ * dma-bufs apart, so the fd is imported into an ION client of our own:
+ * ION hands back the handle it already has for the same buffer, and the
+ * entry holds that handle so the number cannot go to another buffer
+ * while it is cached. Fds ION does not know are mapped for one use.
+ */
+class mmap_cache
+{
+    public:
+        mmap_cache();
+        ~mmap_cache();
+        /*Returns NULL on failure, the mapping stays valid until put()*/
+        void *get(int fd, off_t offset, size_t size);
+        void put(void *addr, size_t size);
+        /*Drops every mapping, those in use are unmapped on put()*/
+        void invalidate();
+
+    private:
+        struct entry {
+            void *addr;
+            struct ion_handle_data ion;
+            off_t offset;
+            size_t size;
+            unsigned int refs;
+            unsigned long last_use;
+            bool stale;
+        };
+
+        void release(struct entry *e);
+
+        pthread_mutex_t m_lock;
+        int m_ion_fd;
+        struct entry m_entries[MMAP_CACHE_ENTRIES];
+        unsigned long m_clock;
+};
+
+#endif /* __MMAP_CACHE_H__ */
@@ -0,0 +1,60 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __MSG_DOORBELL_H__
+#define __MSG_DOORBELL_H__
+
+/*
+ * Wakes the component message thread after a message has been queued.
+ * Rings that arrive before the message thread has taken the previous one
+ * are coalesced, so a burst of posts costs one eventfd write and one
+ * wakeup. The message thread must take the ring before draining its
+ * queues so that a post racing with the drain rings again.
+ */
+class msg_doorbell
+{
+    public:
+        msg_doorbell();
+        ~msg_doorbell();
+        bool open();
+        void close();
+        /*Called by producers once the message is visible in the queue*/
+        void ring();
+        /*Returns 1 when rung, 0 on timeout and -1 on error (errno is set)*/
+        int wait(int timeout_ms);
+        /*For callers that poll fd() themselves, takes the ring once readable*/
+        bool take();
+        int fd() const {
+            return m_fd;
+        }
+
+    private:
+        int m_fd;
+        int m_rung;
+};
+
+#endif /* __MSG_DOORBELL_H__ */
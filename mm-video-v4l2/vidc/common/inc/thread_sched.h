@@ -0,0 +1,72 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __THREAD_SCHED_H__
+#define __THREAD_SCHED_H__
+
+#include <pthread.h>
+#include <sys/types.h>
+
+/*
+ * CPU affinity, nice level and SCHED_FIFO priority of the component
+ * threads, per role. Threads attach themselves when they start so that
+ * a configuration set before or after that point reaches them.
+ */
+class thread_sched
+{
+    public:
+        enum {
+            ROLE_MESSAGE,   /* OMX command, EBD and FBD processing */
+            ROLE_CALLBACK,  /* driver event polling */
+            ROLE_MAX,
+        };
+
+        struct config {
+            unsigned int cpu_mask;  /* 0 leaves the affinity alone */
+            int nice;
+            int fifo_priority;      /* 0 runs SCHED_OTHER at nice */
+        };
+
+        thread_sched();
+        ~thread_sched();
+        /*Reads "<prefix>.msg" and "<prefix>.cb" as "cpu_mask,nice,fifo_priority"*/
+        void load_properties(const char *prefix);
+        /*Called from the thread itself*/
+        void attach(int role);
+        void detach(int role);
+        bool set(int role, const config &cfg);
+        void get(int role, config *cfg);
+
+    private:
+        static bool apply(pid_t tid, const config &cfg);
+
+        pthread_mutex_t m_lock;
+        config m_config[ROLE_MAX];
+        pid_t m_tid[ROLE_MAX];
+};
+
+#endif /* __THREAD_SCHED_H__ */
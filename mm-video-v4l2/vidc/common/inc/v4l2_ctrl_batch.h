@@ -0,0 +1,66 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __V4L2_CTRL_BATCH_H__
+#define __V4L2_CTRL_BATCH_H__
+
+#include <linux/videodev2.h>
+
+#define V4L2_CTRL_BATCH_MAX 64
+
+/*
+ * Controls recorded while a session is being configured and written in
+ * one VIDIOC_S_EXT_CTRLS per control class, instead of one VIDIOC_S_CTRL
+ * each. A control written again before the flush keeps its place and
+ * takes the new value, so the driver sees it once.
+ */
+class v4l2_ctrl_batch
+{
+    public:
+        v4l2_ctrl_batch();
+        /*False when the batch is full, write the control directly then*/
+        bool stage(unsigned int id, int value);
+        /*False if the driver rejected any control, all are dropped either way*/
+        bool flush(int fd);
+        /*Whether the last flush() failed to write this control*/
+        bool rejected(unsigned int id) const;
+        unsigned int rejected_count() const {
+            return m_rejected_count;
+        }
+        void discard();
+        unsigned int count() const {
+            return m_count;
+        }
+
+    private:
+        struct v4l2_ext_control m_ctrls[V4L2_CTRL_BATCH_MAX];
+        unsigned int m_count;
+        unsigned int m_rejected[V4L2_CTRL_BATCH_MAX];
+        unsigned int m_rejected_count;
+};
+
+#endif /* __V4L2_CTRL_BATCH_H__ */
@@ -28,6 +28,7 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 --------------------------------------------------------------------------*/
 #include <dlfcn.h>
 #include "C2DColorConverter.h"
+#include "band_executor.h"
 
 using namespace android;
 class omx_c2d_conv
@@ -45,9 +46,22 @@ class omx_c2d_conv
         bool get_buffer_size(int port,unsigned int &buf_size);
         bool get_output_filled_length(unsigned int &filled_length);
         int get_src_format();
+        void flush();
         void close();
+        /*Splits CPU conversions into row bands on executor*/
+        void set_executor(band_executor *executor);
     private:
+        struct conv_band {
+            C2DColorConverterBase *c2dcc;
+            void *src;
+            void *dest;
+            int result;
+        };
+        static void convert_band(void *arg, unsigned int row, unsigned int rows);
         C2DColorConverterBase *c2dcc;
+        band_executor *m_executor;
+        unsigned int m_height;
+        bool m_split_rows;
         void *mLibHandle;
         ColorConvertFormat src_format;
         createC2DColorConverter_t *mConvertOpen;
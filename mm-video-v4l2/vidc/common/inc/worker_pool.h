@@ -0,0 +1,84 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#include <time.h>
+
+/*
+ * Runs component message processing on a process wide pool of threads
+ * sized to the number of cores, instead of one message thread per
+ * instance. Each instance owns a strand: its work function never runs on
+ * two workers at once, so the order of its messages is kept. Posts made
+ * while the strand is queued coalesce, posts made while it runs schedule
+ * exactly one more run. Work functions must not block on other threads;
+ * a wait is turned into a continuation that posts the strand again, with
+ * post_at() covering its deadline.
+ */
+class worker_strand
+{
+    public:
+        typedef void (*work_fn)(void *arg);
+
+        worker_strand();
+        ~worker_strand();
+        /*Attaches to the pool, starting it for the first strand*/
+        bool open(work_fn fn, void *arg);
+        /*
+         * Waits for a running pass to finish, stops the pool with the last
+         * strand. From the strand's own work function it returns at once;
+         * on a worker the pool is left running, as it cannot join itself.
+         */
+        void close();
+        void post();
+        /*Posts once the CLOCK_REALTIME time is reached, replaces an earlier one*/
+        void post_at(const struct timespec *when);
+        bool is_open() const {
+            return m_open;
+        }
+
+    private:
+        friend class worker_pool;
+        enum {
+            STRAND_IDLE,
+            STRAND_QUEUED,
+            STRAND_RUNNING,
+            STRAND_RERUN,
+        };
+
+        work_fn m_fn;
+        void *m_arg;
+        int m_state;
+        bool m_open;
+        worker_strand *m_next;
+        bool m_timed;
+        struct timespec m_due;
+        worker_strand *m_timer_next;
+};
+
+#endif /* __WORKER_POOL_H__ */
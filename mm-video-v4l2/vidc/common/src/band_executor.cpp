@@ -0,0 +1,160 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <string.h>
+#include <sys/prctl.h>
+#include "band_executor.h"
+#include "vidc_debug.h"
+
+band_executor::band_executor()
+    : m_num_threads(0),
+      m_fn(NULL),
+      m_arg(NULL),
+      m_height(0),
+      m_next_row(0),
+      m_bands_left(0),
+      m_generation(0),
+      m_stop(false)
+{
+    pthread_mutex_init(&m_run_lock, NULL);
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_work_cond, NULL);
+    pthread_cond_init(&m_done_cond, NULL);
+}
+
+band_executor::~band_executor()
+{
+    close();
+    pthread_cond_destroy(&m_done_cond);
+    pthread_cond_destroy(&m_work_cond);
+    pthread_mutex_destroy(&m_lock);
+    pthread_mutex_destroy(&m_run_lock);
+}
+
+bool band_executor::open(unsigned int threads)
+{
+    int err;
+
+    close();
+    if (threads > BAND_EXECUTOR_MAX_THREADS)
+        threads = BAND_EXECUTOR_MAX_THREADS;
+
+    pthread_mutex_lock(&m_run_lock);
+    m_stop = false;
+    while (m_num_threads + 1 < threads) {
+        err = pthread_create(&m_threads[m_num_threads], NULL, worker, this);
+        if (err) {
+            DEBUG_PRINT_ERROR("band_executor: thread creation failed: %s", strerror(err));
+            break;
+        }
+        m_num_threads++;
+    }
+    pthread_mutex_unlock(&m_run_lock);
+
+    DEBUG_PRINT_HIGH("band_executor: %u threads", m_num_threads + 1);
+    return m_num_threads + 1 >= threads;
+}
+
+void band_executor::close()
+{
+    pthread_mutex_lock(&m_run_lock);
+    pthread_mutex_lock(&m_lock);
+    m_stop = true;
+    pthread_cond_broadcast(&m_work_cond);
+    pthread_mutex_unlock(&m_lock);
+
+    while (m_num_threads)
+        pthread_join(m_threads[--m_num_threads], NULL);
+    pthread_mutex_unlock(&m_run_lock);
+}
+
+/* Called with m_lock held, returns with it held */
+void band_executor::take_bands()
+{
+    unsigned int row, rows;
+
+    while (m_next_row < m_height) {
+        row = m_next_row;
+        rows = m_height - row < BAND_ROWS ? m_height - row : BAND_ROWS;
+        m_next_row += rows;
+        pthread_mutex_unlock(&m_lock);
+
+        m_fn(m_arg, row, rows);
+
+        pthread_mutex_lock(&m_lock);
+        if (!--m_bands_left)
+            pthread_cond_broadcast(&m_done_cond);
+    }
+}
+
+void *band_executor::worker(void *arg)
+{
+    band_executor *self = (band_executor *)arg;
+    unsigned int seen = 0;
+
+    prctl(PR_SET_NAME, (unsigned long)"VidcBand", 0, 0, 0);
+    pthread_mutex_lock(&self->m_lock);
+    seen = self->m_generation;
+    while (1) {
+        while (!self->m_stop && self->m_generation == seen)
+            pthread_cond_wait(&self->m_work_cond, &self->m_lock);
+        if (self->m_stop)
+            break;
+        seen = self->m_generation;
+        self->take_bands();
+    }
+    pthread_mutex_unlock(&self->m_lock);
+    return NULL;
+}
+
+void band_executor::run(band_fn fn, void *arg, unsigned int height)
+{
+    if (!height)
+        return;
+
+    pthread_mutex_lock(&m_run_lock);
+    if (!m_num_threads || height <= BAND_ROWS) {
+        pthread_mutex_unlock(&m_run_lock);
+        fn(arg, 0, height);
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    m_fn = fn;
+    m_arg = arg;
+    m_height = height;
+    m_next_row = 0;
+    m_bands_left = (height + BAND_ROWS - 1) / BAND_ROWS;
+    m_generation++;
+    pthread_cond_broadcast(&m_work_cond);
+
+    take_bands();
+    while (m_bands_left)
+        pthread_cond_wait(&m_done_cond, &m_lock);
+    pthread_mutex_unlock(&m_lock);
+    pthread_mutex_unlock(&m_run_lock);
+}
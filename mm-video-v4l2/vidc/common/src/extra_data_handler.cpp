@@ -49,35 +49,7 @@ extra_data_handler::~extra_data_handler()
 
 OMX_U32 extra_data_handler::d_u(OMX_U32 num_bits)
 {
-    OMX_U32 rem_bits = num_bits, bins = 0, shift = 0;
-
-    while (rem_bits >= bit_ptr) {
-        DEBUG_PRINT_LOW("In %s() bit_ptr/byte_ptr :%u/%u/%x", __func__, (unsigned int)bit_ptr,
-                (unsigned int)byte_ptr, rbsp_buf[byte_ptr]);
-        bins <<= shift;
-        shift = (8-bit_ptr);
-        bins |= ((rbsp_buf[byte_ptr] << shift) & 0xFF) >> shift;
-        rem_bits -= bit_ptr;
-        bit_ptr = 8;
-        byte_ptr ++;
-    }
-
-    DEBUG_PRINT_LOW("In %s() bit_ptr/byte_ptr :%u/%u/%x", __func__, (unsigned int)bit_ptr,
-            (unsigned int)byte_ptr, rbsp_buf[byte_ptr]);
-
-    if (rem_bits) {
-        bins <<= rem_bits;
-        bins |= ((rbsp_buf[byte_ptr] << (8-bit_ptr)) & 0xFF) >> (8-rem_bits);
-        bit_ptr -= rem_bits;
-
-        if (bit_ptr == 0) {
-            bit_ptr = 8;
-            byte_ptr++;
-        }
-    }
-
-    DEBUG_PRINT_LOW("In %s() bit_ptr/byte_ptr :%u/%u/%x", __func__, (unsigned int)bit_ptr,
-            (unsigned int)byte_ptr, rbsp_buf[byte_ptr]);
+    OMX_U32 bins = rbsp_reader.u(num_bits);
 
     DEBUG_PRINT_LOW("In %s() bin/num_bits : %x/%u", __func__, (unsigned)bins, (unsigned int)num_bits);
     return bins;
@@ -85,15 +57,7 @@ OMX_U32 extra_data_handler::d_u(OMX_U32 num_bits)
 
 OMX_U32 extra_data_handler::d_ue()
 {
-    OMX_S32 lead_zeros = -1;
-    OMX_U32 symbol, bit;
-
-    do {
-        bit = d_u(1);
-        lead_zeros++;
-    } while (!bit);
-
-    symbol = ((1 << lead_zeros) - 1) + d_u(lead_zeros);
+    OMX_U32 symbol = rbsp_reader.ue();
 
     DEBUG_PRINT_LOW("In %s() symbol : %u", __func__, (unsigned int)symbol);
     return symbol;
@@ -134,12 +98,9 @@ OMX_U32 extra_data_handler::parse_frame_pack(void)
 
 OMX_S32 extra_data_handler::parse_rbsp(OMX_U8 *buf, OMX_U32 len)
 {
-    OMX_U32 i = 3, j=0, startcode;
+    OMX_U32 i = 3, startcode;
     OMX_U32 nal_unit_type, nal_ref_idc, forbidden_zero_bit;
 
-    bit_ptr  = 8;
-    byte_ptr = 0;
-
     startcode =  buf[0] << 16 | buf[1] <<8 | buf[2];
 
     if (!startcode) {
@@ -163,22 +124,16 @@ OMX_S32 extra_data_handler::parse_rbsp(OMX_U8 *buf, OMX_U32 len)
 
     nal_unit_type = (buf[i++] & 0x1F);
 
-    while (i<len) {
-        if (!(buf[i] + buf[i+1]) && (buf[i+2] == H264_EMULATION_BYTE) &&
-                (i+2 < len)) {
-            rbsp_buf[j++] = buf[i++];
-            rbsp_buf[j++] = buf[i++];
-            i++;
-        } else
-            rbsp_buf[j++] = buf[i++];
-    }
+    /*The payload is read in place, emulation prevention bytes are
+      skipped by the reader*/
+    rbsp_reader.init(buf + i, (i < len) ? len - i : 0, true);
 
     return nal_unit_type;
 }
 OMX_S32 extra_data_handler::parse_sei(OMX_U8 *buffer, OMX_U32 buffer_length)
 {
     OMX_U32 nal_unit_type, payload_type = 0, payload_size = 0;
-    OMX_U32 marker = 0, pad = 0xFF;
+    OMX_U32 marker = 0, pad = 0xFF, value;
 
     nal_unit_type = parse_rbsp(buffer, buffer_length);
 
@@ -187,17 +142,17 @@ OMX_S32 extra_data_handler::parse_sei(OMX_U8 *buffer, OMX_U32 buffer_length)
         return -1;
     } else {
 
-        while (rbsp_buf[byte_ptr] == 0xFF)
-            payload_type += rbsp_buf[byte_ptr++];
+        while ((value = rbsp_reader.u(8)) == 0xFF && !rbsp_reader.overrun())
+            payload_type += value;
 
-        payload_type += rbsp_buf[byte_ptr++];
+        payload_type += value;
 
         DEBUG_PRINT_LOW("In %s() payload_type : %u", __func__, (unsigned int)payload_type);
 
-        while (rbsp_buf[byte_ptr] == 0xFF)
-            payload_size += rbsp_buf[byte_ptr++];
+        while ((value = rbsp_reader.u(8)) == 0xFF && !rbsp_reader.overrun())
+            payload_size += value;
 
-        payload_size += rbsp_buf[byte_ptr++];
+        payload_size += value;
 
         DEBUG_PRINT_LOW("In %s() payload_size : %u", __func__, (unsigned int)payload_size);
 
@@ -212,12 +167,12 @@ OMX_S32 extra_data_handler::parse_sei(OMX_U8 *buffer, OMX_U32 buffer_length)
         }
     }
 
-    if (bit_ptr != 8) {
+    if (!rbsp_reader.byte_aligned()) {
         marker = d_u(1);
 
         if (marker) {
-            if (bit_ptr != 8) {
-                pad = d_u(bit_ptr);
+            if (!rbsp_reader.byte_aligned()) {
+                pad = d_u(rbsp_reader.bits_to_align());
 
                 if (pad) {
                     DEBUG_PRINT_ERROR("ERROR: In %s() padding Bits Error in SEI",
@@ -233,7 +188,7 @@ OMX_S32 extra_data_handler::parse_sei(OMX_U8 *buffer, OMX_U32 buffer_length)
     }
 
     DEBUG_PRINT_LOW("In %s() payload_size : %u/%u", __func__,
-            (unsigned int)payload_size, (unsigned int)byte_ptr);
+            (unsigned int)payload_size, (unsigned int)rbsp_reader.bytes_consumed());
     return 1;
 }
 
@@ -0,0 +1,237 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "ion_pool.h"
+#include "vidc_debug.h"
+
+#define ION_POOL_PAGE 4096
+/* A cached buffer serves requests down to half its size */
+#define ION_POOL_MAX_SLACK 2
+
+static pthread_once_t s_shared_once = PTHREAD_ONCE_INIT;
+static ion_pool *s_shared;
+
+static void create_shared()
+{
+    /* Never destroyed, components may still free into it at exit */
+    s_shared = new ion_pool();
+}
+
+ion_pool *ion_pool::shared()
+{
+    pthread_once(&s_shared_once, create_shared);
+    return s_shared;
+}
+
+size_t ion_pool::class_size(size_t len)
+{
+    size_t step = ION_POOL_PAGE;
+
+    /* Eight classes per power of two, at most an eighth is wasted */
+    while (step * 16 <= len)
+        step <<= 1;
+    return (len + step - 1) & ~(step - 1);
+}
+
+ion_pool::ion_pool()
+    : m_count(0),
+    m_bytes(0),
+    m_limit(0),
+    m_clock(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    memset(m_entries, 0, sizeof(m_entries));
+}
+
+ion_pool::~ion_pool()
+{
+    for (int i = 0; i < m_count; i++)
+        release(&m_entries[i]);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void ion_pool::release(struct entry *e)
+{
+    if (ioctl(e->ion_device_fd, ION_IOC_FREE, &e->alloc_data.handle))
+        DEBUG_PRINT_ERROR("ion_pool: free failed");
+    close(e->ion_device_fd);
+}
+
+/*
+ * Zeroes the buffer like a new ION allocation, the last owner may have
+ * been the session of another client. Cached buffers are cleaned too, so
+ * the device cannot read what the CPU cache still holds.
+ */
+bool ion_pool::clear(int ion_device_fd, const struct ion_allocation_data *alloc_data)
+{
+    struct ion_fd_data fd_data;
+    void *addr;
+    bool cleared = true;
+
+    memset(&fd_data, 0, sizeof(fd_data));
+    fd_data.handle = alloc_data->handle;
+    if (ioctl(ion_device_fd, ION_IOC_MAP, &fd_data))
+        return false;
+    addr = mmap(NULL, alloc_data->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd_data.fd, 0);
+    if (addr == MAP_FAILED) {
+        close(fd_data.fd);
+        return false;
+    }
+
+    memset(addr, 0, alloc_data->len);
+    if (alloc_data->flags & ION_FLAG_CACHED) {
+        struct ion_flush_data flush_data;
+        struct ion_custom_data custom_data;
+
+        memset(&flush_data, 0, sizeof(flush_data));
+        memset(&custom_data, 0, sizeof(custom_data));
+        flush_data.vaddr = addr;
+        flush_data.fd = fd_data.fd;
+        flush_data.handle = fd_data.handle;
+        flush_data.length = alloc_data->len;
+        custom_data.cmd = ION_IOC_CLEAN_CACHES;
+        custom_data.arg = (unsigned long)&flush_data;
+        cleared = !ioctl(ion_device_fd, ION_IOC_CUSTOM, &custom_data);
+    }
+    munmap(addr, alloc_data->len);
+    close(fd_data.fd);
+    return cleared;
+}
+
+/* Called with m_lock held, evicts the least recently kept until bytes fit */
+void ion_pool::trim(size_t bytes, struct entry *evicted, int *count)
+{
+    while (m_count && (m_bytes + bytes > m_limit || m_count == ION_POOL_ENTRIES)) {
+        int victim = 0;
+
+        for (int i = 1; i < m_count; i++) {
+            if (m_entries[i].last_use < m_entries[victim].last_use)
+                victim = i;
+        }
+        m_bytes -= m_entries[victim].alloc_data.len;
+        evicted[(*count)++] = m_entries[victim];
+        m_entries[victim] = m_entries[--m_count];
+    }
+}
+
+void ion_pool::set_limit(size_t bytes)
+{
+    struct entry evicted[ION_POOL_ENTRIES];
+    int count = 0;
+
+    pthread_mutex_lock(&m_lock);
+    m_limit = bytes;
+    if (m_bytes > m_limit)
+        trim(0, evicted, &count);
+    pthread_mutex_unlock(&m_lock);
+
+    while (count--)
+        release(&evicted[count]);
+}
+
+void ion_pool::raise_limit(size_t bytes)
+{
+    pthread_mutex_lock(&m_lock);
+    if (bytes > m_limit)
+        m_limit = bytes;
+    pthread_mutex_unlock(&m_lock);
+}
+
+int ion_pool::get(struct ion_allocation_data *alloc_data)
+{
+    struct entry e;
+    int best = -1;
+
+    if (alloc_data->flags & ION_SECURE)
+        return -1;
+
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < m_count; i++) {
+        const struct ion_allocation_data *d = &m_entries[i].alloc_data;
+
+        if (d->heap_id_mask != alloc_data->heap_id_mask ||
+                d->flags != alloc_data->flags ||
+                d->align < alloc_data->align ||
+                d->len < alloc_data->len ||
+                d->len > alloc_data->len * ION_POOL_MAX_SLACK)
+            continue;
+        if (best < 0 || d->len < m_entries[best].alloc_data.len)
+            best = i;
+    }
+    if (best < 0) {
+        pthread_mutex_unlock(&m_lock);
+        return -1;
+    }
+
+    e = m_entries[best];
+    m_bytes -= e.alloc_data.len;
+    m_entries[best] = m_entries[--m_count];
+    pthread_mutex_unlock(&m_lock);
+
+    if (!clear(e.ion_device_fd, &e.alloc_data)) {
+        DEBUG_PRINT_ERROR("ion_pool: clearing %zu bytes failed, not reused",
+                (size_t)e.alloc_data.len);
+        release(&e);
+        return -1;
+    }
+
+    alloc_data->handle = e.alloc_data.handle;
+    alloc_data->len = e.alloc_data.len;
+    alloc_data->align = e.alloc_data.align;
+    DEBUG_PRINT_LOW("ion_pool: reusing %zu bytes", (size_t)alloc_data->len);
+    return e.ion_device_fd;
+}
+
+bool ion_pool::put(int ion_device_fd, const struct ion_allocation_data *alloc_data)
+{
+    struct entry evicted[ION_POOL_ENTRIES];
+    int count = 0;
+    bool kept = false;
+
+    if (ion_device_fd < 0 || !alloc_data->handle || (alloc_data->flags & ION_SECURE))
+        return false;
+
+    pthread_mutex_lock(&m_lock);
+    if (alloc_data->len <= m_limit) {
+        trim(alloc_data->len, evicted, &count);
+        m_entries[m_count].ion_device_fd = ion_device_fd;
+        m_entries[m_count].alloc_data = *alloc_data;
+        m_entries[m_count].last_use = ++m_clock;
+        m_count++;
+        m_bytes += alloc_data->len;
+        kept = true;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    while (count--)
+        release(&evicted[count]);
+    return kept;
+}
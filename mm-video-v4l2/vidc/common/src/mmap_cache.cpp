@@ -0,0 +1,183 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "mmap_cache.h"
+#include "vidc_debug.h"
+
+mmap_cache::mmap_cache()
+    : m_clock(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    memset(m_entries, 0, sizeof(m_entries));
+    /* Without it every buffer is mapped for one use */
+    m_ion_fd = open("/dev/ion", O_RDONLY);
+    if (m_ion_fd < 0)
+        DEBUG_PRINT_ERROR("mmap_cache: ION open failed, not caching");
+}
+
+mmap_cache::~mmap_cache()
+{
+    for (int i = 0; i < MMAP_CACHE_ENTRIES; i++) {
+        if (m_entries[i].addr)
+            release(&m_entries[i]);
+    }
+    if (m_ion_fd >= 0)
+        close(m_ion_fd);
+    pthread_mutex_destroy(&m_lock);
+}
+
+/* Called without m_lock on an entry already taken out of the table */
+void mmap_cache::release(struct entry *e)
+{
+    munmap(e->addr, e->size);
+    if (ioctl(m_ion_fd, ION_IOC_FREE, &e->ion))
+        DEBUG_PRINT_ERROR("mmap_cache: ION free failed");
+}
+
+void *mmap_cache::get(int fd, off_t offset, size_t size)
+{
+    struct ion_fd_data import;
+    struct entry *victim = NULL;
+    struct entry old;
+    void *addr;
+
+    memset(&import, 0, sizeof(import));
+    import.fd = fd;
+    if (m_ion_fd < 0 || ioctl(m_ion_fd, ION_IOC_IMPORT, &import)) {
+        addr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, offset);
+        return addr == MAP_FAILED ? NULL : addr;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < MMAP_CACHE_ENTRIES; i++) {
+        struct entry *e = &m_entries[i];
+
+        if (!e->addr || e->stale || e->ion.handle != import.handle ||
+                e->offset != offset || e->size != size)
+            continue;
+        e->refs++;
+        e->last_use = ++m_clock;
+        addr = e->addr;
+        pthread_mutex_unlock(&m_lock);
+        /* The entry keeps the handle, drop the reference the import took */
+        if (ioctl(m_ion_fd, ION_IOC_FREE, &import.handle))
+            DEBUG_PRINT_ERROR("mmap_cache: ION free failed");
+        return addr;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    addr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, offset);
+    if (addr == MAP_FAILED) {
+        ioctl(m_ion_fd, ION_IOC_FREE, &import.handle);
+        return NULL;
+    }
+
+    memset(&old, 0, sizeof(old));
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < MMAP_CACHE_ENTRIES; i++) {
+        struct entry *e = &m_entries[i];
+
+        if (!e->addr) {
+            victim = e;
+            break;
+        }
+        if (!e->refs && (!victim || e->last_use < victim->last_use))
+            victim = e;
+    }
+    if (victim) {
+        old = *victim;
+        victim->addr = addr;
+        victim->ion.handle = import.handle;
+        victim->offset = offset;
+        victim->size = size;
+        victim->refs = 1;
+        victim->last_use = ++m_clock;
+        victim->stale = false;
+    }
+    pthread_mutex_unlock(&m_lock);
+    if (old.addr)
+        release(&old);
+    /* Every entry in use, put() unmaps this one as it is not cached */
+    if (!victim)
+        ioctl(m_ion_fd, ION_IOC_FREE, &import.handle);
+    return addr;
+}
+
+void mmap_cache::put(void *addr, size_t size)
+{
+    struct entry old;
+    bool cached = false;
+
+    memset(&old, 0, sizeof(old));
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < MMAP_CACHE_ENTRIES; i++) {
+        struct entry *e = &m_entries[i];
+
+        if (e->addr != addr || !e->refs)
+            continue;
+        cached = true;
+        if (!--e->refs && e->stale) {
+            old = *e;
+            memset(e, 0, sizeof(*e));
+        }
+        break;
+    }
+    pthread_mutex_unlock(&m_lock);
+    if (old.addr)
+        release(&old);
+    else if (!cached)
+        munmap(addr, size);
+}
+
+void mmap_cache::invalidate()
+{
+    struct entry old[MMAP_CACHE_ENTRIES];
+    int count = 0;
+
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < MMAP_CACHE_ENTRIES; i++) {
+        struct entry *e = &m_entries[i];
+
+        if (!e->addr)
+            continue;
+        if (e->refs) {
+            e->stale = true;
+        } else {
+            old[count++] = *e;
+            memset(e, 0, sizeof(*e));
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    while (count--)
+        release(&old[count]);
+}
@@ -0,0 +1,107 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "msg_doorbell.h"
+#include "vidc_debug.h"
+
+msg_doorbell::msg_doorbell()
+    : m_fd(-1),
+      m_rung(0)
+{
+}
+
+msg_doorbell::~msg_doorbell()
+{
+    close();
+}
+
+bool msg_doorbell::open()
+{
+    close();
+    m_fd = eventfd(0, EFD_CLOEXEC);
+    if (m_fd < 0) {
+        DEBUG_PRINT_ERROR("msg_doorbell: eventfd failed: %s", strerror(errno));
+        return false;
+    }
+    m_rung = 0;
+    return true;
+}
+
+void msg_doorbell::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void msg_doorbell::ring()
+{
+    uint64_t one = 1;
+
+    /* A ring is already pending, the message thread will see our message */
+    if (__atomic_exchange_n(&m_rung, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    if (write(m_fd, &one, sizeof(one)) != sizeof(one)) {
+        DEBUG_PRINT_ERROR("msg_doorbell: write failed: %s", strerror(errno));
+        __atomic_store_n(&m_rung, 0, __ATOMIC_RELEASE);
+    }
+}
+
+int msg_doorbell::wait(int timeout_ms)
+{
+    struct pollfd pfd;
+    int res;
+
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    res = poll(&pfd, 1, timeout_ms);
+    if (res <= 0)
+        return res;
+
+    return take() ? 1 : -1;
+}
+
+bool msg_doorbell::take()
+{
+    uint64_t count;
+
+    if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+        return false;
+
+    __atomic_store_n(&m_rung, 0, __ATOMIC_SEQ_CST);
+    return true;
+}
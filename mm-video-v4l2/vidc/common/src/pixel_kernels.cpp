@@ -0,0 +1,118 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <pthread.h>
+#include "pixel_kernels.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+typedef void (*clip_row_fn)(uint8_t *row, unsigned int len, uint8_t max);
+
+static void clip_row_c(uint8_t *row, unsigned int len, uint8_t max)
+{
+    for (unsigned int i = 0; i < len; i++) {
+        if (row[i] > max)
+            row[i] = max;
+    }
+}
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+static void clip_row_neon(uint8_t *row, unsigned int len, uint8_t max)
+{
+    const uint8x16_t vmax = vdupq_n_u8(max);
+    unsigned int i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        vst1q_u8(row + i, vminq_u8(vld1q_u8(row + i), vmax));
+        vst1q_u8(row + i + 16, vminq_u8(vld1q_u8(row + i + 16), vmax));
+    }
+    for (; i + 16 <= len; i += 16)
+        vst1q_u8(row + i, vminq_u8(vld1q_u8(row + i), vmax));
+    clip_row_c(row + i, len - i, max);
+}
+#elif defined(__i386__) || defined(__x86_64__)
+static void clip_row_sse2(uint8_t *row, unsigned int len, uint8_t max)
+{
+    const __m128i vmax = _mm_set1_epi8((char)max);
+    unsigned int i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i *p = (__m128i *)(row + i);
+
+        _mm_storeu_si128(p, _mm_min_epu8(_mm_loadu_si128(p), vmax));
+    }
+    clip_row_c(row + i, len - i, max);
+}
+
+__attribute__((target("avx2")))
+static void clip_row_avx2(uint8_t *row, unsigned int len, uint8_t max)
+{
+    const __m256i vmax = _mm256_set1_epi8((char)max);
+    unsigned int i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i *p = (__m256i *)(row + i);
+
+        _mm256_storeu_si256(p, _mm256_min_epu8(_mm256_loadu_si256(p), vmax));
+    }
+    clip_row_sse2(row + i, len - i, max);
+}
+#endif
+
+static clip_row_fn clip_row = clip_row_c;
+static pthread_once_t clip_row_once = PTHREAD_ONCE_INIT;
+
+static void select_clip_row()
+{
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    clip_row = clip_row_neon;
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+    clip_row = __builtin_cpu_supports("avx2") ? clip_row_avx2 : clip_row_sse2;
+#endif
+}
+
+void pixel_clip_nv12(uint8_t *luma, uint8_t *chroma, unsigned int stride,
+        unsigned int width, unsigned int height, unsigned int row,
+        unsigned int rows, uint8_t luma_max, uint8_t chroma_max)
+{
+    /* U and V interleaved, an odd last column still has a pair */
+    unsigned int chroma_width = (width + 1) & ~1;
+    unsigned int end = row + rows > height ? height : row + rows;
+
+    pthread_once(&clip_row_once, select_clip_row);
+
+    for (unsigned int y = row; y < end; y++)
+        clip_row(luma + y * stride, width, luma_max);
+    for (unsigned int y = row / 2; y < (end + 1) / 2; y++)
+        clip_row(chroma + y * stride, chroma_width, chroma_max);
+}
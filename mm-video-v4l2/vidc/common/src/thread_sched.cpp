@@ -0,0 +1,165 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <cutils/properties.h>
+#include "thread_sched.h"
+#include "vidc_props.h"
+#include "vidc_debug.h"
+
+static const char *role_suffix[thread_sched::ROLE_MAX] = { "msg", "cb" };
+
+thread_sched::thread_sched()
+{
+    pthread_mutex_init(&m_lock, NULL);
+    memset(m_config, 0, sizeof(m_config));
+    memset(m_tid, 0, sizeof(m_tid));
+}
+
+thread_sched::~thread_sched()
+{
+    pthread_mutex_destroy(&m_lock);
+}
+
+void thread_sched::load_properties(const char *prefix)
+{
+    char name[PROPERTY_KEY_MAX];
+    char value[PROPERTY_VALUE_MAX];
+    config cfg;
+
+    for (int role = 0; role < ROLE_MAX; role++) {
+        snprintf(name, sizeof(name), "%s.%s", prefix, role_suffix[role]);
+        value[0] = '\0';
+        if (vidc_props::get(name, value, "") <= 0)
+            continue;
+        memset(&cfg, 0, sizeof(cfg));
+        if (sscanf(value, "%i,%i,%i", (int *)&cfg.cpu_mask, &cfg.nice, &cfg.fifo_priority) < 1) {
+            DEBUG_PRINT_ERROR("thread_sched: ignoring %s = \"%s\"", name, value);
+            continue;
+        }
+        DEBUG_PRINT_HIGH("%s value is 0x%x,%d,%d", name, cfg.cpu_mask, cfg.nice, cfg.fifo_priority);
+        set(role, cfg);
+    }
+}
+
+bool thread_sched::apply(pid_t tid, const config &cfg)
+{
+    struct sched_param param;
+    bool ok = true;
+
+    if (cfg.cpu_mask) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        for (unsigned int cpu = 0; cpu < 32; cpu++) {
+            if (cfg.cpu_mask & (1u << cpu))
+                CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(tid, sizeof(set), &set)) {
+            DEBUG_PRINT_ERROR("thread_sched: affinity 0x%x for %d failed: %s",
+                    cfg.cpu_mask, tid, strerror(errno));
+            ok = false;
+        }
+    }
+
+    memset(&param, 0, sizeof(param));
+    if (cfg.fifo_priority > 0) {
+        param.sched_priority = cfg.fifo_priority;
+        if (sched_setscheduler(tid, SCHED_FIFO, &param)) {
+            DEBUG_PRINT_ERROR("thread_sched: SCHED_FIFO %d for %d failed: %s",
+                    cfg.fifo_priority, tid, strerror(errno));
+            ok = false;
+        }
+    } else {
+        /* Drop back from SCHED_FIFO if an earlier config asked for it */
+        if (sched_getscheduler(tid) == SCHED_FIFO)
+            sched_setscheduler(tid, SCHED_OTHER, &param);
+        if (setpriority(PRIO_PROCESS, tid, cfg.nice)) {
+            DEBUG_PRINT_ERROR("thread_sched: nice %d for %d failed: %s",
+                    cfg.nice, tid, strerror(errno));
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void thread_sched::attach(int role)
+{
+    if (role < 0 || role >= ROLE_MAX)
+        return;
+
+    /* Under the lock, as in set(), so a concurrent set() is not undone */
+    pthread_mutex_lock(&m_lock);
+    m_tid[role] = syscall(SYS_gettid);
+    if (m_config[role].cpu_mask || m_config[role].nice || m_config[role].fifo_priority)
+        apply(m_tid[role], m_config[role]);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void thread_sched::detach(int role)
+{
+    if (role < 0 || role >= ROLE_MAX)
+        return;
+
+    pthread_mutex_lock(&m_lock);
+    m_tid[role] = 0;
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool thread_sched::set(int role, const config &cfg)
+{
+    bool ok = true;
+
+    if (role < 0 || role >= ROLE_MAX ||
+            cfg.fifo_priority < 0 || cfg.fifo_priority > sched_get_priority_max(SCHED_FIFO) ||
+            cfg.nice < -20 || cfg.nice > 19)
+        return false;
+
+    /* Held across apply() so that the thread cannot detach meanwhile */
+    pthread_mutex_lock(&m_lock);
+    m_config[role] = cfg;
+    if (m_tid[role])
+        ok = apply(m_tid[role], cfg);
+    pthread_mutex_unlock(&m_lock);
+    return ok;
+}
+
+void thread_sched::get(int role, config *cfg)
+{
+    if (role < 0 || role >= ROLE_MAX)
+        return;
+
+    pthread_mutex_lock(&m_lock);
+    *cfg = m_config[role];
+    pthread_mutex_unlock(&m_lock);
+}
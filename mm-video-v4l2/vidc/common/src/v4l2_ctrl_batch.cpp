@@ -0,0 +1,123 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include "v4l2_ctrl_batch.h"
+#include "vidc_debug.h"
+
+v4l2_ctrl_batch::v4l2_ctrl_batch()
+    : m_count(0),
+    m_rejected_count(0)
+{
+    memset(m_ctrls, 0, sizeof(m_ctrls));
+    memset(m_rejected, 0, sizeof(m_rejected));
+}
+
+bool v4l2_ctrl_batch::stage(unsigned int id, int value)
+{
+    for (unsigned int i = 0; i < m_count; i++) {
+        if (m_ctrls[i].id == id) {
+            m_ctrls[i].value = value;
+            return true;
+        }
+    }
+    if (m_count == V4L2_CTRL_BATCH_MAX)
+        return false;
+
+    memset(&m_ctrls[m_count], 0, sizeof(m_ctrls[m_count]));
+    m_ctrls[m_count].id = id;
+    m_ctrls[m_count].value = value;
+    m_count++;
+    return true;
+}
+
+bool v4l2_ctrl_batch::flush(int fd)
+{
+    struct v4l2_ext_control group[V4L2_CTRL_BATCH_MAX];
+    struct v4l2_ext_controls controls;
+    bool done[V4L2_CTRL_BATCH_MAX];
+    bool status = true;
+
+    memset(done, 0, sizeof(done));
+    m_rejected_count = 0;
+    for (unsigned int i = 0; i < m_count; i++) {
+        unsigned int ctrl_class = V4L2_CTRL_ID2CLASS(m_ctrls[i].id);
+        unsigned int n = 0;
+
+        if (done[i])
+            continue;
+        /* Same class, in the order they were staged */
+        for (unsigned int j = i; j < m_count; j++) {
+            if (!done[j] && V4L2_CTRL_ID2CLASS(m_ctrls[j].id) == ctrl_class) {
+                group[n++] = m_ctrls[j];
+                done[j] = true;
+            }
+        }
+
+        memset(&controls, 0, sizeof(controls));
+        controls.ctrl_class = ctrl_class;
+        controls.count = n;
+        controls.controls = group;
+        DEBUG_PRINT_LOW("Calling IOCTL set %u controls of class %#x", n, ctrl_class);
+        if (!ioctl(fd, VIDIOC_S_EXT_CTRLS, &controls))
+            continue;
+
+        /* Find out which ones the driver does not take */
+        DEBUG_PRINT_ERROR("Failed to set %u controls of class %#x: %s, retrying one by one",
+                n, ctrl_class, strerror(errno));
+        for (unsigned int k = 0; k < n; k++) {
+            struct v4l2_control control;
+
+            control.id = group[k].id;
+            control.value = group[k].value;
+            if (ioctl(fd, VIDIOC_S_CTRL, &control)) {
+                DEBUG_PRINT_ERROR("Failed to set control id=%#x, val=%d", control.id, control.value);
+                m_rejected[m_rejected_count++] = control.id;
+                status = false;
+            }
+        }
+    }
+
+    m_count = 0;
+    return status;
+}
+
+bool v4l2_ctrl_batch::rejected(unsigned int id) const
+{
+    for (unsigned int i = 0; i < m_rejected_count; i++) {
+        if (m_rejected[i] == id)
+            return true;
+    }
+    return false;
+}
+
+void v4l2_ctrl_batch::discard()
+{
+    m_count = 0;
+}
@@ -40,6 +40,9 @@ omx_c2d_conv::omx_c2d_conv()
     mConvertOpen = NULL;
     mConvertClose = NULL;
     src_format = NV12_2K;
+    m_executor = NULL;
+    m_height = 0;
+    m_split_rows = false;
 }
 
 bool omx_c2d_conv::init()
@@ -86,12 +89,32 @@ bool omx_c2d_conv::convert(int src_fd, void *src_base, void *src_viraddr,
         return false;
     }
 
-    result =  c2dcc->convertC2D(src_fd, src_base, src_viraddr,
-            dest_fd, dest_base, dest_viraddr);
+    if (m_split_rows && m_executor && m_executor->threads() > 1) {
+        conv_band band = {c2dcc, src_viraddr, dest_viraddr, 0};
+
+        m_executor->run(convert_band, &band, m_height);
+        result = __atomic_load_n(&band.result, __ATOMIC_RELAXED);
+    } else {
+        result =  c2dcc->convertC2D(src_fd, src_base, src_viraddr,
+                dest_fd, dest_base, dest_viraddr);
+    }
     DEBUG_PRINT_LOW("Color convert status %d",result);
     return ((result < 0)?false:true);
 }
 
+void omx_c2d_conv::convert_band(void *arg, unsigned int row, unsigned int rows)
+{
+    conv_band *band = (conv_band *)arg;
+
+    if (band->c2dcc->convertRows(band->src, band->dest, row, rows) < 0)
+        __atomic_store_n(&band->result, -1, __ATOMIC_RELAXED);
+}
+
+void omx_c2d_conv::set_executor(band_executor *executor)
+{
+    m_executor = executor;
+}
+
 bool omx_c2d_conv::open(unsigned int height,unsigned int width,
         ColorConvertFormat src, ColorConvertFormat dest)
 {
@@ -103,6 +126,8 @@ bool omx_c2d_conv::open(unsigned int height,unsigned int width,
 
         if (c2dcc) {
             src_format = src;
+            m_height = height;
+            m_split_rows = c2dcc->canConvertRows();
             status = true;
         } else
             DEBUG_PRINT_ERROR("mConvertOpen failed");
@@ -110,6 +135,12 @@ bool omx_c2d_conv::open(unsigned int height,unsigned int width,
 
     return status;
 }
+void omx_c2d_conv::flush()
+{
+    if (c2dcc)
+        c2dcc->flushMappings();
+}
+
 void omx_c2d_conv::close()
 {
     if (mLibHandle) {
@@ -117,6 +148,7 @@ void omx_c2d_conv::close()
             mConvertClose(c2dcc);
 
         c2dcc = NULL;
+        m_split_rows = false;
     }
 }
 
@@ -0,0 +1,169 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/system_properties.h>
+#include <cutils/properties.h>
+#include "vidc_props.h"
+#include "vidc_debug.h"
+
+#define VIDC_PROPS_NAME_MAX 64
+
+/*
+ * An entry with pi set holds the value at that property's serial. One
+ * without pi is a key found unset while the area was at serial.
+ */
+struct vidc_prop {
+    char name[VIDC_PROPS_NAME_MAX];
+    char value[PROPERTY_VALUE_MAX];
+    const prop_info *pi;
+    uint32_t serial;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static vidc_prop s_props[VIDC_PROPS_MAX];
+static unsigned int s_count;
+static bool s_loaded;
+
+static bool is_vidc_prop(const char *name)
+{
+    return !strncmp(name, "vidc.", 5) || !strncmp(name, "persist.vidc.", 13);
+}
+
+static vidc_prop *add_prop(const char *name)
+{
+    vidc_prop *p;
+
+    if (s_count == VIDC_PROPS_MAX || strlen(name) >= VIDC_PROPS_NAME_MAX)
+        return NULL;
+    p = &s_props[s_count++];
+    memset(p, 0, sizeof(*p));
+    strlcpy(p->name, name, sizeof(p->name));
+    return p;
+}
+
+static void update_prop(void *cookie, const char *name, const char *value, uint32_t serial)
+{
+    vidc_prop *p = (vidc_prop *)cookie;
+
+    (void) name;
+    strlcpy(p->value, value, sizeof(p->value));
+    p->serial = serial;
+}
+
+static void walk_prop(void *cookie, const char *name, const char *value, uint32_t serial)
+{
+    vidc_prop *p;
+
+    if (!is_vidc_prop(name) || !(p = add_prop(name)))
+        return;
+    p->pi = (const prop_info *)cookie;
+    update_prop(p, name, value, serial);
+}
+
+static void visit_prop(const prop_info *pi, void *cookie)
+{
+    (void) cookie;
+    __system_property_read_callback(pi, walk_prop, const_cast<prop_info *>(pi));
+}
+
+/* One walk of the property area picks up every vidc property set now */
+void vidc_props::load()
+{
+    if (s_loaded)
+        return;
+    s_count = 0;
+    __system_property_foreach(visit_prop, NULL);
+    s_loaded = true;
+}
+
+int vidc_props::get(const char *key, char *value, const char *default_value)
+{
+    vidc_prop *p = NULL;
+    int len = -1;
+
+    if (!is_vidc_prop(key))
+        return property_get(key, value, default_value);
+
+    pthread_mutex_lock(&s_lock);
+    load();
+    for (unsigned int i = 0; i < s_count; i++) {
+        if (!strcmp(s_props[i].name, key)) {
+            p = &s_props[i];
+            break;
+        }
+    }
+    if (p && p->pi) {
+        /* Only a write to this property moves its serial */
+        if (__system_property_serial(p->pi) != p->serial)
+            __system_property_read_callback(p->pi, update_prop, p);
+    } else {
+        /* Sampled first, a property added meanwhile is found next time */
+        uint32_t serial = __system_property_area_serial();
+        bool added = false;
+
+        if (!p) {
+            p = add_prop(key);
+            if (!p) {
+                pthread_mutex_unlock(&s_lock);
+                return property_get(key, value, default_value);
+            }
+            added = true;
+        }
+        if (added || p->serial != serial) {
+            p->pi = __system_property_find(key);
+            p->serial = serial;
+            if (p->pi)
+                __system_property_read_callback(p->pi, update_prop, p);
+        }
+    }
+    if (p->pi)
+        len = strlcpy(value, p->value, PROPERTY_VALUE_MAX);
+    pthread_mutex_unlock(&s_lock);
+
+    /* Unset and empty read as the default, as property_get() does */
+    if (len > 0)
+        return len;
+    if (!default_value) {
+        value[0] = '\0';
+        return 0;
+    }
+    strlcpy(value, default_value, PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+int vidc_props::get_int(const char *key, int default_value)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    if (get(key, value, NULL) <= 0)
+        return default_value;
+    return atoi(value);
+}
@@ -0,0 +1,386 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "worker_pool.h"
+#include "vidc_debug.h"
+
+#define WORKER_POOL_MAX_THREADS 8
+
+class worker_pool
+{
+    public:
+        static bool attach(worker_strand *strand);
+        static void detach(worker_strand *strand);
+        static void post(worker_strand *strand);
+        static void post_at(worker_strand *strand, const struct timespec *when);
+
+    private:
+        static void *worker(void *arg);
+        static bool start();
+        static void stop();
+        static int self();
+        static void schedule(worker_strand *strand);
+        static void enqueue(worker_strand *strand);
+        static void remove(worker_strand *strand);
+        static void remove_timer(worker_strand *strand);
+        static bool fire_timers(struct timespec *next);
+
+        /* Serializes pool start/stop, never taken by the workers */
+        static pthread_mutex_t m_life_lock;
+        static pthread_mutex_t m_lock;
+        static pthread_cond_t m_work_cond;
+        static pthread_cond_t m_done_cond;
+        static worker_strand *m_head;
+        static worker_strand *m_tail;
+        static worker_strand *m_timers;
+        static pthread_t m_threads[WORKER_POOL_MAX_THREADS];
+        /* Strand each worker runs, cleared when it closes itself */
+        static worker_strand *m_running[WORKER_POOL_MAX_THREADS];
+        static int m_num_threads;
+        static int m_refs;
+        static bool m_stop;
+};
+
+pthread_mutex_t worker_pool::m_life_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t worker_pool::m_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t worker_pool::m_work_cond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t worker_pool::m_done_cond = PTHREAD_COND_INITIALIZER;
+worker_strand *worker_pool::m_head = NULL;
+worker_strand *worker_pool::m_tail = NULL;
+worker_strand *worker_pool::m_timers = NULL;
+pthread_t worker_pool::m_threads[WORKER_POOL_MAX_THREADS];
+worker_strand *worker_pool::m_running[WORKER_POOL_MAX_THREADS];
+int worker_pool::m_num_threads = 0;
+int worker_pool::m_refs = 0;
+bool worker_pool::m_stop = false;
+
+void worker_pool::enqueue(worker_strand *strand)
+{
+    strand->m_next = NULL;
+    if (m_tail)
+        m_tail->m_next = strand;
+    else
+        m_head = strand;
+    m_tail = strand;
+}
+
+void worker_pool::remove(worker_strand *strand)
+{
+    worker_strand **link = &m_head;
+    worker_strand *prev = NULL;
+
+    while (*link && *link != strand) {
+        prev = *link;
+        link = &prev->m_next;
+    }
+    if (!*link)
+        return;
+    *link = strand->m_next;
+    if (m_tail == strand)
+        m_tail = prev;
+    strand->m_next = NULL;
+}
+
+void worker_pool::remove_timer(worker_strand *strand)
+{
+    worker_strand **link = &m_timers;
+
+    if (!strand->m_timed)
+        return;
+    while (*link != strand)
+        link = &(*link)->m_timer_next;
+    *link = strand->m_timer_next;
+    strand->m_timer_next = NULL;
+    strand->m_timed = false;
+}
+
+/* Called with m_lock held */
+void worker_pool::schedule(worker_strand *strand)
+{
+    switch (strand->m_state) {
+        case worker_strand::STRAND_IDLE:
+            strand->m_state = worker_strand::STRAND_QUEUED;
+            enqueue(strand);
+            pthread_cond_signal(&m_work_cond);
+            break;
+        case worker_strand::STRAND_RUNNING:
+            /* The pass may already be past our message, run once more */
+            strand->m_state = worker_strand::STRAND_RERUN;
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Schedules the strands whose time has come. Returns true with the
+ * earliest remaining due time in next if any timer is left.
+ */
+bool worker_pool::fire_timers(struct timespec *next)
+{
+    worker_strand **link = &m_timers;
+    worker_strand *strand;
+    struct timespec now;
+    bool pending = false;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    while ((strand = *link)) {
+        if (strand->m_due.tv_sec < now.tv_sec ||
+                (strand->m_due.tv_sec == now.tv_sec &&
+                 strand->m_due.tv_nsec <= now.tv_nsec)) {
+            *link = strand->m_timer_next;
+            strand->m_timer_next = NULL;
+            strand->m_timed = false;
+            schedule(strand);
+            continue;
+        }
+        if (!pending || strand->m_due.tv_sec < next->tv_sec ||
+                (strand->m_due.tv_sec == next->tv_sec &&
+                 strand->m_due.tv_nsec < next->tv_nsec))
+            *next = strand->m_due;
+        pending = true;
+        link = &strand->m_timer_next;
+    }
+    return pending;
+}
+
+/* Index of the calling thread in m_threads, -1 if it is not a worker */
+int worker_pool::self()
+{
+    for (int i = 0; i < m_num_threads; i++)
+        if (pthread_equal(m_threads[i], pthread_self()))
+            return i;
+    return -1;
+}
+
+void *worker_pool::worker(void *arg)
+{
+    int index = (int)(intptr_t)arg;
+    worker_strand *strand;
+    struct timespec next;
+    bool pending;
+
+    prctl(PR_SET_NAME, (unsigned long)"VidcWorker", 0, 0, 0);
+    pthread_mutex_lock(&m_lock);
+    while (1) {
+        pending = fire_timers(&next);
+        if (m_stop)
+            break;
+        if (!m_head) {
+            if (pending)
+                pthread_cond_timedwait(&m_work_cond, &m_lock, &next);
+            else
+                pthread_cond_wait(&m_work_cond, &m_lock);
+            continue;
+        }
+
+        strand = m_head;
+        m_head = strand->m_next;
+        if (!m_head)
+            m_tail = NULL;
+        strand->m_state = worker_strand::STRAND_RUNNING;
+        m_running[index] = strand;
+        pthread_mutex_unlock(&m_lock);
+
+        strand->m_fn(strand->m_arg);
+
+        pthread_mutex_lock(&m_lock);
+        if (m_running[index] != strand) {
+            /* Closed from its own work function, it may be gone already */
+        } else if (strand->m_state == worker_strand::STRAND_RERUN && strand->m_open) {
+            /* Back of the queue, other instances get their turn first */
+            strand->m_state = worker_strand::STRAND_QUEUED;
+            enqueue(strand);
+            pthread_cond_signal(&m_work_cond);
+        } else {
+            strand->m_state = worker_strand::STRAND_IDLE;
+        }
+        m_running[index] = NULL;
+        pthread_cond_broadcast(&m_done_cond);
+    }
+    pthread_mutex_unlock(&m_lock);
+    return NULL;
+}
+
+bool worker_pool::start()
+{
+    long cores = sysconf(_SC_NPROCESSORS_CONF);
+    int num_threads = cores < 1 ? 1 :
+        (cores > WORKER_POOL_MAX_THREADS ? WORKER_POOL_MAX_THREADS : (int)cores);
+    int err;
+
+    m_stop = false;
+    for (m_num_threads = 0; m_num_threads < num_threads; m_num_threads++) {
+        m_running[m_num_threads] = NULL;
+        err = pthread_create(&m_threads[m_num_threads], NULL, worker,
+                (void *)(intptr_t)m_num_threads);
+        if (err) {
+            DEBUG_PRINT_ERROR("worker_pool: thread creation failed: %s", strerror(err));
+            break;
+        }
+    }
+    if (!m_num_threads)
+        return false;
+
+    DEBUG_PRINT_HIGH("worker_pool: started %d threads", m_num_threads);
+    return true;
+}
+
+void worker_pool::stop()
+{
+    pthread_mutex_lock(&m_lock);
+    m_stop = true;
+    pthread_cond_broadcast(&m_work_cond);
+    pthread_mutex_unlock(&m_lock);
+
+    while (m_num_threads)
+        pthread_join(m_threads[--m_num_threads], NULL);
+    DEBUG_PRINT_HIGH("worker_pool: stopped");
+}
+
+bool worker_pool::attach(worker_strand *strand)
+{
+    pthread_mutex_lock(&m_life_lock);
+    /* A pool left running by a close on a worker is reused */
+    if (!m_num_threads && !start()) {
+        pthread_mutex_unlock(&m_life_lock);
+        return false;
+    }
+    m_refs++;
+    pthread_mutex_unlock(&m_life_lock);
+
+    pthread_mutex_lock(&m_lock);
+    strand->m_state = worker_strand::STRAND_IDLE;
+    strand->m_next = NULL;
+    strand->m_timed = false;
+    strand->m_timer_next = NULL;
+    strand->m_open = true;
+    pthread_mutex_unlock(&m_lock);
+    return true;
+}
+
+void worker_pool::detach(worker_strand *strand)
+{
+    int index;
+
+    pthread_mutex_lock(&m_life_lock);
+    index = self();
+
+    pthread_mutex_lock(&m_lock);
+    strand->m_open = false;
+    remove_timer(strand);
+    if (strand->m_state == worker_strand::STRAND_QUEUED) {
+        remove(strand);
+        strand->m_state = worker_strand::STRAND_IDLE;
+    }
+    if (index >= 0 && m_running[index] == strand) {
+        /* Closing from its own work function, waiting would never end */
+        m_running[index] = NULL;
+        strand->m_state = worker_strand::STRAND_IDLE;
+    }
+    while (strand->m_state != worker_strand::STRAND_IDLE)
+        pthread_cond_wait(&m_done_cond, &m_lock);
+    pthread_mutex_unlock(&m_lock);
+
+    if (!--m_refs) {
+        if (index < 0)
+            stop();
+        else
+            DEBUG_PRINT_HIGH("worker_pool: last strand closed on a worker, pool kept");
+    }
+    pthread_mutex_unlock(&m_life_lock);
+}
+
+void worker_pool::post(worker_strand *strand)
+{
+    pthread_mutex_lock(&m_lock);
+    if (strand->m_open)
+        schedule(strand);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void worker_pool::post_at(worker_strand *strand, const struct timespec *when)
+{
+    pthread_mutex_lock(&m_lock);
+    if (strand->m_open) {
+        if (!strand->m_timed) {
+            strand->m_timer_next = m_timers;
+            m_timers = strand;
+            strand->m_timed = true;
+        }
+        strand->m_due = *when;
+        /* An idle worker recomputes its wait */
+        pthread_cond_broadcast(&m_work_cond);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+worker_strand::worker_strand()
+    : m_fn(NULL),
+      m_arg(NULL),
+      m_state(STRAND_IDLE),
+      m_open(false),
+      m_next(NULL),
+      m_timed(false),
+      m_timer_next(NULL)
+{
+}
+
+worker_strand::~worker_strand()
+{
+    close();
+}
+
+bool worker_strand::open(work_fn fn, void *arg)
+{
+    close();
+    m_fn = fn;
+    m_arg = arg;
+    return worker_pool::attach(this);
+}
+
+void worker_strand::close()
+{
+    if (m_open)
+        worker_pool::detach(this);
+}
+
+void worker_strand::post()
+{
+    worker_pool::post(this);
+}
+
+void worker_strand::post_at(const struct timespec *when)
+{
+    worker_pool::post_at(this, when);
+}
@@ -11,3 +11,44 @@ LOCAL_CFLAGS                  := -DLOG_TAG=\"MSM-VIDC-TEST\"
 LOCAL_MODULE_TAGS             := optional
 LOCAL_32_BIT_ONLY             := true
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := ts-reorder-test
+LOCAL_SRC_FILES               := ts_reorder_test.cpp
+LOCAL_SRC_FILES               += ../vdec/src/ts_parser.cpp
+LOCAL_C_INCLUDES              := $(LOCAL_PATH)/../vdec/inc
+LOCAL_C_INCLUDES              += $(LOCAL_PATH)/../common/inc
+LOCAL_C_INCLUDES              += $(LOCAL_PATH)/../../../mm-core/inc
+LOCAL_SHARED_LIBRARIES        := liblog libutils
+LOCAL_CFLAGS                  := -DLOG_TAG=\"TS-REORDER-TEST\" -D_ANDROID_
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := buf-ref-table-test
+LOCAL_SRC_FILES               := buf_ref_table_test.cpp
+LOCAL_SRC_FILES               += ../vdec/src/buf_ref_table.cpp
+LOCAL_C_INCLUDES              := $(LOCAL_PATH)/../vdec/inc
+LOCAL_C_INCLUDES              += $(LOCAL_PATH)/../common/inc
+LOCAL_C_INCLUDES              += $(LOCAL_PATH)/../../../mm-core/inc
+LOCAL_SHARED_LIBRARIES        := liblog libutils
+LOCAL_CFLAGS                  := -DLOG_TAG=\"BUF-REF-TABLE-TEST\" -D_ANDROID_
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := mmap-cache-test
+LOCAL_HEADER_LIBRARIES        := generated_kernel_headers
+LOCAL_SRC_FILES               := mmap_cache_test.cpp
+LOCAL_SRC_FILES               += ../common/src/mmap_cache.cpp
+LOCAL_C_INCLUDES              := $(LOCAL_PATH)/../common/inc
+LOCAL_SHARED_LIBRARIES        := liblog libutils
+LOCAL_CFLAGS                  := -DLOG_TAG=\"MMAP-CACHE-TEST\" -D_ANDROID_
+LOCAL_MODULE_TAGS             := optional
+LOCAL_32_BIT_ONLY             := true
+include $(BUILD_EXECUTABLE)
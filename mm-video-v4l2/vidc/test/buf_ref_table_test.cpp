@@ -0,0 +1,183 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+/*
+ * Replays random add/remove operations through buf_ref_table and through
+ * a copy of the out_dynamic_list scan it replaced, checks that both give
+ * the same result every time and that the table holds exactly as many
+ * dup'ed fds as the list, none once it is released.
+ *
+ * Usage: buf-ref-table-test [operations] [seed]
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "buf_ref_table.h"
+
+int debug_level = 0;
+
+#define NUM_FDS     24
+#define NUM_OFFSETS 3
+
+/*buf_ref_add/buf_ref_remove as they were, over a plain array*/
+class buf_ref_list
+{
+    public:
+        buf_ref_list(unsigned count) : m_count(count) {
+            m_list = (struct dynamic_buf_list *)calloc(count, sizeof(*m_list));
+            for (unsigned i = 0; i < count; i++)
+                m_list[i].dup_fd = -1;
+        }
+        ~buf_ref_list() {
+            for (unsigned i = 0; i < m_count; i++)
+                if (m_list[i].dup_fd >= 0)
+                    close(m_list[i].dup_fd);
+            free(m_list);
+        }
+        bool add(long fd, OMX_U32 offset) {
+            for (unsigned i = 0; i < m_count; i++) {
+                if (m_list[i].fd == fd && m_list[i].offset == offset) {
+                    m_list[i].ref_count++;
+                    return true;
+                }
+            }
+            for (unsigned i = 0; i < m_count; i++) {
+                if (m_list[i].dup_fd < 0) {
+                    m_list[i].fd = fd;
+                    m_list[i].offset = offset;
+                    m_list[i].dup_fd = dup(fd);
+                    m_list[i].ref_count++;
+                    return true;
+                }
+            }
+            return false;
+        }
+        bool remove(long fd, OMX_U32 offset) {
+            for (unsigned i = 0; i < m_count; i++) {
+                if (m_list[i].fd == fd && m_list[i].offset == offset) {
+                    m_list[i].ref_count--;
+                    if (m_list[i].ref_count == 0) {
+                        close(m_list[i].dup_fd);
+                        m_list[i].dup_fd = -1;
+                        m_list[i].fd = 0;
+                        m_list[i].offset = 0;
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+        unsigned held() const {
+            unsigned n = 0;
+            for (unsigned i = 0; i < m_count; i++)
+                n += m_list[i].dup_fd >= 0;
+            return n;
+        }
+
+    private:
+        struct dynamic_buf_list *m_list;
+        unsigned m_count;
+};
+
+static int open_fds()
+{
+    DIR *dir = opendir("/proc/self/fd");
+    struct dirent *entry;
+    int count = 0;
+
+    if (!dir)
+        return -1;
+    while ((entry = readdir(dir)))
+        count += entry->d_name[0] != '.';
+    closedir(dir);
+    /* Less the one opendir() holds */
+    return count - 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long ops = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000000;
+    unsigned int seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+    int fds[NUM_FDS];
+    int base_fds;
+    unsigned long op = 0;
+
+    srand(seed);
+    for (int i = 0; i < NUM_FDS; i++) {
+        fds[i] = open("/dev/null", O_RDONLY);
+        if (fds[i] < 0) {
+            printf("FAIL: open /dev/null\n");
+            return -1;
+        }
+    }
+    base_fds = open_fds();
+
+    while (op < ops) {
+        /* Output buffer counts as the component sees them */
+        unsigned count = 4 + rand() % 20;
+        buf_ref_table table;
+        buf_ref_list *list = new buf_ref_list(count);
+        unsigned long run = 1 + rand() % 50000;
+
+        if (!table.init(count)) {
+            printf("FAIL: init %u\n", count);
+            return -1;
+        }
+        for (unsigned long i = 0; i < run && op < ops; i++, op++) {
+            long fd = fds[rand() % NUM_FDS];
+            OMX_U32 offset = (rand() % NUM_OFFSETS) * 4096;
+            bool add = rand() % 100 < 52;
+            bool ret_table = add ? table.add(fd, offset) : table.remove(fd, offset);
+            bool ret_list = add ? list->add(fd, offset) : list->remove(fd, offset);
+
+            if (ret_table != ret_list) {
+                printf("FAIL: op %lu %s fd %ld offset %u: table %d list %d\n", op,
+                        add ? "add" : "remove", fd, offset, ret_table, ret_list);
+                return -1;
+            }
+            if (!(op % 997) && open_fds() - base_fds != 2 * (int)list->held()) {
+                printf("FAIL: op %lu: %d fds open, list holds %u\n", op,
+                        open_fds() - base_fds, list->held());
+                return -1;
+            }
+        }
+        delete list;
+        table.release();
+        if (open_fds() != base_fds) {
+            printf("FAIL: op %lu: %d fds left after release\n", op, open_fds() - base_fds);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < NUM_FDS; i++)
+        close(fds[i]);
+    printf("PASS: %lu operations\n", ops);
+    return 0;
+}
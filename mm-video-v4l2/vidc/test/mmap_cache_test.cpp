@@ -0,0 +1,195 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+/*
+ * Maps ION buffers through mmap_cache and checks what it hands back:
+ * the same buffer reached through another fd hits the cached mapping,
+ * an fd number closed and reused for a different buffer never does, and
+ * mappings stay correct through eviction and with every entry in use.
+ *
+ * Usage: mmap-cache-test
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "mmap_cache.h"
+
+int debug_level = 0;
+
+#define BUF_SIZE 65536
+
+struct ion_buf {
+    int ion_fd;
+    struct ion_allocation_data alloc_data;
+    struct ion_fd_data fd_data;
+};
+
+static bool alloc_buf(struct ion_buf *buf, unsigned char fill)
+{
+    void *addr;
+
+    memset(buf, 0, sizeof(*buf));
+    buf->ion_fd = open("/dev/ion", O_RDONLY);
+    if (buf->ion_fd < 0)
+        return false;
+    buf->alloc_data.len = BUF_SIZE;
+    buf->alloc_data.align = 4096;
+    buf->alloc_data.heap_id_mask = ION_HEAP(ION_IOMMU_HEAP_ID) |
+        ION_HEAP(ION_SYSTEM_HEAP_ID);
+    if (ioctl(buf->ion_fd, ION_IOC_ALLOC, &buf->alloc_data)) {
+        close(buf->ion_fd);
+        return false;
+    }
+    buf->fd_data.handle = buf->alloc_data.handle;
+    if (ioctl(buf->ion_fd, ION_IOC_MAP, &buf->fd_data)) {
+        ioctl(buf->ion_fd, ION_IOC_FREE, &buf->alloc_data.handle);
+        close(buf->ion_fd);
+        return false;
+    }
+    addr = mmap(NULL, BUF_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED,
+            buf->fd_data.fd, 0);
+    if (addr == MAP_FAILED)
+        return false;
+    memset(addr, fill, BUF_SIZE);
+    munmap(addr, BUF_SIZE);
+    return true;
+}
+
+static void free_buf(struct ion_buf *buf)
+{
+    if (buf->fd_data.fd >= 0)
+        close(buf->fd_data.fd);
+    ioctl(buf->ion_fd, ION_IOC_FREE, &buf->alloc_data.handle);
+    close(buf->ion_fd);
+}
+
+static bool check(mmap_cache *cache, int fd, unsigned char fill, void **addr)
+{
+    unsigned char *p = (unsigned char *)cache->get(fd, 0, BUF_SIZE);
+
+    *addr = p;
+    if (!p) {
+        printf("FAIL: mapping fd %d\n", fd);
+        return false;
+    }
+    if (p[0] != fill || p[BUF_SIZE - 1] != fill) {
+        printf("FAIL: fd %d reads 0x%x, buffer holds 0x%x\n", fd, p[0], fill);
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    mmap_cache cache;
+    struct ion_buf a, b;
+    struct ion_buf many[MMAP_CACHE_ENTRIES + 2];
+    void *first, *second;
+    int fd, dup_fd;
+
+    if (!alloc_buf(&a, 0xaa) || !alloc_buf(&b, 0xbb)) {
+        printf("FAIL: ION allocation\n");
+        return -1;
+    }
+
+    /* The same buffer through the same fd and through a dup hits */
+    fd = a.fd_data.fd;
+    if (!check(&cache, fd, 0xaa, &first))
+        return -1;
+    cache.put(first, BUF_SIZE);
+    if (!check(&cache, fd, 0xaa, &second))
+        return -1;
+    cache.put(second, BUF_SIZE);
+    if (first != second) {
+        printf("FAIL: second get of fd %d missed\n", fd);
+        return -1;
+    }
+    dup_fd = dup(fd);
+    if (!check(&cache, dup_fd, 0xaa, &second))
+        return -1;
+    cache.put(second, BUF_SIZE);
+    close(dup_fd);
+    if (first != second) {
+        printf("FAIL: dup of fd %d missed\n", fd);
+        return -1;
+    }
+
+    /* Buffer a goes away and its fd number now refers to buffer b */
+    close(a.fd_data.fd);
+    a.fd_data.fd = -1;
+    free_buf(&a);
+    if (dup2(b.fd_data.fd, fd) != fd) {
+        printf("FAIL: dup2\n");
+        return -1;
+    }
+    close(b.fd_data.fd);
+    b.fd_data.fd = fd;
+    if (!check(&cache, fd, 0xbb, &second))
+        return -1;
+    cache.put(second, BUF_SIZE);
+
+    /* More buffers than entries, all held at once and then cycled */
+    for (int i = 0; i < MMAP_CACHE_ENTRIES + 2; i++) {
+        if (!alloc_buf(&many[i], i)) {
+            printf("FAIL: ION allocation %d\n", i);
+            return -1;
+        }
+    }
+    void *held[MMAP_CACHE_ENTRIES + 2];
+    for (int i = 0; i < MMAP_CACHE_ENTRIES + 2; i++) {
+        if (!check(&cache, many[i].fd_data.fd, i, &held[i]))
+            return -1;
+    }
+    for (int i = 0; i < MMAP_CACHE_ENTRIES + 2; i++)
+        cache.put(held[i], BUF_SIZE);
+    for (int round = 0; round < 100; round++) {
+        int i = (round * 7) % (MMAP_CACHE_ENTRIES + 2);
+
+        if (!check(&cache, many[i].fd_data.fd, i, &first))
+            return -1;
+        cache.put(first, BUF_SIZE);
+    }
+
+    /* Dropped while in use, the mapping stays until put() */
+    if (!check(&cache, b.fd_data.fd, 0xbb, &first))
+        return -1;
+    cache.invalidate();
+    if (((unsigned char *)first)[0] != 0xbb) {
+        printf("FAIL: mapping in use went away\n");
+        return -1;
+    }
+    cache.put(first, BUF_SIZE);
+
+    free_buf(&b);
+    for (int i = 0; i < MMAP_CACHE_ENTRIES + 2; i++)
+        free_buf(&many[i]);
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,443 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+/*
+ * Replays random insert/get/remove/flush traces through the heap based
+ * omx_time_stamp_reorder and through a copy of the list of 64 entry pages
+ * it replaced, and checks that both hand out the same timestamps.
+ *
+ * Usage: ts-reorder-test [iterations] [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ts_parser.h"
+
+int debug_level = 0;
+
+/*The reorder engine as it was before the heap, one page per EOS segment*/
+class ts_page_list
+{
+    public:
+        ts_page_list() : error(false), phead(NULL), pcurrent(NULL) {
+        }
+        ~ts_page_list() {
+            delete_list();
+        }
+        bool insert_timestamp(OMX_BUFFERHEADERTYPE *header);
+        bool get_next_timestamp(OMX_BUFFERHEADERTYPE *header, bool is_interlaced);
+        bool remove_time_stamp(OMX_TICKS ts, bool is_interlaced);
+        void flush_timestamp() {
+            delete_list();
+        }
+        /*The head page is empty while a newer one exists*/
+        bool stalled() const {
+            return phead && !phead->entries_filled && phead->next != phead;
+        }
+        bool current_empty() const {
+            return !phead || !phead->prev->entries_filled;
+        }
+        unsigned int filled() const {
+            unsigned int count = 0;
+            for (time_stamp_list *p = phead; p; p = p->next == phead ? NULL : p->next)
+                count += p->entries_filled;
+            return count;
+        }
+
+    private:
+        struct timestamp {
+            OMX_TICKS timestamps;
+            bool in_use;
+        };
+        struct time_stamp_list {
+            timestamp input_timestamps[TIME_SZ];
+            time_stamp_list *next;
+            time_stamp_list *prev;
+            unsigned int entries_filled;
+        };
+        bool error;
+        time_stamp_list *phead, *pcurrent;
+        bool get_current_list();
+        bool add_new_list();
+        bool update_head();
+        void delete_list();
+        void handle_error() {
+            if (error)
+                return;
+            error = true;
+            delete_list();
+        }
+};
+
+void ts_page_list::delete_list()
+{
+    time_stamp_list *ptemp;
+
+    if (!phead) return;
+
+    while (phead->next != phead) {
+        ptemp = phead;
+        phead = phead->next;
+        phead->prev = ptemp->prev;
+        ptemp->prev->next = phead;
+        delete ptemp;
+    }
+
+    delete phead;
+    phead = NULL;
+}
+
+bool ts_page_list::get_current_list()
+{
+    if (!phead && !add_new_list())
+        return false;
+
+    pcurrent = phead->prev;
+    return true;
+}
+
+bool ts_page_list::update_head()
+{
+    time_stamp_list *ptemp;
+
+    if (!phead) return false;
+
+    if (phead->next != phead) {
+        ptemp = phead;
+        phead = ptemp->next;
+        phead->prev = ptemp->prev;
+        ptemp->prev->next = phead;
+        delete ptemp;
+    }
+
+    return true;
+}
+
+bool ts_page_list::add_new_list()
+{
+    time_stamp_list *ptemp = new time_stamp_list;
+
+    if (!phead) {
+        phead = ptemp;
+        phead->prev = phead->next = phead;
+    } else {
+        ptemp->prev = phead->prev;
+        ptemp->next = phead;
+        phead->prev->next = ptemp;
+        phead->prev = ptemp;
+    }
+
+    ptemp->entries_filled = 0;
+
+    for (int i = 0; i < TIME_SZ; i++) {
+        ptemp->input_timestamps[i].in_use = false;
+        ptemp->input_timestamps[i].timestamps = -1;
+    }
+
+    return true;
+}
+
+bool ts_page_list::insert_timestamp(OMX_BUFFERHEADERTYPE *header)
+{
+    OMX_TICKS *table_entry = NULL;
+
+    if (error)
+        return false;
+
+    if (!get_current_list()) {
+        handle_error();
+        return false;
+    }
+
+    if (pcurrent->entries_filled > (TIME_SZ - 1)) {
+        handle_error();
+        return false;
+    }
+
+    if (header->nFlags & OMX_BUFFERFLAG_CODECCONFIG)
+        return true;
+
+    if ((header->nFlags & OMX_BUFFERFLAG_EOS) && !header->nFilledLen)
+        return add_new_list();
+
+    for (int i = 0; i < TIME_SZ && !table_entry; i++) {
+        if (!pcurrent->input_timestamps[i].in_use) {
+            table_entry = &pcurrent->input_timestamps[i].timestamps;
+            pcurrent->input_timestamps[i].in_use = true;
+            pcurrent->entries_filled++;
+        }
+    }
+
+    if (!table_entry) {
+        handle_error();
+        return false;
+    }
+
+    *table_entry = header->nTimeStamp;
+
+    if (header->nFlags & OMX_BUFFERFLAG_EOS)
+        return add_new_list();
+
+    return true;
+}
+
+bool ts_page_list::remove_time_stamp(OMX_TICKS ts, bool is_interlaced)
+{
+    unsigned int num_ent_remove = (is_interlaced)?2:1;
+
+    if (error)
+        return false;
+
+    if (!phead || !phead->entries_filled) return false;
+
+    for (int i = 0; i < TIME_SZ && num_ent_remove; i++) {
+        if (phead->input_timestamps[i].in_use && phead->input_timestamps[i].timestamps == ts) {
+            phead->input_timestamps[i].in_use = false;
+            phead->entries_filled--;
+            num_ent_remove--;
+        }
+    }
+
+    if (!phead->entries_filled && !update_head()) {
+        handle_error();
+        return false;
+    }
+
+    return true;
+}
+
+bool ts_page_list::get_next_timestamp(OMX_BUFFERHEADERTYPE *header, bool is_interlaced)
+{
+    timestamp *element = NULL, *duplicate = NULL;
+    bool status = false;
+
+    if (error)
+        return false;
+
+    if (!phead || !phead->entries_filled) return false;
+
+    for (int i = 0; i < TIME_SZ; i++) {
+        if (phead->input_timestamps[i].in_use) {
+            status = true;
+
+            if (!element)
+                element = &phead->input_timestamps[i];
+            else {
+                if (element->timestamps > phead->input_timestamps[i].timestamps) {
+                    element = &phead->input_timestamps[i];
+                    duplicate = NULL;
+                } else if (element->timestamps == phead->input_timestamps[i].timestamps)
+                    duplicate = &phead->input_timestamps[i];
+            }
+        }
+    }
+
+    if (element) {
+        phead->entries_filled--;
+        header->nTimeStamp = element->timestamps;
+        element->in_use = false;
+    }
+
+    if (is_interlaced && duplicate) {
+        phead->entries_filled--;
+        duplicate->in_use = false;
+    } else if (is_interlaced && !duplicate) {
+        element = NULL;
+
+        for (int i = 0; i < TIME_SZ; i++) {
+            if (phead->input_timestamps[i].in_use) {
+                if (!element)
+                    element = &phead->input_timestamps[i];
+                else if (element->timestamps > phead->input_timestamps[i].timestamps)
+                    element = &phead->input_timestamps[i];
+            }
+        }
+
+        if (element) {
+            phead->entries_filled--;
+            header->nTimeStamp = element->timestamps;
+            element->in_use = false;
+        }
+    }
+
+    if (!phead->entries_filled && !update_head()) {
+        handle_error();
+        return false;
+    }
+
+    return status;
+}
+
+static int run_trace(unsigned int ops)
+{
+    omx_time_stamp_reorder *heap = new omx_time_stamp_reorder;
+    ts_page_list *list = new ts_page_list;
+    OMX_BUFFERHEADERTYPE hdr_heap, hdr_list;
+    OMX_TICKS recent[16];
+    unsigned int num_recent = 0, max_pending = 0;
+    bool is_interlaced = rand() & 1;
+
+    heap->set_timestamp_reorder_mode(true);
+    memset(recent, 0, sizeof(recent));
+
+    for (unsigned int op = 0; op < ops; op++) {
+        unsigned int pick = rand() % 100;
+        bool ret_heap, ret_list;
+
+        memset(&hdr_heap, 0, sizeof(hdr_heap));
+        memset(&hdr_list, 0, sizeof(hdr_list));
+
+        if (pick < 55) {
+            hdr_heap.nTimeStamp = (OMX_TICKS)(rand() % 400) * 33333;
+            hdr_heap.nFilledLen = 1;
+            pick = rand() % 100;
+            if (pick < 8)
+                hdr_heap.nFlags = OMX_BUFFERFLAG_EOS;
+            else if (pick < 10)
+                hdr_heap.nFlags = OMX_BUFFERFLAG_CODECCONFIG;
+            else if (pick < 13 && !list->current_empty()) {
+                /*An empty head page stalls the old engine, see main()*/
+                hdr_heap.nFlags = OMX_BUFFERFLAG_EOS;
+                hdr_heap.nFilledLen = 0;
+            }
+            hdr_list = hdr_heap;
+            ret_heap = heap->insert_timestamp(&hdr_heap);
+            ret_list = list->insert_timestamp(&hdr_list);
+            if (ret_heap)
+                recent[num_recent++ % 16] = hdr_heap.nTimeStamp;
+        } else if (pick < 85) {
+            ret_heap = heap->get_next_timestamp(&hdr_heap, is_interlaced);
+            ret_list = list->get_next_timestamp(&hdr_list, is_interlaced);
+            if (ret_heap && ret_list && hdr_heap.nTimeStamp != hdr_list.nTimeStamp) {
+                printf("get %u: heap %lld list %lld\n", op,
+                        (long long)hdr_heap.nTimeStamp, (long long)hdr_list.nTimeStamp);
+                return -1;
+            }
+        } else if (pick < 98) {
+            OMX_TICKS ts = recent[rand() % 16];
+            ret_heap = heap->remove_time_stamp(ts, is_interlaced);
+            ret_list = list->remove_time_stamp(ts, is_interlaced);
+        } else {
+            heap->flush_timestamp();
+            list->flush_timestamp();
+            ret_heap = ret_list = true;
+        }
+
+        if (ret_heap != ret_list) {
+            printf("op %u (%u): heap %d list %d\n", op, pick, ret_heap, ret_list);
+            return -1;
+        }
+
+        if (list->filled() > max_pending)
+            max_pending = list->filled();
+
+        if (list->stalled()) {
+            printf("op %u: old engine stalled on an empty page\n", op);
+            return -1;
+        }
+
+        /*A full segment puts both into the permanent error state*/
+        if (!ret_heap && pick < 55) {
+            delete heap;
+            delete list;
+            heap = new omx_time_stamp_reorder;
+            list = new ts_page_list;
+            heap->set_timestamp_reorder_mode(true);
+        }
+    }
+
+    delete heap;
+    delete list;
+    return (int)max_pending;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int iterations = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000;
+    unsigned int seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 1;
+    OMX_BUFFERHEADERTYPE hdr;
+    omx_time_stamp_reorder reorder;
+    int max_pending = 0, ret;
+
+    srand(seed);
+
+    for (unsigned int i = 0; i < iterations; i++) {
+        ret = run_trace(1 + rand() % 4000);
+        if (ret < 0) {
+            printf("FAIL: trace %u seed %u\n", i, seed);
+            return -1;
+        }
+        if (ret > max_pending)
+            max_pending = ret;
+    }
+
+    /*
+     * Six full segments pending at once, well past TIME_HEAP_SZ. The old
+     * engine held these in six pages.
+     */
+    reorder.set_timestamp_reorder_mode(true);
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.nFilledLen = 1;
+    for (int s = 0; s < 6; s++) {
+        for (int i = 0; i < TIME_SZ; i++) {
+            hdr.nTimeStamp = (OMX_TICKS)(s * 1000 + TIME_SZ - i);
+            hdr.nFlags = i == TIME_SZ - 1 ? OMX_BUFFERFLAG_EOS : 0;
+            if (!reorder.insert_timestamp(&hdr)) {
+                printf("FAIL: insert segment %d entry %d\n", s, i);
+                return -1;
+            }
+        }
+    }
+    for (int s = 0; s < 6; s++) {
+        for (int i = 0; i < TIME_SZ; i++) {
+            if (!reorder.get_next_timestamp(&hdr, false) ||
+                    hdr.nTimeStamp != (OMX_TICKS)(s * 1000 + i + 1)) {
+                printf("FAIL: get segment %d entry %d\n", s, i);
+                return -1;
+            }
+        }
+    }
+
+    /*
+     * A zero length EOS on an empty segment. The old engine stopped
+     * handing out timestamps here; the segment is skipped now.
+     */
+    hdr.nFlags = OMX_BUFFERFLAG_EOS;
+    hdr.nFilledLen = 0;
+    reorder.insert_timestamp(&hdr);
+    hdr.nFlags = 0;
+    hdr.nFilledLen = 1;
+    hdr.nTimeStamp = 42;
+    reorder.insert_timestamp(&hdr);
+    if (!reorder.get_next_timestamp(&hdr, false) || hdr.nTimeStamp != 42) {
+        printf("FAIL: empty segment\n");
+        return -1;
+    }
+
+    printf("PASS: %u traces, up to %d timestamps pending\n", iterations, max_pending);
+    return 0;
+}
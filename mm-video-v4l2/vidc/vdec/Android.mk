@@ -123,6 +123,8 @@ LOCAL_SRC_FILES         += src/h264_utils.cpp
 LOCAL_SRC_FILES         += src/ts_parser.cpp
 LOCAL_SRC_FILES         += src/mp4_utils.cpp
 LOCAL_SRC_FILES         += src/hevc_utils.cpp
+LOCAL_SRC_FILES         += src/nal_index.cpp
+LOCAL_SRC_FILES         += src/buf_ref_table.cpp
 LOCAL_STATIC_LIBRARIES  := libOmxVidcCommon
 LOCAL_SRC_FILES         += src/omx_vdec_msm8974.cpp
 
@@ -158,6 +160,8 @@ LOCAL_SRC_FILES         += src/h264_utils.cpp
 LOCAL_SRC_FILES         += src/ts_parser.cpp
 LOCAL_SRC_FILES         += src/mp4_utils.cpp
 LOCAL_SRC_FILES         += src/hevc_utils.cpp
+LOCAL_SRC_FILES         += src/nal_index.cpp
+LOCAL_SRC_FILES         += src/buf_ref_table.cpp
 
 LOCAL_STATIC_LIBRARIES  := libOmxVidcCommon
 
@@ -0,0 +1,73 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef BUF_REF_TABLE_H
+#define BUF_REF_TABLE_H
+
+#include <pthread.h>
+#include "OMX_Types.h"
+
+struct dynamic_buf_list {
+    long fd;
+    long dup_fd;
+    OMX_U32 offset;
+    OMX_U32 ref_count;
+};
+
+/*
+ * References held on dynamic output buffers, keyed by (fd, offset) in an
+ * open addressing table. The table has its own lock so that FTBs and the
+ * driver's release events do not contend with the message queues, and
+ * the fd is dup'ed and closed outside of it.
+ */
+class buf_ref_table
+{
+    public:
+        buf_ref_table();
+        ~buf_ref_table();
+        /*Holds up to count distinct buffers*/
+        bool init(unsigned count);
+        /*Closes the fds of references still held*/
+        void release();
+        /*Returns false if the table is full or not initialized*/
+        bool add(long fd, OMX_U32 offset);
+        /*Returns false if no reference was held*/
+        bool remove(long fd, OMX_U32 offset);
+
+    private:
+        unsigned home(long fd, OMX_U32 offset) const;
+        int find(long fd, OMX_U32 offset) const;
+        void erase(unsigned i);
+
+        pthread_mutex_t m_lock;
+        struct dynamic_buf_list *m_slots;
+        unsigned m_mask;
+        unsigned m_count;
+        unsigned m_limit;
+};
+
+#endif /* BUF_REF_TABLE_H */
@@ -62,6 +62,12 @@ enum state_nal_parse {
     NAL_PARSING
 };
 
+/*Complete NAL (including its start code) still resident in the source buffer*/
+struct nal_span {
+    OMX_U8 *data;
+    OMX_U32 len;
+};
+
 class frame_parse
 {
 
@@ -70,7 +76,8 @@ class frame_parse
         int init_start_codes (codec_type codec_type_parse);
         int parse_sc_frame (OMX_BUFFERHEADERTYPE *source,
                 OMX_BUFFERHEADERTYPE *dest ,
-                OMX_U32 *partialframe);
+                OMX_U32 *partialframe,
+                nal_span *span = NULL);
         int init_nal_length (unsigned int nal_length);
         int parse_h264_nallength (OMX_BUFFERHEADERTYPE *source,
                 OMX_BUFFERHEADERTYPE *dest ,
@@ -81,22 +88,38 @@ class frame_parse
 
     private:
         /*Variables for Start code based Parsing*/
+        typedef int (frame_parse::*parse_sc_func)(OMX_BUFFERHEADERTYPE *source,
+                OMX_BUFFERHEADERTYPE *dest,
+                OMX_U32 *partialframe,
+                nal_span *span);
         enum state_start_code_parse parse_state;
-        unsigned char *start_code;
-        unsigned char *mask_code;
+        parse_sc_func parse_sc;
         unsigned char last_byte_h263;
         unsigned char last_byte;
         bool header_found;
         bool skip_frame_boundary;
+        /*Where the last start code ended, and the source it was read from*/
+        OMX_U8 *sc_end;
+        OMX_BUFFERHEADERTYPE *sc_source;
+        OMX_U8 *sc_buffer;
 
         /*Variables for NAL Length Parsing*/
         enum state_nal_parse state_nal;
         unsigned int nal_length;
         unsigned int accum_length;
         unsigned int bytes_tobeparsed;
+        /*Start code parser specialized per codec, picked in init_start_codes*/
+        template <codec_type CODEC>
+        int parse_sc_codec (OMX_BUFFERHEADERTYPE *source,
+                OMX_BUFFERHEADERTYPE *dest ,
+                OMX_U32 *partialframe,
+                nal_span *span);
         /*Functions to support additional start code parsing*/
+        template <codec_type CODEC>
         void parse_additional_start_code(OMX_U8 *psource, OMX_U32 *parsed_length);
+        template <codec_type CODEC>
         void check_skip_frame_boundary(OMX_U32 *partial_frame);
+        template <codec_type CODEC>
         void update_skip_frame();
 };
 
@@ -44,7 +44,8 @@ This module contains H264 video decoder utilities and helper routines.
 
 ========================================================================== */
 #include <stdio.h>
-#include "Map.h"
+#include "bit_reader.h"
+#include "param_set_table.h"
 #include "qtypes.h"
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
@@ -124,8 +125,15 @@ struct H264ParamNalu {
     uint32 crop_top;
     uint32 crop_bot;
 };
-//typedef map<uint32, H264ParamNalu> H264ParamNaluSet;
-typedef Map<uint32, H264ParamNalu *> H264ParamNaluSet;
+
+/*seq_parameter_set_id is 0..31 and pic_parameter_set_id 0..255*/
+#define H264_MAX_SPS_COUNT 32
+#define H264_MAX_PPS_COUNT 256
+/*Sanity bound on the SPS picture size, 8192 luma samples*/
+#define H264_MAX_WIDTH_MBS 512
+
+typedef param_set_table<H264ParamNalu, H264_MAX_SPS_COUNT> H264SeqParamSet;
+typedef param_set_table<H264ParamNalu, H264_MAX_PPS_COUNT> H264PicParamSet;
 
 typedef enum {
     NALU_TYPE_UNSPECIFIED = 0,
@@ -154,11 +162,12 @@ typedef struct {
 // This structure contains persistent information about an H.264 stream as it
 // is parsed.
 //struct H264StreamInfo {
-//    H264ParamNaluSet pic;
-//    H264ParamNaluSet seq;
+//    H264PicParamSet pic;
+//    H264SeqParamSet seq;
 //};
 
 class extra_data_parser;
+struct nal_record;
 
 class RbspParser
 /******************************************************************************
@@ -171,18 +180,12 @@ class RbspParser
 
         virtual ~RbspParser ();
 
-        uint32 next ();
-        void advance ();
         uint32 u (uint32 n);
         uint32 ue ();
         int32 se ();
 
     private:
-        const     uint8 *begin, *end;
-        int32     pos;
-        uint32    bit;
-        uint32    cursor;
-        bool      advanceNeeded;
+        bit_reader reader;
 };
 
 class H264_Utils
@@ -195,21 +198,40 @@ class H264_Utils
         bool isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
                 OMX_IN OMX_U32 size_of_nal_length_field,
                 OMX_OUT OMX_BOOL &isNewFrame);
+        bool isNewFrame(const nal_record *nal,
+                OMX_OUT OMX_BOOL &isNewFrame);
         uint32 nalu_type;
 
+        const H264ParamNalu *find_sps(uint32 id) const {
+            return seq.find(id);
+        }
+        const H264ParamNalu *find_pps(uint32 id) const {
+            return pic.find(id);
+        }
+        bool store_sps(const H264ParamNalu &sps) {
+            return seq.insert(sps.seqSetID, sps);
+        }
+        bool store_pps(const H264ParamNalu &pps) {
+            return pic.insert(pps.picSetID, pps);
+        }
+
     private:
+        void check_new_frame(const NALU &nal_unit, bool first_mb,
+                OMX_OUT OMX_BOOL &isNewFrame);
         boolean extract_rbsp(OMX_IN   OMX_U8  *buffer,
                 OMX_IN   OMX_U32 buffer_length,
                 OMX_IN   OMX_U32 size_of_nal_length_field,
                 OMX_OUT  OMX_U8  *rbsp_bistream,
+                OMX_IN   OMX_U32 rbsp_size,
                 OMX_OUT  OMX_U32 *rbsp_length,
                 OMX_OUT  NALU    *nal_unit);
 
         unsigned          m_height;
         unsigned          m_width;
-        H264ParamNaluSet  pic;
-        H264ParamNaluSet  seq;
+        H264PicParamSet   pic;
+        H264SeqParamSet   seq;
         uint8             *m_rbspBytes;
+        uint32            m_rbspSize;
         NALU              m_prv_nalu;
         bool              m_forceToStichNextNAL;
         bool              m_au_data;
@@ -265,6 +287,11 @@ enum SEI_PAYLOAD_TYPE {
     SEI_PAYLOAD_FRAME_PACKING_ARRANGEMENT = 0x2D
 };
 
+/* Bit of an SEI payload type in the mask given to set_sei_payload_mask() */
+#define SEI_PAYLOAD_BIT(type) (((type) < 64) ? ((OMX_U64)1 << (type)) : 0)
+/* Consecutive SEI NALs without a wanted payload before SEI is skipped */
+#define SEI_MISS_LIMIT 16
+
 typedef struct {
     OMX_U32  cpb_cnt;
     OMX_U8   bit_rate_scale;
@@ -425,6 +452,8 @@ class h264_stream_parser
         bool is_mbaff();
         void get_frame_rate(OMX_U32 *frame_rate);
         OMX_U32 get_profile();
+        bool get_resolution(OMX_U32 *width, OMX_U32 *height);
+        void set_sei_payload_mask(OMX_U64 mask);
 #ifdef PANSCAN_HDLR
         void update_panscan_data(OMX_S64 timestamp);
 #endif
@@ -433,7 +462,6 @@ class h264_stream_parser
         void init_bitstream(OMX_U8* data, OMX_U32 size);
         OMX_U32 extract_bits(OMX_U32 n);
         inline bool more_bits();
-        void read_word();
         OMX_U32 uev();
         OMX_S32 sev();
         OMX_S32 iv(OMX_U32 n_bits);
@@ -455,15 +483,15 @@ class h264_stream_parser
         OMX_S64 calculate_fixed_fps_ts(OMX_S64 timestamp, OMX_U32 DeltaTfiDivisor);
         void parse_frame_pack();
 
-        OMX_U32 curr_32_bit;
-        OMX_U32 bits_read;
+        bit_reader bits;
         OMX_U32 profile;
-        OMX_U32 zero_cntr;
-        OMX_U32 emulation_code_skip_cntr;
-        OMX_U8* bitstream;
-        OMX_U32 bitstream_bytes;
         OMX_U32 frame_rate;
+        OMX_U32 pic_width;
+        OMX_U32 pic_height;
         bool    emulation_sc_enabled;
+        OMX_U64 sei_payload_mask;
+        OMX_U32 sei_miss_count;
+        bool    sei_skip;
 
         h264_vui_param vui_param;
         h264_sei_buf_period sei_buf_period;
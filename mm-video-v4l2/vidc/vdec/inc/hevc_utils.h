@@ -47,11 +47,37 @@ This module contains H264 video decoder utilities and helper routines.
 ========================================================================== */
 #include <stdio.h>
 #include <utils/Log.h>
-#include "Map.h"
+#include "bit_reader.h"
+#include "param_set_table.h"
 #include "qtypes.h"
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
 
+struct nal_record;
+
+// Parameter set fields the decoder needs ahead of the first slice. For a
+// VPS refSetID is unused, for an SPS it is the VPS id and for a PPS it is
+// the SPS id. The crop offsets are in luma samples.
+struct HEVCParamNalu {
+    uint32 paramSetID;
+    uint32 refSetID;
+    uint32 chromaFormatIdc;
+    uint32 picWidthInLumaSamples;
+    uint32 picHeightInLumaSamples;
+    uint32 bitDepthLumaMinus8;
+    uint32 bitDepthChromaMinus8;
+    uint32 crop_left;
+    uint32 crop_right;
+    uint32 crop_top;
+    uint32 crop_bot;
+};
+
+/*vps_video_parameter_set_id 0..15, sps 0..15 and pps 0..63*/
+#define HEVC_MAX_VPS_COUNT 16
+#define HEVC_MAX_SPS_COUNT 16
+#define HEVC_MAX_PPS_COUNT 64
+/*Sanity bound on pic_width/height_in_luma_samples*/
+#define HEVC_MAX_PIC_SIZE 8192
 
 class HEVC_Utils
 {
@@ -135,9 +161,36 @@ class HEVC_Utils
         bool isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
                 OMX_IN OMX_U32 size_of_nal_length_field,
                 OMX_OUT OMX_BOOL &isNewFrame);
+        bool isNewFrame(const nal_record *nal,
+                OMX_OUT OMX_BOOL &isNewFrame);
+
+        const HEVCParamNalu *parse_sps(const OMX_U8 *nal, OMX_U32 size);
+
+        const HEVCParamNalu *find_vps(uint32 id) const {
+            return m_vps.find(id);
+        }
+        const HEVCParamNalu *find_sps(uint32 id) const {
+            return m_sps.find(id);
+        }
+        const HEVCParamNalu *find_pps(uint32 id) const {
+            return m_pps.find(id);
+        }
+        bool store_vps(const HEVCParamNalu &vps) {
+            return m_vps.insert(vps.paramSetID, vps);
+        }
+        bool store_sps(const HEVCParamNalu &sps) {
+            return m_sps.insert(sps.paramSetID, sps);
+        }
+        bool store_pps(const HEVCParamNalu &pps) {
+            return m_pps.insert(pps.paramSetID, pps);
+        }
 
     private:
+        void check_new_frame(bool first_slice, OMX_OUT OMX_BOOL &isNewFrame);
 
+        param_set_table<HEVCParamNalu, HEVC_MAX_VPS_COUNT> m_vps;
+        param_set_table<HEVCParamNalu, HEVC_MAX_SPS_COUNT> m_sps;
+        param_set_table<HEVCParamNalu, HEVC_MAX_PPS_COUNT> m_pps;
         bool              m_forceToStichNextNAL;
         bool              m_au_data;
         uint32 nalu_type;
@@ -0,0 +1,159 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef MIN_HEAP_H
+#define MIN_HEAP_H
+
+#include <new>
+
+/*
+ * Binary min-heap over a fixed array of N entries, ordered by T's
+ * operator<. Push and pop are O(log n) and never allocate; clear() just
+ * forgets the entries. Equal keys are all kept and come out one by one.
+ * With GROW set, a push to a full heap moves the entries to an allocated
+ * array of twice the size instead of failing.
+ */
+template <typename T, unsigned N, bool GROW = false>
+class min_heap
+{
+    public:
+        min_heap() : m_heap(m_inline), m_capacity(N), m_count(0) {
+        }
+
+        ~min_heap() {
+            if (m_heap != m_inline)
+                delete[] m_heap;
+        }
+
+        /*Returns false if the heap is full*/
+        bool push(const T &entry) {
+            if (m_count == m_capacity && !grow())
+                return false;
+            m_heap[m_count] = entry;
+            sift_up(m_count++);
+            return true;
+        }
+
+        bool pop(T &entry) {
+            if (!m_count)
+                return false;
+            entry = m_heap[0];
+            remove_at(0);
+            return true;
+        }
+
+        const T *top() const {
+            return m_count ? &m_heap[0] : NULL;
+        }
+
+        /*Entries in heap order, for a linear search ahead of remove_at()*/
+        const T &at(unsigned index) const {
+            return m_heap[index];
+        }
+
+        void remove_at(unsigned index) {
+            if (index >= m_count)
+                return;
+            if (index == --m_count)
+                return;
+            m_heap[index] = m_heap[m_count];
+            if (index && m_heap[index] < m_heap[(index - 1) / 2])
+                sift_up(index);
+            else
+                sift_down(index);
+        }
+
+        void clear() {
+            m_count = 0;
+        }
+
+        unsigned size() const {
+            return m_count;
+        }
+
+        bool empty() const {
+            return !m_count;
+        }
+
+        unsigned capacity() const {
+            return m_capacity;
+        }
+
+    private:
+        min_heap(const min_heap &);
+        min_heap &operator=(const min_heap &);
+
+        bool grow() {
+            T *heap;
+
+            if (!GROW)
+                return false;
+            heap = new (std::nothrow) T[2 * m_capacity];
+            if (!heap)
+                return false;
+            for (unsigned i = 0; i < m_count; i++)
+                heap[i] = m_heap[i];
+            if (m_heap != m_inline)
+                delete[] m_heap;
+            m_heap = heap;
+            m_capacity *= 2;
+            return true;
+        }
+
+        void sift_up(unsigned index) {
+            T entry = m_heap[index];
+            while (index) {
+                unsigned parent = (index - 1) / 2;
+                if (!(entry < m_heap[parent]))
+                    break;
+                m_heap[index] = m_heap[parent];
+                index = parent;
+            }
+            m_heap[index] = entry;
+        }
+
+        void sift_down(unsigned index) {
+            T entry = m_heap[index];
+            unsigned child;
+            while ((child = 2 * index + 1) < m_count) {
+                if (child + 1 < m_count && m_heap[child + 1] < m_heap[child])
+                    child++;
+                if (!(m_heap[child] < entry))
+                    break;
+                m_heap[index] = m_heap[child];
+                index = child;
+            }
+            m_heap[index] = entry;
+        }
+
+        T        m_inline[N];
+        T        *m_heap;
+        unsigned m_capacity;
+        unsigned m_count;
+};
+
+#endif /* MIN_HEAP_H */
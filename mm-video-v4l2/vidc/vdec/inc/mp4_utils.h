@@ -29,6 +29,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MP4_UTILS_H
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
+#include "bit_reader.h"
 typedef signed long long int64;
 typedef unsigned int uint32;   /* Unsigned 32 bit value */
 typedef unsigned short uint16;   /* Unsigned 16 bit value */
@@ -150,6 +151,7 @@ class MP4_Utils
     private:
         struct posInfoType {
             uint8 *bytePtr;
+            uint8 *endPtr;
             uint8 bitPos;
         };
 
@@ -0,0 +1,81 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef NAL_INDEX_H
+#define NAL_INDEX_H
+
+#include "OMX_Core.h"
+#include "frameparser.h"
+
+/*One entry per start code delimited unit found in an input buffer*/
+struct nal_record {
+    OMX_U32 offset;         /*start code offset from pBuffer + nOffset*/
+    OMX_U32 size;           /*start code + payload, up to the next start code*/
+    OMX_U8  sc_size;        /*3 or 4 byte start code*/
+    OMX_U8  nal_unit_type;  /*H264/HEVC nal_unit_type, start code suffix otherwise*/
+    OMX_U8  nal_ref_idc;    /*H264 only*/
+    OMX_U8  first_slice;    /*first_mb_in_slice == 0 / first_slice_segment_in_pic_flag*/
+};
+
+/*
+ * Scans an input buffer once and records where every NAL (or start code
+ * delimited header for the other codecs) lives, so that frame boundary
+ * detection, SPS/SEI parsing and demux descriptors can all work from the
+ * same table instead of re-scanning the bitstream.
+ */
+class nal_index
+{
+    public:
+        nal_index();
+        ~nal_index();
+        int build(OMX_BUFFERHEADERTYPE *buffer, codec_type codec);
+        int build(OMX_U8 *buf, OMX_U32 len, codec_type codec);
+        void reset();
+        OMX_U32 count() const {
+            return m_count;
+        }
+        const nal_record *get(OMX_U32 index) const {
+            return (index < m_count) ? &m_records[index] : NULL;
+        }
+        const nal_record *find(OMX_U32 nal_unit_type, OMX_U32 from = 0) const;
+        OMX_U8 *data(const nal_record *nal) const {
+            return m_data + nal->offset;
+        }
+        /*Describes the one unit that starts at buf, its payload is not scanned*/
+        static bool peek(OMX_U8 *buf, OMX_U32 len, codec_type codec, nal_record *nal);
+
+    private:
+        bool grow();
+        static void read_header(nal_record *nal, OMX_U8 *hdr, OMX_U32 left, codec_type codec);
+
+        OMX_U8 *m_data;
+        nal_record *m_records;
+        OMX_U32 m_count;
+        OMX_U32 m_capacity;
+};
+
+#endif /* NAL_INDEX_H */
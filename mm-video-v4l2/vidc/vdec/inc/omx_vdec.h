@@ -100,12 +100,22 @@ extern "C" {
 #include <linux/msm_vidc_dec.h>
 #include <media/msm_vidc.h>
 #include "frameparser.h"
+#include "nal_index.h"
 #ifdef MAX_RES_1080P
 #include "mp4_utils.h"
 #endif
 #include <linux/android_pmem.h>
 #include "extra_data_handler.h"
 #include "ts_parser.h"
+#include "msg_doorbell.h"
+#include "worker_pool.h"
+#include "thread_sched.h"
+#include "band_executor.h"
+#include "v4l2_ctrl_batch.h"
+#include "vidc_props.h"
+#include "ion_pool.h"
+#include "min_heap.h"
+#include "buf_ref_table.h"
 #include "vidc_color_converter.h"
 #include "vidc_debug.h"
 #ifdef _ANDROID_
@@ -324,13 +334,6 @@ struct debug_cap {
     FILE *outfile;
 };
 
-struct dynamic_buf_list {
-    long fd;
-    long dup_fd;
-    OMX_U32 offset;
-    OMX_U32 ref_count;
-};
-
 // OMX video decoder class
 class omx_vdec: public qc_omx_component
 {
@@ -456,15 +459,28 @@ class omx_vdec: public qc_omx_component
                 OMX_PTR              appData,
                 void *               eglImage);
         void complete_pending_buffer_done_cbs();
+        /*Logs the time since the previous phase with vidc.dec.debug.perf*/
+        void startup_phase(const char *phase, bool last = false);
         struct video_driver_context drv_ctx;
 #ifdef _MSM8974_
         OMX_ERRORTYPE allocate_extradata();
         void free_extradata();
         int update_resolution(int width, int height, int stride, int scan_lines);
         OMX_ERRORTYPE is_video_session_supported();
+        void configure_output_from_sps(OMX_U8 *data, OMX_U32 len);
 #endif
-        int  m_pipe_in;
-        int  m_pipe_out;
+        msg_doorbell m_msg_doorbell;
+        worker_strand m_msg_strand;
+        thread_sched m_thread_sched;
+        // vidc.dec.pixel_threads: threads for CPU color conversion
+        band_executor m_band_executor;
+        // vidc.dec.ion_pool: MB of freed ION buffers kept for reuse,
+        // in this component or, with vidc.dec.ion_pool.shared, process wide
+        // where the largest value any component asked for applies
+        ion_pool m_own_ion_pool;
+        ion_pool *m_ion_pool;
+        bool wait_codec_config_ebds(const struct timespec *deadline);
+        bool resume_deferred_flush();
         pthread_t msg_thread_id;
         pthread_t async_thread_id;
         bool is_component_secure();
@@ -574,13 +590,8 @@ class omx_vdec: public qc_omx_component
         };
 
 #ifdef _ANDROID_
-        struct ts_entry {
-            OMX_TICKS timestamp;
-            bool valid;
-        };
-
         struct ts_arr_list {
-            ts_entry m_ts_arr_list[MAX_NUM_INPUT_OUTPUT_BUFFERS];
+            min_heap<OMX_TICKS, MAX_NUM_INPUT_OUTPUT_BUFFERS> m_ts_arr_list;
 
             ts_arr_list();
             ~ts_arr_list();
@@ -670,6 +681,8 @@ class omx_vdec: public qc_omx_component
         OMX_ERRORTYPE push_input_h264 (OMX_HANDLETYPE hComp);
         OMX_ERRORTYPE push_input_hevc (OMX_HANDLETYPE hComp);
         OMX_ERRORTYPE push_input_vc1 (OMX_HANDLETYPE hComp);
+        OMX_ERRORTYPE parse_nal_to_scratch (OMX_U32 *partial_frame);
+        OMX_ERRORTYPE stage_scratch_nal (void);
 
         OMX_ERRORTYPE fill_this_buffer_proxy(OMX_HANDLETYPE       hComp,
                 OMX_BUFFERHEADERTYPE *buffer);
@@ -814,11 +827,6 @@ class omx_vdec: public qc_omx_component
         nativebuffer native_buffer[MAX_NUM_INPUT_OUTPUT_BUFFERS];
 #endif
 
-public:
-        inline bool omx_close_msg_thread(unsigned char id) {
-            return (id == OMX_COMPONENT_CLOSE_MSG);
-        }
-
 private:
         //*************************************************************
         //*******************MEMBER VARIABLES *************************
@@ -829,6 +837,9 @@ private:
         //sem to handle the minimum procesing of commands
         sem_t                 m_cmd_lock;
         sem_t                 m_safe_flush;
+        // flush left pending on the worker pool until the CODEC CONFIG EBDs
+        OMX_U32               m_deferred_flush_port;
+        struct timespec       m_deferred_flush_deadline;
         bool              m_error_propogated;
         // compression format
         OMX_VIDEO_CODINGTYPE eCompressionFormat;
@@ -900,11 +911,21 @@ private:
         h264_stream_parser *h264_parser;
         MP4_Utils mp4_headerparser;
         HEVC_Utils m_hevc_utils;
+        nal_index m_nal_index;
 
         omx_cmd_queue m_input_pending_q;
         omx_cmd_queue m_input_free_q;
         bool arbitrary_bytes;
         OMX_BUFFERHEADERTYPE  h264_scratch;
+        // h264_scratch.pBuffer either points here or at a NAL inside psource_frame
+        OMX_U8                *h264_scratch_mem;
+        // h264_scratch.pBuffer references a NAL inside psource_frame
+        bool                  m_scratch_in_place;
+        bool                  m_sg_assembly;
+        // one thread serves both the driver and the message queue
+        bool                  m_event_loop;
+        // message processing runs on the shared worker pool
+        bool                  m_worker_pool;
         OMX_BUFFERHEADERTYPE  *psource_frame;
         OMX_BUFFERHEADERTYPE  *pdest_frame;
         OMX_BUFFERHEADERTYPE  *m_inp_heap_ptr;
@@ -937,6 +958,8 @@ private:
         bool in_reconfig;
         OMX_NATIVE_WINDOWTYPE m_display_id;
         OMX_U32 client_extradata;
+        /*Extradata types ever enabled on the driver, internal or client*/
+        OMX_U32 m_driver_extradata;
 #ifdef _ANDROID_
         bool m_debug_timestamp;
         bool perf_flag;
@@ -998,6 +1021,8 @@ private:
         } m_custom_buffersize;
         bool m_power_hinted;
         bool is_q6_platform;
+        OMX_U64 m_startup_begin;
+        OMX_U64 m_startup_mark;
         OMX_ERRORTYPE power_module_register();
         OMX_ERRORTYPE power_module_deregister();
         bool msg_thread_created;
@@ -1008,7 +1033,7 @@ private:
 
         //variables to handle dynamic buffer mode
         bool dynamic_buf_mode;
-        struct dynamic_buf_list *out_dynamic_list;
+        buf_ref_table m_buf_refs;
         OMX_U32 m_reconfig_width;
         OMX_U32 m_reconfig_height;
         bool m_smoothstreaming_mode;
@@ -0,0 +1,89 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef PARAM_SET_TABLE_H
+#define PARAM_SET_TABLE_H
+
+#include <string.h>
+
+/*
+ * Parameter sets indexed directly by their id. Storage for all N ids is
+ * part of the table, so inserting copies into the slot and never
+ * allocates. Resending a set with the same id overwrites it in place.
+ */
+template <typename T, unsigned N>
+class param_set_table
+{
+    public:
+        param_set_table() : m_count(0) {
+            memset(m_valid, 0, sizeof(m_valid));
+        }
+
+        /*Returns false if id is out of range for this table*/
+        bool insert(unsigned id, const T &set) {
+            if (id >= N)
+                return false;
+            if (!m_valid[id]) {
+                m_valid[id] = true;
+                m_count++;
+            }
+            m_sets[id] = set;
+            return true;
+        }
+
+        const T *find(unsigned id) const {
+            return (id < N && m_valid[id]) ? &m_sets[id] : NULL;
+        }
+
+        bool erase(unsigned id) {
+            if (id >= N || !m_valid[id])
+                return false;
+            m_valid[id] = false;
+            m_count--;
+            return true;
+        }
+
+        void clear() {
+            memset(m_valid, 0, sizeof(m_valid));
+            m_count = 0;
+        }
+
+        unsigned size() const {
+            return m_count;
+        }
+
+        static unsigned capacity() {
+            return N;
+        }
+
+    private:
+        T        m_sets[N];
+        bool     m_valid[N];
+        unsigned m_count;
+};
+
+#endif /* PARAM_SET_TABLE_H */
@@ -0,0 +1,93 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef RBSP_UNESCAPE_H
+#define RBSP_UNESCAPE_H
+
+#include "start_code_scan.h"
+
+/*
+ * Copies the NAL payload src[0..len) into dst, dropping the 0x03 of every
+ * 00 00 03 emulation prevention sequence. Emulation prevention bytes can
+ * only follow a "00 00" pair, so the runs between pairs are located with
+ * sc_find_zero_pair and moved with memcpy; only the bytes right after a
+ * pair go through the byte-wise check.
+ *
+ * When stop_at_sc is set the copy ends ahead of a 00 00 00 or 00 00 01
+ * sequence, i.e. at the start code of the next NAL. At most dst_size bytes
+ * are written.
+ *
+ * Returns the number of bytes written to dst. If consumed is not NULL it
+ * receives the number of source bytes covered.
+ *
+ * Used by H264_Utils::extract_rbsp. h264_stream_parser does not copy, its
+ * bit_reader skips emulation prevention bytes in place.
+ */
+static inline uint32_t rbsp_unescape(const uint8_t *src, uint32_t len,
+        uint8_t *dst, uint32_t dst_size, bool stop_at_sc, uint32_t *consumed)
+{
+    uint32_t pos = 0, out = 0, zeros = 0;
+
+    while (pos < len && out < dst_size) {
+        if (!zeros) {
+            uint32_t run = sc_find_zero_pair(src + pos, len - pos);
+
+            if (run > dst_size - out)
+                run = dst_size - out;
+            memcpy(dst + out, src + pos, run);
+            pos += run;
+            out += run;
+            if (pos >= len || out >= dst_size)
+                break;
+        }
+
+        if (zeros == 2) {
+            if (src[pos] == 0x03) {
+                pos++;
+                zeros = 0;
+                continue;
+            }
+            if (src[pos] <= 0x01 && stop_at_sc) {
+                /*Both zeros belong to the next start code*/
+                out -= 2;
+                pos -= 2;
+                break;
+            }
+            zeros = 0;
+        }
+
+        zeros = src[pos] ? 0 : zeros + 1;
+        dst[out++] = src[pos++];
+    }
+
+    if (consumed)
+        *consumed = pos;
+
+    return out;
+}
+
+#endif /* RBSP_UNESCAPE_H */
@@ -0,0 +1,126 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef START_CODE_SCAN_H
+#define START_CODE_SCAN_H
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#endif
+
+/*
+ * Every start code handled by frame_parse (H264/HEVC, MPEG4, H263, VC1 AP
+ * and MPEG2) begins with two zero bytes, so the bulk of a bitstream can be
+ * skipped by looking for "00 00" pairs a register at a time and only handing
+ * candidate positions to the byte-wise state machine.
+ *
+ * Returns the offset of the first "00 00" pair in buf[0..len). If there is
+ * none, returns len - 1 when the last byte is zero (the pair may straddle
+ * into the next buffer) and len otherwise.
+ */
+static inline uint32_t sc_find_zero_pair(const uint8_t *buf, uint32_t len)
+{
+    uint32_t i = 0;
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+
+    while (i + 17 <= len) {
+        uint8x16_t a = vceqq_u8(vld1q_u8(buf + i), zero);
+        uint8x16_t b = vceqq_u8(vld1q_u8(buf + i + 1), zero);
+        uint64x2_t m = vreinterpretq_u64_u8(vandq_u8(a, b));
+
+        if (vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1)) {
+            for (uint32_t j = i; j < i + 16; j++) {
+                if (!buf[j] && !buf[j + 1])
+                    return j;
+            }
+        }
+        i += 16;
+    }
+#elif defined(__SSE2__)
+#ifdef __AVX2__
+    const __m256i zero32 = _mm256_setzero_si256();
+
+    while (i + 33 <= len) {
+        __m256i a = _mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)(buf + i)), zero32);
+        __m256i b = _mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)(buf + i + 1)), zero32);
+        uint32_t m = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(a, b));
+
+        if (m)
+            return i + __builtin_ctz(m);
+        i += 32;
+    }
+#endif
+    const __m128i zero = _mm_setzero_si128();
+
+    while (i + 17 <= len) {
+        __m128i a = _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(buf + i)), zero);
+        __m128i b = _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(buf + i + 1)), zero);
+        uint32_t m = (uint32_t)_mm_movemask_epi8(_mm_and_si128(a, b));
+
+        if (m)
+            return i + __builtin_ctz(m);
+        i += 16;
+    }
+#else
+    /* Word at a time: only words holding a zero byte are looked at closely */
+    while (i + 9 <= len) {
+        uint64_t w;
+        memcpy(&w, buf + i, sizeof(w));
+
+        if ((w - 0x0101010101010101ULL) & ~w & 0x8080808080808080ULL) {
+            for (uint32_t j = i; j < i + 8; j++) {
+                if (!buf[j] && !buf[j + 1])
+                    return j;
+            }
+        }
+        i += 8;
+    }
+#endif
+
+    for (; i + 1 < len; i++) {
+        if (!buf[i] && !buf[i + 1])
+            return i;
+    }
+
+    return (len && !buf[len - 1]) ? len - 1 : len;
+}
+
+#endif /* START_CODE_SCAN_H */
@@ -31,6 +31,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
 #include "qc_omx_component.h"
+#include "min_heap.h"
 
 #include<stdlib.h>
 
@@ -74,22 +75,30 @@ class omx_time_stamp_reorder
         void flush_timestamp();
 
     private:
+/*Timestamps pending in one EOS delimited segment*/
 #define TIME_SZ 64
-        typedef struct timestamp {
+/*Timestamps pending across all segments before the heap has to grow*/
+#define TIME_HEAP_SZ (2 * TIME_SZ)
+        /*
+         * Segments are numbered in input order, so the heap hands out all
+         * timestamps of the oldest segment before any of the next one.
+         */
+        struct timestamp {
             OMX_TICKS timestamps;
-            bool in_use;
-        } timestamp;
-        typedef struct time_stamp_list {
-            timestamp input_timestamps[TIME_SZ];
-            time_stamp_list *next;
-            time_stamp_list *prev;
-            unsigned int entries_filled;
-        } time_stamp_list;
+            unsigned int segment;
+            bool operator<(const timestamp &other) const {
+                if (segment != other.segment)
+                    return (int)(segment - other.segment) < 0;
+                return timestamps < other.timestamps;
+            }
+        };
         bool error;
-        time_stamp_list *phead,*pcurrent;
-        bool get_current_list();
-        bool add_new_list();
-        bool update_head();
+        /* Any number of segments can be pending, as with the old page list */
+        min_heap<timestamp, TIME_HEAP_SZ, true> heap;
+        unsigned int segment;
+        unsigned int segment_filled;
+        void add_new_segment();
+        bool pop_timestamp(timestamp &entry);
         void delete_list();
         void handle_error() {
             ALOGE("Error handler called for TS Parser");
@@ -0,0 +1,196 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <unistd.h>
+#include "buf_ref_table.h"
+#include "vidc_debug.h"
+
+buf_ref_table::buf_ref_table()
+    : m_slots(NULL),
+      m_mask(0),
+      m_count(0),
+      m_limit(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+}
+
+buf_ref_table::~buf_ref_table()
+{
+    release();
+    pthread_mutex_destroy(&m_lock);
+}
+
+bool buf_ref_table::init(unsigned count)
+{
+    unsigned size = 8;
+    struct dynamic_buf_list *slots;
+
+    /* At most half full, probe sequences stay short */
+    while (size < 2 * count)
+        size <<= 1;
+    slots = (struct dynamic_buf_list *)calloc(size, sizeof(*slots));
+    if (!slots)
+        return false;
+    for (unsigned i = 0; i < size; i++)
+        slots[i].dup_fd = -1;
+
+    release();
+    pthread_mutex_lock(&m_lock);
+    m_slots = slots;
+    m_mask = size - 1;
+    m_count = 0;
+    m_limit = count;
+    pthread_mutex_unlock(&m_lock);
+    return true;
+}
+
+void buf_ref_table::release()
+{
+    struct dynamic_buf_list *slots;
+    unsigned size;
+
+    pthread_mutex_lock(&m_lock);
+    slots = m_slots;
+    size = slots ? m_mask + 1 : 0;
+    m_slots = NULL;
+    m_mask = m_count = m_limit = 0;
+    pthread_mutex_unlock(&m_lock);
+
+    for (unsigned i = 0; i < size; i++) {
+        if (slots[i].dup_fd >= 0)
+            close(slots[i].dup_fd);
+    }
+    free(slots);
+}
+
+unsigned buf_ref_table::home(long fd, OMX_U32 offset) const
+{
+    unsigned h = (unsigned)fd * 0x9E3779B1u ^ offset;
+
+    h ^= h >> 16;
+    return h & m_mask;
+}
+
+int buf_ref_table::find(long fd, OMX_U32 offset) const
+{
+    for (unsigned i = home(fd, offset); m_slots[i].dup_fd >= 0; i = (i + 1) & m_mask) {
+        if (m_slots[i].fd == fd && m_slots[i].offset == offset)
+            return i;
+    }
+    return -1;
+}
+
+/* Backward shift deletion, keeps every probe sequence unbroken */
+void buf_ref_table::erase(unsigned i)
+{
+    unsigned j = i;
+    unsigned k;
+
+    while (1) {
+        j = (j + 1) & m_mask;
+        if (m_slots[j].dup_fd < 0)
+            break;
+        k = home(m_slots[j].fd, m_slots[j].offset);
+        /* Entry j may move to i only if its home is not in (i, j] */
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        m_slots[i] = m_slots[j];
+        i = j;
+    }
+    m_slots[i].fd = 0;
+    m_slots[i].offset = 0;
+    m_slots[i].ref_count = 0;
+    m_slots[i].dup_fd = -1;
+    m_count--;
+}
+
+bool buf_ref_table::add(long fd, OMX_U32 offset)
+{
+    long dup_fd = -1;
+    bool added = false;
+    int i;
+
+    pthread_mutex_lock(&m_lock);
+    while (m_slots) {
+        i = find(fd, offset);
+        if (i >= 0) {
+            m_slots[i].ref_count++;
+            DEBUG_PRINT_LOW("buf_ref_add: [ALREADY PRESENT] fd = %u ref_count = %u",
+                    (unsigned int)fd, (unsigned int)m_slots[i].ref_count);
+            added = true;
+            break;
+        }
+        if (m_count >= m_limit)
+            break;
+        if (dup_fd < 0) {
+            pthread_mutex_unlock(&m_lock);
+            dup_fd = dup(fd);
+            pthread_mutex_lock(&m_lock);
+            if (dup_fd < 0)
+                break;
+            /* Look again, the buffer may have been added meanwhile */
+            continue;
+        }
+        for (i = home(fd, offset); m_slots[i].dup_fd >= 0; i = (i + 1) & m_mask);
+        m_slots[i].fd = fd;
+        m_slots[i].offset = offset;
+        m_slots[i].dup_fd = dup_fd;
+        m_slots[i].ref_count = 1;
+        m_count++;
+        dup_fd = -1;
+        DEBUG_PRINT_LOW("buf_ref_add: [ADDED] fd = %u ref_count = 1", (unsigned int)fd);
+        added = true;
+        break;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (dup_fd >= 0)
+        close(dup_fd);
+    return added;
+}
+
+bool buf_ref_table::remove(long fd, OMX_U32 offset)
+{
+    long dup_fd = -1;
+    int i = -1;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_slots)
+        i = find(fd, offset);
+    if (i >= 0 && !--m_slots[i].ref_count) {
+        dup_fd = m_slots[i].dup_fd;
+        erase(i);
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (dup_fd >= 0) {
+        close(dup_fd);
+        DEBUG_PRINT_LOW("buf_ref_remove: [REMOVED] fd = %u ref_count = 0", (unsigned int)fd);
+    }
+    return i >= 0;
+}
@@ -43,6 +43,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdint.h>
 
 #include "frameparser.h"
+#include "start_code_scan.h"
 #include "vidc_debug.h"
 
 #ifdef _ANDROID_
@@ -51,29 +52,61 @@ extern "C" {
 }
 #endif//_ANDROID_
 
-static unsigned char H264_mask_code[4] = {0xFF,0xFF,0xFF,0xFF};
 static unsigned char H264_start_code[4] = {0x00,0x00,0x00,0x01};
 
-static unsigned char MPEG4_start_code[4] = {0x00,0x00,0x01,0xB6};
-static unsigned char MPEG4_mask_code[4] = {0xFF,0xFF,0xFF,0xFF};
-
-static unsigned char H263_start_code[4] = {0x00,0x00,0x80,0x00};
-static unsigned char H263_mask_code[4] = {0xFF,0xFF,0xFC,0x00};
-
-static unsigned char VC1_AP_start_code[4] = {0x00,0x00,0x01,0x0C};
-static unsigned char VC1_AP_mask_code[4] = {0xFF,0xFF,0xFF,0xFC};
+/*
+ * Start code and mask of each codec, fixed at compile time so that every
+ * parser instance below folds its codec checks away.
+ */
+template <codec_type CODEC> struct sc_traits;
+
+template <> struct sc_traits<CODEC_TYPE_MPEG4> {
+    static constexpr OMX_U8 sc0 = 0x00, sc1 = 0x00, sc2 = 0x01, sc3 = 0xB6;
+    static constexpr OMX_U8 mask0 = 0xFF, mask1 = 0xFF, mask2 = 0xFF, mask3 = 0xFF;
+};
+
+template <> struct sc_traits<CODEC_TYPE_H263> {
+    static constexpr OMX_U8 sc0 = 0x00, sc1 = 0x00, sc2 = 0x80, sc3 = 0x00;
+    static constexpr OMX_U8 mask0 = 0xFF, mask1 = 0xFF, mask2 = 0xFC, mask3 = 0x00;
+};
+
+template <> struct sc_traits<CODEC_TYPE_H264> {
+    static constexpr OMX_U8 sc0 = 0x00, sc1 = 0x00, sc2 = 0x00, sc3 = 0x01;
+    static constexpr OMX_U8 mask0 = 0xFF, mask1 = 0xFF, mask2 = 0xFF, mask3 = 0xFF;
+};
+
+template <> struct sc_traits<CODEC_TYPE_VC1> {
+    static constexpr OMX_U8 sc0 = 0x00, sc1 = 0x00, sc2 = 0x01, sc3 = 0x0C;
+    static constexpr OMX_U8 mask0 = 0xFF, mask1 = 0xFF, mask2 = 0xFF, mask3 = 0xFC;
+};
+
+template <> struct sc_traits<CODEC_TYPE_MPEG2> {
+    static constexpr OMX_U8 sc0 = 0x00, sc1 = 0x00, sc2 = 0x01, sc3 = 0x00;
+    static constexpr OMX_U8 mask0 = 0xFF, mask1 = 0xFF, mask2 = 0xFF, mask3 = 0xFF;
+};
+
+/*Write the first len bytes of the start code*/
+template <codec_type CODEC>
+static inline void put_start_code(OMX_U8 *pdest, int len)
+{
+    typedef sc_traits<CODEC> T;
 
-static unsigned char MPEG2_start_code[4] = {0x00, 0x00, 0x01, 0x00};
-static unsigned char MPEG2_mask_code[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+    if (len > 0) pdest[0] = T::sc0;
+    if (len > 1) pdest[1] = T::sc1;
+    if (len > 2) pdest[2] = T::sc2;
+    if (len > 3) pdest[3] = T::sc3;
+}
 
 frame_parse::frame_parse():mutils(NULL),
     parse_state(A0),
-    start_code(NULL),
-    mask_code(NULL),
+    parse_sc(NULL),
     last_byte_h263(0),
     last_byte(0),
     header_found(false),
     skip_frame_boundary(false),
+    sc_end(NULL),
+    sc_source(NULL),
+    sc_buffer(NULL),
     state_nal(NAL_LENGTH_ACC),
     nal_length(0),
     accum_length(0),
@@ -96,30 +129,30 @@ int frame_parse::init_start_codes (codec_type codec_type_parse)
         return -1;
     }
 
+    sc_end = NULL;
+    sc_source = NULL;
+    sc_buffer = NULL;
+
     switch (codec_type_parse) {
         case CODEC_TYPE_MPEG4:
-            start_code = MPEG4_start_code;
-            mask_code = MPEG4_mask_code;
+            parse_sc = &frame_parse::parse_sc_codec<CODEC_TYPE_MPEG4>;
             break;
         case CODEC_TYPE_H263:
-            start_code = H263_start_code;
-            mask_code = H263_mask_code;
+            parse_sc = &frame_parse::parse_sc_codec<CODEC_TYPE_H263>;
             break;
         case CODEC_TYPE_H264:
         case CODEC_TYPE_HEVC:
-            start_code = H264_start_code;
-            mask_code = H264_mask_code;
+            parse_sc = &frame_parse::parse_sc_codec<CODEC_TYPE_H264>;
             break;
         case CODEC_TYPE_VC1:
-            start_code = VC1_AP_start_code;
-            mask_code = VC1_AP_mask_code;
+            parse_sc = &frame_parse::parse_sc_codec<CODEC_TYPE_VC1>;
             break;
         case CODEC_TYPE_MPEG2:
-            start_code = MPEG2_start_code;
-            mask_code = MPEG2_mask_code;
+            parse_sc = &frame_parse::parse_sc_codec<CODEC_TYPE_MPEG2>;
             break;
 #ifdef _MSM8974_
         case CODEC_TYPE_VP8:
+            parse_sc = NULL;
             break;
 #endif
         default:
@@ -141,19 +174,48 @@ int frame_parse::init_nal_length (unsigned int nal_len)
     return 1;
 }
 
+/*
+ * When span is given and the NAL that starts at the current source offset is
+ * found complete within the same source buffer, its body is not copied into
+ * dest. Instead span is pointed at the NAL (start code included)
+ * inside the source buffer and dest is left as it was. NALs that straddle
+ * source buffers are always accumulated in dest.
+ */
 int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
         OMX_BUFFERHEADERTYPE *dest ,
-        OMX_U32 *partialframe)
+        OMX_U32 *partialframe,
+        nal_span *span)
 {
+    if (parse_sc == NULL) {
+        DEBUG_PRINT_ERROR("FrameParser: no start code parser for this codec");
+        return -1;
+    }
+
+    return (this->*parse_sc)(source, dest, partialframe, span);
+}
+
+template <codec_type CODEC>
+int frame_parse::parse_sc_codec ( OMX_BUFFERHEADERTYPE *source,
+        OMX_BUFFERHEADERTYPE *dest ,
+        OMX_U32 *partialframe,
+        nal_span *span)
+{
+    typedef sc_traits<CODEC> T;
     OMX_U8 *pdest = NULL,*psource = NULL, match_found = FALSE, is_byte_match = 0;
     OMX_U32 dest_len =0, source_len = 0, temp_len = 0;
-    OMX_U32 parsed_length = 0,i=0;
-    int residue_byte = 0;
+    OMX_U32 parsed_length = 0;
+    bool in_place = false;
+    OMX_U32 sc_len = 0;
 
     if (source == NULL || dest == NULL || partialframe == NULL) {
         return -1;
     }
 
+    if (span) {
+        span->data = NULL;
+        span->len = 0;
+    }
+
     /*Calculate how many bytes are left in source and destination*/
     dest_len = dest->nAllocLen - (dest->nFilledLen + dest->nOffset);
     psource = source->pBuffer + source->nOffset;
@@ -161,8 +223,8 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
     source_len = source->nFilledLen;
 
     /*Need Minimum Start Code size for destination to copy atleast Start code*/
-    if ((start_code == H263_start_code && dest_len < 3) ||
-            (start_code != H263_start_code && dest_len < 4) || (source_len == 0)) {
+    if ((CODEC == CODEC_TYPE_H263 && dest_len < 3) ||
+            (CODEC != CODEC_TYPE_H263 && dest_len < 4) || (source_len == 0)) {
         DEBUG_PRINT_LOW("FrameParser: dest_len %u source_len %u",(unsigned int)dest_len, (unsigned int)source_len);
 
         if (source_len == 0 && (source->nFlags & 0x01)) {
@@ -175,25 +237,37 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
         return -1;
     }
 
+    /*NAL can be referenced in place only if its start code was consumed
+      from this very source buffer, not a later one at the same address*/
+    sc_len = (parse_state == A4) ? 4 : 3;
+    in_place = span && dest->nFilledLen == 0 &&
+        (parse_state == A4 || parse_state == A5) &&
+        CODEC == CODEC_TYPE_H264 && source == sc_source &&
+        source->pBuffer == sc_buffer && psource == sc_end &&
+        source->nOffset >= sc_len;
+    sc_end = NULL;
+    sc_source = NULL;
+    sc_buffer = NULL;
+
     /*Check if State of the previous find is a Start code*/
     if (parse_state == A4 || parse_state == A5) {
         /*Check for minimun size should be 4*/
         dest->nFlags = source->nFlags;
         dest->nTimeStamp = source->nTimeStamp;
 
-        if (start_code == H263_start_code) {
-            memcpy (pdest,start_code,2);
+        if (CODEC == CODEC_TYPE_H263) {
+            put_start_code<CODEC>(pdest, 2);
             pdest[2] = last_byte_h263;
             dest->nFilledLen += 3;
             pdest += 3;
         } else {
-            memcpy (pdest,start_code,4);
+            put_start_code<CODEC>(pdest, 4);
 
-            if (start_code == VC1_AP_start_code
-                    || start_code == MPEG4_start_code
-                    || start_code == MPEG2_start_code) {
+            if (CODEC == CODEC_TYPE_VC1
+                    || CODEC == CODEC_TYPE_MPEG4
+                    || CODEC == CODEC_TYPE_MPEG2) {
                 pdest[3] = last_byte;
-                update_skip_frame();
+                update_skip_frame<CODEC>();
             }
 
             dest->nFilledLen += 4;
@@ -210,7 +284,7 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
         //printf ("In the Entry Loop");
         switch (parse_state) {
             case A3:
-                parse_additional_start_code(psource,&parsed_length);
+                parse_additional_start_code<CODEC>(psource,&parsed_length);
 
                 if (parse_state == A4) {
                     source->nFilledLen--;
@@ -220,27 +294,27 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
                 }
 
                 /*If fourth Byte is matching then start code is found*/
-                if ((*psource & mask_code [3]) == start_code [3]) {
+                if ((*psource & T::mask3) == T::sc3) {
                     parse_state = A4;
                     last_byte =  *psource;
                     source->nFilledLen--;
                     source->nOffset++;
                     psource++;
-                } else if ((start_code [1] == start_code [0]) && (start_code [2]  == start_code [1])) {
+                } else if ((T::sc1 == T::sc0) && (T::sc2  == T::sc1)) {
                     parse_state = A2;
-                    memcpy (pdest,start_code,1);
+                    put_start_code<CODEC>(pdest, 1);
                     pdest++;
                     dest->nFilledLen++;
                     dest_len--;
-                } else if (start_code [2] == start_code [0]) {
+                } else if (T::sc2 == T::sc0) {
                     parse_state = A1;
-                    memcpy (pdest,start_code,2);
+                    put_start_code<CODEC>(pdest, 2);
                     pdest += 2;
                     dest->nFilledLen += 2;
                     dest_len -= 2;
                 } else {
                     parse_state = A0;
-                    memcpy (pdest,start_code,3);
+                    put_start_code<CODEC>(pdest, 3);
                     pdest += 3;
                     dest->nFilledLen +=3;
                     dest_len -= 3;
@@ -249,17 +323,17 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
                 break;
 
             case A2:
-                is_byte_match = ((*psource & mask_code [2]) == start_code [2]);
+                is_byte_match = ((*psource & T::mask2) == T::sc2);
                 match_found = FALSE;
 
-                if (start_code == H263_start_code) {
+                if (CODEC == CODEC_TYPE_H263) {
                     if (is_byte_match) {
                         last_byte_h263 = *psource;
                         parse_state = A5;
                         match_found = TRUE;
                     }
-                } else if (start_code == H264_start_code &&
-                        (*psource & mask_code [3]) == start_code [3]) {
+                } else if (CODEC == CODEC_TYPE_H264 &&
+                        (*psource & T::mask3) == T::sc3) {
                     parse_state = A5;
                     match_found = TRUE;
                 } else {
@@ -273,15 +347,15 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
                     source->nFilledLen--;
                     source->nOffset++;
                     psource++;
-                } else if (start_code [1] == start_code [0]) {
+                } else if (T::sc1 == T::sc0) {
                     parse_state = A1;
-                    memcpy (pdest,start_code,1);
+                    put_start_code<CODEC>(pdest, 1);
                     dest->nFilledLen +=1;
                     dest_len--;
                     pdest++;
                 } else {
                     parse_state = A0;
-                    memcpy (pdest,start_code,2);
+                    put_start_code<CODEC>(pdest, 2);
                     dest->nFilledLen +=2;
                     dest_len -= 2;
                     pdest += 2;
@@ -291,13 +365,13 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
 
             case A1:
 
-                if ((*psource & mask_code [1]) == start_code [1]) {
+                if ((*psource & T::mask1) == T::sc1) {
                     parse_state = A2;
                     source->nFilledLen--;
                     source->nOffset++;
                     psource++;
                 } else {
-                    memcpy (pdest,start_code,1);
+                    put_start_code<CODEC>(pdest, 1);
                     dest->nFilledLen +=1;
                     pdest++;
                     dest_len--;
@@ -316,7 +390,7 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
 
     if (parse_state == A4 || parse_state == A5) {
         *partialframe = 0;
-        check_skip_frame_boundary(partialframe);
+        check_skip_frame_boundary<CODEC>(partialframe);
         DEBUG_PRINT_LOW("FrameParser: Parsed Len = %u", (unsigned int)dest->nFilledLen);
         return 1;
     }
@@ -342,7 +416,17 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
         switch (parse_state) {
             case A0:
 
-                if ((psource [parsed_length] & mask_code [0])  == start_code[0]) {
+                if (T::sc0 == 0x00 && T::mask0 == 0xFF &&
+                        T::sc1 == 0x00 && T::mask1 == 0xFF) {
+                    /*Skip ahead to the next 00 00 candidate*/
+                    parsed_length += sc_find_zero_pair(psource + parsed_length,
+                            temp_len - parsed_length);
+
+                    if (parsed_length >= temp_len)
+                        break;
+                }
+
+                if ((psource [parsed_length] & T::mask0)  == T::sc0) {
                     parse_state = A1;
                 }
 
@@ -350,7 +434,7 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
                 break;
             case A1:
 
-                if ((psource [parsed_length] & mask_code [1]) == start_code [1]) {
+                if ((psource [parsed_length] & T::mask1) == T::sc1) {
                     parsed_length++;
                     parse_state = A2;
                 } else {
@@ -359,17 +443,17 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
 
                 break;
             case A2:
-                is_byte_match = ((psource[parsed_length] & mask_code [2]) == start_code [2]);
+                is_byte_match = ((psource[parsed_length] & T::mask2) == T::sc2);
                 match_found = FALSE;
 
-                if (start_code == H263_start_code) {
+                if (CODEC == CODEC_TYPE_H263) {
                     if (is_byte_match) {
                         last_byte_h263 = psource[parsed_length];
                         parse_state = A5;
                         match_found = TRUE;
                     }
-                } else if (start_code == H264_start_code &&
-                        (psource[parsed_length] & mask_code [3]) == start_code [3]) {
+                } else if (CODEC == CODEC_TYPE_H264 &&
+                        (psource[parsed_length] & T::mask3) == T::sc3) {
                     parse_state = A5;
                     match_found = TRUE;
                 } else {
@@ -381,7 +465,7 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
 
                 if (match_found) {
                     parsed_length++;
-                } else if (start_code [1] == start_code [0]) {
+                } else if (T::sc1 == T::sc0) {
                     parse_state = A1;
                 } else {
                     parse_state = A0;
@@ -389,17 +473,17 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
 
                 break;
             case A3:
-                parse_additional_start_code(psource,&parsed_length);
+                parse_additional_start_code<CODEC>(psource,&parsed_length);
 
                 if (parse_state == A4) break;
 
-                if ((psource [parsed_length] & mask_code [3]) == start_code [3]) {
+                if ((psource [parsed_length] & T::mask3) == T::sc3) {
                     last_byte = psource [parsed_length];
                     parsed_length++;
                     parse_state = A4;
-                } else if ((start_code [1] == start_code [0]) && (start_code [2] == start_code [1])) {
+                } else if ((T::sc1 == T::sc0) && (T::sc2 == T::sc1)) {
                     parse_state = A2;
-                } else if (start_code [2] == start_code [0]) {
+                } else if (T::sc2 == T::sc0) {
                     parse_state = A1;
                 } else {
                     parse_state = A0;
@@ -413,6 +497,9 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
 
         /*Found the code break*/
         if (parse_state == A4 || parse_state == A5) {
+            sc_end = psource + parsed_length;
+            sc_source = source;
+            sc_buffer = source->pBuffer;
             break;
         }
     }
@@ -423,12 +510,12 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
     switch (parse_state) {
         case A5:
             *partialframe = 0;
-            check_skip_frame_boundary(partialframe);
+            check_skip_frame_boundary<CODEC>(partialframe);
             bytes_to_skip = 3;
             break;
         case A4:
             *partialframe = 0;
-            check_skip_frame_boundary(partialframe);
+            check_skip_frame_boundary<CODEC>(partialframe);
             bytes_to_skip = 4;
             break;
         case A3:
@@ -462,7 +549,14 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
         return -1;
     }
 
-    if (parsed_length > bytes_to_skip) {
+    if (in_place && (parse_state == A4 || parse_state == A5)) {
+        /*Drop the start code written above, the source already has it*/
+        dest->nFilledLen = 0;
+        span->data = psource - sc_len;
+        span->len = sc_len;
+        if (parsed_length > bytes_to_skip)
+            span->len += parsed_length - bytes_to_skip;
+    } else if (parsed_length > bytes_to_skip) {
         memcpy (pdest, psource, (parsed_length-bytes_to_skip));
         dest->nFilledLen += (parsed_length-bytes_to_skip);
     }
@@ -470,6 +564,13 @@ int frame_parse::parse_sc_frame ( OMX_BUFFERHEADERTYPE *source,
     source->nFilledLen -= parsed_length;
     source->nOffset += parsed_length;
 
+    /*An emptied source goes back to the client, nothing in it can be kept*/
+    if (source->nFilledLen == 0) {
+        sc_end = NULL;
+        sc_source = NULL;
+        sc_buffer = NULL;
+    }
+
     return 1;
 }
 
@@ -578,6 +679,9 @@ int frame_parse::parse_h264_nallength (OMX_BUFFERHEADERTYPE *source,
 void frame_parse::flush ()
 {
     parse_state = A0;
+    sc_end = NULL;
+    sc_source = NULL;
+    sc_buffer = NULL;
     state_nal = NAL_LENGTH_ACC;
     accum_length = 0;
     bytes_tobeparsed = 0;
@@ -585,19 +689,20 @@ void frame_parse::flush ()
     skip_frame_boundary = false;
 }
 
+template <codec_type CODEC>
 void frame_parse::parse_additional_start_code(OMX_U8 *psource,
         OMX_U32 *parsed_length)
 {
 
-    if (((start_code == MPEG4_start_code) ||
-                (start_code == MPEG2_start_code)) &&
+    if (((CODEC == CODEC_TYPE_MPEG4) ||
+                (CODEC == CODEC_TYPE_MPEG2)) &&
             psource &&
             parsed_length) {
         OMX_U32 index = *parsed_length;
 
-        if ((start_code == MPEG4_start_code &&
+        if ((CODEC == CODEC_TYPE_MPEG4 &&
                     (psource [index] & 0xF0) == 0x20) ||
-                (start_code == MPEG2_start_code &&
+                (CODEC == CODEC_TYPE_MPEG2 &&
                  psource [index] == 0xB3)) {
             if (header_found) {
                 last_byte = psource [index];
@@ -611,10 +716,11 @@ void frame_parse::parse_additional_start_code(OMX_U8 *psource,
     }
 }
 
+template <codec_type CODEC>
 void frame_parse::check_skip_frame_boundary(OMX_U32 *partialframe)
 {
-    if ((start_code == MPEG4_start_code ||
-                start_code == MPEG2_start_code) &&
+    if ((CODEC == CODEC_TYPE_MPEG4 ||
+                CODEC == CODEC_TYPE_MPEG2) &&
             partialframe) {
 
         *partialframe = 1;
@@ -626,11 +732,12 @@ void frame_parse::check_skip_frame_boundary(OMX_U32 *partialframe)
     }
 }
 
+template <codec_type CODEC>
 void frame_parse::update_skip_frame()
 {
-    if (((start_code == MPEG4_start_code) &&
+    if (((CODEC == CODEC_TYPE_MPEG4) &&
                 ((last_byte & 0xF0) == 0x20)) ||
-            ((start_code == MPEG2_start_code) &&
+            ((CODEC == CODEC_TYPE_MPEG2) &&
              (last_byte == 0xB3))) {
 
         skip_frame_boundary = true;
@@ -46,6 +46,8 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 ========================================================================== */
 #include "h264_utils.h"
+#include "nal_index.h"
+#include "rbsp_unescape.h"
 #include "extra_data_handler.h"
 #include <string.h>
 #include <stdlib.h>
@@ -53,6 +55,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sys/time.h>
 #ifdef _ANDROID_
 #include <cutils/properties.h>
+#include "vidc_props.h"
 extern "C" {
 #include<utils/Log.h>
 }
@@ -71,90 +74,42 @@ extern "C" {
 
 #define MAX_SUPPORTED_LEVEL 32
 
+/* Only first_mb_in_slice is read out of a slice, the RBSP of the rest of
+   the NAL is never looked at */
+#define SLICE_HEADER_PEEK_SIZE 16
+
     RbspParser::RbspParser (const uint8 *_begin, const uint8 *_end)
-: begin (_begin), end(_end), pos (- 1), bit (0),
-    cursor (0xFFFFFF), advanceNeeded (true)
+: reader (_begin, (uint32)(_end - _begin), true)
 {
 }
 
 // Destructor
-/*lint -e{1540}  Pointer member neither freed nor zeroed by destructor
- * No problem
- */
 RbspParser::~RbspParser () {}
 
-// Return next RBSP byte as a word
-uint32 RbspParser::next ()
-{
-    if (advanceNeeded) advance ();
-    //return static_cast<uint32> (*pos);
-    return static_cast<uint32> (begin[pos]);
-}
-
-// Advance RBSP decoder to next byte
-void RbspParser::advance ()
-{
-    ++pos;
-    //if (pos >= stop)
-    if (begin + pos == end) {
-        /*lint -e{730}  Boolean argument to function
-         * I don't see a problem here
-         */
-        //throw false;
-        ALOGV("H264Parser-->NEED TO THROW THE EXCEPTION...");
-    }
-    cursor <<= 8;
-    //cursor |= static_cast<uint32> (*pos);
-    cursor |= static_cast<uint32> (begin[pos]);
-    if ((cursor & 0xFFFFFF) == 0x000003) {
-        advance ();
-    }
-    advanceNeeded = false;
-}
-
 // Decode unsigned integer
 uint32 RbspParser::u (uint32 n)
 {
-    uint32 i, s, x = 0;
-    for (i = 0; i < n; i += s) {
-        s = static_cast<uint32>STD_MIN(static_cast<int>(8 - bit),
-                static_cast<int>(n - i));
-        x <<= s;
-
-        x |= ((next () >> ((8 - static_cast<uint32>(bit)) - s)) &
-                ((1 << s) - 1));
-
-        bit = (bit + s) % 8;
-        if (!bit) {
-            advanceNeeded = true;
-        }
-    }
-    return x;
+    return reader.u (n);
 }
 
 // Decode unsigned integer Exp-Golomb-coded syntax element
 uint32 RbspParser::ue ()
 {
-    int leadingZeroBits = -1;
-    for (uint32 b = 0; !b; ++leadingZeroBits) {
-        b = u (1);
-    }
-    return ((1 << leadingZeroBits) - 1) +
-        u (static_cast<uint32>(leadingZeroBits));
+    return reader.ue ();
 }
 
 // Decode signed integer Exp-Golomb-coded syntax element
 int32 RbspParser::se ()
 {
-    const uint32 x = ue ();
-    if (!x) return 0;
-    else if (x & 1) return static_cast<int32> ((x >> 1) + 1);
-    else return - static_cast<int32> (x >> 1);
+    return reader.se ();
 }
 
 void H264_Utils::allocate_rbsp_buffer(uint32 inputBufferSize)
 {
+    if (m_rbspBytes)
+        free(m_rbspBytes);
     m_rbspBytes = (byte *) calloc(1,inputBufferSize);
+    m_rbspSize = m_rbspBytes ? inputBufferSize : 0;
     m_prv_nalu.nal_ref_idc = 0;
     m_prv_nalu.nalu_type = NALU_TYPE_UNSPECIFIED;
 }
@@ -162,6 +117,7 @@ void H264_Utils::allocate_rbsp_buffer(uint32 inputBufferSize)
 H264_Utils::H264_Utils(): m_height(0),
     m_width(0),
     m_rbspBytes(NULL),
+    m_rbspSize(0),
     m_au_data (false)
 {
     initialize_frame_checking_environment();
@@ -224,7 +180,8 @@ otherwise size nal length is detected
 size_of_nal_length_field: size of nal length field
 
 <Out>
-rbsp_bistream : extracted RBSP bistream
+rbsp_bistream : extracted RBSP bistream, provided by the caller
+rbsp_size : size of rbsp_bistream, extraction stops once it is full
 rbsp_length : the length of the RBSP bitstream
 nal_unit : decoded NAL header information
 
@@ -240,6 +197,7 @@ boolean H264_Utils::extract_rbsp(OMX_IN   OMX_U8  *buffer,
         OMX_IN   OMX_U32 buffer_length,
         OMX_IN   OMX_U32 size_of_nal_length_field,
         OMX_OUT  OMX_U8  *rbsp_bistream,
+        OMX_IN   OMX_U32 rbsp_size,
         OMX_OUT  OMX_U32 *rbsp_length,
         OMX_OUT  NALU    *nal_unit)
 {
@@ -247,7 +205,6 @@ boolean H264_Utils::extract_rbsp(OMX_IN   OMX_U8  *buffer,
     uint32 pos = 0;
     uint32 nal_len = buffer_length;
     uint32 sizeofNalLengthField = 0;
-    uint32 zero_count;
     boolean eRet = true;
     boolean start_code = (size_of_nal_length_field==0)?true:false;
 
@@ -301,28 +258,10 @@ boolean H264_Utils::extract_rbsp(OMX_IN   OMX_U8  *buffer,
             nal_unit->nalu_type == NALU_TYPE_EOSTREAM)
         return (nal_len + sizeofNalLengthField);
 
-    zero_count = 0;
-    while (pos < (nal_len+sizeofNalLengthField)) {  //similar to for in p-42
-        if ( zero_count == 2 ) {
-            if ( buffer[pos] == 0x03 ) {
-                pos ++;
-                zero_count = 0;
-                continue;
-            }
-            if ( buffer[pos] <= 0x01 ) {
-                if ( start_code ) {
-                    *rbsp_length -= 2;
-                    pos -= 2;
-                    return pos;
-                }
-            }
-            zero_count = 0;
-        }
-        zero_count ++;
-        if ( buffer[pos] != 0 )
-            zero_count = 0;
-
-        rbsp_bistream[(*rbsp_length)++] = buffer[pos++];
+    if (pos < (nal_len + sizeofNalLengthField)) {
+        *rbsp_length = rbsp_unescape(buffer + pos,
+                (nal_len + sizeofNalLengthField) - pos,
+                rbsp_bistream, rbsp_size, start_code, NULL);
     }
 
     return eRet;
@@ -369,64 +308,101 @@ bool H264_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
             size_of_nal_length_field);
 
     if ( false == extract_rbsp(buffer, buffer_length, size_of_nal_length_field,
-                m_rbspBytes, &numBytesInRBSP, &nal_unit) ) {
+                m_rbspBytes, STD_MIN(m_rbspSize, SLICE_HEADER_PEEK_SIZE),
+                &numBytesInRBSP, &nal_unit) ) {
         ALOGE("ERROR: In %s() - extract_rbsp() failed", __func__);
         isNewFrame = OMX_FALSE;
         eRet = false;
+        m_prv_nalu = nal_unit;
     } else {
-        nalu_type = nal_unit.nalu_type;
-        switch (nal_unit.nalu_type) {
-            case NALU_TYPE_IDR:
-            case NALU_TYPE_NON_IDR: {
-                            ALOGV("AU Boundary with NAL type %d ",nal_unit.nalu_type);
-                            if (m_forceToStichNextNAL) {
-                                isNewFrame = OMX_FALSE;
-                            } else {
-                                RbspParser rbsp_parser(m_rbspBytes, (m_rbspBytes+numBytesInRBSP));
-                                first_mb_in_slice = rbsp_parser.ue();
-
-                                if ((!first_mb_in_slice) || /*(slice.prv_frame_num != slice.frame_num ) ||*/
-                                        ( (m_prv_nalu.nal_ref_idc != nal_unit.nal_ref_idc) && ( nal_unit.nal_ref_idc * m_prv_nalu.nal_ref_idc == 0 ) ) ||
-                                        /*( ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) && (nal_unit.nalu_type == NALU_TYPE_IDR)) && (slice.idr_pic_id != slice.prv_idr_pic_id) ) || */
-                                        ( (m_prv_nalu.nalu_type != nal_unit.nalu_type ) && ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) || (nal_unit.nalu_type == NALU_TYPE_IDR)) ) ) {
-                                    //ALOGV("Found a New Frame due to NALU_TYPE_IDR/NALU_TYPE_NON_IDR");
-                                    isNewFrame = OMX_TRUE;
-                                } else {
-                                    isNewFrame = OMX_FALSE;
-                                }
-                            }
-                            m_au_data = true;
-                            m_forceToStichNextNAL = false;
-                            break;
-                        }
-            case NALU_TYPE_SPS:
-            case NALU_TYPE_PPS:
-            case NALU_TYPE_SEI: {
-                            ALOGV("Non-AU boundary with NAL type %d", nal_unit.nalu_type);
-                            if (m_au_data) {
+        if ((nal_unit.nalu_type == NALU_TYPE_IDR ||
+                    nal_unit.nalu_type == NALU_TYPE_NON_IDR) &&
+                !m_forceToStichNextNAL) {
+            RbspParser rbsp_parser(m_rbspBytes, (m_rbspBytes+numBytesInRBSP));
+            first_mb_in_slice = rbsp_parser.ue();
+        }
+        check_new_frame(nal_unit, !first_mb_in_slice, isNewFrame);
+    }
+    return eRet;
+}
+
+/*===========================================================================
+FUNCTION:
+H264_Utils::isNewFrame
+
+DESCRIPTION:
+Same as above for a NAL that has already been located by nal_index, the
+decision is taken from the indexed header fields without touching the
+bitstream again.
+===========================================================================*/
+bool H264_Utils::isNewFrame(const nal_record *nal,
+        OMX_OUT OMX_BOOL &isNewFrame)
+{
+    NALU nal_unit;
+
+    if (!nal) {
+        isNewFrame = OMX_FALSE;
+        return false;
+    }
+
+    nal_unit.forbidden_zero_bit = 0;
+    nal_unit.nal_ref_idc = nal->nal_ref_idc;
+    nal_unit.nalu_type = nal->nal_unit_type;
+    check_new_frame(nal_unit, nal->first_slice, isNewFrame);
+    return true;
+}
+
+void H264_Utils::check_new_frame(const NALU &nal_unit, bool first_mb,
+        OMX_OUT OMX_BOOL &isNewFrame)
+{
+    nalu_type = nal_unit.nalu_type;
+    switch (nal_unit.nalu_type) {
+        case NALU_TYPE_IDR:
+        case NALU_TYPE_NON_IDR: {
+                        ALOGV("AU Boundary with NAL type %d ",nal_unit.nalu_type);
+                        if (m_forceToStichNextNAL) {
+                            isNewFrame = OMX_FALSE;
+                        } else {
+                            if ((first_mb) || /*(slice.prv_frame_num != slice.frame_num ) ||*/
+                                    ( (m_prv_nalu.nal_ref_idc != nal_unit.nal_ref_idc) && ( nal_unit.nal_ref_idc * m_prv_nalu.nal_ref_idc == 0 ) ) ||
+                                    /*( ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) && (nal_unit.nalu_type == NALU_TYPE_IDR)) && (slice.idr_pic_id != slice.prv_idr_pic_id) ) || */
+                                    ( (m_prv_nalu.nalu_type != nal_unit.nalu_type ) && ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) || (nal_unit.nalu_type == NALU_TYPE_IDR)) ) ) {
+                                //ALOGV("Found a New Frame due to NALU_TYPE_IDR/NALU_TYPE_NON_IDR");
                                 isNewFrame = OMX_TRUE;
-                                m_au_data = false;
                             } else {
-                                isNewFrame =  OMX_FALSE;
+                                isNewFrame = OMX_FALSE;
                             }
-
-                            m_forceToStichNextNAL = true;
-                            break;
                         }
-            case NALU_TYPE_ACCESS_DELIM:
-            case NALU_TYPE_UNSPECIFIED:
-            case NALU_TYPE_EOSEQ:
-            case NALU_TYPE_EOSTREAM:
-            default: {
-                     isNewFrame =  OMX_FALSE;
-                     // Do not update m_forceToStichNextNAL
-                     break;
-                 }
-        } // end of switch
-    } // end of if
+                        m_au_data = true;
+                        m_forceToStichNextNAL = false;
+                        break;
+                    }
+        case NALU_TYPE_SPS:
+        case NALU_TYPE_PPS:
+        case NALU_TYPE_SEI: {
+                        ALOGV("Non-AU boundary with NAL type %d", nal_unit.nalu_type);
+                        if (m_au_data) {
+                            isNewFrame = OMX_TRUE;
+                            m_au_data = false;
+                        } else {
+                            isNewFrame =  OMX_FALSE;
+                        }
+
+                        m_forceToStichNextNAL = true;
+                        break;
+                    }
+        case NALU_TYPE_ACCESS_DELIM:
+        case NALU_TYPE_UNSPECIFIED:
+        case NALU_TYPE_EOSEQ:
+        case NALU_TYPE_EOSTREAM:
+        default: {
+                 isNewFrame =  OMX_FALSE;
+                 // Do not update m_forceToStichNextNAL
+                 break;
+             }
+    } // end of switch
     m_prv_nalu = nal_unit;
     ALOGV("get_h264_nal_type - newFrame value %d",isNewFrame);
-    return eRet;
 }
 
 void perf_metrics::start()
@@ -476,6 +452,10 @@ OMX_U64 perf_metrics::processing_time_us()
 
 h264_stream_parser::h264_stream_parser()
 {
+    sei_payload_mask = SEI_PAYLOAD_BIT(BUFFERING_PERIOD) |
+        SEI_PAYLOAD_BIT(PIC_TIMING) |
+        SEI_PAYLOAD_BIT(PAN_SCAN_RECT) |
+        SEI_PAYLOAD_BIT(SEI_PAYLOAD_FRAME_PACKING_ARRANGEMENT);
     reset();
 #ifdef PANSCAN_HDLR
     panscan_hdl = new panscan_handler();
@@ -504,13 +484,10 @@ h264_stream_parser::~h264_stream_parser()
 
 void h264_stream_parser::reset()
 {
-    curr_32_bit = 0;
-    bits_read = 0;
-    zero_cntr = 0;
-    emulation_code_skip_cntr = 0;
     emulation_sc_enabled = true;
-    bitstream = NULL;
-    bitstream_bytes = 0;
+    bits.init(NULL, 0);
+    sei_miss_count = 0;
+    sei_skip = false;
     memset(&vui_param, 0, sizeof(vui_param));
     vui_param.fixed_fps_prev_ts = LLONG_MAX;
     memset(&sei_buf_period, 0, sizeof(sei_buf_period));
@@ -518,16 +495,20 @@ void h264_stream_parser::reset()
     memset(&frame_packing_arrangement,0,sizeof(frame_packing_arrangement));
     frame_packing_arrangement.cancel_flag = 1;
     mbaff_flag = 0;
+    pic_width = 0;
+    pic_height = 0;
 }
 
 void h264_stream_parser::init_bitstream(OMX_U8* data, OMX_U32 size)
 {
-    bitstream = data;
-    bitstream_bytes = size;
-    curr_32_bit = 0;
-    bits_read = 0;
-    zero_cntr = 0;
-    emulation_code_skip_cntr = 0;
+    bits.init(data, size, emulation_sc_enabled);
+}
+
+void h264_stream_parser::set_sei_payload_mask(OMX_U64 mask)
+{
+    sei_payload_mask = mask;
+    sei_miss_count = 0;
+    sei_skip = false;
 }
 
 void h264_stream_parser::parse_vui(bool vui_in_extradata)
@@ -721,27 +702,29 @@ void h264_stream_parser::hrd_parameters(h264_hrd_param *hrd_param)
 
 void h264_stream_parser::parse_sei()
 {
-    OMX_U32 value = 0, processed_bytes = 0;
-    OMX_U8 *sei_msg_start = bitstream;
-    OMX_U32 sei_unit_size = bitstream_bytes;
-    ALOGV("@@parse_sei: IN sei_unit_size(%u)", sei_unit_size);
-    while ((processed_bytes + 2) < sei_unit_size && more_bits()) {
-        init_bitstream(sei_msg_start + processed_bytes, sei_unit_size - processed_bytes);
+    OMX_U32 value = 0;
+    bool wanted_found = false;
+    ALOGV("@@parse_sei: IN sei_unit_size(%u)", bits.bytes_left());
+    while (bits.bytes_left() > 2) {
         ALOGV("-->NALU_TYPE_SEI");
-        OMX_U32 payload_type = 0, payload_size = 0, aux = 0;
+        OMX_U32 payload_type = 0, payload_size = 0;
         do {
             value = extract_bits(8);
             payload_type += value;
-            processed_bytes++;
-        } while (value == 0xFF);
+        } while (value == 0xFF && !bits.overrun());
         ALOGV("-->payload_type   : %u", payload_type);
         do {
             value = extract_bits(8);
             payload_size += value;
-            processed_bytes++;
-        } while (value == 0xFF);
+        } while (value == 0xFF && !bits.overrun());
         ALOGV("-->payload_size   : %u", payload_size);
-        if (payload_size > 0) {
+        if (bits.overrun())
+            break;
+        if (payload_size > 0 && (sei_payload_mask & SEI_PAYLOAD_BIT(payload_type))) {
+            /* Payload parsers may stop short of or run past payload_size,
+               the next message is always found from the payload start */
+            bit_reader payload = bits;
+            wanted_found = true;
             switch (payload_type) {
                 case BUFFERING_PERIOD:
                     sei_buffering_period();
@@ -758,9 +741,16 @@ void h264_stream_parser::parse_sei()
                 default:
                     ALOGV("-->SEI payload type [%u] not implemented! size[%u]", payload_type, payload_size);
             }
+            bits = payload;
         }
-        processed_bytes += (payload_size + emulation_code_skip_cntr);
-        ALOGV("-->SEI processed_bytes[%u]", processed_bytes);
+        bits.skip_bytes(payload_size);
+    }
+    if (wanted_found) {
+        sei_miss_count = 0;
+    } else if (++sei_miss_count >= SEI_MISS_LIMIT) {
+        ALOGV("-->No SEI of interest in %u NALs, skipping SEI until next SPS",
+                sei_miss_count);
+        sei_skip = true;
     }
     ALOGV("@@parse_sei: OUT");
 }
@@ -906,7 +896,7 @@ void h264_stream_parser::sei_pan_scan()
 #ifdef _ANDROID_
     char property_value[PROPERTY_VALUE_MAX] = {0};
     OMX_S32 enable_panscan_log = 0;
-    property_get("vidc.dec.debug.panframedata", property_value, "0");
+    vidc_props::get("vidc.dec.debug.panframedata", property_value, "0");
     enable_panscan_log = atoi(property_value);
 #endif
 #ifdef PANSCAN_HDLR
@@ -983,7 +973,13 @@ void h264_stream_parser::print_pan_data(h264_pan_scan *pan_scan_param)
 void h264_stream_parser::parse_sps()
 {
     OMX_U32 value = 0, scaling_matrix_limit;
+    OMX_U32 chroma_format_idc = 1, width_mbs, height_map_units;
+    OMX_U32 crop_unit_x, crop_unit_y, frame_mbs_only;
+    OMX_U32 crop_left = 0, crop_right = 0, crop_top = 0, crop_bot = 0;
     ALOGV("@@parse_sps: IN");
+    /* A new sequence may carry SEI that the previous one did not */
+    sei_miss_count = 0;
+    sei_skip = false;
     value = extract_bits(8); //profile_idc
     profile = value;
     extract_bits(8); //constraint flags and reserved bits
@@ -991,8 +987,10 @@ void h264_stream_parser::parse_sps()
     uev(); //sps id
     if (value == 100 || value == 110 || value == 122 || value == 244 ||
             value ==  44 || value ==  83 || value ==  86 || value == 118) {
-        if (uev() == 3) { //chroma_format_idc
-            extract_bits(1); //separate_colour_plane_flag
+        chroma_format_idc = uev();
+        if (chroma_format_idc == 3) {
+            if (extract_bits(1)) //separate_colour_plane_flag
+                chroma_format_idc = 0; //ChromaArrayType
             scaling_matrix_limit = 12;
         } else
             scaling_matrix_limit = 12;
@@ -1024,16 +1022,33 @@ void h264_stream_parser::parse_sps()
     }
     uev(); //max_num_ref_frames
     extract_bits(1); //gaps_in_frame_num_value_allowed_flag
-    value = uev(); //pic_width_in_mbs_minus1
-    value = uev(); //pic_height_in_map_units_minus1
-    if (!extract_bits(1)) //frame_mbs_only_flag
+    width_mbs = uev() + 1; //pic_width_in_mbs_minus1
+    height_map_units = uev() + 1; //pic_height_in_map_units_minus1
+    frame_mbs_only = extract_bits(1); //frame_mbs_only_flag
+    if (!frame_mbs_only)
         mbaff_flag = extract_bits(1); //mb_adaptive_frame_field_flag
     extract_bits(1); //direct_8x8_inference_flag
     if (extract_bits(1)) { //frame_cropping_flag
-        uev(); //frame_crop_left_offset
-        uev(); //frame_crop_right_offset
-        uev(); //frame_crop_top_offset
-        uev(); //frame_crop_bottom_offset
+        crop_left = uev(); //frame_crop_left_offset
+        crop_right = uev(); //frame_crop_right_offset
+        crop_top = uev(); //frame_crop_top_offset
+        crop_bot = uev(); //frame_crop_bottom_offset
+    }
+
+    /* Display size as per 7.4.2.1.1, frame_crop offsets are in chroma units */
+    crop_unit_x = (chroma_format_idc == 1 || chroma_format_idc == 2) ? 2 : 1;
+    crop_unit_y = ((chroma_format_idc == 1) ? 2 : 1) * (2 - frame_mbs_only);
+    pic_width = width_mbs * 16;
+    pic_height = height_map_units * 16 * (2 - frame_mbs_only);
+    if (bits.overrun() ||
+            width_mbs > H264_MAX_WIDTH_MBS || height_map_units > H264_MAX_WIDTH_MBS ||
+            ((OMX_U64)crop_left + crop_right) * crop_unit_x >= pic_width ||
+            ((OMX_U64)crop_top + crop_bot) * crop_unit_y >= pic_height) {
+        ALOGE("parse_sps: invalid picture size %ux%u", pic_width, pic_height);
+        pic_width = pic_height = 0;
+    } else {
+        pic_width -= (crop_left + crop_right) * crop_unit_x;
+        pic_height -= (crop_top + crop_bot) * crop_unit_y;
     }
     if (extract_bits(1)) //vui_parameters_present_flag
         parse_vui(false);
@@ -1054,72 +1069,26 @@ void h264_stream_parser::scaling_list(OMX_U32 size_of_scaling_list)
 
 OMX_U32 h264_stream_parser::extract_bits(OMX_U32 n)
 {
-    OMX_U32 value = 0;
     if (n > 32) {
         ALOGE("ERROR: extract_bits limit to 32 bits!");
-        return value;
-    }
-    value = curr_32_bit >> (32 - n);
-    if (bits_read < n) {
-        n -= bits_read;
-        read_word();
-        value |= (curr_32_bit >> (32 - n));
-        if (bits_read < n) {
-            ALOGV("ERROR: extract_bits underflow!");
-            value >>= (n - bits_read);
-            n = bits_read;
-        }
-    }
-    bits_read -= n;
-    curr_32_bit <<= n;
-    return value;
-}
-
-void h264_stream_parser::read_word()
-{
-    curr_32_bit = 0;
-    bits_read = 0;
-    while (bitstream_bytes && bits_read < 32) {
-        if (*bitstream == EMULATION_PREVENTION_THREE_BYTE &&
-                zero_cntr >= 2 && emulation_sc_enabled) {
-            ALOGV("EMULATION_PREVENTION_THREE_BYTE: Skip 0x03 byte aligned!");
-            emulation_code_skip_cntr++;
-        } else {
-            curr_32_bit <<= 8;
-            curr_32_bit |= *bitstream;
-            bits_read += 8;
-        }
-        if (*bitstream == 0)
-            zero_cntr++;
-        else
-            zero_cntr = 0;
-        bitstream++;
-        bitstream_bytes--;
+        return 0;
     }
-    curr_32_bit <<= (32 - bits_read);
+    return bits.u(n);
 }
 
 OMX_U32 h264_stream_parser::uev()
 {
-    OMX_U32 lead_zero_bits = 0, code_num = 0;
-    while (!extract_bits(1) && more_bits())
-        lead_zero_bits++;
-    code_num = lead_zero_bits == 0 ? 0 :
-        (1 << lead_zero_bits) - 1 + extract_bits(lead_zero_bits);
-    return code_num;
+    return bits.ue();
 }
 
 bool h264_stream_parser::more_bits()
 {
-    return (bitstream_bytes > 0 || bits_read > 0);
+    return bits.more_bits();
 }
 
 OMX_S32 h264_stream_parser::sev()
 {
-    OMX_U32 code_num = uev();
-    OMX_S32 ret;
-    ret = (code_num + 1) >> 1;
-    return ((code_num & 1) ? ret : -ret);
+    return bits.se();
 }
 
 OMX_S32 h264_stream_parser::iv(OMX_U32 n_bits)
@@ -1164,6 +1133,15 @@ OMX_U32 h264_stream_parser::get_profile()
     return profile;
 }
 
+bool h264_stream_parser::get_resolution(OMX_U32 *width, OMX_U32 *height)
+{
+    if (!pic_width || !pic_height)
+        return false;
+    *width = pic_width;
+    *height = pic_height;
+    return true;
+}
+
 OMX_S64 h264_stream_parser::calculate_buf_period_ts(OMX_S64 timestamp)
 {
     OMX_S64 clock_ts = timestamp;
@@ -1195,7 +1173,7 @@ void h264_stream_parser::parse_frame_pack()
     char property_value[PROPERTY_VALUE_MAX] = {0};
     OMX_S32 enable_framepack_log = 0;
 
-    property_get("vidc.dec.debug.panframedata", property_value, "0");
+    vidc_props::get("vidc.dec.debug.panframedata", property_value, "0");
     enable_framepack_log = atoi(property_value);
 #endif
     ALOGV("%s:%d parse_frame_pack", __func__, __LINE__);
@@ -1295,8 +1273,10 @@ void h264_stream_parser::parse_nal(OMX_U8* data_ptr, OMX_U32 data_len, OMX_U32 n
     ALOGV("parse_nal(): IN nal_type(%u)", nal_type);
     if (!data_len)
         return;
-    init_bitstream(data_ptr, data_len);
+    if (nal_type == NALU_TYPE_SEI && (sei_skip || !sei_payload_mask))
+        return;
     emulation_sc_enabled = enable_emu_sc;
+    init_bitstream(data_ptr, data_len);
     if (nal_type != NALU_TYPE_VUI) {
         cons_bytes = get_nal_unit_type(&nal_unit_type);
         if (nal_type != nal_unit_type && nal_type != NALU_TYPE_UNSPECIFIED) {
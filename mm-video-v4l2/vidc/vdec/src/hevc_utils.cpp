@@ -47,6 +47,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 ========================================================================== */
 #include "hevc_utils.h"
+#include "nal_index.h"
 #include "vidc_debug.h"
 #include <string.h>
 #include <stdlib.h>
@@ -131,7 +132,6 @@ bool HEVC_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
 {
     OMX_IN OMX_U8 *buffer = p_buf_hdr->pBuffer;
     OMX_IN OMX_U32 buffer_length = p_buf_hdr->nFilledLen;
-    byte bFirstSliceInPic = 0;
 
     byte coef1=1, coef2=0, coef3=0;
     uint32 pos = 0;
@@ -185,6 +185,33 @@ bool HEVC_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
 
     DEBUG_PRINT_LOW("@#@# Pos = %x NalType = %x buflen = %u", pos-1, nalu_type, (unsigned int) buffer_length);
 
+    //=== first_ctb_in_slice is only 1'b1  coded tree block
+    check_new_frame(pos + 2 < buffer_length && (buffer[pos+2] & 0x80), isNewFrame);
+    return true;
+}
+
+/*===========================================================================
+FUNCTION:
+HEVC_Utils::isNewFrame
+
+DESCRIPTION:
+Same as above for a NAL that has already been located by nal_index.
+===========================================================================*/
+bool HEVC_Utils::isNewFrame(const nal_record *nal,
+        OMX_OUT OMX_BOOL &isNewFrame)
+{
+    if (!nal) {
+        isNewFrame = OMX_FALSE;
+        return false;
+    }
+
+    nalu_type = nal->nal_unit_type;
+    check_new_frame(nal->first_slice, isNewFrame);
+    return true;
+}
+
+void HEVC_Utils::check_new_frame(bool first_slice, OMX_OUT OMX_BOOL &isNewFrame)
+{
     isNewFrame =  OMX_FALSE;
 
     if (nalu_type == NAL_UNIT_VPS ||
@@ -203,9 +230,7 @@ bool HEVC_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
         DEBUG_PRINT_LOW("AU Boundary with NAL type %d ", nalu_type);
 
         if (!m_forceToStichNextNAL) {
-            bFirstSliceInPic = ((buffer[pos+2] & 0x80)>>7);
-
-            if (bFirstSliceInPic) {    //=== first_ctb_in_slice is only 1'b1  coded tree block
+            if (first_slice) {
                 DEBUG_PRINT_LOW("Found a New Frame due to 1st coded tree block");
                 isNewFrame = OMX_TRUE;
             }
@@ -216,6 +241,101 @@ bool HEVC_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
     }
 
     DEBUG_PRINT_LOW("get_HEVC_nal_type - newFrame value %d",isNewFrame);
-    return true;
 }
 
+/*===========================================================================
+FUNCTION:
+HEVC_Utils::parse_sps
+
+DESCRIPTION:
+Parses an SPS up to the bit depths (7.3.2.2) and keeps it in the SPS table.
+The conformance window is converted to luma samples.
+
+INPUT/OUTPUT PARAMETERS:
+<In>
+nal : SPS NAL starting at the NAL unit header, without the start code
+size : NAL size in bytes
+
+RETURN VALUE:
+The stored SPS, NULL if the NAL is truncated or out of range
+
+SIDE EFFECTS:
+None.
+===========================================================================*/
+const HEVCParamNalu *HEVC_Utils::parse_sps(const OMX_U8 *nal, OMX_U32 size)
+{
+    HEVCParamNalu sps;
+    bit_reader bits(nal, size, true);
+    uint32 max_sub_layers_minus1, sub_layer_flags = 0;
+    uint32 sub_width = 1, sub_height = 1;
+
+    memset(&sps, 0, sizeof(sps));
+    if (((bits.u(16) >> 9) & 0x3f) != NAL_UNIT_SPS) {
+        return NULL;
+    }
+
+    sps.refSetID = bits.u(4); //sps_video_parameter_set_id
+    max_sub_layers_minus1 = bits.u(3);
+    bits.skip(1); //sps_temporal_id_nesting_flag
+
+    /* profile_tier_level(1, sps_max_sub_layers_minus1) */
+    bits.skip(88); //general profile space, tier, idc, compatibility and constraint flags
+    bits.skip(8); //general_level_idc
+    for (uint32 i = 0; i < max_sub_layers_minus1; i++) {
+        sub_layer_flags = (sub_layer_flags << 2) | bits.u(2);
+    }
+    if (max_sub_layers_minus1 > 0) {
+        bits.skip(2 * (8 - max_sub_layers_minus1)); //reserved_zero_2bits
+    }
+    for (uint32 i = 0; i < max_sub_layers_minus1; i++) {
+        uint32 flags = sub_layer_flags >> (2 * (max_sub_layers_minus1 - 1 - i));
+        if (flags & 0x2) {
+            bits.skip(88); //sub_layer profile
+        }
+        if (flags & 0x1) {
+            bits.skip(8); //sub_layer_level_idc
+        }
+    }
+
+    sps.paramSetID = bits.ue();
+    sps.chromaFormatIdc = bits.ue();
+    if (sps.chromaFormatIdc == 3 && bits.u(1)) { //separate_colour_plane_flag
+        sps.chromaFormatIdc = 0; //ChromaArrayType
+    }
+    sps.picWidthInLumaSamples = bits.ue();
+    sps.picHeightInLumaSamples = bits.ue();
+    if (bits.u(1)) { //conformance_window_flag
+        sps.crop_left = bits.ue();
+        sps.crop_right = bits.ue();
+        sps.crop_top = bits.ue();
+        sps.crop_bot = bits.ue();
+    }
+    sps.bitDepthLumaMinus8 = bits.ue();
+    sps.bitDepthChromaMinus8 = bits.ue();
+
+    if (sps.chromaFormatIdc == 1 || sps.chromaFormatIdc == 2) {
+        sub_width = 2;
+    }
+    if (sps.chromaFormatIdc == 1) {
+        sub_height = 2;
+    }
+    if (bits.overrun() || sps.paramSetID >= HEVC_MAX_SPS_COUNT ||
+            sps.chromaFormatIdc > 3 ||
+            sps.picWidthInLumaSamples > HEVC_MAX_PIC_SIZE ||
+            sps.picHeightInLumaSamples > HEVC_MAX_PIC_SIZE ||
+            ((uint64)sps.crop_left + sps.crop_right) * sub_width >= sps.picWidthInLumaSamples ||
+            ((uint64)sps.crop_top + sps.crop_bot) * sub_height >= sps.picHeightInLumaSamples) {
+        DEBUG_PRINT_ERROR("Invalid HEVC SPS, id %u size %ux%u", sps.paramSetID,
+                sps.picWidthInLumaSamples, sps.picHeightInLumaSamples);
+        return NULL;
+    }
+    sps.crop_left *= sub_width;
+    sps.crop_right *= sub_width;
+    sps.crop_top *= sub_height;
+    sps.crop_bot *= sub_height;
+
+    if (!store_sps(sps)) {
+        return NULL;
+    }
+    return find_sps(sps.paramSetID);
+}
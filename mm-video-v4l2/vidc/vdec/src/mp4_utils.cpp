@@ -49,19 +49,14 @@ MP4_Utils::~MP4_Utils()
 
 uint32 MP4_Utils::read_bit_field(posInfoType * posPtr, uint32 size)
 {
-    uint8 *bits = &posPtr->bytePtr[0];
-    uint32 bitBuf =
-        (bits[0] << 24) | (bits[1] << 16) | (bits[2] << 8) | bits[3];
-
-    uint32 value = (bitBuf >> (32 - posPtr->bitPos - size)) & MASK(size);
+    uint32 avail = (posPtr->endPtr > posPtr->bytePtr) ?
+        (uint32)(posPtr->endPtr - posPtr->bytePtr) : 0;
+    uint32 value = bits_read_at(posPtr->bytePtr, avail, posPtr->bitPos, size);
 
     /* Update the offset in preparation for next field    */
     posPtr->bitPos += size;
-
-    while (posPtr->bitPos >= 8) {
-        posPtr->bitPos -= 8;
-        posPtr->bytePtr++;
-    }
+    posPtr->bytePtr += posPtr->bitPos >> 3;
+    posPtr->bitPos &= 7;
 
     return value;
 }
@@ -88,6 +83,7 @@ bool MP4_Utils::parseHeader(mp4StreamType * psBits)
     uint8 VerID = 1; /* default value */
     long hxw = 0;
 
+    m_posInfo.endPtr = psBits->data + psBits->numBytes;
     m_posInfo.bitPos = 0;
     m_posInfo.bytePtr = psBits->data;
     m_dataBeginPtr = psBits->data;
@@ -0,0 +1,207 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2016, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "nal_index.h"
+#include "start_code_scan.h"
+#include "vidc_debug.h"
+
+#ifdef _ANDROID_
+extern "C" {
+#include<utils/Log.h>
+}
+#endif//_ANDROID_
+
+#define NAL_INDEX_INITIAL_SIZE 64
+
+nal_index::nal_index():
+    m_data(NULL),
+    m_records(NULL),
+    m_count(0),
+    m_capacity(0)
+{
+}
+
+nal_index::~nal_index()
+{
+    free(m_records);
+    m_records = NULL;
+}
+
+void nal_index::reset()
+{
+    m_data = NULL;
+    m_count = 0;
+}
+
+bool nal_index::grow()
+{
+    OMX_U32 capacity = m_capacity ? m_capacity * 2 : NAL_INDEX_INITIAL_SIZE;
+    nal_record *records = (nal_record *)realloc(m_records, capacity * sizeof(nal_record));
+
+    if (!records) {
+        DEBUG_PRINT_ERROR("nal_index: failed to grow to %u entries", (unsigned int)capacity);
+        return false;
+    }
+    m_records = records;
+    m_capacity = capacity;
+    return true;
+}
+
+/*
+ * Returns the number of records found or -1 on error. The table stays valid
+ * until the next build() and refers to the buffer memory, not a copy of it.
+ */
+int nal_index::build(OMX_BUFFERHEADERTYPE *buffer, codec_type codec)
+{
+    if (!buffer || !buffer->pBuffer) {
+        reset();
+        return -1;
+    }
+    return build(buffer->pBuffer + buffer->nOffset, buffer->nFilledLen, codec);
+}
+
+int nal_index::build(OMX_U8 *buf, OMX_U32 len, codec_type codec)
+{
+    OMX_U32 pos = 0;
+    nal_record *nal = NULL;
+
+    reset();
+    if (!buf) {
+        return -1;
+    }
+    m_data = buf;
+
+    while (pos + 3 <= len) {
+        OMX_U32 sc;
+
+        pos += sc_find_zero_pair(buf + pos, len - pos);
+        if (pos + 3 > len) {
+            break;
+        }
+        if (buf[pos + 2] != 0x01) {
+            pos++;
+            continue;
+        }
+
+        if (m_count == m_capacity && !grow()) {
+            return -1;
+        }
+
+        sc = (pos && !buf[pos - 1]) ? pos - 1 : pos;
+        if (m_count) {
+            m_records[m_count - 1].size = sc - m_records[m_count - 1].offset;
+        }
+
+        nal = &m_records[m_count++];
+        memset(nal, 0, sizeof(*nal));
+        nal->offset = sc;
+        nal->sc_size = pos + 3 - sc;
+        pos += 3;
+
+        if (pos >= len) {
+            break;
+        }
+        read_header(nal, buf + pos, len - pos, codec);
+    }
+
+    if (m_count) {
+        m_records[m_count - 1].size = len - m_records[m_count - 1].offset;
+    }
+
+    DEBUG_PRINT_LOW("nal_index: %u entries in %u bytes", (unsigned int)m_count, (unsigned int)len);
+    return m_count;
+}
+
+/*
+ * For a buffer holding a single unit, as h264_scratch does while access
+ * units are assembled. Only the start code and the header bytes are read.
+ */
+bool nal_index::peek(OMX_U8 *buf, OMX_U32 len, codec_type codec, nal_record *nal)
+{
+    OMX_U32 pos = 0;
+
+    if (!buf || !nal) {
+        return false;
+    }
+    while (pos < len && !buf[pos]) {
+        pos++;
+    }
+    if (pos < 2 || pos + 1 >= len || buf[pos] != 0x01) {
+        return false;
+    }
+
+    memset(nal, 0, sizeof(*nal));
+    nal->offset = 0;
+    nal->size = len;
+    nal->sc_size = pos + 1;
+    pos++;
+    read_header(nal, buf + pos, len - pos, codec);
+    return true;
+}
+
+void nal_index::read_header(nal_record *nal, OMX_U8 *hdr, OMX_U32 left, codec_type codec)
+{
+    switch (codec) {
+        case CODEC_TYPE_H264:
+            nal->nal_ref_idc = (hdr[0] & 0x60) >> 5;
+            nal->nal_unit_type = hdr[0] & 0x1F;
+            /*first_mb_in_slice is ue(v), a leading 1 bit means 0*/
+            if ((nal->nal_unit_type == NALU_TYPE_NON_IDR ||
+                        nal->nal_unit_type == NALU_TYPE_PARTITION_A ||
+                        nal->nal_unit_type == NALU_TYPE_IDR) && left > 1) {
+                nal->first_slice = (hdr[1] & 0x80) ? 1 : 0;
+            }
+            break;
+#ifdef _MSM8974_
+        case CODEC_TYPE_HEVC:
+            nal->nal_unit_type = (hdr[0] & 0x7E) >> 1;
+            /*VCL NAL units carry first_slice_segment_in_pic_flag*/
+            if (nal->nal_unit_type < 32 && left > 2) {
+                nal->first_slice = (hdr[2] & 0x80) ? 1 : 0;
+            }
+            break;
+#endif
+        default:
+            nal->nal_unit_type = hdr[0];
+            break;
+    }
+}
+
+const nal_record *nal_index::find(OMX_U32 nal_unit_type, OMX_U32 from) const
+{
+    for (OMX_U32 i = from; i < m_count; i++) {
+        if (m_records[i].nal_unit_type == nal_unit_type) {
+            return &m_records[i];
+        }
+    }
+    return NULL;
+}
@@ -135,20 +135,171 @@ extern "C" {
 static OMX_U32 maxSmoothStreamingWidth = 1920;
 static OMX_U32 maxSmoothStreamingHeight = 1088;
 
-void* async_message_thread (void *input)
+/*
+ * Dequeues everything the driver has signalled in revents and hands it to
+ * async_message_process. Returns -1 once the driver session is closed or
+ * cannot be serviced any more.
+ */
+static int dec_process_driver_events(omx_vdec *omx, int fd, short revents)
 {
-    OMX_BUFFERHEADERTYPE *buffer;
     struct v4l2_plane plane[VIDEO_MAX_PLANES];
-    struct pollfd pfd;
     struct v4l2_buffer v4l2_buf;
-    memset((void *)&v4l2_buf,0,sizeof(v4l2_buf));
     struct v4l2_event dqevent;
+
+    memset((void *)&v4l2_buf,0,sizeof(v4l2_buf));
+    if ((revents & POLLIN) || (revents & POLLRDNORM)) {
+        struct vdec_msginfo vdec_msg;
+        memset(&vdec_msg, 0, sizeof(vdec_msg));
+        v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        v4l2_buf.memory = V4L2_MEMORY_USERPTR;
+        v4l2_buf.length = omx->drv_ctx.num_planes;
+        v4l2_buf.m.planes = plane;
+        while (!ioctl(fd, VIDIOC_DQBUF, &v4l2_buf)) {
+            vdec_msg.msgcode=VDEC_MSG_RESP_OUTPUT_BUFFER_DONE;
+            vdec_msg.status_code=VDEC_S_SUCCESS;
+            vdec_msg.msgdata.output_frame.client_data=(void*)&v4l2_buf;
+            vdec_msg.msgdata.output_frame.len=plane[0].bytesused;
+            vdec_msg.msgdata.output_frame.bufferaddr=(void*)plane[0].m.userptr;
+            vdec_msg.msgdata.output_frame.time_stamp= ((uint64_t)v4l2_buf.timestamp.tv_sec * (uint64_t)1000000) +
+                (uint64_t)v4l2_buf.timestamp.tv_usec;
+            if (vdec_msg.msgdata.output_frame.len) {
+                vdec_msg.msgdata.output_frame.framesize.left = plane[0].reserved[2];
+                vdec_msg.msgdata.output_frame.framesize.top = plane[0].reserved[3];
+                vdec_msg.msgdata.output_frame.framesize.right = plane[0].reserved[4];
+                vdec_msg.msgdata.output_frame.framesize.bottom = plane[0].reserved[5];
+                vdec_msg.msgdata.output_frame.picsize.frame_width = plane[0].reserved[6];
+                vdec_msg.msgdata.output_frame.picsize.frame_height = plane[0].reserved[7];
+            }
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exited");
+                break;
+            }
+        }
+    }
+    if ((revents & POLLOUT) || (revents & POLLWRNORM)) {
+        struct vdec_msginfo vdec_msg;
+        v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        v4l2_buf.memory = V4L2_MEMORY_USERPTR;
+        v4l2_buf.length = 1;
+        v4l2_buf.m.planes = plane;
+        while (!ioctl(fd, VIDIOC_DQBUF, &v4l2_buf)) {
+            vdec_msg.msgcode=VDEC_MSG_RESP_INPUT_BUFFER_DONE;
+            vdec_msg.status_code=VDEC_S_SUCCESS;
+            vdec_msg.msgdata.input_frame_clientdata=(void*)&v4l2_buf;
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exited");
+                break;
+            }
+        }
+    }
+    if (revents & POLLPRI) {
+        ioctl(fd, VIDIOC_DQEVENT, &dqevent);
+        if (dqevent.type == V4L2_EVENT_MSM_VIDC_PORT_SETTINGS_CHANGED_INSUFFICIENT ) {
+            struct vdec_msginfo vdec_msg;
+            unsigned int *ptr = (unsigned int *)(void *)dqevent.u.data;
+
+            vdec_msg.msgcode=VDEC_MSG_EVT_CONFIG_CHANGED;
+            vdec_msg.status_code=VDEC_S_SUCCESS;
+            vdec_msg.msgdata.output_frame.picsize.frame_height = ptr[0];
+            vdec_msg.msgdata.output_frame.picsize.frame_width = ptr[1];
+            DEBUG_PRINT_HIGH("VIDC Port Reconfig recieved insufficient");
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exited");
+                return -1;
+            }
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_FLUSH_DONE) {
+            struct vdec_msginfo vdec_msg;
+            vdec_msg.msgcode=VDEC_MSG_RESP_FLUSH_INPUT_DONE;
+            vdec_msg.status_code=VDEC_S_SUCCESS;
+            DEBUG_PRINT_HIGH("VIDC Input Flush Done Recieved");
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exited");
+                return -1;
+            }
+            vdec_msg.msgcode=VDEC_MSG_RESP_FLUSH_OUTPUT_DONE;
+            vdec_msg.status_code=VDEC_S_SUCCESS;
+            DEBUG_PRINT_HIGH("VIDC Output Flush Done Recieved");
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exited");
+                return -1;
+            }
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_CLOSE_DONE) {
+            DEBUG_PRINT_HIGH("VIDC Close Done Recieved and async_message_thread Exited");
+            return -1;
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_HW_OVERLOAD) {
+            struct vdec_msginfo vdec_msg;
+            vdec_msg.msgcode=VDEC_MSG_EVT_HW_OVERLOAD;
+            vdec_msg.status_code=VDEC_S_SUCCESS;
+            DEBUG_PRINT_ERROR("HW Overload received");
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exited");
+                return -1;
+            }
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_HW_UNSUPPORTED) {
+            struct vdec_msginfo vdec_msg;
+            vdec_msg.msgcode=VDEC_MSG_EVT_HW_UNSUPPORTED;
+            vdec_msg.status_code=VDEC_S_SUCCESS;
+            DEBUG_PRINT_ERROR("HW Unsupported received");
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exited");
+                return -1;
+            }
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_SYS_ERROR) {
+            struct vdec_msginfo vdec_msg;
+            vdec_msg.msgcode = VDEC_MSG_EVT_HW_ERROR;
+            vdec_msg.status_code = VDEC_S_SUCCESS;
+            DEBUG_PRINT_HIGH("SYS Error Recieved");
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exited");
+                return -1;
+            }
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_RELEASE_BUFFER_REFERENCE) {
+            unsigned int *ptr = (unsigned int *)(void *)dqevent.u.data;
+
+            DEBUG_PRINT_LOW("REFERENCE RELEASE EVENT RECVD fd = %d offset = %d", ptr[0], ptr[1]);
+            omx->buf_ref_remove(ptr[0], ptr[1]);
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_RELEASE_UNQUEUED_BUFFER) {
+            unsigned int *ptr = (unsigned int *)(void *)dqevent.u.data;
+            struct vdec_msginfo vdec_msg;
+
+            DEBUG_PRINT_LOW("Release unqueued buffer event recvd fd = %d offset = %d", ptr[0], ptr[1]);
+
+            v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+            v4l2_buf.memory = V4L2_MEMORY_USERPTR;
+            v4l2_buf.length = omx->drv_ctx.num_planes;
+            v4l2_buf.m.planes = plane;
+            v4l2_buf.index = ptr[5];
+            v4l2_buf.flags = 0;
+
+            vdec_msg.msgcode = VDEC_MSG_RESP_OUTPUT_BUFFER_DONE;
+            vdec_msg.status_code = VDEC_S_SUCCESS;
+            vdec_msg.msgdata.output_frame.client_data = (void*)&v4l2_buf;
+            vdec_msg.msgdata.output_frame.len = 0;
+            vdec_msg.msgdata.output_frame.bufferaddr = (void*)(intptr_t)ptr[2];
+            vdec_msg.msgdata.output_frame.time_stamp = ((uint64_t)ptr[3] * (uint64_t)1000000) +
+                (uint64_t)ptr[4];
+            if (omx->async_message_process(omx,&vdec_msg) < 0) {
+                DEBUG_PRINT_HIGH("async_message_thread Exitedn");
+                return -1;
+            }
+        }
+        else {
+            DEBUG_PRINT_HIGH("VIDC Some Event recieved");
+        }
+    }
+    return 0;
+}
+
+void* async_message_thread (void *input)
+{
+    struct pollfd pfd;
     omx_vdec *omx = reinterpret_cast<omx_vdec*>(input);
     pfd.events = POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM | POLLRDBAND | POLLPRI;
     pfd.fd = omx->drv_ctx.video_driver_fd;
-    int error_code = 0,rc=0,bytes_read = 0,bytes_written = 0;
+    int rc = 0;
     DEBUG_PRINT_HIGH("omx_vdec: Async thread start");
     prctl(PR_SET_NAME, (unsigned long)"VideoDecCallBackThread", 0, 0, 0);
+    omx->m_thread_sched.attach(thread_sched::ROLE_CALLBACK);
     while (1) {
         rc = poll(&pfd, 1, POLL_TIMEOUT);
         if (!rc) {
@@ -158,148 +309,10 @@ void* async_message_thread (void *input)
             DEBUG_PRINT_ERROR("Error while polling: %d", rc);
             break;
         }
-        if ((pfd.revents & POLLIN) || (pfd.revents & POLLRDNORM)) {
-            struct vdec_msginfo vdec_msg;
-            memset(&vdec_msg, 0, sizeof(vdec_msg));
-            v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-            v4l2_buf.memory = V4L2_MEMORY_USERPTR;
-            v4l2_buf.length = omx->drv_ctx.num_planes;
-            v4l2_buf.m.planes = plane;
-            while (!ioctl(pfd.fd, VIDIOC_DQBUF, &v4l2_buf)) {
-                vdec_msg.msgcode=VDEC_MSG_RESP_OUTPUT_BUFFER_DONE;
-                vdec_msg.status_code=VDEC_S_SUCCESS;
-                vdec_msg.msgdata.output_frame.client_data=(void*)&v4l2_buf;
-                vdec_msg.msgdata.output_frame.len=plane[0].bytesused;
-                vdec_msg.msgdata.output_frame.bufferaddr=(void*)plane[0].m.userptr;
-                vdec_msg.msgdata.output_frame.time_stamp= ((uint64_t)v4l2_buf.timestamp.tv_sec * (uint64_t)1000000) +
-                    (uint64_t)v4l2_buf.timestamp.tv_usec;
-                if (vdec_msg.msgdata.output_frame.len) {
-                    vdec_msg.msgdata.output_frame.framesize.left = plane[0].reserved[2];
-                    vdec_msg.msgdata.output_frame.framesize.top = plane[0].reserved[3];
-                    vdec_msg.msgdata.output_frame.framesize.right = plane[0].reserved[4];
-                    vdec_msg.msgdata.output_frame.framesize.bottom = plane[0].reserved[5];
-                    vdec_msg.msgdata.output_frame.picsize.frame_width = plane[0].reserved[6];
-                    vdec_msg.msgdata.output_frame.picsize.frame_height = plane[0].reserved[7];
-                }
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exited");
-                    break;
-                }
-            }
-        }
-        if ((pfd.revents & POLLOUT) || (pfd.revents & POLLWRNORM)) {
-            struct vdec_msginfo vdec_msg;
-            v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-            v4l2_buf.memory = V4L2_MEMORY_USERPTR;
-            v4l2_buf.length = 1;
-            v4l2_buf.m.planes = plane;
-            while (!ioctl(pfd.fd, VIDIOC_DQBUF, &v4l2_buf)) {
-                vdec_msg.msgcode=VDEC_MSG_RESP_INPUT_BUFFER_DONE;
-                vdec_msg.status_code=VDEC_S_SUCCESS;
-                vdec_msg.msgdata.input_frame_clientdata=(void*)&v4l2_buf;
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exited");
-                    break;
-                }
-            }
-        }
-        if (pfd.revents & POLLPRI) {
-            rc = ioctl(pfd.fd, VIDIOC_DQEVENT, &dqevent);
-            if (dqevent.type == V4L2_EVENT_MSM_VIDC_PORT_SETTINGS_CHANGED_INSUFFICIENT ) {
-                struct vdec_msginfo vdec_msg;
-                unsigned int *ptr = (unsigned int *)(void *)dqevent.u.data;
-
-                vdec_msg.msgcode=VDEC_MSG_EVT_CONFIG_CHANGED;
-                vdec_msg.status_code=VDEC_S_SUCCESS;
-                vdec_msg.msgdata.output_frame.picsize.frame_height = ptr[0];
-                vdec_msg.msgdata.output_frame.picsize.frame_width = ptr[1];
-                DEBUG_PRINT_HIGH("VIDC Port Reconfig recieved insufficient");
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exited");
-                    break;
-                }
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_FLUSH_DONE) {
-                struct vdec_msginfo vdec_msg;
-                vdec_msg.msgcode=VDEC_MSG_RESP_FLUSH_INPUT_DONE;
-                vdec_msg.status_code=VDEC_S_SUCCESS;
-                DEBUG_PRINT_HIGH("VIDC Input Flush Done Recieved");
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exited");
-                    break;
-                }
-                vdec_msg.msgcode=VDEC_MSG_RESP_FLUSH_OUTPUT_DONE;
-                vdec_msg.status_code=VDEC_S_SUCCESS;
-                DEBUG_PRINT_HIGH("VIDC Output Flush Done Recieved");
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exited");
-                    break;
-                }
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_CLOSE_DONE) {
-                DEBUG_PRINT_HIGH("VIDC Close Done Recieved and async_message_thread Exited");
-                break;
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_HW_OVERLOAD) {
-                struct vdec_msginfo vdec_msg;
-                vdec_msg.msgcode=VDEC_MSG_EVT_HW_OVERLOAD;
-                vdec_msg.status_code=VDEC_S_SUCCESS;
-                DEBUG_PRINT_ERROR("HW Overload received");
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exited");
-                    break;
-                }
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_HW_UNSUPPORTED) {
-                struct vdec_msginfo vdec_msg;
-                vdec_msg.msgcode=VDEC_MSG_EVT_HW_UNSUPPORTED;
-                vdec_msg.status_code=VDEC_S_SUCCESS;
-                DEBUG_PRINT_ERROR("HW Unsupported received");
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exited");
-                    break;
-                }
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_SYS_ERROR) {
-                struct vdec_msginfo vdec_msg;
-                vdec_msg.msgcode = VDEC_MSG_EVT_HW_ERROR;
-                vdec_msg.status_code = VDEC_S_SUCCESS;
-                DEBUG_PRINT_HIGH("SYS Error Recieved");
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exited");
-                    break;
-                }
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_RELEASE_BUFFER_REFERENCE) {
-                unsigned int *ptr = (unsigned int *)(void *)dqevent.u.data;
-
-                DEBUG_PRINT_LOW("REFERENCE RELEASE EVENT RECVD fd = %d offset = %d", ptr[0], ptr[1]);
-                omx->buf_ref_remove(ptr[0], ptr[1]);
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_RELEASE_UNQUEUED_BUFFER) {
-                unsigned int *ptr = (unsigned int *)(void *)dqevent.u.data;
-                struct vdec_msginfo vdec_msg;
-
-                DEBUG_PRINT_LOW("Release unqueued buffer event recvd fd = %d offset = %d", ptr[0], ptr[1]);
-
-                v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-                v4l2_buf.memory = V4L2_MEMORY_USERPTR;
-                v4l2_buf.length = omx->drv_ctx.num_planes;
-                v4l2_buf.m.planes = plane;
-                v4l2_buf.index = ptr[5];
-                v4l2_buf.flags = 0;
-
-                vdec_msg.msgcode = VDEC_MSG_RESP_OUTPUT_BUFFER_DONE;
-                vdec_msg.status_code = VDEC_S_SUCCESS;
-                vdec_msg.msgdata.output_frame.client_data = (void*)&v4l2_buf;
-                vdec_msg.msgdata.output_frame.len = 0;
-                vdec_msg.msgdata.output_frame.bufferaddr = (void*)(intptr_t)ptr[2];
-                vdec_msg.msgdata.output_frame.time_stamp = ((uint64_t)ptr[3] * (uint64_t)1000000) +
-                    (uint64_t)ptr[4];
-                if (omx->async_message_process(input,&vdec_msg) < 0) {
-                    DEBUG_PRINT_HIGH("async_message_thread Exitedn");
-                    break;
-                }
-            }
-            else {
-                DEBUG_PRINT_HIGH("VIDC Some Event recieved");
-                continue;
-            }
-        }
+        if (dec_process_driver_events(omx, pfd.fd, pfd.revents) < 0)
+            break;
     }
+    omx->m_thread_sched.detach(thread_sched::ROLE_CALLBACK);
     DEBUG_PRINT_HIGH("omx_vdec: Async thread stop");
     return NULL;
 }
@@ -307,62 +320,118 @@ void* async_message_thread (void *input)
 void* dec_message_thread(void *input)
 {
     omx_vdec* omx = reinterpret_cast<omx_vdec*>(input);
-    unsigned char id;
-    int n;
-
-    fd_set readFds;
     int res = 0;
-    struct timeval tv;
 
     DEBUG_PRINT_HIGH("omx_vdec: message thread start");
     prctl(PR_SET_NAME, (unsigned long)"VideoDecMsgThread", 0, 0, 0);
+    omx->m_thread_sched.attach(thread_sched::ROLE_MESSAGE);
     while (!omx->message_thread_stop) {
-
-        tv.tv_sec = 2;
-        tv.tv_usec = 0;
-
-        FD_ZERO(&readFds);
-        FD_SET(omx->m_pipe_in, &readFds);
-
-        res = select(omx->m_pipe_in + 1, &readFds, NULL, NULL, &tv);
+        res = omx->m_msg_doorbell.wait(2000);
         if (res < 0) {
-             DEBUG_PRINT_ERROR("select() ERROR: %s", strerror(errno));
-             continue;
+            if (errno != EINTR) {
+                DEBUG_PRINT_ERROR("message doorbell ERROR: %s", strerror(errno));
+                break;
+            }
+            continue;
         } else if (res == 0 /*timeout*/ || omx->message_thread_stop) {
             continue;
         }
-        n = read(omx->m_pipe_in, &id, 1);
+        /* One ring covers every message posted so far, drain them all */
+        omx->process_event_cb(omx, 0);
+    }
+    omx->m_thread_sched.detach(thread_sched::ROLE_MESSAGE);
+    DEBUG_PRINT_HIGH("omx_vdec: message thread stop");
+    return 0;
+}
 
-        if (0 == n) {
-            break;
-        }
+/*
+ * Single thread alternative to async_message_thread + dec_message_thread,
+ * enabled with vidc.dec.event_loop. Driver buffers are dequeued and the
+ * resulting EBD/FBD messages are handed to the client in the same pass,
+ * without a thread hop in between.
+ */
+void* dec_event_loop(void *input)
+{
+    omx_vdec* omx = reinterpret_cast<omx_vdec*>(input);
+    struct pollfd pfd[2];
+    nfds_t nfds = 2;
+    int rc = 0;
 
-        if (1 == n) {
-            if (omx->omx_close_msg_thread(id)) {
+    pfd[0].fd = omx->m_msg_doorbell.fd();
+    pfd[0].events = POLLIN;
+    pfd[1].fd = omx->drv_ctx.video_driver_fd;
+    pfd[1].events = POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM | POLLRDBAND | POLLPRI;
+
+    DEBUG_PRINT_HIGH("omx_vdec: event loop start");
+    prctl(PR_SET_NAME, (unsigned long)"VideoDecEventLoop", 0, 0, 0);
+    /* Serves both roles, the message role settings apply */
+    omx->m_thread_sched.attach(thread_sched::ROLE_MESSAGE);
+    while (!omx->message_thread_stop) {
+        rc = poll(pfd, nfds, 2000);
+        if (rc < 0) {
+            if (errno != EINTR) {
+                DEBUG_PRINT_ERROR("event loop poll ERROR: %s", strerror(errno));
                 break;
             }
-            omx->process_event_cb(omx, id);
+            continue;
+        } else if (rc == 0 /*timeout*/ || omx->message_thread_stop) {
+            continue;
         }
-
-        if ((n < 0) && (errno != EINTR)) {
-            DEBUG_PRINT_LOW("ERROR: read from pipe failed, ret %d errno %d", n, errno);
-            break;
+        if (pfd[0].revents & POLLIN)
+            omx->m_msg_doorbell.take();
+        if (nfds > 1 && pfd[1].revents &&
+                dec_process_driver_events(omx, pfd[1].fd, pfd[1].revents) < 0) {
+            /* Session closed, keep serving commands until teardown */
+            DEBUG_PRINT_HIGH("omx_vdec: event loop stops polling the driver");
+            nfds = 1;
         }
+        omx->process_event_cb(omx, 0);
     }
-    DEBUG_PRINT_HIGH("omx_vdec: message thread stop");
+    omx->m_thread_sched.detach(thread_sched::ROLE_MESSAGE);
+    DEBUG_PRINT_HIGH("omx_vdec: event loop stop");
     return 0;
 }
 
+/* vidc.dec.worker_pool: the same drain, run on the shared pool */
+static void dec_message_work(void *input)
+{
+    omx_vdec* omx = reinterpret_cast<omx_vdec*>(input);
+
+    /* A flush waiting for CODEC CONFIG EBDs holds back every later message */
+    if (omx->resume_deferred_flush())
+        omx->process_event_cb(omx, 0);
+}
+
 void post_message(omx_vdec *omx, unsigned char id)
 {
-    int ret_value;
-    DEBUG_PRINT_LOW("omx_vdec: post_message %d pipe out%d", id,omx->m_pipe_out);
-    ret_value = write(omx->m_pipe_out, &id, 1);
-    if (ret_value <= 0) {
-        DEBUG_PRINT_ERROR("post_message to pipe failed : %s", strerror(errno));
-    } else {
-        DEBUG_PRINT_LOW("post_message to pipe done %d",ret_value);
-    }
+    DEBUG_PRINT_LOW("omx_vdec: post_message %d", id);
+    if (omx->m_msg_strand.is_open())
+        omx->m_msg_strand.post();
+    else
+        omx->m_msg_doorbell.ring();
+}
+
+static OMX_U64 startup_clock_us()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (OMX_U64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* Construction to the first Loaded-->Idle, in phases */
+void omx_vdec::startup_phase(const char *phase, bool last)
+{
+    OMX_U64 now;
+
+    if (!m_startup_mark)
+        return;
+    now = startup_clock_us();
+    if (perf_flag)
+        DEBUG_PRINT_HIGH("startup: %s took %llu us, %llu us since construction", phase,
+                (unsigned long long)(now - m_startup_mark),
+                (unsigned long long)(now - m_startup_begin));
+    m_startup_mark = last ? 0 : now;
 }
 
 // omx_cmd_queue destructor
@@ -426,89 +495,41 @@ unsigned omx_vdec::omx_cmd_queue::get_q_msg_type()
 #ifdef _ANDROID_
 omx_vdec::ts_arr_list::ts_arr_list()
 {
-    //initialize timestamps array
-    memset(m_ts_arr_list, 0, ( sizeof(ts_entry) * MAX_NUM_INPUT_OUTPUT_BUFFERS) );
 }
 omx_vdec::ts_arr_list::~ts_arr_list()
 {
-    //free m_ts_arr_list?
 }
 
 bool omx_vdec::ts_arr_list::insert_ts(OMX_TICKS ts)
 {
-    bool ret = true;
-    bool duplicate_ts = false;
-    int idx = 0;
-
-    //insert at the first available empty location
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-        if (!m_ts_arr_list[idx].valid) {
-            //found invalid or empty entry, save timestamp
-            m_ts_arr_list[idx].valid = true;
-            m_ts_arr_list[idx].timestamp = ts;
-            DEBUG_PRINT_LOW("Insert_ts(): Inserting TIMESTAMP (%lld) at idx (%d)",
-                    ts, idx);
-            break;
-        }
-    }
-
-    if (idx == MAX_NUM_INPUT_OUTPUT_BUFFERS) {
+    if (!m_ts_arr_list.push(ts)) {
         DEBUG_PRINT_LOW("Timestamp array list is FULL. Unsuccessful insert");
-        ret = false;
+        return false;
     }
-    return ret;
+    DEBUG_PRINT_LOW("Insert_ts(): Inserting TIMESTAMP (%lld), count (%u)",
+            ts, m_ts_arr_list.size());
+    return true;
 }
 
 bool omx_vdec::ts_arr_list::pop_min_ts(OMX_TICKS &ts)
 {
-    bool ret = true;
-    int min_idx = -1;
-    OMX_TICKS min_ts = 0;
-    int idx = 0;
-
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-
-        if (m_ts_arr_list[idx].valid) {
-            //found valid entry, save index
-            if (min_idx < 0) {
-                //first valid entry
-                min_ts = m_ts_arr_list[idx].timestamp;
-                min_idx = idx;
-            } else if (m_ts_arr_list[idx].timestamp < min_ts) {
-                min_ts = m_ts_arr_list[idx].timestamp;
-                min_idx = idx;
-            }
-        }
-
-    }
-
-    if (min_idx < 0) {
+    if (!m_ts_arr_list.pop(ts)) {
         //no valid entries found
         DEBUG_PRINT_LOW("Timestamp array list is empty. Unsuccessful pop");
         ts = 0;
-        ret = false;
-    } else {
-        ts = m_ts_arr_list[min_idx].timestamp;
-        m_ts_arr_list[min_idx].valid = false;
-        DEBUG_PRINT_LOW("Pop_min_ts:Timestamp (%lld), index(%d)",
-                ts, min_idx);
+        return false;
     }
-
-    return ret;
-
+    DEBUG_PRINT_LOW("Pop_min_ts:Timestamp (%lld), count(%u)",
+            ts, m_ts_arr_list.size());
+    return true;
 }
 
 
 bool omx_vdec::ts_arr_list::reset_ts_list()
 {
-    bool ret = true;
-    int idx = 0;
-
     DEBUG_PRINT_LOW("reset_ts_list(): Resetting timestamp array list");
-    for ( ; idx < MAX_NUM_INPUT_OUTPUT_BUFFERS; idx++) {
-        m_ts_arr_list[idx].valid = false;
-    }
-    return ret;
+    m_ts_arr_list.clear();
+    return true;
 }
 #endif
 
@@ -561,6 +582,11 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_pmem_info(NULL),
     h264_parser(NULL),
     arbitrary_bytes (true),
+    h264_scratch_mem (NULL),
+    m_scratch_in_place (false),
+    m_sg_assembly (true),
+    m_event_loop (false),
+    m_worker_pool (false),
     psource_frame (NULL),
     pdest_frame (NULL),
     m_inp_heap_ptr (NULL),
@@ -607,17 +633,19 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_buffer_error(false)
 {
     /* Assumption is that , to begin with , we have all the frames with decoder */
+    m_startup_begin = m_startup_mark = startup_clock_us();
     DEBUG_PRINT_HIGH("In %u bit OMX vdec Constructor", (unsigned int)sizeof(long) * 8);
     memset(&m_debug,0,sizeof(m_debug));
+    m_ion_pool = NULL;
 #ifdef _ANDROID_
     char property_value[PROPERTY_VALUE_MAX] = {0};
-    property_get("vidc.debug.level", property_value, "1");
+    vidc_props::get("vidc.debug.level", property_value, "1");
     debug_level = atoi(property_value);
     property_value[0] = '\0';
 
     DEBUG_PRINT_HIGH("In OMX vdec Constructor");
 
-    property_get("vidc.dec.debug.perf", property_value, "0");
+    vidc_props::get("vidc.dec.debug.perf", property_value, "0");
     perf_flag = atoi(property_value);
     if (perf_flag) {
         DEBUG_PRINT_HIGH("vidc.dec.debug.perf is %d", perf_flag);
@@ -626,7 +654,7 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     }
     prev_n_filled_len = 0;
     property_value[0] = '\0';
-    property_get("vidc.dec.debug.ts", property_value, "0");
+    vidc_props::get("vidc.dec.debug.ts", property_value, "0");
     m_debug_timestamp = atoi(property_value);
     DEBUG_PRINT_HIGH("vidc.dec.debug.ts value is %d",m_debug_timestamp);
     if (m_debug_timestamp) {
@@ -635,31 +663,31 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     }
 
     property_value[0] = '\0';
-    property_get("vidc.dec.debug.concealedmb", property_value, "0");
+    vidc_props::get("vidc.dec.debug.concealedmb", property_value, "0");
     m_debug_concealedmb = atoi(property_value);
     DEBUG_PRINT_HIGH("vidc.dec.debug.concealedmb value is %d",m_debug_concealedmb);
 
     property_value[0] = '\0';
-    property_get("vidc.dec.profile.check", property_value, "0");
+    vidc_props::get("vidc.dec.profile.check", property_value, "0");
     m_reject_avc_1080p_mp = atoi(property_value);
     DEBUG_PRINT_HIGH("vidc.dec.profile.check value is %d",m_reject_avc_1080p_mp);
 
     property_value[0] = '\0';
-    property_get("vidc.dec.log.in", property_value, "0");
+    vidc_props::get("vidc.dec.log.in", property_value, "0");
     m_debug.in_buffer_log = atoi(property_value);
 
     property_value[0] = '\0';
-    property_get("vidc.dec.log.out", property_value, "0");
+    vidc_props::get("vidc.dec.log.out", property_value, "0");
     m_debug.out_buffer_log = atoi(property_value);
     snprintf(m_debug.log_loc, PROPERTY_VALUE_MAX, "%s", BUFFER_LOG_LOC);
 
     property_value[0] = '\0';
-    property_get("vidc.log.loc", property_value, "");
+    vidc_props::get("vidc.log.loc", property_value, "");
     if (*property_value)
         strlcpy(m_debug.log_loc, property_value, PROPERTY_VALUE_MAX);
 
     property_value[0] = '\0';
-    property_get("vidc.dec.120fps.enabled", property_value, "0");
+    vidc_props::get("vidc.dec.120fps.enabled", property_value, "0");
 
     //if this feature is not enabled then reset this value -ve
     if(atoi(property_value)) {
@@ -668,10 +696,45 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     }
 
     property_value[0] = '\0';
-    property_get("vidc.dec.debug.dyn.disabled", property_value, "0");
+    vidc_props::get("vidc.dec.debug.dyn.disabled", property_value, "0");
     m_disable_dynamic_buf_mode = atoi(property_value);
     DEBUG_PRINT_HIGH("vidc.dec.debug.dyn.disabled value is %d",m_disable_dynamic_buf_mode);
 
+    property_value[0] = '\0';
+    vidc_props::get("vidc.dec.sg.assembly", property_value, "1");
+    m_sg_assembly = atoi(property_value);
+    DEBUG_PRINT_HIGH("vidc.dec.sg.assembly value is %d", m_sg_assembly);
+
+    property_value[0] = '\0';
+    vidc_props::get("vidc.dec.event_loop", property_value, "0");
+    m_event_loop = atoi(property_value);
+    DEBUG_PRINT_HIGH("vidc.dec.event_loop value is %d", m_event_loop);
+
+    property_value[0] = '\0';
+    vidc_props::get("vidc.dec.worker_pool", property_value, "0");
+    m_worker_pool = atoi(property_value);
+    DEBUG_PRINT_HIGH("vidc.dec.worker_pool value is %d", m_worker_pool);
+
+    m_thread_sched.load_properties("vidc.dec.sched");
+
+    property_value[0] = '\0';
+    vidc_props::get("vidc.dec.pixel_threads", property_value, "1");
+    if (atoi(property_value) > 1)
+        m_band_executor.open(atoi(property_value));
+
+    property_value[0] = '\0';
+    vidc_props::get("vidc.dec.ion_pool", property_value, "0");
+    if (atoi(property_value) > 0) {
+        if (vidc_props::get_int("vidc.dec.ion_pool.shared", 0)) {
+            m_ion_pool = ion_pool::shared();
+            m_ion_pool->raise_limit((size_t)atoi(property_value) << 20);
+        } else {
+            m_ion_pool = &m_own_ion_pool;
+            m_ion_pool->set_limit((size_t)atoi(property_value) << 20);
+        }
+        DEBUG_PRINT_HIGH("vidc.dec.ion_pool value is %d MB", atoi(property_value));
+    }
+
 #endif
     memset(&m_cmp,0,sizeof(m_cmp));
     memset(&m_cb,0,sizeof(m_cb));
@@ -705,18 +768,19 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     pthread_mutex_init(&buf_lock, NULL);
     sem_init(&m_cmd_lock,0,0);
     sem_init(&m_safe_flush, 0, 0);
+    m_deferred_flush_port = 0;
+    memset(&m_deferred_flush_deadline, 0, sizeof(m_deferred_flush_deadline));
     streaming[CAPTURE_PORT] =
         streaming[OUTPUT_PORT] = false;
 #ifdef _ANDROID_
     char extradata_value[PROPERTY_VALUE_MAX] = {0};
-    property_get("vidc.dec.debug.extradata", extradata_value, "0");
+    vidc_props::get("vidc.dec.debug.extradata", extradata_value, "0");
     m_debug_extradata = atoi(extradata_value);
     DEBUG_PRINT_HIGH("vidc.dec.debug.extradata value is %d",m_debug_extradata);
 #endif
     m_fill_output_msg = OMX_COMPONENT_GENERATE_FTB;
     client_buffers.set_vdec_client(this);
     dynamic_buf_mode = false;
-    out_dynamic_list = NULL;
     is_down_scalar_enabled = false;
     m_reconfig_height = 0;
     m_reconfig_width = 0;
@@ -724,6 +788,7 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_smoothstreaming_width = 0;
     m_smoothstreaming_height = 0;
     is_q6_platform = false;
+    m_driver_extradata = 0;
     m_perf_control.send_hint_to_mpctl(true);
     m_client_color_space.nPortIndex = (OMX_U32)OMX_CORE_INPUT_PORT_INDEX;
     m_client_color_space.sAspects.mRange =  ColorAspects::RangeUnspecified;
@@ -737,6 +802,18 @@ omx_vdec::omx_vdec(): m_error_propogated(false),
     m_internal_color_space.sAspects.mMatrixCoeffs = ColorAspects::MatrixUnspecified;
     m_internal_color_space.sAspects.mTransfer = ColorAspects::TransferUnspecified;
     m_internal_color_space.nSize = sizeof(DescribeColorAspectsParams);
+    startup_phase("constructor");
+}
+
+/* SEI payloads the H264 stream parser has to decode for the given extradata */
+static OMX_U64 sei_payload_mask(OMX_U32 extradata)
+{
+    OMX_U64 mask = 0;
+    if (extradata & OMX_TIMEINFO_EXTRADATA)
+        mask |= SEI_PAYLOAD_BIT(BUFFERING_PERIOD) | SEI_PAYLOAD_BIT(PIC_TIMING);
+    if (extradata & OMX_FRAMEINFO_EXTRADATA)
+        mask |= SEI_PAYLOAD_BIT(PAN_SCAN_RECT);
+    return mask;
 }
 
 static const int event_type[] = {
@@ -751,6 +828,8 @@ static const int event_type[] = {
     V4L2_EVENT_MSM_VIDC_HW_UNSUPPORTED
 };
 
+static OMX_ERRORTYPE unsubscribe_to_events(int fd);
+
 static OMX_ERRORTYPE subscribe_to_events(int fd)
 {
     OMX_ERRORTYPE eRet = OMX_ErrorNone;
@@ -772,13 +851,7 @@ static OMX_ERRORTYPE subscribe_to_events(int fd)
         }
     }
     if (i < array_sz) {
-        for (--i; i >=0 ; i--) {
-            memset(&sub, 0, sizeof(sub));
-            sub.type = event_type[i];
-            rc = ioctl(fd, VIDIOC_UNSUBSCRIBE_EVENT, &sub);
-            if (rc)
-                DEBUG_PRINT_ERROR("Failed to unsubscribe event: 0x%x", sub.type);
-        }
+        unsubscribe_to_events(fd);
         eRet = OMX_ErrorNotImplemented;
     }
     return eRet;
@@ -796,6 +869,12 @@ static OMX_ERRORTYPE unsubscribe_to_events(int fd)
         return OMX_ErrorBadParameter;
     }
 
+    /* One call drops them all, one per event only if the driver refuses */
+    memset(&sub, 0, sizeof(sub));
+    sub.type = V4L2_EVENT_ALL;
+    if (!ioctl(fd, VIDIOC_UNSUBSCRIBE_EVENT, &sub))
+        return eRet;
+
     for (i = 0; i < array_sz; ++i) {
         memset(&sub, 0, sizeof(sub));
         sub.type = event_type[i];
@@ -833,10 +912,8 @@ omx_vdec::~omx_vdec()
         DEBUG_PRINT_HIGH("Waiting on OMX Msg Thread exit");
         pthread_join(msg_thread_id,NULL);
     }
-    close(m_pipe_in);
-    close(m_pipe_out);
-    m_pipe_in = -1;
-    m_pipe_out = -1;
+    m_msg_strand.close();
+    m_msg_doorbell.close();
     DEBUG_PRINT_HIGH("Waiting on OMX Async Thread exit");
     dec.cmd = V4L2_DEC_CMD_STOP;
     if (drv_ctx.video_driver_fd >=0 ) {
@@ -1553,7 +1630,7 @@ void omx_vdec::process_event_cb(void *ctxt, unsigned char id)
         if (pThis->m_state != OMX_StatePause)
             qsize += (pThis->m_ftb_q.m_size + pThis->m_etb_q.m_size);
         pthread_mutex_unlock(&pThis->m_lock);
-    } while (qsize>0);
+    } while (qsize>0 && !BITMASK_PRESENT(&pThis->m_flags, OMX_COMPONENT_FLUSH_DEFERRED));
 
 }
 
@@ -1616,6 +1693,78 @@ OMX_ERRORTYPE omx_vdec::is_video_session_supported()
     return OMX_ErrorNone;
 }
 
+/*
+ * Sizes the output port from the SPS in codec config data. Only used while
+ * no output buffer is allocated, so that the client allocates buffers of the
+ * right size up front instead of going through an insufficient port settings
+ * change once the first frame reaches the driver.
+ */
+void omx_vdec::configure_output_from_sps(OMX_U8 *data, OMX_U32 len)
+{
+    const nal_record *nal = NULL;
+    OMX_U32 width = 0, height = 0;
+    OMX_U32 old_width = drv_ctx.video_resolution.frame_width;
+    OMX_U32 old_height = drv_ctx.video_resolution.frame_height;
+    OMX_U32 old_stride = drv_ctx.video_resolution.stride;
+    OMX_U32 old_scan_lines = drv_ctx.video_resolution.scan_lines;
+    struct v4l2_format fmt;
+
+    if (codec_type_parse == CODEC_TYPE_H264 && h264_parser) {
+        if (m_nal_index.build(data, len, CODEC_TYPE_H264) > 0)
+            nal = m_nal_index.find(NALU_TYPE_SPS);
+        if (!nal)
+            return;
+        h264_parser->parse_nal(m_nal_index.data(nal), nal->size, NALU_TYPE_SPS);
+        if (!h264_parser->get_resolution(&width, &height))
+            return;
+    } else if (codec_type_parse == CODEC_TYPE_HEVC) {
+        const HEVCParamNalu *sps = NULL;
+        if (m_nal_index.build(data, len, CODEC_TYPE_HEVC) > 0)
+            nal = m_nal_index.find(HEVC_Utils::NAL_UNIT_SPS);
+        if (nal && nal->size > nal->sc_size)
+            sps = m_hevc_utils.parse_sps(m_nal_index.data(nal) + nal->sc_size,
+                    nal->size - nal->sc_size);
+        if (!sps)
+            return;
+        width = sps->picWidthInLumaSamples - sps->crop_left - sps->crop_right;
+        height = sps->picHeightInLumaSamples - sps->crop_top - sps->crop_bot;
+    } else {
+        return;
+    }
+
+    if (width == old_width && height == old_height)
+        return;
+    if (m_smoothstreaming_mode &&
+            width <= m_smoothstreaming_width && height <= m_smoothstreaming_height) {
+        /* Buffers are already sized for the adaptive playback maximum */
+        return;
+    }
+
+    DEBUG_PRINT_HIGH("Configure output from SPS: WxH %ux%u -> %ux%u",
+            (unsigned int)old_width, (unsigned int)old_height,
+            (unsigned int)width, (unsigned int)height);
+    update_resolution(width, height, width, height);
+    if (is_video_session_supported() == OMX_ErrorNone) {
+        /* The bitstream queue has buffers by now, only the still empty
+           capture queue is reconfigured, as the output port definition does */
+        memset(&fmt, 0x0, sizeof(struct v4l2_format));
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        fmt.fmt.pix_mp.height = drv_ctx.video_resolution.frame_height;
+        fmt.fmt.pix_mp.width = drv_ctx.video_resolution.frame_width;
+        fmt.fmt.pix_mp.pixelformat = capture_capability;
+        if (!ioctl(drv_ctx.video_driver_fd, VIDIOC_S_FMT, &fmt)) {
+            if (!is_down_scalar_enabled && get_buffer_req(&drv_ctx.op_buf) != OMX_ErrorNone)
+                DEBUG_PRINT_ERROR("Configure output from SPS: get_buffer_req failed");
+            else if (!client_buffers.update_buffer_req())
+                DEBUG_PRINT_ERROR("Configure output from SPS: C2D buffer requirements failed");
+            return;
+        }
+        DEBUG_PRINT_ERROR("Configure output from SPS: set resolution failed");
+    }
+    /* Leave it to the driver to report the new resolution */
+    update_resolution(old_width, old_height, old_stride, old_scan_lines);
+}
+
 int omx_vdec::log_input_buffers(const char *buffer_addr, int buffer_len)
 {
     if (m_debug.in_buffer_log && !m_debug.infile) {
@@ -1787,14 +1936,13 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
     struct v4l2_fmtdesc fdesc;
     struct v4l2_format fmt;
     struct v4l2_requestbuffers bufreq;
-    struct v4l2_control control;
     struct v4l2_frmsizeenum frmsize;
     unsigned int   alignment = 0,buffer_size = 0;
-    int fds[2];
     int r,ret=0;
     bool codec_ambiguous = false;
     OMX_STRING device_name = (OMX_STRING)"/dev/video32";
     char property_value[PROPERTY_VALUE_MAX] = {0};
+    v4l2_ctrl_batch ctrls;
 
 #ifdef _ANDROID_
     char platform_name[PROPERTY_VALUE_MAX];
@@ -1820,7 +1968,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
      * Clients may configure OMX_QCOM_FramePacking_Arbitrary to enable this mode
      */
     arbitrary_bytes = false;
-    property_get("vidc.dec.debug.arbitrarybytes.mode", property_value, "0");
+    vidc_props::get("vidc.dec.debug.arbitrarybytes.mode", property_value, "0");
     if (atoi(property_value)) {
         DEBUG_PRINT_HIGH("arbitrary_bytes mode enabled via property command");
         arbitrary_bytes = true;
@@ -1877,7 +2025,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
     drv_ctx.frame_rate.fps_denominator = 1;
 
     ret = subscribe_to_events(drv_ctx.video_driver_fd);
-    if (!ret) {
+    if (!ret && !m_event_loop) {
         async_thread_created = true;
         ret = pthread_create(&async_thread_id,0,async_message_thread,this);
     }
@@ -1886,6 +2034,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         async_thread_created = false;
         return OMX_ErrorInsufficientResources;
     }
+    startup_phase("device open");
 
 #ifdef OUTPUT_EXTRADATA_LOG
     outputExtradataFile = fopen (output_extradata_filename, "ab");
@@ -2055,20 +2204,23 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
                     cap.bus_info, cap.version, cap.capabilities);
         }
         ret=0;
-        fdesc.type=V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-        fdesc.index=0;
-        while (ioctl(drv_ctx.video_driver_fd, VIDIOC_ENUM_FMT, &fdesc) == 0) {
-            DEBUG_PRINT_HIGH("fmt: description: %s, fmt: %x, flags = %x", fdesc.description,
-                    fdesc.pixelformat, fdesc.flags);
-            fdesc.index++;
-        }
-        fdesc.type=V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-        fdesc.index=0;
-        while (ioctl(drv_ctx.video_driver_fd, VIDIOC_ENUM_FMT, &fdesc) == 0) {
+        /* Only printed, skip the enumeration when nobody reads it */
+        if (debug_level & PRIO_HIGH) {
+            fdesc.type=V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+            fdesc.index=0;
+            while (ioctl(drv_ctx.video_driver_fd, VIDIOC_ENUM_FMT, &fdesc) == 0) {
+                DEBUG_PRINT_HIGH("fmt: description: %s, fmt: %x, flags = %x", fdesc.description,
+                        fdesc.pixelformat, fdesc.flags);
+                fdesc.index++;
+            }
+            fdesc.type=V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+            fdesc.index=0;
+            while (ioctl(drv_ctx.video_driver_fd, VIDIOC_ENUM_FMT, &fdesc) == 0) {
 
-            DEBUG_PRINT_HIGH("fmt: description: %s, fmt: %x, flags = %x", fdesc.description,
-                    fdesc.pixelformat, fdesc.flags);
-            fdesc.index++;
+                DEBUG_PRINT_HIGH("fmt: description: %s, fmt: %x, flags = %x", fdesc.description,
+                        fdesc.pixelformat, fdesc.flags);
+                fdesc.index++;
+            }
         }
         update_resolution(320, 240, 320, 240);
         fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
@@ -2084,35 +2236,25 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         DEBUG_PRINT_HIGH("Set Format was successful");
         if (codec_ambiguous) {
             if (output_capability == V4L2_PIX_FMT_DIVX) {
-                struct v4l2_control divx_ctrl;
+                int divx_format;
 
                 if (drv_ctx.decoder_format == VDEC_CODECTYPE_DIVX_4) {
-                    divx_ctrl.value = V4L2_MPEG_VIDC_VIDEO_DIVX_FORMAT_4;
+                    divx_format = V4L2_MPEG_VIDC_VIDEO_DIVX_FORMAT_4;
                 } else if (drv_ctx.decoder_format == VDEC_CODECTYPE_DIVX_5) {
-                    divx_ctrl.value = V4L2_MPEG_VIDC_VIDEO_DIVX_FORMAT_5;
+                    divx_format = V4L2_MPEG_VIDC_VIDEO_DIVX_FORMAT_5;
                 } else {
-                    divx_ctrl.value = V4L2_MPEG_VIDC_VIDEO_DIVX_FORMAT_6;
-                }
-
-                divx_ctrl.id = V4L2_CID_MPEG_VIDC_VIDEO_DIVX_FORMAT;
-                ret = ioctl(drv_ctx.video_driver_fd, VIDIOC_S_CTRL, &divx_ctrl);
-                if (ret) {
-                    DEBUG_PRINT_ERROR("Failed to set divx version");
+                    divx_format = V4L2_MPEG_VIDC_VIDEO_DIVX_FORMAT_6;
                 }
+                ctrls.stage(V4L2_CID_MPEG_VIDC_VIDEO_DIVX_FORMAT, divx_format);
             } else {
                 DEBUG_PRINT_ERROR("Codec should not be ambiguous");
             }
         }
 
-        property_get("persist.vidc.dec.conceal_color", property_value, DEFAULT_CONCEAL_COLOR);
+        vidc_props::get("persist.vidc.dec.conceal_color", property_value, DEFAULT_CONCEAL_COLOR);
         m_conceal_color= atoi(property_value);
         DEBUG_PRINT_HIGH("trying to set 0x%u as conceal color\n", (unsigned int)m_conceal_color);
-        control.id = V4L2_CID_MPEG_VIDC_VIDEO_CONCEAL_COLOR;
-        control.value = m_conceal_color;
-        ret = ioctl(drv_ctx.video_driver_fd, VIDIOC_S_CTRL, &control);
-        if (ret) {
-            DEBUG_PRINT_ERROR("Failed to set conceal color %d\n", ret);
-        }
+        ctrls.stage(V4L2_CID_MPEG_VIDC_VIDEO_CONCEAL_COLOR, m_conceal_color);
 
         //Get the hardware capabilities
         memset((void *)&frmsize,0,sizeof(frmsize));
@@ -2152,23 +2294,12 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
 
         DEBUG_PRINT_HIGH("Set Format was successful");
         if (secure_mode) {
-            control.id = V4L2_CID_MPEG_VIDC_VIDEO_SECURE;
-            control.value = 1;
-            DEBUG_PRINT_LOW("Omx_vdec:: calling to open secure device %d", ret);
-            ret=ioctl(drv_ctx.video_driver_fd, VIDIOC_S_CTRL,&control);
-            if (ret) {
-                DEBUG_PRINT_ERROR("Omx_vdec:: Unable to open secure device %d", ret);
-                return OMX_ErrorInsufficientResources;
-            }
+            DEBUG_PRINT_LOW("Omx_vdec:: calling to open secure device");
+            ctrls.stage(V4L2_CID_MPEG_VIDC_VIDEO_SECURE, 1);
         }
         if (output_capability == V4L2_PIX_FMT_H264_MVC) {
-            control.id = V4L2_CID_MPEG_VIDC_VIDEO_MVC_BUFFER_LAYOUT;
-            control.value = V4L2_MPEG_VIDC_VIDEO_MVC_TOP_BOTTOM;
-            ret = ioctl(drv_ctx.video_driver_fd, VIDIOC_S_CTRL, &control);
-            if (ret) {
-                DEBUG_PRINT_ERROR("Failed to set MVC buffer layout");
-                return OMX_ErrorInsufficientResources;
-            }
+            ctrls.stage(V4L2_CID_MPEG_VIDC_VIDEO_MVC_BUFFER_LAYOUT,
+                    V4L2_MPEG_VIDC_VIDEO_MVC_TOP_BOTTOM);
         }
 
         /*Get the Buffer requirements for input and output ports*/
@@ -2184,28 +2315,45 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         drv_ctx.interlace = VDEC_InterlaceFrameProgressive;
         drv_ctx.extradata = 0;
         drv_ctx.picture_order = VDEC_ORDER_DISPLAY;
-        control.id = V4L2_CID_MPEG_VIDC_VIDEO_OUTPUT_ORDER;
-        control.value = V4L2_MPEG_VIDC_VIDEO_OUTPUT_ORDER_DISPLAY;
-        ret = ioctl(drv_ctx.video_driver_fd, VIDIOC_S_CTRL, &control);
+        ctrls.stage(V4L2_CID_MPEG_VIDC_VIDEO_OUTPUT_ORDER,
+                V4L2_MPEG_VIDC_VIDEO_OUTPUT_ORDER_DISPLAY);
         drv_ctx.idr_only_decoding = 0;
 
-        property_get("vidc.debug.turbo", property_value, "0");
+        vidc_props::get("vidc.debug.turbo", property_value, "0");
         if (atoi(property_value)) {
             DEBUG_PRINT_HIGH("Turbo mode debug property enabled");
-            control.id = V4L2_CID_MPEG_VIDC_SET_PERF_LEVEL;
-            control.value = V4L2_CID_MPEG_VIDC_PERF_LEVEL_TURBO;
-            if (ioctl(drv_ctx.video_driver_fd, VIDIOC_S_CTRL, &control)) {
+            ctrls.stage(V4L2_CID_MPEG_VIDC_SET_PERF_LEVEL,
+                    V4L2_CID_MPEG_VIDC_PERF_LEVEL_TURBO);
+        }
+        ctrls.stage(V4L2_CID_MPEG_VIDC_VIDEO_PRIORITY,
+                V4L2_MPEG_VIDC_VIDEO_PRIORITY_REALTIME_DISABLE);
+
+        /* Everything above goes to the driver in one call */
+        if (!ctrls.flush(drv_ctx.video_driver_fd)) {
+            if (ctrls.rejected(V4L2_CID_MPEG_VIDC_VIDEO_DIVX_FORMAT))
+                DEBUG_PRINT_ERROR("Failed to set divx version");
+            if (ctrls.rejected(V4L2_CID_MPEG_VIDC_VIDEO_CONCEAL_COLOR))
+                DEBUG_PRINT_ERROR("Failed to set conceal color");
+            if (ctrls.rejected(V4L2_CID_MPEG_VIDC_SET_PERF_LEVEL))
                 DEBUG_PRINT_ERROR("Failed to set turbo mode");
+            if (ctrls.rejected(V4L2_CID_MPEG_VIDC_VIDEO_SECURE)) {
+                DEBUG_PRINT_ERROR("Omx_vdec:: Unable to open secure device");
+                return OMX_ErrorInsufficientResources;
+            }
+            if (ctrls.rejected(V4L2_CID_MPEG_VIDC_VIDEO_MVC_BUFFER_LAYOUT)) {
+                DEBUG_PRINT_ERROR("Failed to set MVC buffer layout");
+                return OMX_ErrorInsufficientResources;
             }
         }
+        startup_phase("port configuration");
         if (is_downscalar_supported) {
            m_downscalar_width = DOWNSCALAR_WIDTH;
            m_downscalar_height = DOWNSCALAR_HEIGHT;
-           property_get("vidc.dec.downscalar_width",property_value,"0");
+           vidc_props::get("vidc.dec.downscalar_width",property_value,"0");
            if (atoi(property_value)) {
               m_downscalar_width = atoi(property_value);
            }
-           property_get("vidc.dec.downscalar_height",property_value,"0");
+           vidc_props::get("vidc.dec.downscalar_height",property_value,"0");
            if (atoi(property_value)) {
               m_downscalar_height = atoi(property_value);
            }
@@ -2226,6 +2374,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         eRet = get_buffer_req(&drv_ctx.ip_buf);
         DEBUG_PRINT_HIGH("Input Buffer Size =%u",(unsigned int)drv_ctx.ip_buf.buffer_size);
         get_buffer_req(&drv_ctx.op_buf);
+        startup_phase("buffer requirements");
         if (drv_ctx.decoder_format == VDEC_CODECTYPE_H264 ||
                 drv_ctx.decoder_format == VDEC_CODECTYPE_HEVC ||
                 drv_ctx.decoder_format == VDEC_CODECTYPE_MVC) {
@@ -2233,6 +2382,7 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
                     h264_scratch.pBuffer = (OMX_U8 *)malloc (drv_ctx.ip_buf.buffer_size);
                     h264_scratch.nFilledLen = 0;
                     h264_scratch.nOffset = 0;
+                    h264_scratch_mem = h264_scratch.pBuffer;
 
                     if (h264_scratch.pBuffer == NULL) {
                         DEBUG_PRINT_ERROR("h264_scratch.pBuffer Allocation failed ");
@@ -2256,28 +2406,23 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
             if (!h264_parser) {
                 DEBUG_PRINT_ERROR("ERROR: H264 parser allocation failed!");
                 eRet = OMX_ErrorInsufficientResources;
+            } else {
+                h264_parser->set_sei_payload_mask(sei_payload_mask(client_extradata));
             }
         }
 
-        if (pipe(fds)) {
-            DEBUG_PRINT_ERROR("pipe creation failed");
+        if (m_worker_pool && !m_event_loop) {
+            if (!m_msg_strand.open(dec_message_work, this)) {
+                DEBUG_PRINT_ERROR("worker pool attach failed");
+                eRet = OMX_ErrorInsufficientResources;
+            }
+        } else if (!m_msg_doorbell.open()) {
+            DEBUG_PRINT_ERROR("message doorbell creation failed");
             eRet = OMX_ErrorInsufficientResources;
         } else {
-            int temp1[2];
-            if (fds[0] == 0 || fds[1] == 0) {
-                if (pipe (temp1)) {
-                    DEBUG_PRINT_ERROR("pipe creation failed");
-                    return OMX_ErrorInsufficientResources;
-                }
-                //close (fds[0]);
-                //close (fds[1]);
-                fds[0] = temp1 [0];
-                fds[1] = temp1 [1];
-            }
-            m_pipe_in = fds[0];
-            m_pipe_out = fds[1];
             msg_thread_created = true;
-            r = pthread_create(&msg_thread_id,0, dec_message_thread,this);
+            r = pthread_create(&msg_thread_id,0,
+                    m_event_loop ? dec_event_loop : dec_message_thread,this);
 
             if (r < 0) {
                 DEBUG_PRINT_ERROR("component_init(): dec_message_thread creation failed");
@@ -2294,13 +2439,11 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
                 drv_ctx.video_driver_fd);
     }
     //memset(&h264_mv_buff,0,sizeof(struct h264_mv_buffer));
-    control.id = V4L2_CID_MPEG_VIDC_VIDEO_PRIORITY;
-    control.value = V4L2_MPEG_VIDC_VIDEO_PRIORITY_REALTIME_DISABLE;
-
-    if (ioctl(drv_ctx.video_driver_fd, VIDIOC_S_CTRL, &control)) {
+    if (ctrls.rejected(V4L2_CID_MPEG_VIDC_VIDEO_PRIORITY)) {
         DEBUG_PRINT_ERROR("Failed to set Default Priority");
         eRet = OMX_ErrorUnsupportedSetting;
     }
+    startup_phase("message thread");
     return eRet;
 }
 
@@ -2381,6 +2524,86 @@ OMX_ERRORTYPE  omx_vdec::send_command(OMX_IN OMX_HANDLETYPE hComp,
     return OMX_ErrorNone;
 }
 
+/* ======================================================================
+   FUNCTION
+   omx_vdec::wait_codec_config_ebds
+
+   DESCRIPTION
+   Event loop counterpart of waiting on m_safe_flush. The loop thread is
+   the one that would dequeue the CODEC CONFIG EBDs, so service the driver
+   here until async_message_process posts the semaphore.
+
+   PARAMETERS
+   deadline - absolute CLOCK_REALTIME limit of the wait.
+
+   RETURN VALUE
+   true if the EBDs arrived before the deadline.
+
+   ========================================================================== */
+bool omx_vdec::wait_codec_config_ebds(const struct timespec *deadline)
+{
+    struct pollfd pfd;
+    struct timespec now;
+    long timeout_ms;
+
+    pfd.fd = drv_ctx.video_driver_fd;
+    pfd.events = POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM | POLLRDBAND | POLLPRI;
+    while (sem_trywait(&m_safe_flush)) {
+        clock_gettime(CLOCK_REALTIME, &now);
+        timeout_ms = (deadline->tv_sec - now.tv_sec) * 1000 +
+            (deadline->tv_nsec - now.tv_nsec) / 1000000;
+        if (timeout_ms <= 0 || poll(&pfd, 1, timeout_ms) <= 0)
+            return false;
+        if (dec_process_driver_events(this, pfd.fd, pfd.revents) < 0)
+            return false;
+    }
+    return true;
+}
+
+/* ======================================================================
+   FUNCTION
+   omx_vdec::resume_deferred_flush
+
+   DESCRIPTION
+   Worker pool counterpart of waiting on m_safe_flush. A flush that found
+   CODEC CONFIG buffers queued leaves OMX_COMPONENT_FLUSH_DEFERRED set and
+   returns; every pass of the strand lands here until the EBDs are back or
+   the deadline passed, and then runs the flush.
+
+   PARAMETERS
+   None.
+
+   RETURN VALUE
+   true if the message queues may be drained.
+
+   ========================================================================== */
+bool omx_vdec::resume_deferred_flush()
+{
+    struct timespec now;
+
+    if (!BITMASK_PRESENT(&m_flags, OMX_COMPONENT_FLUSH_DEFERRED))
+        return true;
+
+    if (android_atomic_add(0, &m_queued_codec_config_count) > 0) {
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (now.tv_sec < m_deferred_flush_deadline.tv_sec ||
+                (now.tv_sec == m_deferred_flush_deadline.tv_sec &&
+                 now.tv_nsec < m_deferred_flush_deadline.tv_nsec))
+            return false;
+        DEBUG_PRINT_ERROR("Failed to wait for EBDs of CODEC CONFIG buffers");
+    }
+    BITMASK_CLEAR(&m_flags, OMX_COMPONENT_FLUSH_DEFERRED);
+
+    if (OMX_CORE_INPUT_PORT_INDEX == m_deferred_flush_port || OMX_ALL == m_deferred_flush_port) {
+        BITMASK_SET(&m_flags, OMX_COMPONENT_INPUT_FLUSH_PENDING);
+    }
+    if (OMX_CORE_OUTPUT_PORT_INDEX == m_deferred_flush_port || OMX_ALL == m_deferred_flush_port) {
+        BITMASK_SET(&m_flags, OMX_COMPONENT_OUTPUT_FLUSH_PENDING);
+    }
+    execute_omx_flush(m_deferred_flush_port);
+    return true;
+}
+
 /* ======================================================================
    FUNCTION
    omx_vdec::SendCommand
@@ -2723,24 +2946,36 @@ OMX_ERRORTYPE  omx_vdec::send_command_proxy(OMX_IN OMX_HANDLETYPE hComp,
                DEBUG_PRINT_LOW("waiting for %d EBDs of CODEC CONFIG buffers ",
                        m_queued_codec_config_count);
                BITMASK_SET(&m_flags, OMX_COMPONENT_FLUSH_DEFERRED);
-               if (sem_timedwait(&m_safe_flush, &ts)) {
-                   DEBUG_PRINT_ERROR("Failed to wait for EBDs of CODEC CONFIG buffers");
+               if (m_msg_strand.is_open()) {
+                   /* No blocking on the shared pool, resume_deferred_flush() ends it */
+                   m_deferred_flush_port = param1;
+                   m_deferred_flush_deadline = ts;
+                   m_msg_strand.post_at(&ts);
+               } else {
+                   if (m_event_loop ? !wait_codec_config_ebds(&ts) :
+                           sem_timedwait(&m_safe_flush, &ts)) {
+                       DEBUG_PRINT_ERROR("Failed to wait for EBDs of CODEC CONFIG buffers");
+                   }
+                   BITMASK_CLEAR (&m_flags,OMX_COMPONENT_FLUSH_DEFERRED);
                }
-               BITMASK_CLEAR (&m_flags,OMX_COMPONENT_FLUSH_DEFERRED);
             }
         }
 
-        if (OMX_CORE_INPUT_PORT_INDEX == param1 || OMX_ALL == param1) {
-            BITMASK_SET(&m_flags, OMX_COMPONENT_INPUT_FLUSH_PENDING);
-        }
-        if (OMX_CORE_OUTPUT_PORT_INDEX == param1 || OMX_ALL == param1) {
-            BITMASK_SET(&m_flags, OMX_COMPONENT_OUTPUT_FLUSH_PENDING);
-        }
-        if (!sem_posted) {
-            sem_posted = 1;
-            DEBUG_PRINT_LOW("Set the Semaphore");
-            sem_post (&m_cmd_lock);
-            execute_omx_flush(param1);
+        if (BITMASK_PRESENT(&m_flags, OMX_COMPONENT_FLUSH_DEFERRED)) {
+            DEBUG_PRINT_LOW("Flush deferred until the CODEC CONFIG EBDs");
+        } else {
+            if (OMX_CORE_INPUT_PORT_INDEX == param1 || OMX_ALL == param1) {
+                BITMASK_SET(&m_flags, OMX_COMPONENT_INPUT_FLUSH_PENDING);
+            }
+            if (OMX_CORE_OUTPUT_PORT_INDEX == param1 || OMX_ALL == param1) {
+                BITMASK_SET(&m_flags, OMX_COMPONENT_OUTPUT_FLUSH_PENDING);
+            }
+            if (!sem_posted) {
+                sem_posted = 1;
+                DEBUG_PRINT_LOW("Set the Semaphore");
+                sem_post (&m_cmd_lock);
+                execute_omx_flush(param1);
+            }
         }
         bFlag = 0;
     } else if ( cmd == OMX_CommandPortEnable) {
@@ -2984,6 +3219,8 @@ bool omx_vdec::execute_input_flush()
     if (arbitrary_bytes && !(codec_config_flag)) {
         DEBUG_PRINT_LOW("Reset all the variables before flusing");
         h264_scratch.nFilledLen = 0;
+        h264_scratch.pBuffer = h264_scratch_mem;
+        m_scratch_in_place = false;
         nal_count = 0;
         look_ahead_nal = false;
         frame_count = 0;
@@ -3924,7 +4161,7 @@ OMX_ERRORTYPE  omx_vdec::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
                                         OMX_QCOM_FramePacking_OnlyOneCompleteFrame) {
                                     arbitrary_bytes = false;
 #ifdef _ANDROID_
-                                    property_get("vidc.dec.debug.arbitrarybytes.mode", property_value, "0");
+                                    vidc_props::get("vidc.dec.debug.arbitrarybytes.mode", property_value, "0");
                                     if (atoi(property_value)) {
                                         DEBUG_PRINT_HIGH("arbitrary_bytes enabled via property command");
                                         arbitrary_bytes = true;
@@ -4659,6 +4896,23 @@ OMX_ERRORTYPE  omx_vdec::get_config(OMX_IN OMX_HANDLETYPE      hComp,
 
             break;
         }
+        case OMX_QTIIndexConfigThreadScheduling:
+        {
+            VALIDATE_OMX_PARAM_DATA(configData, QOMX_CONFIG_THREAD_SCHEDULING);
+            QOMX_CONFIG_THREAD_SCHEDULING *sched = (QOMX_CONFIG_THREAD_SCHEDULING *)configData;
+            thread_sched::config cfg;
+
+            // QOMX_THREAD_ROLE values are the thread_sched roles
+            if ((OMX_U32)sched->eRole >= thread_sched::ROLE_MAX) {
+                eRet = OMX_ErrorBadParameter;
+                break;
+            }
+            m_thread_sched.get(sched->eRole, &cfg);
+            sched->nCpuMask = cfg.cpu_mask;
+            sched->nNice = cfg.nice;
+            sched->nFifoPriority = cfg.fifo_priority;
+            break;
+        }
         default: {
                  DEBUG_PRINT_ERROR("get_config: unknown param %d",configIndex);
                  eRet = OMX_ErrorBadParameter;
@@ -4858,6 +5112,21 @@ OMX_ERRORTYPE  omx_vdec::set_config(OMX_IN OMX_HANDLETYPE      hComp,
         print_debug_color_aspects(&(params->sAspects), "Set Config");
         memcpy(&m_client_color_space, params, sizeof(DescribeColorAspectsParams));
         return ret;
+    } else if ((int)configIndex == (int)OMX_QTIIndexConfigThreadScheduling) {
+        VALIDATE_OMX_PARAM_DATA(configData, QOMX_CONFIG_THREAD_SCHEDULING);
+        QOMX_CONFIG_THREAD_SCHEDULING *sched = (QOMX_CONFIG_THREAD_SCHEDULING *)configData;
+        thread_sched::config cfg;
+
+        cfg.cpu_mask = sched->nCpuMask;
+        cfg.nice = sched->nNice;
+        cfg.fifo_priority = sched->nFifoPriority;
+        DEBUG_PRINT_HIGH("set_config: thread role %d: cpus 0x%x nice %d fifo %d",
+                sched->eRole, cfg.cpu_mask, cfg.nice, cfg.fifo_priority);
+        if (!m_thread_sched.set(sched->eRole, cfg)) {
+            DEBUG_PRINT_ERROR("Failed to set scheduling of thread role %d", sched->eRole);
+            return OMX_ErrorUnsupportedSetting;
+        }
+        return ret;
     }
 
     return OMX_ErrorNotImplemented;
@@ -4939,6 +5208,8 @@ OMX_ERRORTYPE  omx_vdec::get_extension_index(OMX_IN OMX_HANDLETYPE      hComp,
     }
     else if (extn_equals(paramName, OMX_QTI_INDEX_PARAM_VIDEO_CLIENT_EXTRADATA)) {
         *indexType = (OMX_INDEXTYPE)OMX_QTIIndexParamVideoClientExtradata;
+    } else if (extn_equals(paramName, OMX_QTI_INDEX_CONFIG_THREAD_SCHEDULING)) {
+        *indexType = (OMX_INDEXTYPE)OMX_QTIIndexConfigThreadScheduling;
     } else {
         DEBUG_PRINT_ERROR("Extension: %s not implemented", paramName);
         return OMX_ErrorNotImplemented;
@@ -5013,6 +5284,11 @@ OMX_ERRORTYPE  omx_vdec::component_tunnel_request(OMX_IN OMX_HANDLETYPE  hComp,
    ========================================================================== */
 OMX_ERRORTYPE omx_vdec::allocate_extradata()
 {
+    /* Nothing asked the driver for extradata, its plane goes empty */
+    if (!m_driver_extradata) {
+        DEBUG_PRINT_LOW("No extradata enabled, skipping extradata allocation");
+        return OMX_ErrorNone;
+    }
 #ifdef USE_ION
     if (drv_ctx.extradata_info.buffer_size) {
         if (drv_ctx.extradata_info.ion.ion_alloc_data.handle) {
@@ -5041,7 +5317,8 @@ OMX_ERRORTYPE omx_vdec::allocate_extradata()
         }
     }
 #endif
-    if (!m_other_extradata) {
+    /* Staging copy for secure sessions only */
+    if (secure_mode && !m_other_extradata) {
         m_other_extradata = (OMX_OTHER_EXTRADATATYPE *)malloc(drv_ctx.extradata_info.buffer_size);
         if (!m_other_extradata) {
             DEBUG_PRINT_ERROR("Failed to alloc memory\n");
@@ -5058,6 +5335,7 @@ void omx_vdec::free_extradata()
         munmap((void *)drv_ctx.extradata_info.uaddr, drv_ctx.extradata_info.size);
         close(drv_ctx.extradata_info.ion.fd_ion_data.fd);
         free_ion_memory(&drv_ctx.extradata_info.ion);
+        drv_ctx.extradata_info.uaddr = NULL;
     }
 #endif
     if (m_other_extradata) {
@@ -5309,7 +5587,8 @@ OMX_ERRORTYPE  omx_vdec::use_output_buffer(
         plane[0].data_offset = 0;
         extra_idx = EXTRADATA_IDX(drv_ctx.num_planes);
         if (extra_idx && (extra_idx < VIDEO_MAX_PLANES)) {
-            plane[extra_idx].length = drv_ctx.extradata_info.buffer_size;
+            plane[extra_idx].length = drv_ctx.extradata_info.uaddr ?
+                    drv_ctx.extradata_info.buffer_size : 0;
             plane[extra_idx].m.userptr = (long unsigned int) (drv_ctx.extradata_info.uaddr + i * drv_ctx.extradata_info.buffer_size);
 #ifdef USE_ION
             plane[extra_idx].reserved[0] = drv_ctx.extradata_info.ion.fd_ion_data.fd;
@@ -5558,6 +5837,7 @@ OMX_ERRORTYPE  omx_vdec::use_buffer(
         if (allocate_done() && BITMASK_PRESENT(&m_flags,OMX_COMPONENT_IDLE_PENDING)) {
             // Send the callback now
             BITMASK_CLEAR((&m_flags),OMX_COMPONENT_IDLE_PENDING);
+            startup_phase("port setup", true);
             post_event(OMX_CommandStateSet,OMX_StateIdle,
                     OMX_COMPONENT_GENERATE_EVENT);
         }
@@ -6281,7 +6561,8 @@ OMX_ERRORTYPE  omx_vdec::allocate_output_buffer(
             plane[0].data_offset = 0;
             extra_idx = EXTRADATA_IDX(drv_ctx.num_planes);
             if (extra_idx && (extra_idx < VIDEO_MAX_PLANES)) {
-                plane[extra_idx].length = drv_ctx.extradata_info.buffer_size;
+                plane[extra_idx].length = drv_ctx.extradata_info.uaddr ?
+                        drv_ctx.extradata_info.buffer_size : 0;
                 plane[extra_idx].m.userptr = (long unsigned int) (drv_ctx.extradata_info.uaddr + i * drv_ctx.extradata_info.buffer_size);
 #ifdef USE_ION
                 plane[extra_idx].reserved[0] = drv_ctx.extradata_info.ion.fd_ion_data.fd;
@@ -6386,6 +6667,7 @@ OMX_ERRORTYPE  omx_vdec::allocate_buffer(OMX_IN OMX_HANDLETYPE                hC
             if (BITMASK_PRESENT(&m_flags,OMX_COMPONENT_IDLE_PENDING)) {
                 // Send the callback now
                 BITMASK_CLEAR((&m_flags),OMX_COMPONENT_IDLE_PENDING);
+                startup_phase("port setup", true);
                 post_event(OMX_CommandStateSet,OMX_StateIdle,
                         OMX_COMPONENT_GENERATE_EVENT);
             }
@@ -6740,8 +7022,15 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE  hComp,
             m_reject_avc_1080p_mp) {
         first_frame = 1;
         DEBUG_PRINT_ERROR("Parse nal to get the profile");
-        h264_parser->parse_nal((OMX_U8*)buffer->pBuffer, buffer->nFilledLen,
-                NALU_TYPE_SPS);
+        const nal_record *sps = NULL;
+        if (m_nal_index.build(buffer, CODEC_TYPE_H264) > 0)
+            sps = m_nal_index.find(NALU_TYPE_SPS);
+        if (sps)
+            h264_parser->parse_nal(m_nal_index.data(sps), sps->size,
+                    NALU_TYPE_SPS);
+        else
+            h264_parser->parse_nal((OMX_U8*)buffer->pBuffer, buffer->nFilledLen,
+                    NALU_TYPE_SPS);
         m_profile = h264_parser->get_profile();
         ret = is_video_session_supported();
         if (ret) {
@@ -6771,6 +7060,17 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE  hComp,
 
     }
 
+    /* Size the output port before the client allocates it */
+    if ((buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG) && !secure_mode &&
+            !m_out_mem_ptr && !in_reconfig && temp_buffer->bufferaddr) {
+        /* The use buffer copy above starts at bufferaddr, otherwise
+           the data sits at nOffset like the driver is told below */
+        OMX_U32 config_offset = input_use_buffer ? 0 : buffer->nOffset;
+        if (config_offset + temp_buffer->buffer_len <= drv_ctx.ip_buf.buffer_size)
+            configure_output_from_sps((OMX_U8 *)temp_buffer->bufferaddr + config_offset,
+                    temp_buffer->buffer_len);
+    }
+
     frameinfo.bufferaddr = temp_buffer->bufferaddr;
     frameinfo.client_data = (void *) buffer;
     frameinfo.datalen = temp_buffer->buffer_len;
@@ -6820,6 +7120,8 @@ if (buffer->nFlags & QOMX_VIDEO_BUFFERFLAG_EOSEQ) {
         DEBUG_PRINT_HIGH("Rxd i/p EOS, Notify Driver that EOS has been reached");
         frameinfo.flags |= VDEC_BUFFERFLAG_EOS;
         h264_scratch.nFilledLen = 0;
+        h264_scratch.pBuffer = h264_scratch_mem;
+        m_scratch_in_place = false;
         nal_count = 0;
         look_ahead_nal = false;
         frame_count = 0;
@@ -6902,7 +7204,10 @@ if (buffer->nFlags & QOMX_VIDEO_BUFFERFLAG_EOSEQ) {
             if ((android_atomic_add(0, &m_queued_codec_config_count) == 0) &&
                 BITMASK_PRESENT(&m_flags, OMX_COMPONENT_FLUSH_DEFERRED)) {
                 DEBUG_PRINT_ERROR("streamon failed: sem post for m_safe_flush to avoid waiting");
-                sem_post(&m_safe_flush);
+                if (m_msg_strand.is_open())
+                    m_msg_strand.post();
+                else
+                    sem_post(&m_safe_flush);
             }
         }
         empty_buffer_done(&m_cmp,buffer);
@@ -7109,7 +7414,8 @@ OMX_ERRORTYPE  omx_vdec::fill_this_buffer_proxy(
     extra_idx = EXTRADATA_IDX(drv_ctx.num_planes);
     if (extra_idx && (extra_idx < VIDEO_MAX_PLANES)) {
         plane[extra_idx].bytesused = 0;
-        plane[extra_idx].length = drv_ctx.extradata_info.buffer_size;
+        plane[extra_idx].length = drv_ctx.extradata_info.uaddr ?
+                drv_ctx.extradata_info.buffer_size : 0;
         plane[extra_idx].m.userptr = (long unsigned int) (drv_ctx.extradata_info.uaddr + nPortIndex * drv_ctx.extradata_info.buffer_size);
 #ifdef USE_ION
         plane[extra_idx].reserved[0] = drv_ctx.extradata_info.ion.fd_ion_data.fd;
@@ -7230,9 +7536,11 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
     }
     free_input_buffer_header();
     free_output_buffer_header();
-    if (h264_scratch.pBuffer) {
-        free(h264_scratch.pBuffer);
+    if (h264_scratch_mem) {
+        free(h264_scratch_mem);
+        h264_scratch_mem = NULL;
         h264_scratch.pBuffer = NULL;
+        m_scratch_in_place = false;
     }
 
     if (h264_parser) {
@@ -7791,6 +8099,7 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
                     OMX_COMPONENT_GENERATE_EOS_DONE);
 
         if (psource_frame) {
+            stage_scratch_nal();
             m_cb.EmptyBufferDone(&m_cmp, m_app_data, psource_frame);
             psource_frame = NULL;
         }
@@ -8164,7 +8473,10 @@ int omx_vdec::async_message_process (void *context, void* message)
                 if ((android_atomic_add(0, &omx->m_queued_codec_config_count) == 0) &&
                     BITMASK_PRESENT(&omx->m_flags, OMX_COMPONENT_FLUSH_DEFERRED)) {
                     DEBUG_PRINT_LOW("sem post for CODEC CONFIG buffer");
-                    sem_post(&omx->m_safe_flush);
+                    if (omx->m_msg_strand.is_open())
+                        omx->m_msg_strand.post();
+                    else
+                        sem_post(&omx->m_safe_flush);
                 }
             }
 
@@ -8567,11 +8879,76 @@ OMX_ERRORTYPE omx_vdec::push_input_sc_codec(OMX_HANDLETYPE hComp)
     return OMX_ErrorNone;
 }
 
+/* Parse the next NAL of psource_frame into h264_scratch. With scatter-gather
+ * assembly a NAL that is complete inside psource_frame is not copied, instead
+ * h264_scratch is pointed at it so that its bytes are copied only once, into
+ * pdest_frame. Only NALs spanning source buffers go through the scratch memory.
+ */
+OMX_ERRORTYPE omx_vdec::parse_nal_to_scratch(OMX_U32 *partial_frame)
+{
+    nal_span span;
+
+    /* Parser appends to h264_scratch, it must be backed by its own memory */
+    if (stage_scratch_nal() != OMX_ErrorNone) {
+        return OMX_ErrorBadParameter;
+    }
+
+    if (nal_length == 0) {
+        DEBUG_PRINT_LOW("Zero NAL, hence parse using start code");
+        if (m_frame_parser.parse_sc_frame(psource_frame, &h264_scratch,
+                    partial_frame, m_sg_assembly ? &span : NULL) == -1) {
+            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
+            return OMX_ErrorBadParameter;
+        }
+        if (m_sg_assembly && span.len) {
+            h264_scratch.pBuffer = span.data;
+            h264_scratch.nFilledLen = span.len;
+            m_scratch_in_place = true;
+        }
+    } else {
+        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d ",nal_length);
+        if (m_frame_parser.parse_h264_nallength(psource_frame,
+                    &h264_scratch, partial_frame) == -1) {
+            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
+            return OMX_ErrorBadParameter;
+        }
+    }
+    return OMX_ErrorNone;
+}
+
+/* A NAL referenced in place has to be staged before psource_frame is
+ * returned to the client or the parser writes into h264_scratch again.
+ */
+OMX_ERRORTYPE omx_vdec::stage_scratch_nal()
+{
+    if (!m_scratch_in_place) {
+        return OMX_ErrorNone;
+    }
+
+    m_scratch_in_place = false;
+    if (h264_scratch.nFilledLen > h264_scratch.nAllocLen) {
+        DEBUG_PRINT_ERROR("NAL of %u bytes does not fit scratch buffer of %u",
+                (unsigned int)h264_scratch.nFilledLen, (unsigned int)h264_scratch.nAllocLen);
+        h264_scratch.pBuffer = h264_scratch_mem;
+        h264_scratch.nFilledLen = 0;
+        return OMX_ErrorBadParameter;
+    }
+
+    if (h264_scratch.nFilledLen) {
+        DEBUG_PRINT_LOW("Stage look ahead NAL of %u bytes", (unsigned int)h264_scratch.nFilledLen);
+        /* the NAL may sit anywhere in the source, even over the scratch memory */
+        memmove(h264_scratch_mem, h264_scratch.pBuffer, h264_scratch.nFilledLen);
+    }
+    h264_scratch.pBuffer = h264_scratch_mem;
+    return OMX_ErrorNone;
+}
+
 OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
 {
     OMX_U32 partial_frame = 1;
     unsigned long address = 0, p2 = 0, id = 0;
     OMX_BOOL isNewFrame = OMX_FALSE;
+    nal_record nal;
     OMX_BOOL generate_ebd = OMX_TRUE;
 
     if (h264_scratch.pBuffer == NULL) {
@@ -8605,20 +8982,8 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
         generate_ebd = OMX_FALSE;
     }
 
-    if (nal_length == 0) {
-        DEBUG_PRINT_LOW("Zero NAL, hence parse using start code");
-        if (m_frame_parser.parse_sc_frame(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    } else {
-        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d ",nal_length);
-        if (m_frame_parser.parse_h264_nallength(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
-            return OMX_ErrorBadParameter;
-        }
+    if (parse_nal_to_scratch(&partial_frame) != OMX_ErrorNone) {
+        return OMX_ErrorBadParameter;
     }
 
     if (partial_frame == 0) {
@@ -8633,15 +8998,13 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
                 h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer, h264_scratch.nFilledLen,
                         NALU_TYPE_SPS);
 #ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-                if (client_extradata & OMX_TIMEINFO_EXTRADATA)
-                    h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer,
-                            h264_scratch.nFilledLen, NALU_TYPE_SEI);
-                else if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
-                    // If timeinfo is present frame info from SEI is already processed
+                if (client_extradata & (OMX_TIMEINFO_EXTRADATA | OMX_FRAMEINFO_EXTRADATA))
                     h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer,
                             h264_scratch.nFilledLen, NALU_TYPE_SEI);
 #endif
-                m_frame_parser.mutils->isNewFrame(&h264_scratch, 0, isNewFrame);
+                m_frame_parser.mutils->isNewFrame(nal_index::peek(h264_scratch.pBuffer,
+                            h264_scratch.nFilledLen, CODEC_TYPE_H264, &nal) ? &nal : NULL,
+                        isNewFrame);
                 nal_count++;
                 if (VALID_TS(h264_last_au_ts) && !VALID_TS(pdest_frame->nTimeStamp)) {
                     pdest_frame->nTimeStamp = h264_last_au_ts;
@@ -8750,7 +9113,9 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
                         h264_scratch.nFilledLen = 0;
                         pdest_frame->nTimeStamp = h264_scratch.nTimeStamp;
                     } else {
-                        m_frame_parser.mutils->isNewFrame(&h264_scratch, 0, isNewFrame);
+                        m_frame_parser.mutils->isNewFrame(nal_index::peek(h264_scratch.pBuffer,
+                                    h264_scratch.nFilledLen, CODEC_TYPE_H264, &nal) ? &nal : NULL,
+                                isNewFrame);
                         if(!isNewFrame) {
                             /* Have a residual frame, but we know that the
                              * AU in this frame is belonging to whatever
@@ -8804,6 +9169,9 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
         }
     }
     if (generate_ebd && !psource_frame->nFilledLen) {
+        if (stage_scratch_nal() != OMX_ErrorNone) {
+            return OMX_ErrorBadParameter;
+        }
         m_cb.EmptyBufferDone (hComp,m_app_data,psource_frame);
         psource_frame = NULL;
         if (m_input_pending_q.m_size) {
@@ -8840,6 +9208,7 @@ OMX_ERRORTYPE omx_vdec::push_input_hevc(OMX_HANDLETYPE hComp)
     OMX_U32 partial_frame = 1;
     unsigned long address,p2,id;
     OMX_BOOL isNewFrame = OMX_FALSE;
+    nal_record nal;
     OMX_BOOL generate_ebd = OMX_TRUE;
     OMX_ERRORTYPE rc = OMX_ErrorNone;
     if (h264_scratch.pBuffer == NULL) {
@@ -8859,19 +9228,8 @@ OMX_ERRORTYPE omx_vdec::push_input_hevc(OMX_HANDLETYPE hComp)
         }
     }
 
-    if (nal_length == 0) {
-        if (m_frame_parser.parse_sc_frame(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing Return Error");
-            return OMX_ErrorBadParameter;
-        }
-    } else {
-        DEBUG_PRINT_LOW("Non-zero NAL length clip, hence parse with NAL size %d",nal_length);
-        if (m_frame_parser.parse_h264_nallength(psource_frame,
-                    &h264_scratch,&partial_frame) == -1) {
-            DEBUG_PRINT_ERROR("Error In Parsing NAL size, Return Error");
-            return OMX_ErrorBadParameter;
-        }
+    if (parse_nal_to_scratch(&partial_frame) != OMX_ErrorNone) {
+        return OMX_ErrorBadParameter;
     }
 
     if (partial_frame == 0) {
@@ -8883,7 +9241,9 @@ OMX_ERRORTYPE omx_vdec::push_input_hevc(OMX_HANDLETYPE hComp)
         } else {
             DEBUG_PRINT_LOW("Parsed New NAL Length = %u", (unsigned int)h264_scratch.nFilledLen);
             if (h264_scratch.nFilledLen) {
-                m_hevc_utils.isNewFrame(&h264_scratch, 0, isNewFrame);
+                m_hevc_utils.isNewFrame(nal_index::peek(h264_scratch.pBuffer,
+                            h264_scratch.nFilledLen, CODEC_TYPE_HEVC, &nal) ? &nal : NULL,
+                        isNewFrame);
                 nal_count++;
             }
 
@@ -8972,6 +9332,9 @@ OMX_ERRORTYPE omx_vdec::push_input_hevc(OMX_HANDLETYPE hComp)
     }
 
     if (generate_ebd && !psource_frame->nFilledLen) {
+        if (stage_scratch_nal() != OMX_ErrorNone) {
+            return OMX_ErrorBadParameter;
+        }
         m_cb.EmptyBufferDone (hComp, m_app_data, psource_frame);
         psource_frame = NULL;
         if (m_input_pending_q.m_size) {
@@ -9066,17 +9429,10 @@ int omx_vdec::alloc_map_ion_memory(OMX_U32 buffer_size,
     int fd = -EINVAL;
     int rc = -EINVAL;
     int ion_dev_flag;
-    struct vdec_ion ion_buf_info;
     if (!alloc_data || buffer_size <= 0 || !fd_data) {
         DEBUG_PRINT_ERROR("Invalid arguments to alloc_map_ion_memory");
         return -EINVAL;
     }
-    ion_dev_flag = O_RDONLY;
-    fd = open (MEM_DEVICE, ion_dev_flag);
-    if (fd < 0) {
-        DEBUG_PRINT_ERROR("opening ion device failed with fd = %d", fd);
-        return fd;
-    }
     alloc_data->flags = 0;
     if (!secure_mode && (flag & ION_FLAG_CACHED)) {
         alloc_data->flags |= ION_FLAG_CACHED;
@@ -9092,22 +9448,37 @@ int omx_vdec::alloc_map_ion_memory(OMX_U32 buffer_size,
     alloc_data->heap_id_mask = ION_HEAP(ION_IOMMU_HEAP_ID);
     if (secure_mode && (alloc_data->flags & ION_SECURE))
         alloc_data->heap_id_mask = ION_HEAP(MEM_HEAP_ID);
-    rc = ioctl(fd,ION_IOC_ALLOC,alloc_data);
-    if (rc || !alloc_data->handle) {
-        DEBUG_PRINT_ERROR("ION ALLOC memory failed");
-        alloc_data->handle = 0;
-        close(fd);
-        fd = -ENOMEM;
-        return fd;
+
+    if (m_ion_pool && !(alloc_data->flags & ION_SECURE)) {
+        fd = m_ion_pool->get(alloc_data);
+        if (fd < 0)
+            alloc_data->len = ion_pool::class_size(buffer_size);
+    }
+    if (fd < 0) {
+        ion_dev_flag = O_RDONLY;
+        fd = open (MEM_DEVICE, ion_dev_flag);
+        if (fd < 0) {
+            DEBUG_PRINT_ERROR("opening ion device failed with fd = %d", fd);
+            return fd;
+        }
+        rc = ioctl(fd,ION_IOC_ALLOC,alloc_data);
+        if (rc || !alloc_data->handle) {
+            DEBUG_PRINT_ERROR("ION ALLOC memory failed");
+            alloc_data->handle = 0;
+            close(fd);
+            fd = -ENOMEM;
+            return fd;
+        }
     }
     fd_data->handle = alloc_data->handle;
     rc = ioctl(fd,ION_IOC_MAP,fd_data);
     if (rc) {
         DEBUG_PRINT_ERROR("ION MAP failed ");
-        ion_buf_info.ion_alloc_data = *alloc_data;
-        ion_buf_info.ion_device_fd = fd;
-        ion_buf_info.fd_ion_data = *fd_data;
-        free_ion_memory(&ion_buf_info);
+        /* Not given back to the pool, the handle may be what failed */
+        if (ioctl(fd, ION_IOC_FREE, &alloc_data->handle))
+            DEBUG_PRINT_ERROR("ION: free failed" );
+        close(fd);
+        alloc_data->handle = 0;
         fd_data->fd =-1;
         fd = -ENOMEM;
     }
@@ -9122,11 +9493,15 @@ void omx_vdec::free_ion_memory(struct vdec_ion *buf_ion_info)
         DEBUG_PRINT_ERROR("ION: free called with invalid fd/allocdata");
         return;
     }
-    if (ioctl(buf_ion_info->ion_device_fd,ION_IOC_FREE,
-                &buf_ion_info->ion_alloc_data.handle)) {
-        DEBUG_PRINT_ERROR("ION: free failed" );
+    /* Kept for the next allocation, the pool owns the client then */
+    if (!m_ion_pool || !m_ion_pool->put(buf_ion_info->ion_device_fd,
+                &buf_ion_info->ion_alloc_data)) {
+        if (ioctl(buf_ion_info->ion_device_fd,ION_IOC_FREE,
+                    &buf_ion_info->ion_alloc_data.handle)) {
+            DEBUG_PRINT_ERROR("ION: free failed" );
+        }
+        close(buf_ion_info->ion_device_fd);
     }
-    close(buf_ion_info->ion_device_fd);
     buf_ion_info->ion_device_fd = -1;
     buf_ion_info->ion_alloc_data.handle = 0;
     buf_ion_info->fd_ion_data.fd = -1;
@@ -9163,10 +9538,7 @@ void omx_vdec::free_output_buffer_header()
         drv_ctx.op_buf_ion_info = NULL;
     }
 #endif
-    if (out_dynamic_list) {
-        free(out_dynamic_list);
-        out_dynamic_list = NULL;
-    }
+    m_buf_refs.release();
 }
 
 void omx_vdec::free_input_buffer_header()
@@ -9627,13 +9999,8 @@ OMX_ERRORTYPE omx_vdec::allocate_output_headers()
             return OMX_ErrorInsufficientResources;
         }
 #endif
-        if (dynamic_buf_mode) {
-            out_dynamic_list = (struct dynamic_buf_list *) \
-                calloc (sizeof(struct dynamic_buf_list), drv_ctx.op_buf.actualcount);
-            if (out_dynamic_list) {
-               for (unsigned int i = 0; i < drv_ctx.op_buf.actualcount; i++)
-                  out_dynamic_list[i].dup_fd = -1;
-            }
+        if (dynamic_buf_mode && !m_buf_refs.init(drv_ctx.op_buf.actualcount)) {
+            DEBUG_PRINT_ERROR("Failed to alloc dynamic buffer reference table");
         }
 
         if (m_out_mem_ptr && pPtr && drv_ctx.ptr_outputbuffer
@@ -10429,11 +10796,15 @@ OMX_ERRORTYPE omx_vdec::enable_extradata(OMX_U32 requested_extradata,
     DEBUG_PRINT_HIGH("NOTE: enable_extradata: actual[%u] requested[%u] enable[%d], is_internal: %d",
             (unsigned int)client_extradata, (unsigned int)requested_extradata, enable, is_internal);
 
+    if (enable)
+        m_driver_extradata |= requested_extradata;
     if (!is_internal) {
         if (enable)
             client_extradata |= requested_extradata;
         else
             client_extradata = client_extradata & ~requested_extradata;
+        if (h264_parser)
+            h264_parser->set_sei_payload_mask(sei_payload_mask(client_extradata));
     }
 
     if (enable) {
@@ -11001,25 +11372,16 @@ void omx_vdec::insert_demux_addr_offset(OMX_U32 address_offset)
 
 void omx_vdec::extract_demux_addr_offsets(OMX_BUFFERHEADERTYPE *buf_hdr)
 {
-    OMX_U32 bytes_to_parse = buf_hdr->nFilledLen;
-    OMX_U8 *buf = buf_hdr->pBuffer + buf_hdr->nOffset;
-    OMX_U32 index = 0;
-
     m_demux_entries = 0;
 
-    while (index < bytes_to_parse) {
-        if ( ((buf[index] == 0x00) && (buf[index+1] == 0x00) &&
-                    (buf[index+2] == 0x00) && (buf[index+3] == 0x01)) ||
-                ((buf[index] == 0x00) && (buf[index+1] == 0x00) &&
-                 (buf[index+2] == 0x01)) ) {
-            //Found start code, insert address offset
-            insert_demux_addr_offset(index);
-            if (buf[index+2] == 0x01) // 3 byte start code
-                index += 3;
-            else                      //4 byte start code
-                index += 4;
-        } else
-            index++;
+    if (m_nal_index.build(buf_hdr, codec_type_parse) < 0) {
+        DEBUG_PRINT_ERROR("Failed to index the start codes of %p", buf_hdr);
+        return;
+    }
+
+    for (OMX_U32 i = 0; i < m_nal_index.count(); i++) {
+        //Found start code, insert address offset
+        insert_demux_addr_offset(m_nal_index.get(i)->offset);
     }
     DEBUG_PRINT_LOW("Extracted (%u) demux entry offsets", (unsigned int)m_demux_entries);
     return;
@@ -11118,6 +11480,7 @@ omx_vdec::allocate_color_convert_buf::allocate_color_convert_buf()
 void omx_vdec::allocate_color_convert_buf::set_vdec_client(void *client)
 {
     omx = reinterpret_cast<omx_vdec*>(client);
+    c2d.set_executor(&omx->m_band_executor);
 }
 
 void omx_vdec::allocate_color_convert_buf::init_members()
@@ -11356,6 +11719,9 @@ OMX_ERRORTYPE omx_vdec::allocate_color_convert_buf::free_output_buffer(
         return OMX_ErrorBadParameter;
     }
     if (pmem_fd[index] > 0) {
+        pthread_mutex_lock(&omx->c_lock);
+        c2d.flush();
+        pthread_mutex_unlock(&omx->c_lock);
         munmap(pmem_baseaddress[index], buffer_size_req);
         close(pmem_fd[index]);
     }
@@ -11526,83 +11892,25 @@ OMX_ERRORTYPE omx_vdec::allocate_color_convert_buf::cache_ops(
 
 void omx_vdec::buf_ref_add(long fd, OMX_U32 offset)
 {
-    unsigned long i = 0;
-    bool buf_present = false;
-
     if (!dynamic_buf_mode) {
         return;
     }
 
-    if (!out_dynamic_list) {
-        DEBUG_PRINT_ERROR("buf_ref_add: out_dynamic_list is NULL");
-        return;
+    if (!m_buf_refs.add(fd, offset)) {
+        DEBUG_PRINT_ERROR("buf_ref_add: no room for fd = %ld offset = %u",
+                fd, (unsigned int)offset);
     }
-
-    pthread_mutex_lock(&m_lock);
-    for (i = 0; i < drv_ctx.op_buf.actualcount; i++) {
-        //check the buffer fd, offset, uv addr with list contents
-        //If present increment reference.
-        if ((out_dynamic_list[i].fd == fd) &&
-            (out_dynamic_list[i].offset == offset)) {
-               out_dynamic_list[i].ref_count++;
-               DEBUG_PRINT_LOW("buf_ref_add: [ALREADY PRESENT] fd = %u ref_count = %u",
-                     (unsigned int)out_dynamic_list[i].fd, (unsigned int)out_dynamic_list[i].ref_count);
-               buf_present = true;
-               break;
-        }
-    }
-    if (!buf_present) {
-        for (i = 0; i < drv_ctx.op_buf.actualcount; i++) {
-            //search for a entry to insert details of the new buffer
-            if (out_dynamic_list[i].dup_fd < 0) {
-                out_dynamic_list[i].fd = fd;
-                out_dynamic_list[i].offset = offset;
-                out_dynamic_list[i].dup_fd = dup(fd);
-                out_dynamic_list[i].ref_count++;
-                DEBUG_PRINT_LOW("buf_ref_add: [ADDED] fd = %u ref_count = %u",
-                     (unsigned int)out_dynamic_list[i].fd, (unsigned int)out_dynamic_list[i].ref_count);
-                break;
-            }
-        }
-    }
-   pthread_mutex_unlock(&m_lock);
 }
 
 void omx_vdec::buf_ref_remove(long fd, OMX_U32 offset)
 {
-    unsigned long i = 0;
-
     if (!dynamic_buf_mode) {
         return;
     }
 
-    if (!out_dynamic_list) {
-        DEBUG_PRINT_ERROR("buf_ref_add: out_dynamic_list is NULL");
-        return;
-    }
-
-    pthread_mutex_lock(&m_lock);
-    for (i = 0; i < drv_ctx.op_buf.actualcount; i++) {
-        //check the buffer fd, offset, uv addr with list contents
-        //If present decrement reference.
-        if ((out_dynamic_list[i].fd == fd) &&
-            (out_dynamic_list[i].offset == offset)) {
-            out_dynamic_list[i].ref_count--;
-            if (out_dynamic_list[i].ref_count == 0) {
-                close(out_dynamic_list[i].dup_fd);
-                DEBUG_PRINT_LOW("buf_ref_remove: [REMOVED] fd = %u ref_count = %u",
-                     (unsigned int)out_dynamic_list[i].fd, (unsigned int)out_dynamic_list[i].ref_count);
-                out_dynamic_list[i].dup_fd = -1;
-                out_dynamic_list[i].fd = 0;
-                out_dynamic_list[i].offset = 0;
-            }
-            break;
-        }
-    }
-    if (i  >= drv_ctx.op_buf.actualcount) {
+    if (!m_buf_refs.remove(fd, offset)) {
         DEBUG_PRINT_ERROR("Error - could not remove ref, no match with any entry in list");
     }
-    pthread_mutex_unlock(&m_lock);
 }
 
 #ifdef _MSM8974_
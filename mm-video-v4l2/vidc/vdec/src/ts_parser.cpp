@@ -51,7 +51,8 @@ omx_time_stamp_reorder::~omx_time_stamp_reorder()
 omx_time_stamp_reorder::omx_time_stamp_reorder()
 {
     reorder_ts = false;
-    phead = pcurrent = NULL;
+    segment = 0;
+    segment_filled = 0;
     error = false;
     print_debug = false;
     pthread_mutex_init(&m_lock, NULL);
@@ -59,96 +60,21 @@ omx_time_stamp_reorder::omx_time_stamp_reorder()
 
 void omx_time_stamp_reorder::delete_list()
 {
-    time_stamp_list *ptemp;
-
-    if (!phead) return;
-
-    while (phead->next != phead) {
-        ptemp = phead;
-        phead = phead->next;
-        phead->prev = ptemp->prev;
-        ptemp->prev->next = phead;
-        delete ptemp;
-    }
-
-    delete phead;
-    phead = NULL;
-}
-
-bool omx_time_stamp_reorder::get_current_list()
-{
-    if (!phead) {
-        if (!add_new_list()) {
-            handle_error();
-            return false;
-        }
-    }
-
-    pcurrent = phead->prev;
-    return true;
+    heap.clear();
+    segment = 0;
+    segment_filled = 0;
 }
 
-bool omx_time_stamp_reorder::update_head()
+void omx_time_stamp_reorder::add_new_segment()
 {
-    time_stamp_list *ptemp;
-
-    if (!phead) return false;
-
-    if (phead->next != phead) {
-        ptemp = phead;
-        phead = ptemp->next;
-        phead->prev = ptemp->prev;
-        ptemp->prev->next = phead;
-        delete ptemp;
-    }
-
-    return true;
-}
-
-bool omx_time_stamp_reorder::add_new_list()
-{
-    bool status = true;
-    time_stamp_list *ptemp = NULL;
-
-    if (!phead) {
-        ptemp = phead = new time_stamp_list;
-
-        if (!phead) {
-            handle_error();
-            status = false;
-            return status;
-        }
-
-        phead->prev = phead->next = phead;
-    } else {
-        ptemp = new time_stamp_list;
-
-        if (!ptemp) {
-            handle_error();
-            status = false;
-            return status;
-        }
-
-        ptemp->prev = phead->prev;
-        ptemp->next = phead;
-        phead->prev->next = ptemp;
-        phead->prev = ptemp;
-    }
-
-    ptemp->entries_filled = 0;
-
-    for (int i=0; i < TIME_SZ; i++) {
-        ptemp->input_timestamps[i].in_use = false;
-        ptemp->input_timestamps[i].timestamps = -1;
-    }
-
-    return status;
+    segment++;
+    segment_filled = 0;
 }
 
 bool omx_time_stamp_reorder::insert_timestamp(OMX_BUFFERHEADERTYPE *header)
 {
     auto_lock l(&m_lock);
-    OMX_TICKS *table_entry = NULL;
+    timestamp entry;
 
     if (!reorder_ts || error || !header) {
         if (error || !header)
@@ -157,12 +83,7 @@ bool omx_time_stamp_reorder::insert_timestamp(OMX_BUFFERHEADERTYPE *header)
         return false;
     }
 
-    if (!get_current_list()) {
-        handle_error();
-        return false;
-    }
-
-    if (pcurrent->entries_filled > (TIME_SZ - 1)) {
+    if (segment_filled > (TIME_SZ - 1)) {
         DEBUG("Table full return error");
         handle_error();
         return false;
@@ -174,72 +95,72 @@ bool omx_time_stamp_reorder::insert_timestamp(OMX_BUFFERHEADERTYPE *header)
 
     if ((header->nFlags & OMX_BUFFERFLAG_EOS) && !header->nFilledLen) {
         DEBUG("EOS with zero length recieved");
-
-        if (!add_new_list()) {
-            handle_error();
-            return false;
-        }
-
+        add_new_segment();
         return true;
     }
 
-    for (int i = 0; i < TIME_SZ && !table_entry; i++) {
-        if (!pcurrent->input_timestamps[i].in_use) {
-            table_entry = &pcurrent->input_timestamps[i].timestamps;
-            pcurrent->input_timestamps[i].in_use = true;
-            pcurrent->entries_filled++;
-        }
-    }
+    entry.timestamps = header->nTimeStamp;
+    entry.segment = segment;
 
-    if (!table_entry) {
+    if (!heap.push(entry)) {
         DEBUG("All entries in use");
         handle_error();
         return false;
     }
 
-    *table_entry = header->nTimeStamp;
+    segment_filled++;
 
     if (print_debug)
         DEBUG("Time stamp inserted %lld", header->nTimeStamp);
 
     if (header->nFlags & OMX_BUFFERFLAG_EOS) {
-        if (!add_new_list()) {
-            handle_error();
-            return false;
-        }
+        add_new_segment();
     }
 
     return true;
 }
 
+bool omx_time_stamp_reorder::pop_timestamp(timestamp &entry)
+{
+    if (!heap.pop(entry))
+        return false;
+    if (entry.segment == segment)
+        segment_filled--;
+    return true;
+}
+
 bool omx_time_stamp_reorder::remove_time_stamp(OMX_TICKS ts, bool is_interlaced = false)
 {
     auto_lock l(&m_lock);
     unsigned int num_ent_remove = (is_interlaced)?2:1;
+    unsigned int head;
 
     if (!reorder_ts || error) {
         DEBUG("not in avi mode");
         return false;
     }
 
-    if (!phead || !phead->entries_filled) return false;
+    if (heap.empty()) return false;
 
-    for (int i=0; i < TIME_SZ && num_ent_remove; i++) {
-        if (phead->input_timestamps[i].in_use && phead->input_timestamps[i].timestamps == ts) {
-            phead->input_timestamps[i].in_use = false;
-            phead->entries_filled--;
+    /* Only the oldest segment is searched, as with the per segment tables */
+    head = heap.top()->segment;
+
+    for (unsigned int i = 0; i < heap.size() && num_ent_remove;) {
+        const timestamp &entry = heap.at(i);
+
+        if (entry.segment == head && entry.timestamps == ts) {
+            if (entry.segment == segment)
+                segment_filled--;
+            heap.remove_at(i);
             num_ent_remove--;
 
             if (print_debug)
                 DEBUG("Removed TS %lld", ts);
-        }
-    }
 
-    if (!phead->entries_filled) {
-        if (!update_head()) {
-            handle_error();
-            return false;
+            /* The last entry moved into slot i, look at it again */
+            continue;
         }
+        i++;
     }
 
     return true;
@@ -254,8 +175,7 @@ void omx_time_stamp_reorder::flush_timestamp()
 bool omx_time_stamp_reorder::get_next_timestamp(OMX_BUFFERHEADERTYPE *header, bool is_interlaced)
 {
     auto_lock l(&m_lock);
-    timestamp *element = NULL,*duplicate = NULL;
-    bool status = false;
+    timestamp element, next;
 
     if (!reorder_ts || error || !header) {
         if (error || !header)
@@ -264,62 +184,23 @@ bool omx_time_stamp_reorder::get_next_timestamp(OMX_BUFFERHEADERTYPE *header, bo
         return false;
     }
 
-    if (!phead || !phead->entries_filled) return false;
-
-    for (int i=0; i < TIME_SZ; i++) {
-        if (phead->input_timestamps[i].in_use) {
-            status = true;
-
-            if (!element)
-                element = &phead->input_timestamps[i];
-            else {
-                if (element->timestamps > phead->input_timestamps[i].timestamps) {
-                    element = &phead->input_timestamps[i];
-                    duplicate = NULL;
-                } else if (element->timestamps == phead->input_timestamps[i].timestamps)
-                    duplicate = &phead->input_timestamps[i];
-            }
-        }
-    }
+    if (!pop_timestamp(element)) return false;
 
-    if (element) {
-        phead->entries_filled--;
-        header->nTimeStamp = element->timestamps;
+    header->nTimeStamp = element.timestamps;
 
-        if (print_debug)
-            DEBUG("Getnext Time stamp %lld", header->nTimeStamp);
-
-        element->in_use = false;
-    }
+    if (print_debug)
+        DEBUG("Getnext Time stamp %lld", header->nTimeStamp);
 
-    if (is_interlaced && duplicate) {
-        phead->entries_filled--;
-        duplicate->in_use = false;
-    } else if (is_interlaced && !duplicate) {
-        element = NULL;
-
-        for (int i=0; i < TIME_SZ; i++) {
-            if (phead->input_timestamps[i].in_use) {
-                if (!element)
-                    element = &phead->input_timestamps[i];
-                else if (element->timestamps > phead->input_timestamps[i].timestamps)
-                    element = &phead->input_timestamps[i];
-            }
-        }
+    /*
+     * For interlaced content the second field carries either the same
+     * timestamp or the next one of the same segment, which is reported.
+     */
+    if (is_interlaced && heap.top() && heap.top()->segment == element.segment) {
+        pop_timestamp(next);
 
-        if (element) {
-            phead->entries_filled--;
-            header->nTimeStamp = element->timestamps;
-            element->in_use = false;
-        }
+        if (next.timestamps != element.timestamps)
+            header->nTimeStamp = next.timestamps;
     }
 
-    if (!phead->entries_filled) {
-        if (!update_head()) {
-            handle_error();
-            return false;
-        }
-    }
-
-    return status;
+    return true;
 }
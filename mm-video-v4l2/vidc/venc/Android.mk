@@ -97,7 +97,6 @@ LOCAL_HEADER_LIBRARIES    += generated_kernel_headers
 LOCAL_SRC_FILES   := src/omx_video_base.cpp
 LOCAL_SRC_FILES   += src/omx_video_encoder.cpp
 LOCAL_SRC_FILES   += src/video_encoder_device_v4l2.cpp
-LOCAL_SRC_FILES   += src/neon.c
 
 include $(BUILD_SHARED_LIBRARY)
 
@@ -131,6 +131,8 @@ class omx_venc: public omx_video
         bool dev_color_align(OMX_BUFFERHEADERTYPE *buffer, OMX_U32 width,
                         OMX_U32 height);
         bool dev_get_output_log_flag();
+        bool dev_reads_heap_input();
+        bool dev_get_clip_limits(OMX_U8 *luma_max, OMX_U8 *chroma_max);
         int dev_output_log_buffers(const char *buffer_addr, int buffer_len);
         int dev_extradata_log_buffers(char *buffer);
 
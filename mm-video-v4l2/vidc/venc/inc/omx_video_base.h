@@ -62,6 +62,12 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "qc_omx_component.h"
 #include "omx_video_common.h"
 #include "extra_data_handler.h"
+#include "msg_doorbell.h"
+#include "worker_pool.h"
+#include "thread_sched.h"
+#include "mmap_cache.h"
+#include "band_executor.h"
+#include "ion_pool.h"
 #include <linux/videodev2.h>
 #include <dlfcn.h>
 #include "C2DColorConverter.h"
@@ -130,6 +136,8 @@ static const char* MEM_DEVICE = "/dev/pmem_smipool";
 
 #define MAX_NUM_INPUT_BUFFERS 64
 #define MAX_NUM_OUTPUT_BUFFERS 64
+#define MAX_CONV_DEPTH C2D_MAX_ASYNC
+#define MAX_HEAP_COPY_DEPTH 4
 
 #ifdef USE_NATIVE_HANDLE_SOURCE
 #define LEGACY_CAM_SOURCE kMetadataBufferTypeNativeHandleSource
@@ -140,6 +148,7 @@ static const char* MEM_DEVICE = "/dev/pmem_smipool";
 #endif
 
 void* enc_message_thread(void *);
+void enc_message_work(void *);
 
 struct output_metabuffer {
     OMX_U32 type;
@@ -174,18 +183,66 @@ class omx_video: public qc_omx_component
                         ColorConvertFormat dest,unsigned int src_stride);
                 bool convert(int src_fd, void *src_base, void *src_viraddr,
                         int dest_fd, void *dest_base, void *dest_viraddr);
+                bool convert_async(int src_fd, void *src_base, void *src_viraddr,
+                        int dest_fd, void *dest_base, void *dest_viraddr,
+                        c2d_ts_handle *ts);
+                bool wait(c2d_ts_handle ts);
                 bool get_buffer_size(int port,unsigned int &buf_size);
                 int get_src_format();
+                void flush();
                 void close();
+                /*Splits CPU conversions into row bands on executor*/
+                void set_executor(band_executor *executor);
+                /*Asks the converter to clamp its output, true if it will*/
+                bool set_clip(OMX_U8 luma_max, OMX_U8 chroma_max);
+                bool clips_output() {
+                    return m_clips_output;
+                }
             private:
+                struct conv_band {
+                    C2DColorConverterBase *c2dcc;
+                    void *src;
+                    void *dest;
+                    int result;
+                };
+                int convert_rows(void *src_viraddr, void *dest_viraddr);
+                static void convert_band(void *arg, unsigned int row, unsigned int rows);
                 C2DColorConverterBase *c2dcc;
                 pthread_mutex_t c_lock;
+                band_executor *m_executor;
+                unsigned int m_height;
+                bool m_split_rows;
+                bool m_clips_output;
                 void *mLibHandle;
                 ColorConvertFormat src_format;
                 createC2DColorConverter_t *mConvertOpen;
                 destroyC2DColorConverter_t *mConvertClose;
         };
         omx_c2d_conv c2d_conv;
+
+        // color conversion submitted to the GPU, queued to the encoder
+        // once conv_thread sees it complete
+        struct conv_job {
+            OMX_BUFFERHEADERTYPE *source;
+            OMX_BUFFERHEADERTYPE *dest;
+            unsigned long index;
+            void *uva;
+            unsigned int size;
+            c2d_ts_handle ts;
+            bool failed;
+        };
+        conv_job m_conv_jobs[MAX_CONV_DEPTH];
+        // m_conv_count jobs from m_conv_head, the first m_conv_waited done
+        unsigned int m_conv_head;
+        unsigned int m_conv_count;
+        unsigned int m_conv_waited;
+        // vidc.enc.conv_depth: conversions in flight, 1 converts inline
+        unsigned int m_conv_depth;
+        bool m_conv_thread_created;
+        bool m_conv_thread_stop;
+        pthread_t m_conv_thread_id;
+        pthread_mutex_t m_conv_lock;
+        pthread_cond_t m_conv_cond;
 #endif
     public:
 
@@ -245,6 +302,9 @@ class omx_video: public qc_omx_component
         virtual bool dev_color_align(OMX_BUFFERHEADERTYPE *buffer, OMX_U32 width,
                         OMX_U32 height) = 0;
         virtual bool dev_get_output_log_flag() = 0;
+        /*True when dev_empty_buf reads heap UseBuffer input from the client buffer*/
+        virtual bool dev_reads_heap_input() = 0;
+        virtual bool dev_get_clip_limits(OMX_U8 *luma_max, OMX_U8 *chroma_max) = 0;
         virtual int dev_output_log_buffers(const char *buffer_addr, int buffer_len) = 0;
         virtual int dev_extradata_log_buffers(char *buffer_addr) = 0;
         OMX_ERRORTYPE component_role_enum(
@@ -343,8 +403,44 @@ class omx_video: public qc_omx_component
 
 
 
-        int  m_pipe_in;
-        int  m_pipe_out;
+        msg_doorbell m_msg_doorbell;
+        // message processing runs on the shared worker pool
+        worker_strand m_msg_strand;
+        bool m_worker_pool;
+        // the message thread also serves the driver, see venc_dev::venc_event_loop
+        bool m_event_loop;
+        thread_sched m_thread_sched;
+        // mappings of client input buffers kept across frames
+        mmap_cache m_input_maps;
+        // vidc.enc.pixel_threads: threads for CPU conversion and clipping
+        band_executor m_band_executor;
+        // vidc.enc.ion_pool: MB of freed ION buffers kept for reuse,
+        // in this component or, with vidc.enc.ion_pool.shared, process wide
+        // where the largest value any component asked for applies
+        ion_pool m_own_ion_pool;
+        ion_pool *m_ion_pool;
+        // vidc.enc.heap_copy_async: heap UseBuffer input is copied on
+        // copy_thread while the previous frame encodes, then queued to
+        // the encoder in submission order
+        struct heap_copy_job {
+            OMX_BUFFERHEADERTYPE *buffer;
+            unsigned int index;
+            unsigned int fd;
+            OMX_U8 *dest;
+            OMX_U8 *src;
+            OMX_U32 len;
+        };
+        heap_copy_job m_copy_jobs[MAX_HEAP_COPY_DEPTH];
+        // m_copy_count jobs from m_copy_head, the first m_copy_done copied
+        unsigned int m_copy_head;
+        unsigned int m_copy_count;
+        unsigned int m_copy_done;
+        bool m_heap_copy_async;
+        bool m_copy_thread_created;
+        bool m_copy_thread_stop;
+        pthread_t m_copy_thread_id;
+        pthread_mutex_t m_copy_lock;
+        pthread_cond_t m_copy_cond;
 
         pthread_t msg_thread_id;
         pthread_t async_thread_id;
@@ -425,7 +521,9 @@ class omx_video: public qc_omx_component
             OMX_COMPONENT_GENERATE_HARDWARE_ERROR = 0x11,
             OMX_COMPONENT_GENERATE_LTRUSE_FAILED = 0x12,
             OMX_COMPONENT_GENERATE_ETB_OPQ = 0x13,
-            OMX_COMPONENT_CLOSE_MSG = 0x14
+            OMX_COMPONENT_CLOSE_MSG = 0x14,
+            OMX_COMPONENT_GENERATE_CONV_DONE = 0x15,
+            OMX_COMPONENT_GENERATE_COPY_DONE = 0x16
         };
 
         struct omx_event {
@@ -504,6 +602,18 @@ class omx_video: public qc_omx_component
         OMX_ERRORTYPE push_input_buffer(OMX_HANDLETYPE hComp);
         OMX_ERRORTYPE convert_queue_buffer(OMX_HANDLETYPE hComp,
                 struct pmem &Input_pmem_info,unsigned long &index);
+        OMX_ERRORTYPE submit_conversion(OMX_HANDLETYPE hComp,
+                struct pmem &Input_pmem_info,unsigned long &index);
+        OMX_ERRORTYPE queue_conversion(OMX_HANDLETYPE hComp, conv_job &job);
+        OMX_ERRORTYPE complete_conversions(OMX_HANDLETYPE hComp);
+        void drain_conversions(bool encode);
+        static void* conv_thread(void *input);
+        OMX_ERRORTYPE submit_heap_copy(OMX_BUFFERHEADERTYPE *buffer,
+                unsigned int index, unsigned int fd);
+        OMX_ERRORTYPE queue_heap_copy(heap_copy_job &job);
+        OMX_ERRORTYPE complete_heap_copies();
+        void drain_heap_copies(bool encode);
+        static void* copy_thread(void *input);
         OMX_ERRORTYPE queue_meta_buffer(OMX_HANDLETYPE hComp,
                 struct pmem &Input_pmem_info);
         OMX_ERRORTYPE push_empty_eos_buffer(OMX_HANDLETYPE hComp,
@@ -561,10 +671,6 @@ class omx_video: public qc_omx_component
         void free_ion_memory(struct venc_ion *buf_ion_info);
 #endif
 
-        inline bool omx_close_msg_thread(unsigned char id) {
-            return (id == OMX_COMPONENT_CLOSE_MSG);
-        }
-
         //*************************************************************
         //*******************MEMBER VARIABLES *************************
         //*************************************************************
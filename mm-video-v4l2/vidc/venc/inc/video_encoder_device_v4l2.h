@@ -38,17 +38,13 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "omx_video_base.h"
 #include "omx_video_encoder.h"
 #include <linux/videodev2.h>
+#include "v4l2_ctrl_batch.h"
 #include <poll.h>
 
 #define TIMEOUT 5*60*1000
 #define BIT(num) (1 << (num))
 #define MAX_HYB_HIERP_LAYERS 6
 
-extern "C" {
-    void neon_clip_luma_chroma(unsigned char *, unsigned char *,
-            unsigned int, unsigned int, unsigned int, unsigned int);
-}
-
 enum hier_type {
     HIER_NONE = 0x0,
     HIER_P = 0x1,
@@ -283,6 +279,8 @@ class venc_dev
         ~venc_dev(); //des
 
         static void* async_venc_message_thread (void *);
+        static void* venc_event_loop (void *);
+        static int venc_process_driver_events(void *, int, short, struct statistics *);
         bool venc_open(OMX_U32);
         void venc_close();
         unsigned venc_stop(void);
@@ -296,6 +294,7 @@ class venc_dev
         unsigned venc_start_done(void);
         unsigned venc_stop_done(void);
         unsigned venc_set_message_thread_id(pthread_t);
+        unsigned venc_set_event_loop(void);
         bool venc_use_buf(void*, unsigned,unsigned);
         bool venc_free_buf(void*, unsigned);
         bool venc_empty_buf(void *, void *,unsigned,unsigned);
@@ -350,6 +349,10 @@ class venc_dev
         bool m_max_allowed_bitrate_check;
         pthread_t m_tid;
         bool async_thread_created;
+        // the message thread also polls the driver, see venc_event_loop
+        bool m_event_loop;
+        // posted once venc_event_loop no longer polls m_nDriver_fd
+        sem_t m_loop_detached;
         class omx_venc *venc_handle;
         OMX_ERRORTYPE allocate_extradata();
         void free_extradata();
@@ -395,6 +398,8 @@ class venc_dev
         struct msm_venc_low_latency         low_latency;
         struct msm_venc_hybrid_hp           hybrid_hp;
         struct msm_venc_color_space         color_space;
+        v4l2_ctrl_batch                     m_ctrl_batch;
+        bool                                m_batch_config;
 
         bool venc_set_profile_level(OMX_U32 eProfile,OMX_U32 eLevel);
         bool venc_set_intra_period(OMX_U32 nPFrames, OMX_U32 nBFrames);
@@ -441,6 +446,10 @@ class venc_dev
         bool venc_set_max_hierp(OMX_U32 hierp_layers);
         bool venc_set_lowlatency_mode(OMX_BOOL enable);
         void venc_clip_luma_chroma(int fd, OMX_U32 offset, OMX_U32 size);
+        bool venc_get_clip_limits(OMX_U8 *luma_max, OMX_U8 *chroma_max);
+        static void venc_clip_band(void *arg, unsigned int row, unsigned int rows);
+        int venc_set_ctrl(struct v4l2_control *control);
+        bool venc_apply_config(void *configData, OMX_INDEXTYPE index);
         bool venc_set_layer_bitrates(QOMX_EXTNINDEX_VIDEO_HYBRID_HP_MODE* hpmode);
         bool venc_set_colorspace(OMX_U32 primaries, OMX_U32 range, OMX_U32 transfer_chars, OMX_U32 matrix_coeffs);
         bool venc_set_iframesize_type(QOMX_VIDEO_IFRAMESIZE_TYPE type);
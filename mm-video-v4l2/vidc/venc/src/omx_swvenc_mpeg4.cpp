@@ -115,7 +115,6 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
     SWVENC_CALLBACK callBackInfo;
     OMX_VIDEO_CODINGTYPE codec_type;
     SWVENC_PROPERTY Prop;
-    int fds[2];
 
     strlcpy((char *)m_nkind,role,OMX_MAX_STRINGNAME_SIZE);
     secure_session = false;
@@ -417,33 +416,19 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
 
     if (eRet == OMX_ErrorNone)
     {
-        if (pipe(fds))
+        if (!m_msg_doorbell.open())
         {
-            DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
+            DEBUG_PRINT_ERROR("ERROR: message doorbell creation failed");
             eRet = OMX_ErrorInsufficientResources;
         }
         else
         {
-            if ((fds[0] == 0) || (fds[1] == 0))
-            {
-                if (pipe(fds))
-                {
-                    DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
-                    eRet = OMX_ErrorInsufficientResources;
-                }
+            if (pthread_create(&msg_thread_id,0, message_thread_enc, this) < 0) {
+                eRet = OMX_ErrorInsufficientResources;
+                msg_thread_created = false;
             }
-            if (eRet == OMX_ErrorNone)
-            {
-                m_pipe_in = fds[0];
-                m_pipe_out = fds[1];
-
-                if (pthread_create(&msg_thread_id,0, message_thread_enc, this) < 0) {
-                    eRet = OMX_ErrorInsufficientResources;
-                    msg_thread_created = false;
-                }
-                else {
-                    msg_thread_created = true;
-                }
+            else {
+                msg_thread_created = true;
             }
         }
     }
@@ -1796,7 +1781,12 @@ bool omx_venc::dev_empty_buf
               size = handle->size;
           }
        }
-       ipbuffer.p_buffer = (unsigned char *)mmap(NULL, size, PROT_READ|PROT_WRITE,MAP_SHARED, fd, offset);
+       ipbuffer.p_buffer = (unsigned char *)m_input_maps.get(fd, offset, size);
+       if (ipbuffer.p_buffer == NULL)
+       {
+          DEBUG_PRINT_ERROR("%s, mapping fd %u failed", __FUNCTION__, fd);
+          RETURN(false);
+       }
        ipbuffer.size = size;
        ipbuffer.filled_length = size;
     }
@@ -1827,6 +1817,10 @@ bool omx_venc::dev_empty_buf
     {
        DEBUG_PRINT_ERROR("%s, swvenc_emptythisbuffer failed (%d)",
          __FUNCTION__, Ret);
+       if (meta_mode_enable)
+       {
+          m_input_maps.put(ipbuffer.p_buffer, ipbuffer.size);
+       }
        RETURN(false);
     }
 
@@ -2162,6 +2156,24 @@ bool omx_venc::dev_get_output_log_flag()
     RETURN(m_debug.out_buffer_log == 1);
 }
 
+bool omx_venc::dev_reads_heap_input()
+{
+    ENTER_FUNC();
+
+    /* dev_empty_buf encodes from bufhdr->pBuffer, the internal copy is unused */
+    RETURN(true);
+}
+
+bool omx_venc::dev_get_clip_limits(OMX_U8 *luma_max, OMX_U8 *chroma_max)
+{
+    ENTER_FUNC();
+
+    (void)luma_max;
+    (void)chroma_max;
+
+    RETURN(false);
+}
+
 int omx_venc::dev_output_log_buffers(const char *buffer, int bufferlen)
 {
     ENTER_FUNC();
@@ -2381,8 +2393,8 @@ SWVENC_STATUS omx_venc::swvenc_empty_buffer_done
                   size = handle->size;
               }
            }
-           int status = munmap(p_ipbuffer->p_buffer, size);
-           DEBUG_PRINT_HIGH("Unmapped pBuffer <%p> size <%d> status <%d>", p_ipbuffer->p_buffer, size, status);
+           m_input_maps.put(p_ipbuffer->p_buffer, size);
+           DEBUG_PRINT_LOW("Released pBuffer <%p> size <%d>", p_ipbuffer->p_buffer, size);
         }
 #endif
         post_event ((unsigned long)omxhdr,error,OMX_COMPONENT_GENERATE_EBD);
@@ -2444,14 +2456,7 @@ SWVENC_STATUS omx_venc::swvenc_fill_buffer_done_cb
             }
             DEBUG_PRINT_LOW("o/p flag = 0x%x", omxhdr->nFlags);
 
-            /* Use buffer case */
-            if (omx->output_use_buffer && !omx->m_use_output_pmem)
-            {
-                DEBUG_PRINT_LOW("memcpy() for o/p Heap UseBuffer");
-                memcpy( omxhdr->pBuffer,
-                        (p_opbuffer->p_buffer),
-                        p_opbuffer->filled_length );
-            }
+            /* The encoder writes into pBuffer, heap UseBuffer included */
         }
         else
         {
@@ -101,65 +101,49 @@ typedef struct OMXComponentCapabilityFlagsType {
 void* enc_message_thread(void *input)
 {
     omx_video* omx = reinterpret_cast<omx_video*>(input);
-    unsigned char id;
-    int n;
-
-    fd_set readFds;
     int res = 0;
-    struct timeval tv;
 
     DEBUG_PRINT_HIGH("omx_venc: message thread start");
     prctl(PR_SET_NAME, (unsigned long)"VideoEncMsgThread", 0, 0, 0);
+    omx->m_thread_sched.attach(thread_sched::ROLE_MESSAGE);
      while (!omx->msg_thread_stop) {
-
-        tv.tv_sec = 2;
-        tv.tv_usec = 0;
-
-        FD_ZERO(&readFds);
-        FD_SET(omx->m_pipe_in, &readFds);
-
-        res = select(omx->m_pipe_in + 1, &readFds, NULL, NULL, &tv);
+        res = omx->m_msg_doorbell.wait(2000);
         if (res < 0) {
-            DEBUG_PRINT_ERROR("select() ERROR: %s", strerror(errno));
-            continue;
-        } else if (res == 0 /*timeout*/ || omx->msg_thread_stop) {
-            continue;
-        }
-
-        n = read(omx->m_pipe_in, &id, 1);
-        if (0 == n) {
+#ifdef QLE_BUILD
             break;
-        }
-
-        if (1 == n) {
-            if (omx->omx_close_msg_thread(id)) {
+#else
+            if (errno != EINTR) {
+                DEBUG_PRINT_ERROR("message doorbell ERROR: %s", strerror(errno));
                 break;
             }
-            omx->process_event_cb(omx, id);
-        }
-#ifdef QLE_BUILD
-        if (n < 0) break;
-#else
-        if ((n < 0) && (errno != EINTR)) {
-            DEBUG_PRINT_LOW("ERROR: read from pipe failed, ret %d errno %d", n, errno);
-            break;
-        }
+            continue;
 #endif
+        } else if (res == 0 /*timeout*/ || omx->msg_thread_stop) {
+            continue;
+        }
+        /* One ring covers every message posted so far, drain them all */
+        omx->process_event_cb(omx, 0);
     }
+    omx->m_thread_sched.detach(thread_sched::ROLE_MESSAGE);
     DEBUG_PRINT_HIGH("omx_venc: message thread stop");
     return 0;
 }
 
+/* vidc.enc.worker_pool: the same drain, run on the shared pool */
+void enc_message_work(void *input)
+{
+    omx_video* omx = reinterpret_cast<omx_video*>(input);
+
+    omx->process_event_cb(omx, 0);
+}
+
 void post_message(omx_video *omx, unsigned char id)
 {
     DEBUG_PRINT_LOW("omx_venc: post_message %d", id);
-    int ret_value;
-    ret_value = write(omx->m_pipe_out, &id, 1);
-    if (ret_value <= 0) {
-        DEBUG_PRINT_ERROR("post_message to pipe failed : %s", strerror(errno));
-    } else {
-        DEBUG_PRINT_LOW("post_message to pipe done %d",ret_value);
-    }
+    if (omx->m_msg_strand.is_open())
+        omx->m_msg_strand.post();
+    else
+        omx->m_msg_doorbell.ring();
 }
 
 // omx_cmd_queue destructor
@@ -240,8 +224,6 @@ omx_video::omx_video():
     pdest_frame(NULL),
     secure_session(false),
     mEmptyEosBuffer(NULL),
-    m_pipe_in(-1),
-    m_pipe_out(-1),
     m_pInput_pmem(NULL),
     m_pOutput_pmem(NULL),
 #ifdef USE_ION
@@ -280,6 +262,25 @@ omx_video::omx_video():
     async_thread_created = false;
     msg_thread_created = false;
     msg_thread_stop = false;
+    m_worker_pool = false;
+    m_event_loop = false;
+    m_conv_head = 0;
+    m_conv_count = 0;
+    m_conv_waited = 0;
+    m_conv_depth = 1;
+    m_conv_thread_created = false;
+    m_conv_thread_stop = false;
+    m_ion_pool = NULL;
+    pthread_mutex_init(&m_conv_lock, NULL);
+    pthread_cond_init(&m_conv_cond, NULL);
+    m_copy_head = 0;
+    m_copy_count = 0;
+    m_copy_done = 0;
+    m_heap_copy_async = false;
+    m_copy_thread_created = false;
+    m_copy_thread_stop = false;
+    pthread_mutex_init(&m_copy_lock, NULL);
+    pthread_cond_init(&m_copy_cond, NULL);
 
     mUsesColorConversion = false;
     pthread_mutex_init(&m_lock, NULL);
@@ -306,6 +307,26 @@ omx_video::omx_video():
 omx_video::~omx_video()
 {
     DEBUG_PRINT_HIGH("~omx_video(): Inside Destructor()");
+    if (m_conv_thread_created) {
+        pthread_mutex_lock(&m_conv_lock);
+        m_conv_thread_stop = true;
+        pthread_cond_broadcast(&m_conv_cond);
+        pthread_mutex_unlock(&m_conv_lock);
+        DEBUG_PRINT_HIGH("omx_video: Waiting on Conversion Thread exit");
+        pthread_join(m_conv_thread_id, NULL);
+    }
+    pthread_cond_destroy(&m_conv_cond);
+    pthread_mutex_destroy(&m_conv_lock);
+    if (m_copy_thread_created) {
+        pthread_mutex_lock(&m_copy_lock);
+        m_copy_thread_stop = true;
+        pthread_cond_broadcast(&m_copy_cond);
+        pthread_mutex_unlock(&m_copy_lock);
+        DEBUG_PRINT_HIGH("omx_video: Waiting on Heap Copy Thread exit");
+        pthread_join(m_copy_thread_id, NULL);
+    }
+    pthread_cond_destroy(&m_copy_cond);
+    pthread_mutex_destroy(&m_copy_lock);
     if (msg_thread_created) {
         msg_thread_stop = true;
         DEBUG_PRINT_HIGH("Signalling close to OMX Msg Thread");
@@ -313,10 +334,8 @@ omx_video::~omx_video()
         DEBUG_PRINT_HIGH("omx_video: Waiting on Msg Thread exit");
         pthread_join(msg_thread_id,NULL);
     }
-    if (m_pipe_in >= 0) close(m_pipe_in);
-    if (m_pipe_out >= 0) close(m_pipe_out);
-    m_pipe_in = -1;
-    m_pipe_out = -1;
+    m_msg_strand.close();
+    m_msg_doorbell.close();
     DEBUG_PRINT_HIGH("omx_video: Waiting on Async Thread exit");
     /*For V4L2 based drivers, pthread_join is done in device_close
      * so no need to do it here*/
@@ -445,6 +464,24 @@ void omx_video::process_event_cb(void *ctxt, unsigned char id)
                         DEBUG_PRINT_ERROR("ERROR: ProcessMsgCb NULL callbacks");
                     }
                     break;
+                case OMX_COMPONENT_GENERATE_CONV_DONE:
+                    if (pThis->complete_conversions(&pThis->m_cmp) != OMX_ErrorNone) {
+                        DEBUG_PRINT_ERROR("ERROR: complete_conversions() failed!");
+                        pThis->omx_report_error ();
+                    }
+                    break;
+                case OMX_COMPONENT_GENERATE_COPY_DONE: {
+                        OMX_ERRORTYPE iret;
+                        iret = pThis->complete_heap_copies();
+                        if (iret == OMX_ErrorInsufficientResources) {
+                            DEBUG_PRINT_ERROR("complete_heap_copies failure due to HW overload");
+                            pThis->omx_report_hw_overload ();
+                        } else if (iret != OMX_ErrorNone) {
+                            DEBUG_PRINT_ERROR("ERROR: complete_heap_copies() failed!");
+                            pThis->omx_report_error ();
+                        }
+                    }
+                    break;
                 case OMX_COMPONENT_GENERATE_ETB_OPQ:
                     DEBUG_PRINT_LOW("OMX_COMPONENT_GENERATE_ETB_OPQ");
                     if (pThis->empty_this_buffer_opaque((OMX_HANDLETYPE)p1,\
@@ -1296,6 +1333,10 @@ bool omx_video::execute_input_flush(void)
     /*Generate EBD for all Buffers in the ETBq*/
     DEBUG_PRINT_LOW("execute_input_flush");
 
+    drain_conversions(false);
+    drain_heap_copies(false);
+    /* No blit is pending, drop the GPU mappings of client buffers */
+    c2d_conv.flush();
     pthread_mutex_lock(&m_lock);
     while (m_etb_q.m_size) {
         m_etb_q.pop_entry(&p1,&p2,&ident);
@@ -1357,6 +1398,8 @@ bool omx_video::execute_flush_all(void)
 
     DEBUG_PRINT_LOW("execute_flush_all");
 
+    drain_conversions(false);
+    drain_heap_copies(false);
     /*Generate EBD for all Buffers in the ETBq*/
     pthread_mutex_lock(&m_lock);
     while (m_etb_q.m_size) {
@@ -2135,6 +2178,23 @@ OMX_ERRORTYPE  omx_video::get_config(OMX_IN OMX_HANDLETYPE      hComp,
                 }
                 break;
             }
+       case OMX_QTIIndexConfigThreadScheduling:
+            {
+                VALIDATE_OMX_PARAM_DATA(configData, QOMX_CONFIG_THREAD_SCHEDULING);
+                QOMX_CONFIG_THREAD_SCHEDULING* pParam =
+                    reinterpret_cast<QOMX_CONFIG_THREAD_SCHEDULING*>(configData);
+                thread_sched::config cfg;
+                DEBUG_PRINT_LOW("get_config: OMX_QTIIndexConfigThreadScheduling");
+                // QOMX_THREAD_ROLE values are the thread_sched roles
+                if ((OMX_U32)pParam->eRole >= thread_sched::ROLE_MAX) {
+                    return OMX_ErrorBadParameter;
+                }
+                m_thread_sched.get(pParam->eRole, &cfg);
+                pParam->nCpuMask = cfg.cpu_mask;
+                pParam->nNice = cfg.nice;
+                pParam->nFifoPriority = cfg.fifo_priority;
+                break;
+            }
 #ifdef SUPPORT_CONFIG_INTRA_REFRESH
        case OMX_IndexConfigAndroidIntraRefresh:
            {
@@ -2208,6 +2268,11 @@ OMX_ERRORTYPE  omx_video::get_extension_index(OMX_IN OMX_HANDLETYPE      hComp,
         return OMX_ErrorNone;
     }
 
+    if (extn_equals(paramName, OMX_QTI_INDEX_CONFIG_THREAD_SCHEDULING)) {
+        *indexType = (OMX_INDEXTYPE)OMX_QTIIndexConfigThreadScheduling;
+        return OMX_ErrorNone;
+    }
+
     return OMX_ErrorNotImplemented;
 }
 
@@ -2704,6 +2769,9 @@ OMX_ERRORTYPE omx_video::free_input_buffer(OMX_BUFFERHEADERTYPE *bufferHdr)
         return OMX_ErrorBadParameter;
     }
 
+    /* The client may release the buffers it queued once the port goes */
+    m_input_maps.invalidate();
+
     index = bufferHdr - ((!meta_mode_enable)?m_inp_mem_ptr:meta_buffer_hdr);
 #ifdef _ANDROID_ICS_
     if (meta_mode_enable) {
@@ -2714,6 +2782,8 @@ OMX_ERRORTYPE omx_video::free_input_buffer(OMX_BUFFERHEADERTYPE *bufferHdr)
         if (!mUseProxyColorFormat)
             return OMX_ErrorNone;
         else {
+            drain_conversions(false);
+            c2d_conv.flush();
             c2d_conv.close();
             opaque_buffer_hdr[index] = NULL;
         }
@@ -2742,6 +2812,7 @@ OMX_ERRORTYPE omx_video::free_input_buffer(OMX_BUFFERHEADERTYPE *bufferHdr)
         } else if (m_pInput_pmem[index].fd > 0 && (input_use_buffer == true &&
                     m_use_input_pmem == OMX_FALSE)) {
             DEBUG_PRINT_LOW("FreeBuffer:: i/p Heap UseBuffer case");
+            drain_heap_copies(false);
             if (dev_free_buf(&m_pInput_pmem[index],PORT_INDEX_IN) != true) {
                 DEBUG_PRINT_ERROR("ERROR: dev_free_buf() Failed for i/p buf");
             }
@@ -3686,15 +3757,24 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE  hComp,
     if (input_use_buffer && !m_use_input_pmem && m_pInput_pmem[nBufIndex].buffer)
 #endif
     {
-        DEBUG_PRINT_LOW("Heap UseBuffer case, so memcpy the data");
+        if (m_heap_copy_async) {
+#ifdef _MSM8974_
+            return submit_heap_copy(buffer, nBufIndex, fd);
+#else
+            return submit_heap_copy(buffer, nBufIndex, 0);
+#endif
+        }
 
         auto_lock l(m_buf_lock);
         pmem_data_buf = (OMX_U8 *)m_pInput_pmem[nBufIndex].buffer;
-        if (pmem_data_buf && BITMASK_PRESENT(&m_client_in_bm_count, nBufIndex)) {
+        if (dev_reads_heap_input()) {
+            DEBUG_PRINT_LOW("Heap UseBuffer case, encoding from the client buffer");
+        } else if (pmem_data_buf && BITMASK_PRESENT(&m_client_in_bm_count, nBufIndex)) {
+            DEBUG_PRINT_LOW("Heap UseBuffer case, so memcpy the data");
             memcpy (pmem_data_buf, (buffer->pBuffer + buffer->nOffset),
                     buffer->nFilledLen);
+            DEBUG_PRINT_LOW("memcpy() done in ETBProxy for i/p Heap UseBuf");
         }
-        DEBUG_PRINT_LOW("memcpy() done in ETBProxy for i/p Heap UseBuf");
     } else if (mUseProxyColorFormat) {
         // Gralloc-source buffers with color-conversion
         fd = m_pInput_pmem[nBufIndex].fd;
@@ -4533,20 +4613,12 @@ int omx_video::alloc_map_ion_memory(int size,
         struct ion_allocation_data *alloc_data,
         struct ion_fd_data *fd_data,int flag)
 {
-    struct venc_ion buf_ion_info;
     int ion_device_fd =-1,rc=0,ion_dev_flags = 0;
     if (size <=0 || !alloc_data || !fd_data) {
         DEBUG_PRINT_ERROR("Invalid input to alloc_map_ion_memory");
         return -EINVAL;
     }
 
-    ion_dev_flags = O_RDONLY;
-    ion_device_fd = open (MEM_DEVICE,ion_dev_flags);
-    if (ion_device_fd < 0) {
-        DEBUG_PRINT_ERROR("ERROR: ION Device open() Failed");
-        return ion_device_fd;
-    }
-
     if(secure_session) {
         alloc_data->len = (size + (SZ_1M - 1)) & ~(SZ_1M - 1);
         alloc_data->align = SZ_1M;
@@ -4570,22 +4642,36 @@ int omx_video::alloc_map_ion_memory(int size,
                 alloc_data->flags);
     }
 
-    rc = ioctl(ion_device_fd,ION_IOC_ALLOC,alloc_data);
-    if (rc || !alloc_data->handle) {
-        DEBUG_PRINT_ERROR("ION ALLOC memory failed 0x%x", rc);
-        alloc_data->handle = 0;
-        close(ion_device_fd);
-        ion_device_fd = -1;
-        return ion_device_fd;
+    if (m_ion_pool && !secure_session) {
+        ion_device_fd = m_ion_pool->get(alloc_data);
+        if (ion_device_fd < 0)
+            alloc_data->len = ion_pool::class_size(alloc_data->len);
+    }
+    if (ion_device_fd < 0) {
+        ion_dev_flags = O_RDONLY;
+        ion_device_fd = open (MEM_DEVICE,ion_dev_flags);
+        if (ion_device_fd < 0) {
+            DEBUG_PRINT_ERROR("ERROR: ION Device open() Failed");
+            return ion_device_fd;
+        }
+        rc = ioctl(ion_device_fd,ION_IOC_ALLOC,alloc_data);
+        if (rc || !alloc_data->handle) {
+            DEBUG_PRINT_ERROR("ION ALLOC memory failed 0x%x", rc);
+            alloc_data->handle = 0;
+            close(ion_device_fd);
+            ion_device_fd = -1;
+            return ion_device_fd;
+        }
     }
     fd_data->handle = alloc_data->handle;
     rc = ioctl(ion_device_fd,ION_IOC_MAP,fd_data);
     if (rc) {
         DEBUG_PRINT_ERROR("ION MAP failed ");
-        buf_ion_info.ion_alloc_data = *alloc_data;
-        buf_ion_info.ion_device_fd = ion_device_fd;
-        buf_ion_info.fd_ion_data = *fd_data;
-        free_ion_memory(&buf_ion_info);
+        /* Not given back to the pool, the handle may be what failed */
+        if (ioctl(ion_device_fd, ION_IOC_FREE, &alloc_data->handle))
+            DEBUG_PRINT_ERROR("ION free failed ");
+        close(ion_device_fd);
+        alloc_data->handle = 0;
         fd_data->fd =-1;
         ion_device_fd =-1;
     }
@@ -4598,12 +4684,16 @@ void omx_video::free_ion_memory(struct venc_ion *buf_ion_info)
         DEBUG_PRINT_ERROR("Invalid input to free_ion_memory");
         return;
     }
-    if (ioctl(buf_ion_info->ion_device_fd,ION_IOC_FREE,
-                &buf_ion_info->ion_alloc_data.handle)) {
-        DEBUG_PRINT_ERROR("ION free failed ");
-        return;
+    /* Kept for the next allocation, the pool owns the client then */
+    if (!m_ion_pool || !m_ion_pool->put(buf_ion_info->ion_device_fd,
+                &buf_ion_info->ion_alloc_data)) {
+        if (ioctl(buf_ion_info->ion_device_fd,ION_IOC_FREE,
+                    &buf_ion_info->ion_alloc_data.handle)) {
+            DEBUG_PRINT_ERROR("ION free failed ");
+            return;
+        }
+        close(buf_ion_info->ion_device_fd);
     }
-    close(buf_ion_info->ion_device_fd);
     buf_ion_info->ion_alloc_data.handle = 0;
     buf_ion_info->ion_device_fd = -1;
     buf_ion_info->fd_ion_data.fd = -1;
@@ -4667,6 +4757,10 @@ omx_video::omx_c2d_conv::omx_c2d_conv()
     mConvertOpen = NULL;
     mConvertClose = NULL;
     src_format = NV12_128m;
+    m_executor = NULL;
+    m_height = 0;
+    m_split_rows = false;
+    m_clips_output = false;
     pthread_mutex_init(&c_lock, NULL);
 }
 
@@ -4707,13 +4801,91 @@ bool omx_video::omx_c2d_conv::convert(int src_fd, void *src_base, void *src_vira
         return false;
     }
     pthread_mutex_lock(&c_lock);
-    result =  c2dcc->convertC2D(src_fd, src_base, src_viraddr,
-            dest_fd, dest_base, dest_viraddr);
+    if (m_split_rows && m_executor && m_executor->threads() > 1)
+        result = convert_rows(src_viraddr, dest_viraddr);
+    else
+        result =  c2dcc->convertC2D(src_fd, src_base, src_viraddr,
+                dest_fd, dest_base, dest_viraddr);
     pthread_mutex_unlock(&c_lock);
     DEBUG_PRINT_LOW("Color convert status %d",result);
     return ((result < 0)?false:true);
 }
 
+/* Called with c_lock held */
+int omx_video::omx_c2d_conv::convert_rows(void *src_viraddr, void *dest_viraddr)
+{
+    conv_band band = {c2dcc, src_viraddr, dest_viraddr, 0};
+
+    m_executor->run(convert_band, &band, m_height);
+    return __atomic_load_n(&band.result, __ATOMIC_RELAXED);
+}
+
+void omx_video::omx_c2d_conv::convert_band(void *arg, unsigned int row, unsigned int rows)
+{
+    conv_band *band = (conv_band *)arg;
+
+    if (band->c2dcc->convertRows(band->src, band->dest, row, rows) < 0)
+        __atomic_store_n(&band->result, -1, __ATOMIC_RELAXED);
+}
+
+void omx_video::omx_c2d_conv::set_executor(band_executor *executor)
+{
+    pthread_mutex_lock(&c_lock);
+    m_executor = executor;
+    pthread_mutex_unlock(&c_lock);
+}
+
+bool omx_video::omx_c2d_conv::set_clip(OMX_U8 luma_max, OMX_U8 chroma_max)
+{
+    pthread_mutex_lock(&c_lock);
+    m_clips_output = c2dcc && c2dcc->setOutputClip(luma_max, chroma_max) == 0;
+    pthread_mutex_unlock(&c_lock);
+    return m_clips_output;
+}
+
+bool omx_video::omx_c2d_conv::convert_async(int src_fd, void *src_base, void *src_viraddr,
+        int dest_fd, void *dest_base, void *dest_viraddr, c2d_ts_handle *ts)
+{
+    int result;
+    if (!src_viraddr || !dest_viraddr || !c2dcc || !src_base || !dest_base || !ts) {
+        DEBUG_PRINT_ERROR("Invalid arguments omx_c2d_conv::convert_async");
+        return false;
+    }
+    pthread_mutex_lock(&c_lock);
+    if (m_split_rows && m_executor && m_executor->threads() > 1) {
+        /* CPU conversions finish here, there is nothing to wait for */
+        result = convert_rows(src_viraddr, dest_viraddr);
+        *ts = NULL;
+    } else {
+        result = c2dcc->convertC2DAsync(src_fd, src_base, src_viraddr,
+                dest_fd, dest_base, dest_viraddr, ts);
+    }
+    pthread_mutex_unlock(&c_lock);
+    DEBUG_PRINT_LOW("Color convert submit status %d",result);
+    return ((result < 0)?false:true);
+}
+
+/*
+ * Waits without c_lock so that the next blits can be submitted meanwhile,
+ * the converter guards its own state. Conversions are drained before the
+ * converter is closed.
+ */
+bool omx_video::omx_c2d_conv::wait(c2d_ts_handle ts)
+{
+    C2DColorConverterBase *cc;
+    int result;
+    pthread_mutex_lock(&c_lock);
+    cc = c2dcc;
+    pthread_mutex_unlock(&c_lock);
+    if (!cc) {
+        DEBUG_PRINT_ERROR("Invalid state omx_c2d_conv::wait");
+        return false;
+    }
+    result = cc->waitC2D(ts);
+    DEBUG_PRINT_LOW("Color convert wait status %d",result);
+    return ((result < 0)?false:true);
+}
+
 bool omx_video::omx_c2d_conv::open(unsigned int height,unsigned int width,
         ColorConvertFormat src, ColorConvertFormat dest,unsigned int src_stride)
 {
@@ -4724,6 +4896,8 @@ bool omx_video::omx_c2d_conv::open(unsigned int height,unsigned int width,
                 src,dest,0,src_stride);
         if (c2dcc) {
             src_format = src;
+            m_height = height;
+            m_split_rows = c2dcc->canConvertRows();
             status = true;
         } else
             DEBUG_PRINT_ERROR("mConvertOpen failed");
@@ -4732,12 +4906,22 @@ bool omx_video::omx_c2d_conv::open(unsigned int height,unsigned int width,
     return status;
 }
 
+void omx_video::omx_c2d_conv::flush()
+{
+    pthread_mutex_lock(&c_lock);
+    if (c2dcc)
+        c2dcc->flushMappings();
+    pthread_mutex_unlock(&c_lock);
+}
+
 void omx_video::omx_c2d_conv::close()
 {
     if (mLibHandle) {
         pthread_mutex_lock(&c_lock);
         if (mConvertClose && c2dcc)
             mConvertClose(c2dcc);
+        m_split_rows = false;
+        m_clips_output = false;
         pthread_mutex_unlock(&c_lock);
         c2dcc = NULL;
     }
@@ -4843,6 +5027,7 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_opaque(OMX_IN OMX_HANDLETYPE hComp,
             mUsesColorConversion = false;
 
         if (c2d_opened && handle->format != c2d_conv.get_src_format()) {
+            drain_conversions(true);
             c2d_conv.close();
             c2d_opened = false;
         }
@@ -4859,6 +5044,10 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_opaque(OMX_IN OMX_HANDLETYPE hComp,
                     return OMX_ErrorBadParameter;
                 }
                 c2d_opened = true;
+                OMX_U8 luma_max, chroma_max;
+                if (dev_get_clip_limits(&luma_max, &chroma_max) &&
+                        c2d_conv.set_clip(luma_max, chroma_max))
+                    DEBUG_PRINT_INFO("Color conv clips to %u/%u", luma_max, chroma_max);
 #ifdef _MSM8974_
                 if (!dev_set_format(handle->format))
                     DEBUG_PRINT_ERROR("cannot set color format for RGBA8888");
@@ -4962,10 +5151,9 @@ OMX_ERRORTYPE omx_video::convert_queue_buffer(OMX_HANDLETYPE hComp,
                     pdest_frame, (unsigned int)pdest_frame->nFilledLen);
         }
     } else {
-        uva = (unsigned char *)mmap(NULL, Input_pmem_info.size,
-                PROT_READ|PROT_WRITE,
-                MAP_SHARED,Input_pmem_info.fd,0);
-        if (uva == MAP_FAILED) {
+        uva = (unsigned char *)m_input_maps.get(Input_pmem_info.fd, 0,
+                Input_pmem_info.size);
+        if (!uva) {
             ret = OMX_ErrorBadParameter;
         } else {
             if (!c2d_conv.convert(Input_pmem_info.fd, uva, uva,
@@ -4985,7 +5173,7 @@ OMX_ERRORTYPE omx_video::convert_queue_buffer(OMX_HANDLETYPE hComp,
                             pdest_frame, (unsigned int)pdest_frame->nFilledLen);
                 }
             }
-            munmap(uva,Input_pmem_info.size);
+            m_input_maps.put(uva,Input_pmem_info.size);
         }
     }
     if (dev_use_buf(&m_pInput_pmem[index],PORT_INDEX_IN,0) != true) {
@@ -5012,6 +5200,345 @@ OMX_ERRORTYPE omx_video::convert_queue_buffer(OMX_HANDLETYPE hComp,
     return ret;
 }
 
+/*
+ * vidc.enc.conv_depth > 1: the blit is only submitted here and the next
+ * source frame goes on. conv_thread waits for the GPU and posts
+ * OMX_COMPONENT_GENERATE_CONV_DONE, complete_conversions() then queues
+ * the converted frames to the encoder in submission order. Each blit in
+ * flight has surfaces of its own in the converter, up to C2D_MAX_ASYNC.
+ */
+OMX_ERRORTYPE omx_video::submit_conversion(OMX_HANDLETYPE hComp,
+        struct pmem &Input_pmem_info,unsigned long &index)
+{
+    unsigned long address = 0,p2,id;
+    conv_job *job;
+    void *uva;
+
+    DEBUG_PRINT_LOW("In submit conversion");
+    if (!psource_frame || !pdest_frame) {
+        DEBUG_PRINT_ERROR("submit_conversion invalid params");
+        return OMX_ErrorBadParameter;
+    }
+    if (secure_session) {
+        DEBUG_PRINT_ERROR("cannot convert buffer during secure session");
+        return OMX_ErrorInvalidState;
+    }
+    if (!m_conv_thread_created) {
+        if (pthread_create(&m_conv_thread_id, 0, conv_thread, this) != 0) {
+            DEBUG_PRINT_ERROR("Conversion thread creation failed, converting inline");
+            m_conv_depth = 1;
+            return convert_queue_buffer(hComp,Input_pmem_info,index);
+        }
+        m_conv_thread_created = true;
+    }
+
+    uva = m_input_maps.get(Input_pmem_info.fd, 0, Input_pmem_info.size);
+    if (!uva)
+        return OMX_ErrorBadParameter;
+
+    job = &m_conv_jobs[(m_conv_head + m_conv_count) % MAX_CONV_DEPTH];
+    job->source = psource_frame;
+    job->dest = pdest_frame;
+    job->index = index;
+    job->uva = uva;
+    job->size = Input_pmem_info.size;
+    job->failed = false;
+    if (!c2d_conv.convert_async(Input_pmem_info.fd, uva, uva,
+                m_pInput_pmem[index].fd, pdest_frame->pBuffer, pdest_frame->pBuffer,
+                &job->ts)) {
+        DEBUG_PRINT_ERROR("Color Conversion submit failed");
+        m_input_maps.put(uva, Input_pmem_info.size);
+        return OMX_ErrorBadParameter;
+    }
+
+    pthread_mutex_lock(&m_conv_lock);
+    m_conv_count++;
+    pthread_cond_broadcast(&m_conv_cond);
+    pthread_mutex_unlock(&m_conv_lock);
+
+    psource_frame = NULL;
+    pdest_frame = NULL;
+    if (m_opq_meta_q.m_size) {
+        m_opq_meta_q.pop_entry(&address,&p2,&id);
+        psource_frame = (OMX_BUFFERHEADERTYPE* ) address;
+    }
+    if (m_opq_pmem_q.m_size) {
+        m_opq_pmem_q.pop_entry(&address,&p2,&id);
+        pdest_frame = (OMX_BUFFERHEADERTYPE* ) address;
+        DEBUG_PRINT_LOW("pdest_frame pop address is %p",pdest_frame);
+    }
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE omx_video::queue_conversion(OMX_HANDLETYPE hComp, conv_job &job)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+
+    m_input_maps.put(job.uva, job.size);
+    if (job.failed) {
+        DEBUG_PRINT_ERROR("Color Conversion failed");
+        ret = OMX_ErrorBadParameter;
+    } else {
+        unsigned int buf_size = 0;
+        if (!c2d_conv.get_buffer_size(C2D_OUTPUT,buf_size)) {
+            ret = OMX_ErrorBadParameter;
+        } else {
+            job.dest->nOffset = 0;
+            job.dest->nFilledLen = buf_size;
+            job.dest->nTimeStamp = job.source->nTimeStamp;
+            job.dest->nFlags = job.source->nFlags;
+            DEBUG_PRINT_LOW("Buffer header %p Filled len size %u",
+                    job.dest, (unsigned int)job.dest->nFilledLen);
+        }
+    }
+    if (ret == OMX_ErrorNone &&
+            dev_use_buf(&m_pInput_pmem[job.index],PORT_INDEX_IN,0) != true) {
+        DEBUG_PRINT_ERROR("ERROR: in dev_use_buf");
+        ret = OMX_ErrorBadParameter;
+    }
+    if (ret == OMX_ErrorNone)
+        ret = empty_this_buffer_proxy(hComp,job.dest);
+    if (ret != OMX_ErrorNone)
+        m_opq_pmem_q.insert_entry((unsigned long)job.dest,0,0);
+    m_pCallbacks.EmptyBufferDone(hComp ,m_app_data, job.source);
+    return ret;
+}
+
+OMX_ERRORTYPE omx_video::complete_conversions(OMX_HANDLETYPE hComp)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    conv_job job;
+
+    pthread_mutex_lock(&m_conv_lock);
+    while (m_conv_waited && ret == OMX_ErrorNone) {
+        job = m_conv_jobs[m_conv_head];
+        m_conv_head = (m_conv_head + 1) % MAX_CONV_DEPTH;
+        m_conv_count--;
+        m_conv_waited--;
+        pthread_mutex_unlock(&m_conv_lock);
+        ret = queue_conversion(hComp, job);
+        pthread_mutex_lock(&m_conv_lock);
+    }
+    pthread_mutex_unlock(&m_conv_lock);
+
+    if (ret == OMX_ErrorNone)
+        ret = push_input_buffer(hComp);
+    return ret;
+}
+
+/*
+ * Waits for every pending conversion, then queues the frames to the
+ * encoder or, on flush, returns them to the client unencoded.
+ */
+void omx_video::drain_conversions(bool encode)
+{
+    conv_job job;
+
+    pthread_mutex_lock(&m_conv_lock);
+    while (m_conv_waited < m_conv_count)
+        pthread_cond_wait(&m_conv_cond, &m_conv_lock);
+    while (m_conv_count) {
+        job = m_conv_jobs[m_conv_head];
+        m_conv_head = (m_conv_head + 1) % MAX_CONV_DEPTH;
+        m_conv_count--;
+        m_conv_waited--;
+        pthread_mutex_unlock(&m_conv_lock);
+
+        if (!encode) {
+            m_input_maps.put(job.uva, job.size);
+            m_opq_pmem_q.insert_entry((unsigned long)job.dest,0,0);
+            m_pCallbacks.EmptyBufferDone(&m_cmp, m_app_data, job.source);
+        } else if (queue_conversion(&m_cmp, job) != OMX_ErrorNone) {
+            omx_report_error();
+        }
+
+        pthread_mutex_lock(&m_conv_lock);
+    }
+    pthread_mutex_unlock(&m_conv_lock);
+}
+
+void* omx_video::conv_thread(void *input)
+{
+    omx_video *omx = reinterpret_cast<omx_video*>(input);
+    conv_job *job;
+    bool status;
+
+    DEBUG_PRINT_HIGH("omx_venc: conversion thread start");
+    prctl(PR_SET_NAME, (unsigned long)"VideoEncConvThread", 0, 0, 0);
+    omx->m_thread_sched.attach(thread_sched::ROLE_CALLBACK);
+    pthread_mutex_lock(&omx->m_conv_lock);
+    while (!omx->m_conv_thread_stop) {
+        if (omx->m_conv_waited == omx->m_conv_count) {
+            pthread_cond_wait(&omx->m_conv_cond, &omx->m_conv_lock);
+            continue;
+        }
+        job = &omx->m_conv_jobs[(omx->m_conv_head + omx->m_conv_waited) % MAX_CONV_DEPTH];
+        pthread_mutex_unlock(&omx->m_conv_lock);
+
+        status = omx->c2d_conv.wait(job->ts);
+
+        pthread_mutex_lock(&omx->m_conv_lock);
+        job->failed = !status;
+        omx->m_conv_waited++;
+        pthread_cond_broadcast(&omx->m_conv_cond);
+        pthread_mutex_unlock(&omx->m_conv_lock);
+        omx->post_event(0, 0, OMX_COMPONENT_GENERATE_CONV_DONE);
+        pthread_mutex_lock(&omx->m_conv_lock);
+    }
+    pthread_mutex_unlock(&omx->m_conv_lock);
+    omx->m_thread_sched.detach(thread_sched::ROLE_CALLBACK);
+    DEBUG_PRINT_HIGH("omx_venc: conversion thread stop");
+    return NULL;
+}
+
+/*
+ * vidc.enc.heap_copy_async: the client frame is copied into the ION
+ * buffer on copy_thread, so the message thread goes on while the encoder
+ * works on the previous frame. copy_thread posts
+ * OMX_COMPONENT_GENERATE_COPY_DONE, complete_heap_copies() then queues
+ * the copied frames to the encoder in submission order.
+ */
+OMX_ERRORTYPE omx_video::submit_heap_copy(OMX_BUFFERHEADERTYPE *buffer,
+        unsigned int index, unsigned int fd)
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    heap_copy_job job, done;
+
+    job.buffer = buffer;
+    job.index = index;
+    job.fd = fd;
+    job.src = buffer->pBuffer + buffer->nOffset;
+    {
+        auto_lock l(m_buf_lock);
+        job.dest = (OMX_U8 *)m_pInput_pmem[index].buffer;
+        job.len = BITMASK_PRESENT(&m_client_in_bm_count, index) ? buffer->nFilledLen : 0;
+    }
+
+    if (!m_copy_thread_created) {
+        if (pthread_create(&m_copy_thread_id, 0, copy_thread, this) != 0) {
+            DEBUG_PRINT_ERROR("Heap copy thread creation failed, copying inline");
+            m_heap_copy_async = false;
+            memcpy(job.dest, job.src, job.len);
+            return queue_heap_copy(job);
+        }
+        m_copy_thread_created = true;
+    }
+
+    pthread_mutex_lock(&m_copy_lock);
+    while (m_copy_count == MAX_HEAP_COPY_DEPTH) {
+        while (!m_copy_done)
+            pthread_cond_wait(&m_copy_cond, &m_copy_lock);
+        done = m_copy_jobs[m_copy_head];
+        m_copy_head = (m_copy_head + 1) % MAX_HEAP_COPY_DEPTH;
+        m_copy_count--;
+        m_copy_done--;
+        pthread_mutex_unlock(&m_copy_lock);
+        if (queue_heap_copy(done) != OMX_ErrorNone)
+            ret = OMX_ErrorBadParameter;
+        pthread_mutex_lock(&m_copy_lock);
+    }
+    m_copy_jobs[(m_copy_head + m_copy_count) % MAX_HEAP_COPY_DEPTH] = job;
+    m_copy_count++;
+    pthread_cond_broadcast(&m_copy_cond);
+    pthread_mutex_unlock(&m_copy_lock);
+    return ret;
+}
+
+OMX_ERRORTYPE omx_video::queue_heap_copy(heap_copy_job &job)
+{
+    DEBUG_PRINT_LOW("memcpy() done in copy thread for i/p Heap UseBuf");
+    if (dev_empty_buf(job.buffer, job.dest, job.index, job.fd) != true) {
+        DEBUG_PRINT_ERROR("ERROR: ETBProxy: dev_empty_buf failed");
+        post_event ((unsigned long)job.buffer,0,OMX_COMPONENT_GENERATE_EBD);
+        pending_input_buffers--;
+        if (hw_overload) {
+            return OMX_ErrorInsufficientResources;
+        }
+        return OMX_ErrorBadParameter;
+    }
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE omx_video::complete_heap_copies()
+{
+    OMX_ERRORTYPE ret = OMX_ErrorNone;
+    heap_copy_job job;
+
+    pthread_mutex_lock(&m_copy_lock);
+    while (m_copy_done && ret == OMX_ErrorNone) {
+        job = m_copy_jobs[m_copy_head];
+        m_copy_head = (m_copy_head + 1) % MAX_HEAP_COPY_DEPTH;
+        m_copy_count--;
+        m_copy_done--;
+        pthread_mutex_unlock(&m_copy_lock);
+        ret = queue_heap_copy(job);
+        pthread_mutex_lock(&m_copy_lock);
+    }
+    pthread_mutex_unlock(&m_copy_lock);
+    return ret;
+}
+
+/*
+ * Waits for every pending copy, then queues the frames to the encoder
+ * or, on flush, returns them to the client unencoded.
+ */
+void omx_video::drain_heap_copies(bool encode)
+{
+    heap_copy_job job;
+
+    pthread_mutex_lock(&m_copy_lock);
+    while (m_copy_done < m_copy_count)
+        pthread_cond_wait(&m_copy_cond, &m_copy_lock);
+    while (m_copy_count) {
+        job = m_copy_jobs[m_copy_head];
+        m_copy_head = (m_copy_head + 1) % MAX_HEAP_COPY_DEPTH;
+        m_copy_count--;
+        m_copy_done--;
+        pthread_mutex_unlock(&m_copy_lock);
+
+        if (!encode)
+            empty_buffer_done(&m_cmp, job.buffer);
+        else if (queue_heap_copy(job) != OMX_ErrorNone)
+            omx_report_error();
+
+        pthread_mutex_lock(&m_copy_lock);
+    }
+    pthread_mutex_unlock(&m_copy_lock);
+}
+
+void* omx_video::copy_thread(void *input)
+{
+    omx_video *omx = reinterpret_cast<omx_video*>(input);
+    heap_copy_job *job;
+
+    DEBUG_PRINT_HIGH("omx_venc: heap copy thread start");
+    prctl(PR_SET_NAME, (unsigned long)"VideoEncCopyThread", 0, 0, 0);
+    omx->m_thread_sched.attach(thread_sched::ROLE_CALLBACK);
+    pthread_mutex_lock(&omx->m_copy_lock);
+    while (!omx->m_copy_thread_stop) {
+        if (omx->m_copy_done == omx->m_copy_count) {
+            pthread_cond_wait(&omx->m_copy_cond, &omx->m_copy_lock);
+            continue;
+        }
+        job = &omx->m_copy_jobs[(omx->m_copy_head + omx->m_copy_done) % MAX_HEAP_COPY_DEPTH];
+        pthread_mutex_unlock(&omx->m_copy_lock);
+
+        if (job->dest && job->len)
+            memcpy(job->dest, job->src, job->len);
+
+        pthread_mutex_lock(&omx->m_copy_lock);
+        omx->m_copy_done++;
+        pthread_cond_broadcast(&omx->m_copy_cond);
+        pthread_mutex_unlock(&omx->m_copy_lock);
+        omx->post_event(0, 0, OMX_COMPONENT_GENERATE_COPY_DONE);
+        pthread_mutex_lock(&omx->m_copy_lock);
+    }
+    pthread_mutex_unlock(&omx->m_copy_lock);
+    omx->m_thread_sched.detach(thread_sched::ROLE_CALLBACK);
+    DEBUG_PRINT_HIGH("omx_venc: heap copy thread stop");
+    return NULL;
+}
+
 OMX_ERRORTYPE omx_video::push_input_buffer(OMX_HANDLETYPE hComp)
 {
     unsigned long address = 0,p2,id, index = 0;
@@ -5027,7 +5554,7 @@ OMX_ERRORTYPE omx_video::push_input_buffer(OMX_HANDLETYPE hComp)
         pdest_frame = (OMX_BUFFERHEADERTYPE* ) address;
     }
     while (psource_frame != NULL && pdest_frame != NULL &&
-            ret == OMX_ErrorNone) {
+            ret == OMX_ErrorNone && m_conv_count < m_conv_depth) {
         struct pmem Input_pmem_info;
         LEGACY_CAM_METADATA_TYPE *media_buffer;
         index = pdest_frame - m_inp_mem_ptr;
@@ -5042,6 +5569,9 @@ OMX_ERRORTYPE omx_video::push_input_buffer(OMX_HANDLETYPE hComp)
         // separately by queueing an intermediate color-conversion buffer
         // and propagate the EOS.
         if (psource_frame->nFilledLen == 0 && (psource_frame->nFlags & OMX_BUFFERFLAG_EOS)) {
+            //EOS has to follow the conversions still on the GPU
+            if (m_conv_count)
+                break;
             return push_empty_eos_buffer(hComp, psource_frame);
         }
         media_buffer = (LEGACY_CAM_METADATA_TYPE *)psource_frame->pBuffer;
@@ -5054,6 +5584,8 @@ OMX_ERRORTYPE omx_video::push_input_buffer(OMX_HANDLETYPE hComp)
             DEBUG_PRINT_LOW("ETB fd = %d, offset = %d, size = %d",Input_pmem_info.fd,
                     Input_pmem_info.offset,
                     Input_pmem_info.size);
+            if (m_conv_count)
+                break;
             ret = queue_meta_buffer(hComp,Input_pmem_info);
         } else {
             VideoGrallocMetadata *media_buffer = (VideoGrallocMetadata *)psource_frame->pBuffer;
@@ -5062,7 +5594,12 @@ OMX_ERRORTYPE omx_video::push_input_buffer(OMX_HANDLETYPE hComp)
             Input_pmem_info.fd = handle->fd;
             Input_pmem_info.offset = 0;
             Input_pmem_info.size = handle->size;
-            if (handle->format == HAL_PIXEL_FORMAT_RGBA_8888)
+            if (handle->format == HAL_PIXEL_FORMAT_RGBA_8888 &&
+                    m_conv_depth > 1 && psource_frame->nFilledLen)
+                ret = submit_conversion(hComp,Input_pmem_info,index);
+            else if (m_conv_count)
+                break;
+            else if (handle->format == HAL_PIXEL_FORMAT_RGBA_8888)
                 ret = convert_queue_buffer(hComp,Input_pmem_info,index);
             else if (handle->format == HAL_PIXEL_FORMAT_NV12_ENCODEABLE ||
                     handle->format == QOMX_COLOR_FORMATYUV420PackedSemiPlanar32m)
@@ -165,6 +165,46 @@ omx_venc::omx_venc()
     property_get("vidc.debug.lowlatency", property_value, "0");
     lowlatency = atoi(property_value);
     property_value[0] = '\0';
+    property_get("vidc.enc.event_loop", property_value, "0");
+    m_event_loop = atoi(property_value);
+    property_value[0] = '\0';
+    property_get("vidc.enc.worker_pool", property_value, "0");
+    m_worker_pool = atoi(property_value);
+    property_value[0] = '\0';
+    property_get("vidc.enc.conv_depth", property_value, "1");
+    m_conv_depth = atoi(property_value);
+    if (m_conv_depth < 1)
+        m_conv_depth = 1;
+    else if (m_conv_depth > MAX_CONV_DEPTH)
+        m_conv_depth = MAX_CONV_DEPTH;
+    property_value[0] = '\0';
+    property_get("vidc.enc.heap_copy_async", property_value, "0");
+    m_heap_copy_async = atoi(property_value);
+    property_value[0] = '\0';
+    property_get("vidc.enc.pixel_threads", property_value, "1");
+    if (atoi(property_value) > 1) {
+        m_band_executor.open(atoi(property_value));
+#ifdef _ANDROID_ICS_
+        c2d_conv.set_executor(&m_band_executor);
+#endif
+    }
+    property_value[0] = '\0';
+    property_get("vidc.enc.ion_pool", property_value, "0");
+    if (atoi(property_value) > 0) {
+        char shared_value[PROPERTY_VALUE_MAX] = {0};
+
+        property_get("vidc.enc.ion_pool.shared", shared_value, "0");
+        if (atoi(shared_value)) {
+            m_ion_pool = ion_pool::shared();
+            m_ion_pool->raise_limit((size_t)atoi(property_value) << 20);
+        } else {
+            m_ion_pool = &m_own_ion_pool;
+            m_ion_pool->set_limit((size_t)atoi(property_value) << 20);
+        }
+        DEBUG_PRINT_HIGH("vidc.enc.ion_pool value is %d MB", atoi(property_value));
+    }
+    property_value[0] = '\0';
+    m_thread_sched.load_properties("vidc.enc.sched");
     m_perf_control.send_hint_to_mpctl(true);
     DEBUG_PRINT_HIGH("omx_venc: constructor completed");
 }
@@ -205,7 +245,6 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
 
     OMX_ERRORTYPE eRet = OMX_ErrorNone;
 
-    int fds[2];
     int r;
 
     OMX_VIDEO_CODINGTYPE codec_type;
@@ -574,42 +613,42 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
     m_sExtraData = 0;
 
     if (eRet == OMX_ErrorNone) {
-        if (pipe(fds)) {
-            DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
+        if (m_worker_pool && !m_event_loop) {
+            if (!m_msg_strand.open(enc_message_work, this)) {
+                DEBUG_PRINT_ERROR("ERROR: worker pool attach failed");
+                eRet = OMX_ErrorInsufficientResources;
+            }
+        } else if (!m_msg_doorbell.open()) {
+            DEBUG_PRINT_ERROR("ERROR: message doorbell creation failed");
             eRet = OMX_ErrorInsufficientResources;
         } else {
-            if (fds[0] == 0 || fds[1] == 0) {
-                if (pipe(fds)) {
-                    DEBUG_PRINT_ERROR("ERROR: pipe creation failed");
-                    eRet = OMX_ErrorInsufficientResources;
-                }
+            msg_thread_created = true;
+            r = pthread_create(&msg_thread_id,0,
+                    m_event_loop ? venc_dev::venc_event_loop : enc_message_thread, this);
+            if (r < 0) {
+                DEBUG_PRINT_ERROR("ERROR: message_thread_enc thread creation failed");
+                eRet = OMX_ErrorInsufficientResources;
+                msg_thread_created = false;
             }
-            if (eRet == OMX_ErrorNone) {
-                m_pipe_in = fds[0];
-                m_pipe_out = fds[1];
-
-                msg_thread_created = true;
-                r = pthread_create(&msg_thread_id,0, enc_message_thread, this);
-                if (r < 0) {
-                    DEBUG_PRINT_ERROR("ERROR: message_thread_enc thread creation failed");
-                    eRet = OMX_ErrorInsufficientResources;
+        }
+        if (eRet == OMX_ErrorNone && m_event_loop) {
+            handle->venc_set_event_loop();
+        } else if (eRet == OMX_ErrorNone) {
+            async_thread_created = true;
+            r = pthread_create(&async_thread_id,0, venc_dev::async_venc_message_thread, this);
+            if (r < 0) {
+                DEBUG_PRINT_ERROR("ERROR: venc_dev::async_venc_message_thread thread creation failed");
+                eRet = OMX_ErrorInsufficientResources;
+                async_thread_created = false;
+
+                if (msg_thread_created) {
+                    msg_thread_stop = true;
+                    pthread_join(msg_thread_id,NULL);
                     msg_thread_created = false;
-                } else {
-                    async_thread_created = true;
-                    r = pthread_create(&async_thread_id,0, venc_dev::async_venc_message_thread, this);
-                    if (r < 0) {
-                        DEBUG_PRINT_ERROR("ERROR: venc_dev::async_venc_message_thread thread creation failed");
-                        eRet = OMX_ErrorInsufficientResources;
-                        async_thread_created = false;
-
-                        msg_thread_stop = true;
-                        pthread_join(msg_thread_id,NULL);
-                        msg_thread_created = false;
-
-                    } else
-                        dev_set_message_thread_id(async_thread_id);
                 }
-            }
+                m_msg_strand.close();
+            } else
+                dev_set_message_thread_id(async_thread_id);
         }
     }
 
@@ -2044,6 +2083,22 @@ OMX_ERRORTYPE  omx_venc::set_config(OMX_IN OMX_HANDLETYPE      hComp,
                memcpy(&m_sConfigColorAspects, configData, sizeof(m_sConfigColorAspects));
                break;
            }
+        case OMX_QTIIndexConfigThreadScheduling:
+           {
+               VALIDATE_OMX_PARAM_DATA(configData, QOMX_CONFIG_THREAD_SCHEDULING);
+               QOMX_CONFIG_THREAD_SCHEDULING *pParam = (QOMX_CONFIG_THREAD_SCHEDULING *)configData;
+               thread_sched::config cfg;
+               cfg.cpu_mask = pParam->nCpuMask;
+               cfg.nice = pParam->nNice;
+               cfg.fifo_priority = pParam->nFifoPriority;
+               DEBUG_PRINT_HIGH("set_config: thread role %d: cpus 0x%x nice %d fifo %d",
+                       pParam->eRole, cfg.cpu_mask, cfg.nice, cfg.fifo_priority);
+               if (!m_thread_sched.set(pParam->eRole, cfg)) {
+                   DEBUG_PRINT_ERROR("Failed to set OMX_QTIIndexConfigThreadScheduling");
+                   return OMX_ErrorUnsupportedSetting;
+               }
+               break;
+           }
 #ifdef SUPPORT_CONFIG_INTRA_REFRESH
        case OMX_IndexConfigAndroidIntraRefresh:
            {
@@ -2495,6 +2550,17 @@ bool omx_venc::dev_get_output_log_flag()
     return handle->venc_get_output_log_flag();
 }
 
+bool omx_venc::dev_reads_heap_input()
+{
+    /* msm_vidc maps input planes by ION fd, heap memory has none */
+    return false;
+}
+
+bool omx_venc::dev_get_clip_limits(OMX_U8 *luma_max, OMX_U8 *chroma_max)
+{
+    return handle->venc_get_clip_limits(luma_max, chroma_max);
+}
+
 int omx_venc::dev_output_log_buffers(const char *buffer, int bufferlen)
 {
     return handle->venc_output_log_buffers(buffer, bufferlen);
@@ -33,6 +33,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <fcntl.h>
 #include "video_encoder_device_v4l2.h"
 #include "omx_video_encoder.h"
+#include "pixel_kernels.h"
 #include <linux/android_pmem.h>
 #include <media/msm_vidc.h>
 #ifdef USE_ION
@@ -230,12 +231,15 @@ venc_dev::venc_dev(class omx_venc *venc_class)
     stopped = 1;
     paused = false;
     async_thread_created = false;
+    m_event_loop = false;
     color_format = 0;
     hw_overload = false;
     extradata = false;
+    m_batch_config = false;
 
     pthread_mutex_init(&pause_resume_mlock, NULL);
     pthread_cond_init(&pause_resume_cond, NULL);
+    sem_init(&m_loop_detached, 0, 0);
     memset(&extradata_info, 0, sizeof(extradata_info));
     memset(&idrperiod, 0, sizeof(idrperiod));
     memset(&multislice, 0, sizeof(multislice));
@@ -305,7 +309,162 @@ venc_dev::venc_dev(class omx_venc *venc_class)
 
 venc_dev::~venc_dev()
 {
-    //nothing to do
+    sem_destroy(&m_loop_detached);
+}
+
+/*
+ * Dequeues everything the driver has signalled in revents and hands it to
+ * async_message_process. Returns -1 once the driver session is closed or
+ * cannot be serviced any more.
+ */
+int venc_dev::venc_process_driver_events(void *input, int fd, short revents,
+        struct statistics *stats)
+{
+    struct venc_msg venc_msg;
+    omx_video* omx_venc_base = reinterpret_cast<omx_video*>(input);
+    omx_venc *omx = reinterpret_cast<omx_venc*>(input);
+    OMX_BUFFERHEADERTYPE* omxhdr = NULL;
+    struct v4l2_plane plane[VIDEO_MAX_PLANES];
+    struct v4l2_buffer v4l2_buf;
+    struct v4l2_event dqevent;
+
+    memset(&v4l2_buf, 0, sizeof(v4l2_buf));
+
+    if ((revents & POLLIN) || (revents & POLLRDNORM)) {
+        v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        v4l2_buf.memory = V4L2_MEMORY_USERPTR;
+        v4l2_buf.length = omx->handle->num_planes;
+        v4l2_buf.m.planes = plane;
+
+        while (!ioctl(fd, VIDIOC_DQBUF, &v4l2_buf)) {
+            venc_msg.msgcode=VEN_MSG_OUTPUT_BUFFER_DONE;
+            venc_msg.statuscode=VEN_S_SUCCESS;
+            omxhdr=omx_venc_base->m_out_mem_ptr+v4l2_buf.index;
+            venc_msg.buf.len= v4l2_buf.m.planes->bytesused;
+            venc_msg.buf.offset = v4l2_buf.m.planes->data_offset;
+            venc_msg.buf.flags = 0;
+            venc_msg.buf.ptrbuffer = (OMX_U8 *)omx_venc_base->m_pOutput_pmem[v4l2_buf.index].buffer;
+            venc_msg.buf.clientdata=(void*)omxhdr;
+            venc_msg.buf.timestamp = (uint64_t) v4l2_buf.timestamp.tv_sec * (uint64_t) 1000000 + (uint64_t) v4l2_buf.timestamp.tv_usec;
+
+            /* TODO: ideally report other types of frames as well
+             * for now it doesn't look like IL client cares about
+             * other types
+             */
+            if (v4l2_buf.flags & V4L2_QCOM_BUF_FLAG_IDRFRAME)
+                venc_msg.buf.flags |= QOMX_VIDEO_PictureTypeIDR;
+
+            if (v4l2_buf.flags & V4L2_BUF_FLAG_KEYFRAME)
+                venc_msg.buf.flags |= OMX_BUFFERFLAG_SYNCFRAME;
+
+            if (v4l2_buf.flags & V4L2_QCOM_BUF_FLAG_CODECCONFIG)
+                venc_msg.buf.flags |= OMX_BUFFERFLAG_CODECCONFIG;
+
+            if (v4l2_buf.flags & V4L2_QCOM_BUF_FLAG_EOS)
+                venc_msg.buf.flags |= OMX_BUFFERFLAG_EOS;
+
+            if (omx->handle->num_planes > 1 && v4l2_buf.m.planes->bytesused)
+                venc_msg.buf.flags |= OMX_BUFFERFLAG_EXTRADATA;
+
+            if (omxhdr->nFilledLen)
+                venc_msg.buf.flags |= OMX_BUFFERFLAG_ENDOFFRAME;
+
+            omx->handle->fbd++;
+            stats->bytes_generated += venc_msg.buf.len;
+
+            if (omx->async_message_process(input,&venc_msg) < 0) {
+                DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
+                break;
+            }
+        }
+    }
+
+    if ((revents & POLLOUT) || (revents & POLLWRNORM)) {
+        v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+        v4l2_buf.memory = V4L2_MEMORY_USERPTR;
+        v4l2_buf.m.planes = plane;
+        v4l2_buf.length = 1;
+
+        while (!ioctl(fd, VIDIOC_DQBUF, &v4l2_buf)) {
+            venc_msg.msgcode=VEN_MSG_INPUT_BUFFER_DONE;
+            venc_msg.statuscode=VEN_S_SUCCESS;
+            if (omx_venc_base->mUseProxyColorFormat && !omx_venc_base->mUsesColorConversion)
+                omxhdr = &omx_venc_base->meta_buffer_hdr[v4l2_buf.index];
+            else
+                omxhdr = &omx_venc_base->m_inp_mem_ptr[v4l2_buf.index];
+
+            venc_msg.buf.clientdata=(void*)omxhdr;
+            omx->handle->ebd++;
+
+            if (omx->async_message_process(input,&venc_msg) < 0) {
+                DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
+                break;
+            }
+        }
+    }
+
+    if (revents & POLLPRI) {
+        ioctl(fd, VIDIOC_DQEVENT, &dqevent);
+
+        if (dqevent.type == V4L2_EVENT_MSM_VIDC_CLOSE_DONE) {
+            DEBUG_PRINT_HIGH("CLOSE DONE");
+            return -1;
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_FLUSH_DONE) {
+            venc_msg.msgcode = VEN_MSG_FLUSH_INPUT_DONE;
+            venc_msg.statuscode = VEN_S_SUCCESS;
+
+            if (omx->async_message_process(input,&venc_msg) < 0) {
+                DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
+                return -1;
+            }
+
+            venc_msg.msgcode = VEN_MSG_FLUSH_OUPUT_DONE;
+            venc_msg.statuscode = VEN_S_SUCCESS;
+
+            if (omx->async_message_process(input,&venc_msg) < 0) {
+                DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
+                return -1;
+            }
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_HW_OVERLOAD) {
+            DEBUG_PRINT_ERROR("HW Overload received");
+            venc_msg.statuscode = VEN_S_EFAIL;
+            venc_msg.msgcode = VEN_MSG_HW_OVERLOAD;
+
+            if (omx->async_message_process(input,&venc_msg) < 0) {
+                DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
+                return -1;
+            }
+        } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_SYS_ERROR){
+            DEBUG_PRINT_ERROR("ERROR: Encoder is in bad state");
+            venc_msg.msgcode = VEN_MSG_INDICATION;
+            venc_msg.statuscode=VEN_S_EFAIL;
+
+            if (omx->async_message_process(input,&venc_msg) < 0) {
+                DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
+                return -1;
+            }
+        }
+    }
+
+    /* calc avg. fps, bitrate */
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    OMX_U64 time_diff = (OMX_U32)((tv.tv_sec * 1000000 + tv.tv_usec) -
+            (stats->prev_tv.tv_sec * 1000000 + stats->prev_tv.tv_usec));
+    OMX_U32 num_fbd = omx->handle->fbd - stats->prev_fbd;
+    if (num_fbd && time_diff >= 5000000) {
+        if (stats->prev_tv.tv_sec) {
+            float framerate = num_fbd * 1000000/(float)time_diff;
+            OMX_U32 bitrate = (stats->bytes_generated * 8/num_fbd) * framerate;
+            DEBUG_PRINT_HIGH("stats: avg. fps %0.2f, bitrate %d",
+                framerate, bitrate);
+        }
+        stats->prev_tv = tv;
+        stats->bytes_generated = 0;
+        stats->prev_fbd = omx->handle->fbd;
+    }
+
+    return 0;
 }
 
 void* venc_dev::async_venc_message_thread (void *input)
@@ -314,20 +473,16 @@ void* venc_dev::async_venc_message_thread (void *input)
     omx_video* omx_venc_base = NULL;
     omx_venc *omx = reinterpret_cast<omx_venc*>(input);
     omx_venc_base = reinterpret_cast<omx_video*>(input);
-    OMX_BUFFERHEADERTYPE* omxhdr = NULL;
 
     prctl(PR_SET_NAME, (unsigned long)"VideoEncCallBackThread", 0, 0, 0);
-    struct v4l2_plane plane[VIDEO_MAX_PLANES];
+    omx_venc_base->m_thread_sched.attach(thread_sched::ROLE_CALLBACK);
     struct pollfd pfd;
-    struct v4l2_buffer v4l2_buf;
-    struct v4l2_event dqevent;
     struct statistics stats;
     pfd.events = POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM | POLLRDBAND | POLLPRI;
     pfd.fd = omx->handle->m_nDriver_fd;
-    int error_code = 0,rc=0;
+    int rc=0;
 
     memset(&stats, 0, sizeof(statistics));
-    memset(&v4l2_buf, 0, sizeof(v4l2_buf));
 
     while (1) {
         pthread_mutex_lock(&omx->handle->pause_resume_mlock);
@@ -370,143 +525,82 @@ void* venc_dev::async_venc_message_thread (void *input)
             break;
         }
 
-        if ((pfd.revents & POLLIN) || (pfd.revents & POLLRDNORM)) {
-            v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-            v4l2_buf.memory = V4L2_MEMORY_USERPTR;
-            v4l2_buf.length = omx->handle->num_planes;
-            v4l2_buf.m.planes = plane;
-
-            while (!ioctl(pfd.fd, VIDIOC_DQBUF, &v4l2_buf)) {
-                venc_msg.msgcode=VEN_MSG_OUTPUT_BUFFER_DONE;
-                venc_msg.statuscode=VEN_S_SUCCESS;
-                omxhdr=omx_venc_base->m_out_mem_ptr+v4l2_buf.index;
-                venc_msg.buf.len= v4l2_buf.m.planes->bytesused;
-                venc_msg.buf.offset = v4l2_buf.m.planes->data_offset;
-                venc_msg.buf.flags = 0;
-                venc_msg.buf.ptrbuffer = (OMX_U8 *)omx_venc_base->m_pOutput_pmem[v4l2_buf.index].buffer;
-                venc_msg.buf.clientdata=(void*)omxhdr;
-                venc_msg.buf.timestamp = (uint64_t) v4l2_buf.timestamp.tv_sec * (uint64_t) 1000000 + (uint64_t) v4l2_buf.timestamp.tv_usec;
-
-                /* TODO: ideally report other types of frames as well
-                 * for now it doesn't look like IL client cares about
-                 * other types
-                 */
-                if (v4l2_buf.flags & V4L2_QCOM_BUF_FLAG_IDRFRAME)
-                    venc_msg.buf.flags |= QOMX_VIDEO_PictureTypeIDR;
-
-                if (v4l2_buf.flags & V4L2_BUF_FLAG_KEYFRAME)
-                    venc_msg.buf.flags |= OMX_BUFFERFLAG_SYNCFRAME;
-
-                if (v4l2_buf.flags & V4L2_QCOM_BUF_FLAG_CODECCONFIG)
-                    venc_msg.buf.flags |= OMX_BUFFERFLAG_CODECCONFIG;
-
-                if (v4l2_buf.flags & V4L2_QCOM_BUF_FLAG_EOS)
-                    venc_msg.buf.flags |= OMX_BUFFERFLAG_EOS;
-
-                if (omx->handle->num_planes > 1 && v4l2_buf.m.planes->bytesused)
-                    venc_msg.buf.flags |= OMX_BUFFERFLAG_EXTRADATA;
-
-                if (omxhdr->nFilledLen)
-                    venc_msg.buf.flags |= OMX_BUFFERFLAG_ENDOFFRAME;
-
-                omx->handle->fbd++;
-                stats.bytes_generated += venc_msg.buf.len;
-
-                if (omx->async_message_process(input,&venc_msg) < 0) {
-                    DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
-                    break;
-                }
-            }
-        }
-
-        if ((pfd.revents & POLLOUT) || (pfd.revents & POLLWRNORM)) {
-            v4l2_buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
-            v4l2_buf.memory = V4L2_MEMORY_USERPTR;
-            v4l2_buf.m.planes = plane;
-            v4l2_buf.length = 1;
-
-            while (!ioctl(pfd.fd, VIDIOC_DQBUF, &v4l2_buf)) {
-                venc_msg.msgcode=VEN_MSG_INPUT_BUFFER_DONE;
-                venc_msg.statuscode=VEN_S_SUCCESS;
-                if (omx_venc_base->mUseProxyColorFormat && !omx_venc_base->mUsesColorConversion)
-                    omxhdr = &omx_venc_base->meta_buffer_hdr[v4l2_buf.index];
-                else
-                    omxhdr = &omx_venc_base->m_inp_mem_ptr[v4l2_buf.index];
-
-                venc_msg.buf.clientdata=(void*)omxhdr;
-                omx->handle->ebd++;
-
-                if (omx->async_message_process(input,&venc_msg) < 0) {
-                    DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
-                    break;
-                }
-            }
-        }
-
-        if (pfd.revents & POLLPRI) {
-            rc = ioctl(pfd.fd, VIDIOC_DQEVENT, &dqevent);
-
-            if (dqevent.type == V4L2_EVENT_MSM_VIDC_CLOSE_DONE) {
-                DEBUG_PRINT_HIGH("CLOSE DONE");
-                break;
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_FLUSH_DONE) {
-                venc_msg.msgcode = VEN_MSG_FLUSH_INPUT_DONE;
-                venc_msg.statuscode = VEN_S_SUCCESS;
-
-                if (omx->async_message_process(input,&venc_msg) < 0) {
-                    DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
-                    break;
-                }
+        if (venc_process_driver_events(input, pfd.fd, pfd.revents, &stats) < 0)
+            break;
+    }
 
-                venc_msg.msgcode = VEN_MSG_FLUSH_OUPUT_DONE;
-                venc_msg.statuscode = VEN_S_SUCCESS;
+    omx_venc_base->m_thread_sched.detach(thread_sched::ROLE_CALLBACK);
+    DEBUG_PRINT_HIGH("omx_venc: Async Thread exit");
+    return NULL;
+}
 
-                if (omx->async_message_process(input,&venc_msg) < 0) {
-                    DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
-                    break;
-                }
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_HW_OVERLOAD) {
-                DEBUG_PRINT_ERROR("HW Overload received");
-                venc_msg.statuscode = VEN_S_EFAIL;
-                venc_msg.msgcode = VEN_MSG_HW_OVERLOAD;
+/*
+ * Single thread alternative to async_venc_message_thread + enc_message_thread,
+ * enabled with vidc.enc.event_loop. Driver buffers are dequeued and the
+ * resulting EBD/FBD messages are handed to the client in the same pass.
+ * While paused the driver is not polled, as the callback thread would block.
+ */
+void* venc_dev::venc_event_loop(void *input)
+{
+    struct venc_msg venc_msg;
+    omx_video* omx_venc_base = reinterpret_cast<omx_video*>(input);
+    omx_venc *omx = reinterpret_cast<omx_venc*>(input);
+    struct statistics stats;
+    struct pollfd pfd[2];
+    bool attached = true, paused = false;
+    nfds_t nfds;
+    int rc = 0;
 
-                if (omx->async_message_process(input,&venc_msg) < 0) {
-                    DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
-                    break;
-                }
-            } else if (dqevent.type == V4L2_EVENT_MSM_VIDC_SYS_ERROR){
-                DEBUG_PRINT_ERROR("ERROR: Encoder is in bad state");
-                venc_msg.msgcode = VEN_MSG_INDICATION;
-                venc_msg.statuscode=VEN_S_EFAIL;
+    pfd[0].fd = omx_venc_base->m_msg_doorbell.fd();
+    pfd[0].events = POLLIN;
+    pfd[1].fd = omx->handle->m_nDriver_fd;
+    pfd[1].events = POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM | POLLRDBAND | POLLPRI;
+    memset(&stats, 0, sizeof(statistics));
 
-                if (omx->async_message_process(input,&venc_msg) < 0) {
-                    DEBUG_PRINT_ERROR("ERROR: Wrong ioctl message");
-                    break;
-                }
-            }
+    DEBUG_PRINT_HIGH("omx_venc: event loop start");
+    prctl(PR_SET_NAME, (unsigned long)"VideoEncEventLoop", 0, 0, 0);
+    /* Serves both roles, the message role settings apply */
+    omx_venc_base->m_thread_sched.attach(thread_sched::ROLE_MESSAGE);
+    while (!omx_venc_base->msg_thread_stop) {
+        pthread_mutex_lock(&omx->handle->pause_resume_mlock);
+        if (omx->handle->paused != paused) {
+            paused = omx->handle->paused;
+            venc_msg.msgcode = paused ? VEN_MSG_PAUSE : VEN_MSG_RESUME;
+            venc_msg.statuscode = VEN_S_SUCCESS;
+            if (omx->async_message_process(input, &venc_msg) < 0)
+                DEBUG_PRINT_ERROR("ERROR: Failed to process %s msg",
+                        paused ? "pause" : "resume");
+            if (!paused)
+                memset(&stats, 0, sizeof(statistics));
         }
+        pthread_mutex_unlock(&omx->handle->pause_resume_mlock);
 
-        /* calc avg. fps, bitrate */
-        struct timeval tv;
-        gettimeofday(&tv,NULL);
-        OMX_U64 time_diff = (OMX_U32)((tv.tv_sec * 1000000 + tv.tv_usec) -
-                (stats.prev_tv.tv_sec * 1000000 + stats.prev_tv.tv_usec));
-        OMX_U32 num_fbd = omx->handle->fbd - stats.prev_fbd;
-        if (num_fbd && time_diff >= 5000000) {
-            if (stats.prev_tv.tv_sec) {
-                float framerate = num_fbd * 1000000/(float)time_diff;
-                OMX_U32 bitrate = (stats.bytes_generated * 8/num_fbd) * framerate;
-                DEBUG_PRINT_HIGH("stats: avg. fps %0.2f, bitrate %d",
-                    framerate, bitrate);
+        nfds = attached && !paused ? 2 : 1;
+        rc = poll(pfd, nfds, 2000);
+        if (rc < 0) {
+            if (errno != EINTR) {
+                DEBUG_PRINT_ERROR("event loop poll ERROR: %s", strerror(errno));
+                break;
             }
-            stats.prev_tv = tv;
-            stats.bytes_generated = 0;
-            stats.prev_fbd = omx->handle->fbd;
+            continue;
+        } else if (rc == 0 /*timeout*/ || omx_venc_base->msg_thread_stop) {
+            continue;
         }
-
+        if (pfd[0].revents & POLLIN)
+            omx_venc_base->m_msg_doorbell.take();
+        if (nfds > 1 && pfd[1].revents &&
+                venc_process_driver_events(input, pfd[1].fd, pfd[1].revents, &stats) < 0) {
+            /* Session closed, keep serving commands until teardown */
+            DEBUG_PRINT_HIGH("omx_venc: event loop stops polling the driver");
+            attached = false;
+            sem_post(&omx->handle->m_loop_detached);
+        }
+        omx_venc_base->process_event_cb(omx_venc_base, 0);
     }
-
-    DEBUG_PRINT_HIGH("omx_venc: Async Thread exit");
+    if (attached)
+        sem_post(&omx->handle->m_loop_detached);
+    omx_venc_base->m_thread_sched.detach(thread_sched::ROLE_MESSAGE);
+    DEBUG_PRINT_HIGH("omx_venc: event loop stop");
     return NULL;
 }
 
@@ -867,7 +961,7 @@ int venc_dev::venc_input_log_buffers(OMX_BUFFERHEADERTYPE *pbuffer, int fd, int
 
         msize = VENUS_BUFFER_SIZE(COLOR_FMT_NV12, m_sVenc_cfg.input_width, m_sVenc_cfg.input_height);
         if (metadatamode == 1) {
-            pvirt= (unsigned char *)mmap(NULL, msize, PROT_READ|PROT_WRITE,MAP_SHARED, fd, plane_offset);
+            pvirt = (unsigned char *)venc_handle->m_input_maps.get(fd, plane_offset, msize);
             if (pvirt) {
                ptemp = pvirt;
                for (i = 0; i < m_sVenc_cfg.input_height; i++) {
@@ -879,8 +973,8 @@ int venc_dev::venc_input_log_buffers(OMX_BUFFERHEADERTYPE *pbuffer, int fd, int
                    fwrite(ptemp, m_sVenc_cfg.input_width, 1, m_debug.infile);
                    ptemp += stride;
                }
-               munmap(pvirt, msize);
-             } else if (pvirt == MAP_FAILED) {
+               venc_handle->m_input_maps.put(pvirt, msize);
+             } else {
                  DEBUG_PRINT_ERROR("%s mmap failed", __func__);
                  return -1;
              }
@@ -1105,7 +1199,7 @@ bool venc_dev::venc_open(OMX_U32 codec)
     if (m_sVenc_cfg.codectype == V4L2_PIX_FMT_VP8) {
         control.id = V4L2_CID_MPEG_VIDC_VIDEO_NUM_P_FRAMES;
         control.value = 0x7fffffff;
-        if (ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control))
+        if (venc_set_ctrl(&control))
             DEBUG_PRINT_ERROR("Failed to set V4L2_CID_MPEG_VIDC_VIDEO_NUM_P_FRAME\n");
     }
 
@@ -1165,6 +1259,8 @@ void venc_dev::venc_close()
 
         if (async_thread_created)
             pthread_join(m_tid,NULL);
+        else if (m_event_loop)
+            sem_wait(&m_loop_detached);
 
         DEBUG_PRINT_HIGH("venc_close X");
         unsubscribe_to_events(m_nDriver_fd);
@@ -1262,14 +1358,14 @@ bool venc_dev::venc_enable_low_latency()
             DEBUG_PRINT_HIGH("%s: enable multislice mode with slice_size = %d", __func__, slice_size);
             control.id = V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MODE;
             control.value =  V4L2_MPEG_VIDEO_MULTI_SICE_MODE_MAX_MB;
-            rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+            rc = venc_set_ctrl(&control);
             if (rc) {
                 DEBUG_PRINT_ERROR("%s: Failed to enable multislice mode, rc %d", __func__, rc);
                 return false;
             }
             control.id = V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MAX_MB;
             control.value = slice_size;
-            rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+            rc = venc_set_ctrl(&control);
             if (rc) {
                 DEBUG_PRINT_ERROR("%s: Failed to set slice_slice, rc %d", __func__, rc);
                 return false;
@@ -2107,7 +2203,41 @@ bool venc_dev::venc_check_valid_config()
    return true;
 }
 
+/*
+ * Until the session streams, and while a config is applied, controls are
+ * staged in m_ctrl_batch instead of written one ioctl at a time. Staging
+ * cannot fail, a rejected control fails venc_start or the config instead.
+ * A control staged anywhere must always be written through here, or the
+ * staged value overwrites a direct write when the batch is flushed.
+ */
+int venc_dev::venc_set_ctrl(struct v4l2_control *control)
+{
+    if ((!streaming[CAPTURE_PORT] || m_batch_config) &&
+            m_ctrl_batch.stage(control->id, control->value))
+        return 0;
+
+    return ioctl(m_nDriver_fd, VIDIOC_S_CTRL, control);
+}
+
+/*
+ * Controls written while applying a config go to the driver together once
+ * it is done. Before venc_start they stay staged with the rest.
+ */
 bool venc_dev::venc_set_config(void *configData, OMX_INDEXTYPE index)
+{
+    bool status;
+
+    m_batch_config = true;
+    status = venc_apply_config(configData, index);
+    m_batch_config = false;
+
+    if (streaming[CAPTURE_PORT] && m_ctrl_batch.count() &&
+            !m_ctrl_batch.flush(m_nDriver_fd))
+        status = false;
+    return status;
+}
+
+bool venc_dev::venc_apply_config(void *configData, OMX_INDEXTYPE index)
 {
 
     DEBUG_PRINT_LOW("Inside venc_set_config");
@@ -2592,6 +2722,13 @@ unsigned venc_dev::venc_set_message_thread_id(pthread_t tid)
     return 0;
 }
 
+/*The message thread runs venc_event_loop and also serves the driver*/
+unsigned venc_dev::venc_set_event_loop(void)
+{
+    m_event_loop = true;
+    return 0;
+}
+
 
 unsigned venc_dev::venc_start(void)
 {
@@ -2630,6 +2767,26 @@ unsigned venc_dev::venc_start(void)
         return 1;
     }
 
+    DEBUG_PRINT_LOW("%s(): writing %u staged controls", __func__, m_ctrl_batch.count());
+    if (!m_ctrl_batch.flush(m_nDriver_fd)) {
+        unsigned int optional = 0;
+
+        /* Only these were allowed to fail when they were set one by one */
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDC_VIDEO_HEVC_PROFILE);
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDC_VIDEO_HEVC_TIER_LEVEL);
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDC_VIDEO_COLOR_SPACE);
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDC_VIDEO_FULL_RANGE);
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDC_VIDEO_TRANSFER_CHARS);
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDC_VIDEO_MATRIX_COEFFS);
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDEO_H264_LOOP_FILTER_MODE);
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDEO_H264_LOOP_FILTER_ALPHA);
+        optional += m_ctrl_batch.rejected(V4L2_CID_MPEG_VIDEO_H264_LOOP_FILTER_BETA);
+        if (m_ctrl_batch.rejected_count() > optional) {
+            DEBUG_PRINT_ERROR("%s(): staged controls were rejected", __func__);
+            return 1;
+        }
+    }
+
     buf_type=V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     DEBUG_PRINT_LOW("send_command_proxy(): Idle-->Executing");
     ret=ioctl(m_nDriver_fd, VIDIOC_STREAMON,&buf_type);
@@ -3203,7 +3360,9 @@ bool venc_dev::venc_empty_buf(void *buffer, void *pmem_data_buf, unsigned index,
         }
     }
 
-    venc_clip_luma_chroma(fd, plane.data_offset, plane.bytesused);
+    /* Color converted input may already be clipped by the converter */
+    if (!(metadatamode && color_format && venc_handle->c2d_conv.clips_output()))
+        venc_clip_luma_chroma(fd, plane.data_offset, plane.bytesused);
 
     buf.index = index;
     buf.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
@@ -3568,7 +3727,7 @@ bool venc_dev::venc_set_colorspace(OMX_U32 primaries, OMX_U32 range,
     control.value = primaries;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control : V4L2_CID_MPEG_VIDC_VIDEO_COLOR_SPACE");
@@ -3583,7 +3742,7 @@ bool venc_dev::venc_set_colorspace(OMX_U32 primaries, OMX_U32 range,
     control.value = range;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control : V4L2_CID_MPEG_VIDC_VIDEO_FULL_RANGE");
@@ -3598,7 +3757,7 @@ bool venc_dev::venc_set_colorspace(OMX_U32 primaries, OMX_U32 range,
     control.value = transfer_chars;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control : V4L2_CID_MPEG_VIDC_VIDEO_TRANSFER_CHARS");
@@ -3613,7 +3772,7 @@ bool venc_dev::venc_set_colorspace(OMX_U32 primaries, OMX_U32 range,
     control.value = matrix_coeffs;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control : V4L2_CID_MPEG_VIDC_VIDEO_MATRIX_COEFFS");
@@ -3636,7 +3795,7 @@ bool venc_dev::venc_set_session_qp(OMX_U32 i_frame_qp, OMX_U32 p_frame_qp,OMX_U3
     control.value = i_frame_qp;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -3650,7 +3809,7 @@ bool venc_dev::venc_set_session_qp(OMX_U32 i_frame_qp, OMX_U32 p_frame_qp,OMX_U3
     control.value = p_frame_qp;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -3668,7 +3827,7 @@ bool venc_dev::venc_set_session_qp(OMX_U32 i_frame_qp, OMX_U32 p_frame_qp,OMX_U3
         control.value = b_frame_qp;
 
         DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -3698,7 +3857,7 @@ bool venc_dev::venc_set_session_qp_range(OMX_U32 min_qp, OMX_U32 max_qp)
 
         DEBUG_PRINT_LOW("Calling IOCTL set MIN_QP control id=%d, val=%d",
                 control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
             return false;
@@ -3712,7 +3871,7 @@ bool venc_dev::venc_set_session_qp_range(OMX_U32 min_qp, OMX_U32 max_qp)
 
         DEBUG_PRINT_LOW("Calling IOCTL set MAX_QP control id=%d, val=%d",
                 control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
             return false;
@@ -4086,7 +4245,7 @@ bool venc_dev::venc_set_profile_level(OMX_U32 eProfile,OMX_U32 eLevel)
         control.value = requested_profile.profile;
 
         DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -4121,7 +4280,7 @@ bool venc_dev::venc_set_profile_level(OMX_U32 eProfile,OMX_U32 eLevel)
         control.value = requested_level.level;
 
         DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -4191,7 +4350,7 @@ bool venc_dev::venc_set_intra_period(OMX_U32 nPFrames, OMX_U32 nBFrames)
     }
     control.id = V4L2_CID_MPEG_VIDC_VIDEO_NUM_P_FRAMES;
     control.value = intra_period.num_pframes;
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -4203,7 +4362,7 @@ bool venc_dev::venc_set_intra_period(OMX_U32 nPFrames, OMX_U32 nBFrames)
     control.id = V4L2_CID_MPEG_VIDC_VIDEO_NUM_B_FRAMES;
     control.value = intra_period.num_bframes;
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -4217,7 +4376,7 @@ bool venc_dev::venc_set_intra_period(OMX_U32 nPFrames, OMX_U32 nBFrames)
         control.id = V4L2_CID_MPEG_VIDC_VIDEO_IDR_PERIOD;
         control.value = 1;
 
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -4250,7 +4409,7 @@ bool venc_dev::venc_set_idr_period(OMX_U32 nPFrames, OMX_U32 nIDRPeriod)
     control.id = V4L2_CID_MPEG_VIDC_VIDEO_IDR_PERIOD;
     control.value = nIDRPeriod;
 
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -4275,7 +4434,7 @@ bool venc_dev::venc_set_entropy_config(OMX_BOOL enable, OMX_U32 i_cabac_level)
         control.id = V4L2_CID_MPEG_VIDEO_H264_ENTROPY_MODE;
 
         DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -4296,7 +4455,7 @@ bool venc_dev::venc_set_entropy_config(OMX_BOOL enable, OMX_U32 i_cabac_level)
         control.id = V4L2_CID_MPEG_VIDC_VIDEO_H264_CABAC_MODEL;
         //control.value = entropy_cfg.cabacmodel;
         DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -4309,7 +4468,7 @@ bool venc_dev::venc_set_entropy_config(OMX_BOOL enable, OMX_U32 i_cabac_level)
         control.value =  V4L2_MPEG_VIDEO_H264_ENTROPY_MODE_CAVLC;
         control.id = V4L2_CID_MPEG_VIDEO_H264_ENTROPY_MODE;
         DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -4340,7 +4499,7 @@ bool venc_dev::venc_set_multislice_cfg(OMX_INDEXTYPE Codec, OMX_U32 nSlicesize)
 
     control.id = V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MODE;
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -4355,7 +4514,7 @@ bool venc_dev::venc_set_multislice_cfg(OMX_INDEXTYPE Codec, OMX_U32 nSlicesize)
         control.id = V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MAX_MB;
         control.value = nSlicesize;
         DEBUG_PRINT_LOW("Calling SLICE_MB IOCTL set control for id=%d, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -4413,7 +4572,7 @@ bool venc_dev::venc_set_intra_refresh(OMX_VIDEO_INTRAREFRESHTYPE ir_mode, OMX_U3
     }
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%u, val=%d", control_mode.id, control_mode.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control_mode);
+    rc = venc_set_ctrl(&control_mode);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -4423,7 +4582,7 @@ bool venc_dev::venc_set_intra_refresh(OMX_VIDEO_INTRAREFRESHTYPE ir_mode, OMX_U3
     DEBUG_PRINT_LOW("Success IOCTL set control for id=%d, value=%d", control_mode.id, control_mode.value);
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control_mbs.id, control_mbs.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control_mbs);
+    rc = venc_set_ctrl(&control_mbs);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -4487,7 +4646,7 @@ bool venc_dev::venc_set_error_resilience(OMX_VIDEO_PARAM_ERRORCORRECTIONTYPE* er
     }
 
     DEBUG_PRINT_ERROR("Calling IOCTL set control for id=%x, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
        DEBUG_PRINT_ERROR("Failed to set Slice mode control");
@@ -4501,7 +4660,7 @@ bool venc_dev::venc_set_error_resilience(OMX_VIDEO_PARAM_ERRORCORRECTIONTYPE* er
         control.id = V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MAX_BYTES;
         control.value = resynchMarkerSpacingBytes;
         DEBUG_PRINT_ERROR("Calling IOCTL set control for id=%x, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set MAX MB control");
             return false;
@@ -4530,7 +4689,7 @@ bool venc_dev::venc_set_inloop_filter(OMX_VIDEO_AVCLOOPFILTERTYPE loopfilter)
     }
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         return false;
@@ -4544,7 +4703,7 @@ bool venc_dev::venc_set_inloop_filter(OMX_VIDEO_AVCLOOPFILTERTYPE loopfilter)
     control.value=0;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         return false;
@@ -4554,7 +4713,7 @@ bool venc_dev::venc_set_inloop_filter(OMX_VIDEO_AVCLOOPFILTERTYPE loopfilter)
     control.id=V4L2_CID_MPEG_VIDEO_H264_LOOP_FILTER_BETA;
     control.value=0;
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         return false;
@@ -4577,7 +4736,7 @@ bool venc_dev::venc_set_target_bitrate(OMX_U32 nTargetBitrate, OMX_U32 config)
     control.value = nTargetBitrate;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set control");
@@ -4802,7 +4961,7 @@ bool venc_dev::venc_set_bitrate_type(OMX_U32 type)
     control.id = V4L2_CID_MPEG_VIDC_VIDEO_VENC_BITRATE_TYPE;
     control.value = type;
     DEBUG_PRINT_LOW("Set Bitrate type to %s for %d \n", bitrate_type_string(type), type);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
     if (rc) {
         DEBUG_PRINT_ERROR("Request to set Bitrate type to %s failed",
             bitrate_type_string(type));
@@ -4838,6 +4997,11 @@ bool venc_dev::venc_set_layer_bitrates(QOMX_EXTNINDEX_VIDEO_HYBRID_HP_MODE* hpmo
     controls.ctrl_class = V4L2_CTRL_CLASS_MPEG;
     controls.controls = ctrl;
 
+    /* One id per layer cannot be staged, the bitrate type goes first */
+    if (m_ctrl_batch.count() && !m_ctrl_batch.flush(m_nDriver_fd)) {
+        DEBUG_PRINT_ERROR("Failed to write staged controls");
+        return false;
+    }
     rc = ioctl(m_nDriver_fd, VIDIOC_S_EXT_CTRLS, &controls);
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set layerwise bitrate %d", rc);
@@ -4884,7 +5048,7 @@ bool venc_dev::venc_set_hybrid_hierp(QOMX_EXTNINDEX_VIDEO_HYBRID_HP_MODE* hhp)
      // Update the driver with the new nPframes and nBframes
         control.id = V4L2_CID_MPEG_VIDC_VIDEO_NUM_P_FRAMES;
         control.value = intra_period.num_pframes;
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
             return false;
@@ -4892,7 +5056,7 @@ bool venc_dev::venc_set_hybrid_hierp(QOMX_EXTNINDEX_VIDEO_HYBRID_HP_MODE* hhp)
 
         control.id = V4L2_CID_MPEG_VIDC_VIDEO_NUM_B_FRAMES;
         control.value = intra_period.num_bframes;
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
             return false;
@@ -4913,7 +5077,7 @@ bool venc_dev::venc_set_hybrid_hierp(QOMX_EXTNINDEX_VIDEO_HYBRID_HP_MODE* hhp)
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%x, val=%d",
                     control.id, control.value);
 
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set hybrid hierp/hierp %d", rc);
         return false;
@@ -4924,14 +5088,14 @@ bool venc_dev::venc_set_hybrid_hierp(QOMX_EXTNINDEX_VIDEO_HYBRID_HP_MODE* hhp)
     if (m_sVenc_cfg.codectype == V4L2_PIX_FMT_H264) {
         control.id = V4L2_CID_MPEG_VIDC_VIDEO_H264_NAL_SVC;
         control.value = V4L2_CID_MPEG_VIDC_VIDEO_H264_NAL_SVC_ENABLED;
-        if (ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control)) {
+        if (venc_set_ctrl(&control)) {
             DEBUG_PRINT_ERROR("Failed to enable SVC_NAL");
             return false;
         }
     } else if (m_sVenc_cfg.codectype == V4L2_PIX_FMT_HEVC) {
         control.id = V4L2_CID_MPEG_VIDC_VIDEO_MAX_HIERP_LAYERS;
         control.value = hhp->nHpLayers - 1;
-        if (ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control)) {
+        if (venc_set_ctrl(&control)) {
             DEBUG_PRINT_ERROR("Failed to enable SVC_NAL");
             return false;
         }
@@ -5240,7 +5404,7 @@ bool venc_dev::venc_set_ratectrl_cfg(OMX_VIDEO_CONTROLRATETYPE eControlRate)
     if (status) {
 
         DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-        rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+        rc = venc_set_ctrl(&control);
 
         if (rc) {
             DEBUG_PRINT_ERROR("Failed to set control");
@@ -5408,7 +5572,7 @@ bool venc_dev::venc_set_vui_timing_info(OMX_BOOL enable)
         control.value = V4L2_MPEG_VIDC_VIDEO_H264_VUI_TIMING_INFO_DISABLED;
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%x, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set VUI timing info control");
         return false;
@@ -5427,7 +5591,7 @@ bool venc_dev::venc_set_peak_bitrate(OMX_U32 nPeakBitrate)
     DEBUG_PRINT_LOW("venc_set_peak_bitrate: bitrate = %u", (unsigned int)nPeakBitrate);
 
     DEBUG_PRINT_LOW("Calling IOCTL set control for id=%d, val=%d", control.id, control.value);
-    rc = ioctl(m_nDriver_fd, VIDIOC_S_CTRL, &control);
+    rc = venc_set_ctrl(&control);
 
     if (rc) {
         DEBUG_PRINT_ERROR("Failed to set peak bitrate control");
@@ -6117,22 +6281,47 @@ bool venc_dev::venc_is_video_session_supported(unsigned long width,
     return true;
 }
 
+struct clip_band {
+    unsigned char *luma;
+    unsigned char *chroma;
+    unsigned int stride;
+    unsigned int width;
+    unsigned int height;
+    OMX_U8 luma_max;
+    OMX_U8 chroma_max;
+};
+
+void venc_dev::venc_clip_band(void *arg, unsigned int row, unsigned int rows)
+{
+    clip_band *band = (clip_band *)arg;
+
+    pixel_clip_nv12(band->luma, band->chroma, band->stride, band->width,
+            band->height, row, rows, band->luma_max, band->chroma_max);
+}
+
+/*
+ * limit the pixels in YUV buffer between 0 and 252 for luma and
+ * 0 and 253 for chroma to avoid output video corruption due to
+ * video hardware limitation on msm8956 for mpeg4 encoding usecase.
+ */
+bool venc_dev::venc_get_clip_limits(OMX_U8 *luma_max, OMX_U8 *chroma_max)
+{
+    if (strncmp(m_platform, "msm8956", 7) ||
+            m_sVenc_cfg.codectype != V4L2_PIX_FMT_MPEG4)
+        return false;
+
+    *luma_max = 252;
+    *chroma_max = 253;
+    return true;
+}
+
 void venc_dev::venc_clip_luma_chroma(int fd, OMX_U32 offset, OMX_U32 size)
 {
-    unsigned char *luma = NULL, *chroma = NULL;
+    unsigned char *luma = NULL;
     unsigned int alignedWidth = 0, alignedHeight = 0;
+    clip_band band;
 
-    if (strncmp(m_platform, "msm8956", 7)) {
-        /* return as platform is not msm8956 */
-        return;
-    }
-
-    /*
-     * limit the pixels in YUV buffer between 0 and 252 for luma and
-     * 0 and 253 for chroma to avoid output video corruption due to
-     * video hardware limitation on msm8956 for mpeg4 encoding usecase.
-     */
-    if (m_sVenc_cfg.codectype != V4L2_PIX_FMT_MPEG4)
+    if (!venc_get_clip_limits(&band.luma_max, &band.chroma_max))
         return;
 
     if (size < VENUS_BUFFER_SIZE(COLOR_FMT_NV12, m_sVenc_cfg.input_width, m_sVenc_cfg.input_height)) {
@@ -6143,17 +6332,23 @@ void venc_dev::venc_clip_luma_chroma(int fd, OMX_U32 offset, OMX_U32 size)
     alignedWidth = VENUS_Y_STRIDE(COLOR_FMT_NV12, m_sVenc_cfg.input_width);
     alignedHeight = VENUS_Y_SCANLINES(COLOR_FMT_NV12, m_sVenc_cfg.input_height);
 
-    luma = (unsigned char *)mmap(NULL, size, PROT_READ|PROT_WRITE,
-            MAP_SHARED, fd, offset);
-    if(luma == MAP_FAILED) {
+    luma = (unsigned char *)venc_handle->m_input_maps.get(fd, offset, size);
+    if (!luma) {
         DEBUG_PRINT_ERROR("MMAP FAILED: returning from %s",__func__);
         return;
     }
-    chroma = luma + alignedWidth * alignedHeight;
-    DEBUG_PRINT_LOW("Clip pixels wxh = %ux%u, size = %u", alignedWidth, alignedHeight, size);
-    neon_clip_luma_chroma(luma, chroma, 252, 253, alignedWidth, alignedHeight);
+
+    /* Only the visible region, the padding is never displayed */
+    band.luma = luma;
+    band.chroma = luma + alignedWidth * alignedHeight;
+    band.stride = alignedWidth;
+    band.width = m_sVenc_cfg.input_width;
+    band.height = m_sVenc_cfg.input_height;
+    DEBUG_PRINT_LOW("Clip pixels wxh = %ux%u, stride = %u, size = %u",
+            band.width, band.height, band.stride, size);
+    venc_handle->m_band_executor.run(venc_clip_band, &band, band.height);
     DEBUG_PRINT_LOW("Clip pixels done");
-    munmap(luma, size);
+    venc_handle->m_input_maps.put(luma, size);
 
     return;
 }